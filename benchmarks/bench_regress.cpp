@@ -0,0 +1,479 @@
+// Performance regression check for the benchmark suites.
+//
+// Runs a suite with --benchmark_repetitions, or reads a results file it
+// wrote, and compares every benchmark with the same benchmark in a stored
+// baseline (the suite's own JSON). A benchmark has regressed when its
+// median time per iteration grew by more than --threshold and the
+// repetitions of the two runs differ beyond noise: a Mann-Whitney U test
+// (as in Google Benchmark's compare.py) must reject "same distribution" at
+// --alpha. Small samples without ties use the exact U distribution. When
+// there are too few repetitions for any p-value to fall below --alpha (3
+// against 3 cannot reach 0.05), only the threshold applies and a warning
+// says so. The exit code is 0 if nothing regressed, 1 if
+// something did and 2 on errors, so the check can gate a build.
+//
+// Usage: bench_regress --baseline=FILE (--suite=PROGRAM | --results=FILE)
+//                      [--update] [--repetitions=5] [--threshold=0.10]
+//                      [--alpha=0.05] [--metric=real|cpu] [--out=FILE]
+//                      [-- suite arguments...]
+//
+// --update (or a missing baseline) stores the new run as the baseline
+// instead of comparing. --out keeps the new run's results.
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Just enough JSON for the results files.
+struct JsonValue {
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+    Type type = NUL;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    // Member 'key' of an object, or null.
+    const JsonValue *get(const std::string &key) const {
+        for (const auto &member : members)
+            if (member.first == key)
+                return &member.second;
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string &text) : text_(text), pos_(0) {}
+
+    bool parse(JsonValue &value) {
+        if (!parseValue(value))
+            return false;
+        skipSpace();
+        return pos_ == text_.size();
+    }
+
+private:
+    void skipSpace() {
+        while (pos_ < text_.size() && isspace(static_cast<unsigned char>(text_[pos_])))
+            ++pos_;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool literal(const char *word) {
+        size_t length = strlen(word);
+        if (text_.compare(pos_, length, word) != 0)
+            return false;
+        pos_ += length;
+        return true;
+    }
+
+    bool parseString(std::string &out) {
+        if (!consume('"'))
+            return false;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if (c == '\\') {
+                if (pos_ >= text_.size())
+                    return false;
+                char escaped = text_[pos_++];
+                switch (escaped) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'u':
+                    // Names and labels are ASCII; keep the code point's low byte.
+                    if (pos_ + 4 > text_.size())
+                        return false;
+                    c = static_cast<char>(std::strtol(text_.substr(pos_, 4).c_str(), nullptr, 16));
+                    pos_ += 4;
+                    break;
+                default: c = escaped; break;
+                }
+            }
+            out += c;
+        }
+        return consume('"');
+    }
+
+    bool parseValue(JsonValue &value) {
+        skipSpace();
+        if (pos_ >= text_.size())
+            return false;
+        char c = text_[pos_];
+        if (c == '{') {
+            value.type = JsonValue::OBJECT;
+            ++pos_;
+            if (consume('}'))
+                return true;
+            do {
+                std::pair<std::string, JsonValue> member;
+                if (!parseString(member.first) || !consume(':') || !parseValue(member.second))
+                    return false;
+                value.members.push_back(std::move(member));
+            } while (consume(','));
+            return consume('}');
+        }
+        if (c == '[') {
+            value.type = JsonValue::ARRAY;
+            ++pos_;
+            if (consume(']'))
+                return true;
+            do {
+                value.items.emplace_back();
+                if (!parseValue(value.items.back()))
+                    return false;
+            } while (consume(','));
+            return consume(']');
+        }
+        if (c == '"') {
+            value.type = JsonValue::STRING;
+            return parseString(value.string);
+        }
+        if (literal("true") || literal("false")) {
+            value.type = JsonValue::BOOLEAN;
+            value.boolean = text_[pos_ - 4] == 't';
+            return true;
+        }
+        if (literal("null"))
+            return true;
+        const char *start = text_.c_str() + pos_;
+        char *end = nullptr;
+        value.type = JsonValue::NUMBER;
+        value.number = std::strtod(start, &end);
+        if (end == start)
+            return false;
+        pos_ += end - start;
+        return true;
+    }
+
+    const std::string &text_;
+    size_t pos_;
+};
+
+// Times per iteration of every benchmark's repetitions, by name, in the
+// order the suite ran them.
+struct Samples {
+    std::vector<std::string> names;
+    std::map<std::string, std::vector<double>> times;
+};
+
+static bool readSamples(const std::string &fileName, const std::string &metric, Samples &samples) {
+    std::ifstream file(fileName);
+    if (!file)
+        return false;
+    std::stringstream text;
+    text << file.rdbuf();
+    std::string json = text.str();
+    JsonValue root;
+    if (!JsonParser(json).parse(root)) {
+        std::cerr << fileName << " is not valid JSON" << std::endl;
+        return false;
+    }
+    const JsonValue *benchmarks = root.get("benchmarks");
+    if (benchmarks == nullptr || benchmarks->type != JsonValue::ARRAY) {
+        std::cerr << fileName << " has no benchmarks" << std::endl;
+        return false;
+    }
+    for (const JsonValue &benchmark : benchmarks->items) {
+        const JsonValue *name = benchmark.get("run_name");
+        if (name == nullptr)
+            name = benchmark.get("name");
+        const JsonValue *runType = benchmark.get("run_type");
+        const JsonValue *error = benchmark.get("error_occurred");
+        const JsonValue *time = benchmark.get(metric == "cpu" ? "cpu_time" : "real_time");
+        const JsonValue *unit = benchmark.get("time_unit");
+        // Aggregates are computed again from the repetitions.
+        if (name == nullptr || time == nullptr || (runType != nullptr && runType->string != "iteration") ||
+            (error != nullptr && error->boolean))
+            continue;
+        double scale = 1;
+        if (unit != nullptr) {
+            if (unit->string == "us") scale = 1e3;
+            else if (unit->string == "ms") scale = 1e6;
+            else if (unit->string == "s") scale = 1e9;
+        }
+        std::vector<double> &times = samples.times[name->string];
+        if (times.empty())
+            samples.names.push_back(name->string);
+        times.push_back(time->number * scale);
+    }
+    return true;
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Largest combined sample size whose p-value comes from the exact
+// distribution of U.
+static const size_t kExactSamples = 40;
+
+// For samples of sizes n1 and n2 without ties: the number of orderings of
+// their values with U (pairs in which the first sample's value is larger)
+// equal to u, for every u from 0 to n1 * n2.
+static std::vector<double> uCounts(size_t n1, size_t n2) {
+    // counts[i][j] for the i and j smallest values of each sample. The
+    // largest of them is the first sample's, larger than all j, or the
+    // second's.
+    std::vector<std::vector<std::vector<double>>> counts(n1 + 1, std::vector<std::vector<double>>(n2 + 1));
+    for (size_t i = 0; i <= n1; ++i) {
+        for (size_t j = 0; j <= n2; ++j) {
+            std::vector<double> &c = counts[i][j];
+            c.assign(i * j + 1, 0);
+            if (i == 0 || j == 0) {
+                c[0] = 1;
+                continue;
+            }
+            for (size_t u = 0; u <= i * j; ++u) {
+                if (u >= j)
+                    c[u] += counts[i - 1][j][u - j];
+                if (u <= i * (j - 1))
+                    c[u] += counts[i][j - 1][u];
+            }
+        }
+    }
+    return counts[n1][n2];
+}
+
+// Smallest two-sided p-value the test can give for samples of sizes n1 and
+// n2: that of the most extreme ordering, one of C(n1 + n2, n1).
+static double smallestPValue(size_t n1, size_t n2) {
+    double orderings = 1;
+    for (size_t k = 1; k <= n1; ++k)
+        orderings = orderings * (n2 + k) / k;
+    return std::min(1.0, 2 / orderings);
+}
+
+// Two-sided p-value of the Mann-Whitney U test that 'a' and 'b' come from
+// the same distribution: exact for small samples without ties, otherwise
+// by the normal approximation with tie correction.
+static double mannWhitneyPValue(const std::vector<double> &a, const std::vector<double> &b) {
+    std::vector<std::pair<double, int>> all;
+    for (double value : a)
+        all.push_back({value, 0});
+    for (double value : b)
+        all.push_back({value, 1});
+    std::sort(all.begin(), all.end());
+    double n1 = a.size(), n2 = b.size(), n = all.size();
+    double rankSumA = 0, tieTerm = 0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first)
+            ++j;
+        double rank = (i + 1 + j) / 2.0; // Mean of ranks i+1..j.
+        for (size_t k = i; k < j; ++k)
+            if (all[k].second == 0)
+                rankSumA += rank;
+        double ties = j - i;
+        tieTerm += ties * ties * ties - ties;
+        i = j;
+    }
+    double u = rankSumA - n1 * (n1 + 1) / 2;
+    if (tieTerm == 0 && all.size() <= kExactSamples) {
+        // U is symmetric around its mean; double the smaller tail.
+        std::vector<double> counts = uCounts(a.size(), b.size());
+        size_t tail = static_cast<size_t>(std::min(u, n1 * n2 - u));
+        double total = 0, extreme = 0;
+        for (size_t k = 0; k < counts.size(); ++k) {
+            total += counts[k];
+            if (k <= tail)
+                extreme += counts[k];
+        }
+        return std::min(1.0, 2 * extreme / total);
+    }
+    double mean = n1 * n2 / 2;
+    double variance = n1 * n2 / 12 * ((n + 1) - tieTerm / (n * (n - 1)));
+    if (variance <= 0)
+        return 1;
+    double z = (std::fabs(u - mean) - 0.5) / std::sqrt(variance);
+    return std::erfc(std::max(0.0, z) / std::sqrt(2.0));
+}
+
+static std::string shellQuote(const std::string &text) {
+    std::string quoted = "'";
+    for (char c : text) {
+        if (c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+    return quoted + "'";
+}
+
+static bool copyFile(const std::string &from, const std::string &to) {
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary);
+    out << in.rdbuf();
+    return in && out;
+}
+
+// Value of "--name=value" if 'arg' is that flag.
+static bool flagValue(const std::string &arg, const std::string &name, std::string &value) {
+    std::string prefix = "--" + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0)
+        return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::string baseline, suite, results, metric = "real", outFile;
+    std::vector<std::string> suiteArguments;
+    bool update = false;
+    int repetitions = 5;
+    double threshold = 0.10, alpha = 0.05;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i], value;
+        if (arg == "--") {
+            suiteArguments.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        if (flagValue(arg, "baseline", value))
+            baseline = value;
+        else if (flagValue(arg, "suite", value))
+            suite = value;
+        else if (flagValue(arg, "results", value))
+            results = value;
+        else if (flagValue(arg, "repetitions", value))
+            repetitions = std::max(1, std::atoi(value.c_str()));
+        else if (flagValue(arg, "threshold", value))
+            threshold = std::atof(value.c_str());
+        else if (flagValue(arg, "alpha", value))
+            alpha = std::atof(value.c_str());
+        else if (flagValue(arg, "metric", value) && (value == "real" || value == "cpu"))
+            metric = value;
+        else if (flagValue(arg, "out", value))
+            outFile = value;
+        else if (arg == "--update")
+            update = true;
+        else {
+            std::cerr << "invalid argument " << arg << std::endl;
+            return 2;
+        }
+    }
+    if (baseline.empty() || suite.empty() == results.empty()) {
+        std::cerr << "usage: bench_regress --baseline=FILE (--suite=PROGRAM | --results=FILE) [--update]"
+                     " [--repetitions=N] [--threshold=F] [--alpha=F] [--metric=real|cpu] [--out=FILE]"
+                     " [-- suite arguments]"
+                  << std::endl;
+        return 2;
+    }
+
+    bool temporary = false;
+    if (!suite.empty()) {
+        results = outFile;
+        if (results.empty()) {
+            char name[] = "/tmp/bench_regressXXXXXX";
+            int fd = mkstemp(name);
+            if (fd < 0) {
+                std::cerr << "cannot create a temporary file" << std::endl;
+                return 2;
+            }
+            close(fd);
+            results = name;
+            temporary = true;
+        }
+        std::string command = shellQuote(suite);
+        for (const std::string &arg : suiteArguments)
+            command += " " + shellQuote(arg);
+        command += " --benchmark_repetitions=" + std::to_string(repetitions) +
+                   " --benchmark_out=" + shellQuote(results);
+        std::cout << command << std::endl;
+        if (std::system(command.c_str()) != 0) {
+            std::cerr << "the suite failed" << std::endl;
+            if (temporary)
+                std::remove(results.c_str());
+            return 2;
+        }
+    }
+
+    Samples current, base;
+    bool haveResults = readSamples(results, metric, current);
+    bool haveBaseline = !update && readSamples(baseline, metric, base);
+    int status = 0;
+    if (!haveResults) {
+        std::cerr << "cannot read " << results << std::endl;
+        status = 2;
+    } else if (!haveBaseline) {
+        if (copyFile(results, baseline)) {
+            std::cout << "Stored " << current.names.size() << " benchmarks as the baseline in " << baseline
+                      << std::endl;
+        } else {
+            std::cerr << "cannot write " << baseline << std::endl;
+            status = 2;
+        }
+    } else {
+        char line[256];
+        snprintf(line, sizeof(line), "%-48s %14s %14s %9s %8s  %s", "Benchmark", "Baseline", "Current", "Change",
+                 "p", "Verdict");
+        std::cout << line << std::endl;
+        int regressions = 0, improvements = 0;
+        bool warned = false;
+        for (const std::string &name : current.names) {
+            auto found = base.times.find(name);
+            if (found == base.times.end()) {
+                snprintf(line, sizeof(line), "%-48s %14s", name.c_str(), "new");
+                std::cout << line << std::endl;
+                continue;
+            }
+            const std::vector<double> &before = found->second, &after = current.times[name];
+            double baseMedian = median(before), currentMedian = median(after);
+            double change = baseMedian > 0 ? currentMedian / baseMedian - 1 : 0;
+            bool tested = smallestPValue(before.size(), after.size()) < alpha;
+            if (!tested && !warned) {
+                std::cerr << "warning: " << before.size() << " and " << after.size()
+                          << " repetitions cannot reach p < " << alpha << " (at best "
+                          << smallestPValue(before.size(), after.size())
+                          << "); only the threshold applies to such benchmarks" << std::endl;
+                warned = true;
+            }
+            double p = tested ? mannWhitneyPValue(before, after) : 0;
+            const char *verdict = "";
+            if (std::fabs(change) > threshold && p < alpha) {
+                verdict = change > 0 ? "REGRESSION" : "improved";
+                ++(change > 0 ? regressions : improvements);
+            } else if (std::fabs(change) > threshold) {
+                verdict = "noise";
+            }
+            char pText[16] = "-";
+            if (tested)
+                snprintf(pText, sizeof(pText), "%.4f", p);
+            snprintf(line, sizeof(line), "%-48s %11.1f ns %11.1f ns %+8.1f%% %8s  %s", name.c_str(), baseMedian,
+                     currentMedian, change * 100, pText, verdict);
+            std::cout << line << std::endl;
+        }
+        for (const std::string &name : base.names)
+            if (current.times.count(name) == 0)
+                std::cout << name << " is missing from this run" << std::endl;
+        std::cout << regressions << " regressions and " << improvements << " improvements beyond "
+                  << threshold * 100 << "% (alpha " << alpha << ")" << std::endl;
+        status = regressions > 0 ? 1 : 0;
+    }
+    if (temporary)
+        std::remove(results.c_str());
+    return status;
+}
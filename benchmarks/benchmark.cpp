@@ -0,0 +1,264 @@
+#include "benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+static int64_t cpuNow() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+BenchmarkState::BenchmarkState(int64_t iterations)
+    : iterations_(iterations), remaining_(iterations), running_(false), cpuStart_(0), realNanoseconds_(0),
+      cpuNanoseconds_(0), items_(0), bytes_(0)
+{
+}
+
+void BenchmarkState::pauseTiming() {
+    if (!running_)
+        return;
+    running_ = false;
+    realNanoseconds_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - realStart_).count();
+    cpuNanoseconds_ += cpuNow() - cpuStart_;
+}
+
+void BenchmarkState::resumeTiming() {
+    if (running_)
+        return;
+    running_ = true;
+    cpuStart_ = cpuNow();
+    realStart_ = std::chrono::steady_clock::now();
+}
+
+// Value of "--name=value" if 'arg' is that flag.
+static bool flagValue(const std::string &arg, const std::string &name, std::string &value) {
+    std::string prefix = "--" + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0)
+        return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+BenchmarkSuite::BenchmarkSuite(int argc, char **argv)
+    : program_(argc > 0 ? argv[0] : "benchmark"), minTime_(0.5), repetitions_(1), json_(false), listOnly_(false)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i], value;
+        if (flagValue(arg, "benchmark_filter", value))
+            filter_ = value;
+        else if (flagValue(arg, "benchmark_min_time", value))
+            minTime_ = std::atof(value.c_str());
+        else if (flagValue(arg, "benchmark_repetitions", value))
+            repetitions_ = std::max(1, std::atoi(value.c_str()));
+        else if (flagValue(arg, "benchmark_format", value))
+            json_ = value == "json";
+        else if (flagValue(arg, "benchmark_out", value))
+            outFile_ = value;
+        else if (arg == "--benchmark_list_tests" || arg == "--benchmark_list_tests=true")
+            listOnly_ = true;
+        else
+            arguments_.push_back(arg);
+    }
+}
+
+void BenchmarkSuite::add(const std::string &name, Function function) {
+    benchmarks_.emplace_back(name, std::move(function));
+}
+
+BenchmarkSuite::Result BenchmarkSuite::measure(const std::string &name, Function &function) {
+    Result result;
+    result.name = name;
+    result.runName = name;
+    int64_t iterations = 1;
+    for (;;) {
+        BenchmarkState state(iterations);
+        function(state);
+        double seconds = state.realNanoseconds_ / 1e9;
+        result.iterations = iterations;
+        result.realNanoseconds = static_cast<double>(state.realNanoseconds_) / iterations;
+        result.cpuNanoseconds = static_cast<double>(state.cpuNanoseconds_) / iterations;
+        result.itemsPerSecond = seconds > 0 ? state.items_ / seconds : 0;
+        result.bytesPerSecond = seconds > 0 ? state.bytes_ / seconds : 0;
+        result.label = state.label_;
+        result.error = state.error_;
+        if (!state.error_.empty() || seconds >= minTime_ || iterations >= 1000000000)
+            return result;
+        // Aim 40% past the minimum time, growing at most tenfold per round.
+        double multiplier = seconds > 0 ? minTime_ * 1.4 / seconds : 10;
+        iterations = static_cast<int64_t>(iterations * std::min(10.0, std::max(multiplier, 1.0)) + 1);
+    }
+}
+
+void BenchmarkSuite::addAggregates(const std::vector<Result> &runs, std::vector<Result> &results) {
+    if (runs.size() < 2 || !runs[0].error.empty())
+        return;
+    auto statistic = [&](const std::string &aggregate, std::function<double(std::vector<double>)> compute) {
+        Result result = runs[0];
+        result.name = runs[0].runName + "_" + aggregate;
+        result.aggregate = aggregate;
+        result.iterations = static_cast<int64_t>(runs.size());
+        auto field = [&](double Result::*member) {
+            std::vector<double> values;
+            for (const Result &run : runs)
+                values.push_back(run.*member);
+            return compute(values);
+        };
+        result.realNanoseconds = field(&Result::realNanoseconds);
+        result.cpuNanoseconds = field(&Result::cpuNanoseconds);
+        result.itemsPerSecond = field(&Result::itemsPerSecond);
+        result.bytesPerSecond = field(&Result::bytesPerSecond);
+        results.push_back(result);
+        printConsole(result);
+    };
+    auto mean = [](std::vector<double> values) {
+        double sum = 0;
+        for (double value : values)
+            sum += value;
+        return sum / values.size();
+    };
+    statistic("mean", mean);
+    statistic("median", [](std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        size_t n = values.size();
+        return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    });
+    statistic("stddev", [&](std::vector<double> values) {
+        double average = mean(values), sum = 0;
+        for (double value : values)
+            sum += (value - average) * (value - average);
+        return std::sqrt(sum / (values.size() - 1));
+    });
+}
+
+void BenchmarkSuite::printConsole(const Result &result) {
+    if (json_)
+        return;
+    char line[256];
+    if (!result.error.empty()) {
+        snprintf(line, sizeof(line), "%-48s ERROR: %s", result.name.c_str(), result.error.c_str());
+        std::cout << line << std::endl;
+        return;
+    }
+    snprintf(line, sizeof(line), "%-48s %12.1f ns %12.1f ns %12lld", result.name.c_str(), result.realNanoseconds,
+             result.cpuNanoseconds, static_cast<long long>(result.iterations));
+    std::string text = line;
+    if (result.bytesPerSecond > 0) {
+        snprintf(line, sizeof(line), " %9.1f MB/s", result.bytesPerSecond / 1e6);
+        text += line;
+    }
+    if (result.itemsPerSecond > 0) {
+        snprintf(line, sizeof(line), " %9.3f M items/s", result.itemsPerSecond / 1e6);
+        text += line;
+    }
+    if (!result.label.empty())
+        text += " " + result.label;
+    std::cout << text << std::endl;
+}
+
+static std::string jsonString(const std::string &text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+std::string BenchmarkSuite::toJson(const std::vector<Result> &results) const {
+    std::ostringstream out;
+    char date[64];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": " << jsonString(date) << ",\n"
+        << "    \"host_name\": " << jsonString(host) << ",\n"
+        << "    \"executable\": " << jsonString(program_) << ",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+#ifdef NDEBUG
+        << "    \"library_build_type\": \"release\"\n"
+#else
+        << "    \"library_build_type\": \"debug\"\n"
+#endif
+        << "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &result = results[i];
+        out << (i ? ",\n" : "\n") << "    {\n"
+            << "      \"name\": " << jsonString(result.name) << ",\n"
+            << "      \"run_name\": " << jsonString(result.runName) << ",\n"
+            << "      \"run_type\": " << (result.aggregate.empty() ? "\"iteration\"" : "\"aggregate\"") << ",\n";
+        if (!result.aggregate.empty())
+            out << "      \"aggregate_name\": " << jsonString(result.aggregate) << ",\n";
+        if (!result.error.empty()) {
+            out << "      \"error_occurred\": true,\n"
+                << "      \"error_message\": " << jsonString(result.error) << "\n    }";
+            continue;
+        }
+        out << "      \"iterations\": " << result.iterations << ",\n"
+            << "      \"real_time\": " << result.realNanoseconds << ",\n"
+            << "      \"cpu_time\": " << result.cpuNanoseconds << ",\n"
+            << "      \"time_unit\": \"ns\"";
+        if (result.bytesPerSecond > 0)
+            out << ",\n      \"bytes_per_second\": " << result.bytesPerSecond;
+        if (result.itemsPerSecond > 0)
+            out << ",\n      \"items_per_second\": " << result.itemsPerSecond;
+        if (!result.label.empty())
+            out << ",\n      \"label\": " << jsonString(result.label);
+        out << "\n    }";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+int BenchmarkSuite::run() {
+    std::regex filter(filter_.empty() ? ".*" : filter_);
+    std::vector<Result> results;
+    if (!json_ && !listOnly_) {
+        char header[256];
+        snprintf(header, sizeof(header), "%-48s %15s %15s %12s", "Benchmark", "Time", "CPU", "Iterations");
+        std::cout << header << std::endl;
+    }
+    bool failed = false;
+    for (auto &benchmark : benchmarks_) {
+        if (!std::regex_search(benchmark.first, filter))
+            continue;
+        if (listOnly_) {
+            std::cout << benchmark.first << std::endl;
+            continue;
+        }
+        std::vector<Result> runs;
+        for (int r = 0; r < repetitions_; ++r) {
+            runs.push_back(measure(benchmark.first, benchmark.second));
+            failed = failed || !runs.back().error.empty();
+            printConsole(runs.back());
+        }
+        results.insert(results.end(), runs.begin(), runs.end());
+        addAggregates(runs, results);
+    }
+    if (listOnly_)
+        return 0;
+    std::string json = toJson(results);
+    if (json_)
+        std::cout << json;
+    if (!outFile_.empty()) {
+        std::ofstream out(outFile_);
+        out << json;
+        if (!out) {
+            std::cerr << "cannot write " << outFile_ << std::endl;
+            return 1;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Small microbenchmark harness modelled on Google Benchmark, so that its
+// results can be compared with the same tools: every benchmark is run for
+// enough iterations to take --benchmark_min_time seconds, and the results
+// are printed as a table or written as Google Benchmark JSON.
+//
+// Flags:
+//   --benchmark_filter=<regex>       Run only the benchmarks whose name matches.
+//   --benchmark_min_time=<seconds>   Time each measurement runs for (default 0.5).
+//   --benchmark_repetitions=<n>      Measurements per benchmark; with more than
+//                                    one, mean, median and stddev are added.
+//   --benchmark_format=console|json  Output on stdout.
+//   --benchmark_out=<file>           Also write JSON to 'file'.
+//   --benchmark_list_tests           Print the names and exit.
+
+// Passed to a benchmark function, which runs the measured code in
+//
+//   while (state.keepRunning()) { ... }
+//
+// Setup before the loop is not timed; pauseTiming()/resumeTiming() leave
+// out work inside it.
+class BenchmarkState {
+public:
+    explicit BenchmarkState(int64_t iterations);
+
+    bool keepRunning() {
+        if (remaining_ > 0) {
+            if (remaining_-- == iterations_)
+                resumeTiming();
+            return true;
+        }
+        pauseTiming();
+        return false;
+    }
+
+    void pauseTiming();
+    void resumeTiming();
+
+    int64_t iterations() const { return iterations_; }
+
+    // Reported per second of real time.
+    void setItemsProcessed(int64_t items) { items_ = items; }
+    void setBytesProcessed(int64_t bytes) { bytes_ = bytes; }
+    void setLabel(const std::string &label) { label_ = label; }
+
+    // Marks the run as failed; it is reported with the message instead of times.
+    void skipWithError(const std::string &message) { error_ = message; remaining_ = 0; }
+
+private:
+    friend class BenchmarkSuite;
+
+    int64_t iterations_;
+    int64_t remaining_;
+    bool running_;
+    std::chrono::steady_clock::time_point realStart_;
+    int64_t cpuStart_;
+    int64_t realNanoseconds_;
+    int64_t cpuNanoseconds_;
+    int64_t items_;
+    int64_t bytes_;
+    std::string label_;
+    std::string error_;
+};
+
+// Keeps the compiler from discarding a value that is computed but not used.
+template <typename T>
+inline void doNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// The benchmarks of one executable.
+class BenchmarkSuite {
+public:
+    typedef std::function<void(BenchmarkState &)> Function;
+
+    // Reads the flags above; unknown arguments are left for the caller in
+    // getArguments().
+    BenchmarkSuite(int argc, char **argv);
+
+    void add(const std::string &name, Function function);
+
+    // Runs the benchmarks in the order they were added and prints the
+    // results. Returns the exit code for main().
+    int run();
+
+    const std::vector<std::string> &getArguments() const { return arguments_; }
+
+private:
+    struct Result {
+        std::string name;
+        std::string runName;
+        std::string aggregate; // "mean", "median", "stddev" or empty.
+        int64_t iterations;
+        double realNanoseconds; // Per iteration.
+        double cpuNanoseconds;
+        double itemsPerSecond;
+        double bytesPerSecond;
+        std::string label;
+        std::string error;
+    };
+
+    // One measurement of 'function': iterations are raised until it runs
+    // for the minimum time.
+    Result measure(const std::string &name, Function &function);
+    void addAggregates(const std::vector<Result> &runs, std::vector<Result> &results);
+    void printConsole(const Result &result);
+    std::string toJson(const std::vector<Result> &results) const;
+
+    std::vector<std::pair<std::string, Function>> benchmarks_;
+    std::vector<std::string> arguments_;
+    std::string program_;
+    std::string filter_;
+    double minTime_;
+    int repetitions_;
+    bool json_;
+    bool listOnly_;
+    std::string outFile_;
+};
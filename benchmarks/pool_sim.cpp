@@ -0,0 +1,328 @@
+// Replays a page trace recorded by PageTraceWriter (BufferPool::setPageTrace,
+// DatabaseOptions::pageTraceFile or ycsb_bench --trace) against buffer
+// replacement policies at many pool sizes, and prints the hit ratio of each:
+//
+//   LRU    least recently used, as BufferPool evicts today
+//   CLOCK  second chance with one reference bit per frame
+//   LRU-2  LRU-K with K = 2 (O'Neil et al.): evicts the page whose second
+//          most recent request is oldest; history is kept for evicted pages
+//   ARC    adaptive replacement cache (Megiddo and Modha)
+//
+// Only fixPage() requests count; unfixes and pins are ignored, so every
+// frame can always be evicted. The curves are hit ratio over pool size,
+// which is what sizing the pool and choosing a policy needs.
+//
+// Usage: pool_sim TRACE [--sizes=16,64,256,...] [--policies=lru,clock,lru2,arc] [--csv]
+//
+// By default the sizes are the powers of two from 16 up to the number of
+// distinct pages in the trace.
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "../storage_engine/page_trace.h"
+
+// A replacement policy over pages numbered 0..pageCount-1.
+class Policy {
+public:
+    virtual ~Policy() {}
+    // Requests 'page'; returns whether it was resident.
+    virtual bool access(int page) = 0;
+};
+
+class LruPolicy : public Policy {
+public:
+    LruPolicy(int frames, int pageCount) : frames_(frames), position_(pageCount, order_.end()), resident_(pageCount) {}
+
+    bool access(int page) override {
+        if (resident_[page]) {
+            order_.splice(order_.begin(), order_, position_[page]);
+            return true;
+        }
+        if (static_cast<int>(order_.size()) == frames_) {
+            resident_[order_.back()] = false;
+            order_.pop_back();
+        }
+        order_.push_front(page);
+        position_[page] = order_.begin();
+        resident_[page] = true;
+        return false;
+    }
+
+private:
+    int frames_;
+    std::list<int> order_; // Most recently used first.
+    std::vector<std::list<int>::iterator> position_;
+    std::vector<bool> resident_;
+};
+
+class ClockPolicy : public Policy {
+public:
+    ClockPolicy(int frames, int pageCount) : pages_(frames, -1), referenced_(frames), frameOf_(pageCount, -1), hand_(0) {}
+
+    bool access(int page) override {
+        if (frameOf_[page] >= 0) {
+            referenced_[frameOf_[page]] = true;
+            return true;
+        }
+        // Clear reference bits until a frame without one comes up.
+        while (pages_[hand_] >= 0 && referenced_[hand_]) {
+            referenced_[hand_] = false;
+            hand_ = (hand_ + 1) % pages_.size();
+        }
+        if (pages_[hand_] >= 0)
+            frameOf_[pages_[hand_]] = -1;
+        pages_[hand_] = page;
+        referenced_[hand_] = true;
+        frameOf_[page] = static_cast<int>(hand_);
+        hand_ = (hand_ + 1) % pages_.size();
+        return false;
+    }
+
+private:
+    std::vector<int> pages_; // By frame; -1 if empty.
+    std::vector<bool> referenced_;
+    std::vector<int> frameOf_;
+    size_t hand_;
+};
+
+class Lru2Policy : public Policy {
+public:
+    Lru2Policy(int frames, int pageCount)
+        : frames_(frames), last_(pageCount, 0), secondLast_(pageCount, 0), resident_(pageCount), time_(0) {}
+
+    bool access(int page) override {
+        ++time_;
+        bool hit = resident_[page];
+        if (hit) {
+            order_.erase(key(page));
+        } else {
+            if (static_cast<int>(order_.size()) == frames_) {
+                // Pages requested once have no second request (time 0) and
+                // go first, least recently used among them first.
+                int victim = std::get<2>(*order_.begin());
+                order_.erase(order_.begin());
+                resident_[victim] = false;
+            }
+            resident_[page] = true;
+        }
+        secondLast_[page] = last_[page];
+        last_[page] = time_;
+        order_.insert(key(page));
+        return hit;
+    }
+
+private:
+    std::tuple<uint64_t, uint64_t, int> key(int page) const {
+        return std::make_tuple(secondLast_[page], last_[page], page);
+    }
+
+    int frames_;
+    std::vector<uint64_t> last_;       // Time of the latest request, 0 if none.
+    std::vector<uint64_t> secondLast_; // Time of the one before, 0 if none.
+    std::vector<bool> resident_;
+    std::set<std::tuple<uint64_t, uint64_t, int>> order_; // Resident pages, first evicted first.
+    uint64_t time_;
+};
+
+class ArcPolicy : public Policy {
+public:
+    ArcPolicy(int frames, int pageCount)
+        : capacity_(frames), target_(0), list_(pageCount, NONE), position_(pageCount) {}
+
+    bool access(int page) override {
+        switch (list_[page]) {
+        case T1:
+        case T2:
+            move(page, T2);
+            return true;
+        case B1:
+            target_ = std::min<double>(capacity_, target_ + std::max<double>(1.0, size(B2) / double(size(B1))));
+            replace(false);
+            move(page, T2);
+            return false;
+        case B2:
+            target_ = std::max<double>(0, target_ - std::max<double>(1.0, size(B1) / double(size(B2))));
+            replace(true);
+            move(page, T2);
+            return false;
+        case NONE:
+            break;
+        }
+        size_t t1b1 = size(T1) + size(B1);
+        size_t total = t1b1 + size(T2) + size(B2);
+        if (t1b1 == capacity_) {
+            if (size(T1) < capacity_) {
+                drop(B1);
+                replace(false);
+            } else {
+                drop(T1);
+            }
+        } else if (total >= capacity_) {
+            if (total == 2 * capacity_)
+                drop(B2);
+            replace(false);
+        }
+        move(page, T1);
+        return false;
+    }
+
+private:
+    enum List { T1, T2, B1, B2, NONE };
+
+    size_t size(List list) const { return lists_[list].size(); }
+
+    // Makes 'page' the most recent entry of 'list'.
+    void move(int page, List list) {
+        if (list_[page] != NONE)
+            lists_[list_[page]].erase(position_[page]);
+        lists_[list].push_front(page);
+        position_[page] = lists_[list].begin();
+        list_[page] = list;
+    }
+
+    // Forgets the least recent entry of 'list'.
+    void drop(List list) {
+        int page = lists_[list].back();
+        lists_[list].pop_back();
+        list_[page] = NONE;
+    }
+
+    // Evicts from T1 or T2, by the target size of T1, into its ghost list.
+    void replace(bool requestInB2) {
+        if (size(T1) > 0 && (size(T1) > target_ || (requestInB2 && size(T1) == target_)))
+            move(lists_[T1].back(), B1);
+        else if (size(T2) > 0)
+            move(lists_[T2].back(), B2);
+    }
+
+    size_t capacity_;
+    double target_; // Target size of T1.
+    std::list<int> lists_[4];
+    std::vector<List> list_;
+    std::vector<std::list<int>::iterator> position_;
+};
+
+static std::unique_ptr<Policy> makePolicy(const std::string &name, int frames, int pageCount) {
+    if (name == "lru") return std::unique_ptr<Policy>(new LruPolicy(frames, pageCount));
+    if (name == "clock") return std::unique_ptr<Policy>(new ClockPolicy(frames, pageCount));
+    if (name == "lru2") return std::unique_ptr<Policy>(new Lru2Policy(frames, pageCount));
+    if (name == "arc") return std::unique_ptr<Policy>(new ArcPolicy(frames, pageCount));
+    return nullptr;
+}
+
+static std::vector<std::string> split(const std::string &text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+// Value of "--name=value" if 'arg' is that flag.
+static bool flagValue(const std::string &arg, const std::string &name, std::string &value) {
+    std::string prefix = "--" + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0)
+        return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::string traceFile;
+    std::vector<int> sizes;
+    std::vector<std::string> policies = {"lru", "clock", "lru2", "arc"};
+    bool csv = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i], value;
+        if (flagValue(arg, "sizes", value)) {
+            for (const std::string &size : split(value))
+                sizes.push_back(std::max(1, std::atoi(size.c_str())));
+        } else if (flagValue(arg, "policies", value)) {
+            policies = split(value);
+        } else if (arg == "--csv") {
+            csv = true;
+        } else if (arg.compare(0, 2, "--") != 0 && traceFile.empty()) {
+            traceFile = arg;
+        } else {
+            std::cerr << "invalid argument " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (traceFile.empty() || policies.empty()) {
+        std::cerr << "usage: pool_sim TRACE [--sizes=16,64,...] [--policies=lru,clock,lru2,arc] [--csv]" << std::endl;
+        return 1;
+    }
+    for (const std::string &policy : policies) {
+        if (!makePolicy(policy, 1, 1)) {
+            std::cerr << "unknown policy " << policy << std::endl;
+            return 1;
+        }
+    }
+
+    // The requests, with page ids numbered densely in order of appearance.
+    PageTraceReader reader;
+    if (!reader.open(traceFile)) {
+        std::cerr << "cannot read page trace " << traceFile << std::endl;
+        return 1;
+    }
+    std::vector<int> requests;
+    std::unordered_map<int, int> pageNumbers;
+    uint64_t writes = 0;
+    PageAccess access;
+    while (reader.next(access)) {
+        if (access.isUnfix)
+            continue;
+        auto inserted = pageNumbers.emplace(access.pageId, static_cast<int>(pageNumbers.size()));
+        requests.push_back(inserted.first->second);
+        writes += access.isWrite;
+    }
+    int pageCount = static_cast<int>(pageNumbers.size());
+    if (requests.empty()) {
+        std::cerr << traceFile << " has no page requests" << std::endl;
+        return 1;
+    }
+    if (sizes.empty()) {
+        for (int size = 16; size < pageCount; size *= 2)
+            sizes.push_back(size);
+        sizes.push_back(std::max(1, pageCount));
+    }
+
+    if (!csv) {
+        std::cout << requests.size() << " requests (" << 100.0 * writes / requests.size() << "% writes) to "
+                  << pageCount << " pages; hit ratio in % by pool size" << std::endl;
+    }
+    std::string header = csv ? "frames" : "    frames";
+    char cell[64];
+    for (const std::string &policy : policies) {
+        std::string upper = policy == "lru2" ? "LRU-2" : policy;
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        snprintf(cell, sizeof(cell), csv ? ",%s" : " %9s", upper.c_str());
+        header += cell;
+    }
+    std::cout << header << std::endl;
+    for (int frames : sizes) {
+        snprintf(cell, sizeof(cell), csv ? "%d" : "%10d", frames);
+        std::string line = cell;
+        for (const std::string &name : policies) {
+            std::unique_ptr<Policy> policy = makePolicy(name, frames, pageCount);
+            uint64_t hits = 0;
+            for (int page : requests)
+                hits += policy->access(page);
+            snprintf(cell, sizeof(cell), csv ? ",%.4f" : " %9.2f", 100.0 * hits / requests.size());
+            line += cell;
+        }
+        std::cout << line << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+// Microbenchmarks of the storage layer: slotted page operations at several
+// record sizes, page (de)serialization, DiskManager sequential and random
+// page I/O, and the BufferPool::fixPage hit, clean-miss and dirty-miss
+// paths at several pool sizes.
+//
+// The data files are small enough to stay in the OS page cache, so the
+// I/O benchmarks measure the system call and copy path rather than the
+// device; drop the caches between runs to measure the device.
+//
+// Usage: storage_bench [directory] [--benchmark_... flags, see benchmark.h]
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../storage_engine/bufferpool.h"
+#include "../storage_engine/diskmanager.h"
+#include "../storage_engine/page.h"
+#include "benchmark.h"
+
+static const int kRecordSizes[] = {16, 64, 256, 1024};
+static const int kPoolSizes[] = {64, 1024, 8192};
+static const int kDiskPages = 4096; // 16 MB.
+// Pages filled or emptied between two pauses of the page benchmarks, so
+// that refilling them (and pausing the clocks) is rare.
+static const size_t kScratchPages = 256;
+
+// Inserts records of 'size' bytes until the page is full; returns how many.
+static int fillPage(Page &page, const std::vector<char> &record) {
+    page.clear();
+    int count = 0;
+    while (page.insertRecord(record.data(), static_cast<int>(record.size())) >= 0)
+        ++count;
+    return count;
+}
+
+static void addPageBenchmarks(BenchmarkSuite &suite) {
+    for (int size : kRecordSizes) {
+        std::string suffix = "/" + std::to_string(size);
+
+        suite.add("Page/insertRecord" + suffix, [size](BenchmarkState &state) {
+            std::vector<char> record(size, 'x');
+            std::vector<Page> pages(kScratchPages);
+            size_t current = 0;
+            while (state.keepRunning()) {
+                if (pages[current].insertRecord(record.data(), size) >= 0)
+                    continue;
+                if (++current == pages.size()) {
+                    state.pauseTiming();
+                    for (Page &page : pages)
+                        page.clear();
+                    current = 0;
+                    state.resumeTiming();
+                }
+                pages[current].insertRecord(record.data(), size);
+            }
+            state.setItemsProcessed(state.iterations());
+            state.setBytesProcessed(state.iterations() * size);
+        });
+
+        suite.add("Page/getRecord" + suffix, [size](BenchmarkState &state) {
+            std::vector<char> record(size, 'x'), buffer(size);
+            Page page;
+            int count = fillPage(page, record);
+            int slot = 0;
+            while (state.keepRunning()) {
+                doNotOptimize(page.getRecord(slot, buffer.data()));
+                if (++slot == count)
+                    slot = 0;
+            }
+            state.setItemsProcessed(state.iterations());
+            state.setBytesProcessed(state.iterations() * size);
+        });
+
+        // Deletes in random order: every delete compacts the record data
+        // behind the deleted record.
+        suite.add("Page/deleteRecord" + suffix, [size](BenchmarkState &state) {
+            std::vector<char> record(size, 'x');
+            std::vector<Page> pages(kScratchPages);
+            int count = 0;
+            for (Page &page : pages)
+                count = fillPage(page, record);
+            std::vector<int> order(count);
+            for (int i = 0; i < count; ++i)
+                order[i] = i;
+            std::shuffle(order.begin(), order.end(), std::mt19937(42));
+            size_t current = 0;
+            int next = 0;
+            while (state.keepRunning()) {
+                if (next == count) {
+                    next = 0;
+                    if (++current == pages.size()) {
+                        state.pauseTiming();
+                        for (Page &page : pages)
+                            fillPage(page, record);
+                        current = 0;
+                        state.resumeTiming();
+                    }
+                }
+                doNotOptimize(pages[current].deleteRecord(order[next++]));
+            }
+            state.setItemsProcessed(state.iterations());
+        });
+    }
+
+    suite.add("Page/serialize", [](BenchmarkState &state) {
+        Page page;
+        fillPage(page, std::vector<char>(64, 'x'));
+        std::vector<char> buffer(PAGE_SIZE);
+        while (state.keepRunning()) {
+            page.serialize(buffer.data());
+            doNotOptimize(buffer[0]);
+        }
+        state.setBytesProcessed(state.iterations() * PAGE_SIZE);
+    });
+
+    suite.add("Page/deserialize", [](BenchmarkState &state) {
+        Page page;
+        fillPage(page, std::vector<char>(64, 'x'));
+        std::vector<char> buffer(PAGE_SIZE);
+        page.serialize(buffer.data());
+        while (state.keepRunning()) {
+            page.deserialize(buffer.data());
+            doNotOptimize(page.getNumberOfSlots());
+        }
+        state.setBytesProcessed(state.iterations() * PAGE_SIZE);
+    });
+}
+
+// Creates 'fileName' with 'numPages' pages of 64-byte records.
+static bool createFile(const std::string &fileName, int numPages) {
+    std::remove(fileName.c_str());
+    DiskManager disk(fileName);
+    Page page;
+    fillPage(page, std::vector<char>(64, 'x'));
+    for (int pageId = 0; pageId < numPages; ++pageId) {
+        page.setPageId(pageId);
+        if (!disk.writePage(pageId, page))
+            return false;
+    }
+    return true;
+}
+
+// Page ids 0..numPages-1 in sequential or (seeded) random order.
+static std::vector<int> pageOrder(int numPages, bool random) {
+    std::vector<int> order(numPages);
+    for (int i = 0; i < numPages; ++i)
+        order[i] = i;
+    if (random)
+        std::shuffle(order.begin(), order.end(), std::mt19937(7));
+    return order;
+}
+
+static void addDiskBenchmarks(BenchmarkSuite &suite, const std::string &fileName) {
+    for (bool random : {false, true}) {
+        std::string pattern = random ? "random" : "sequential";
+
+        suite.add("DiskManager/readPage/" + pattern, [=](BenchmarkState &state) {
+            DiskManager disk(fileName);
+            std::vector<int> order = pageOrder(disk.getNumberOfPages(), random);
+            Page page;
+            size_t next = 0;
+            while (state.keepRunning()) {
+                if (!disk.readPage(order[next], page)) {
+                    state.skipWithError("read failed");
+                    break;
+                }
+                if (++next == order.size())
+                    next = 0;
+            }
+            state.setItemsProcessed(state.iterations());
+            state.setBytesProcessed(state.iterations() * PAGE_SIZE);
+        });
+
+        suite.add("DiskManager/writePage/" + pattern, [=](BenchmarkState &state) {
+            DiskManager disk(fileName);
+            std::vector<int> order = pageOrder(disk.getNumberOfPages(), random);
+            Page page;
+            fillPage(page, std::vector<char>(64, 'y'));
+            size_t next = 0;
+            while (state.keepRunning()) {
+                page.setPageId(order[next]);
+                if (!disk.writePage(order[next], page)) {
+                    state.skipWithError("write failed");
+                    break;
+                }
+                if (++next == order.size())
+                    next = 0;
+            }
+            state.setItemsProcessed(state.iterations());
+            state.setBytesProcessed(state.iterations() * PAGE_SIZE);
+        });
+    }
+
+    // One vectored read per DiskManager::kMaxPagesPerRead pages.
+    suite.add("DiskManager/readPages/sequential", [=](BenchmarkState &state) {
+        DiskManager disk(fileName);
+        const int run = DiskManager::kMaxPagesPerRead;
+        std::vector<Page> pages(run);
+        std::vector<Page *> pointers;
+        for (Page &page : pages)
+            pointers.push_back(&page);
+        int first = 0;
+        while (state.keepRunning()) {
+            if (!disk.readPages(first, run, pointers.data())) {
+                state.skipWithError("read failed");
+                break;
+            }
+            first += run;
+            if (first + run > disk.getNumberOfPages())
+                first = 0;
+        }
+        state.setItemsProcessed(state.iterations() * run);
+        state.setBytesProcessed(state.iterations() * run * PAGE_SIZE);
+    });
+}
+
+static void addBufferPoolBenchmarks(BenchmarkSuite &suite, const std::string &fileName) {
+    for (int poolSize : kPoolSizes) {
+        std::string suffix = "/" + std::to_string(poolSize);
+
+        // Cycles over half the pool's worth of pages, which all stay cached.
+        suite.add("BufferPool/fixPage/hit" + suffix, [=](BenchmarkState &state) {
+            DiskManager disk(fileName);
+            BufferPool pool(poolSize, &disk);
+            int workingSet = std::max(1, poolSize / 2);
+            for (int pageId = 0; pageId < workingSet; ++pageId)
+                pool.unfixPage(pool.fixPage(pageId, false), false);
+            int pageId = 0;
+            while (state.keepRunning()) {
+                Page *page = pool.fixPage(pageId, false);
+                pool.unfixPage(page, false);
+                if (++pageId == workingSet)
+                    pageId = 0;
+            }
+            state.setItemsProcessed(state.iterations());
+        });
+
+        // Cycles over twice the pool's worth of pages, so with LRU every fix
+        // misses and evicts the page fixed a pool size earlier. Dirty misses
+        // write that page back first.
+        for (bool dirty : {false, true}) {
+            suite.add(std::string("BufferPool/fixPage/") + (dirty ? "missDirty" : "missClean") + suffix,
+                      [=](BenchmarkState &state) {
+                DiskManager disk(fileName);
+                BufferPool pool(poolSize, &disk);
+                int cycle = std::min(2 * poolSize, disk.getNumberOfPages());
+                if (cycle <= poolSize) {
+                    state.skipWithError("data file smaller than twice the pool");
+                    return;
+                }
+                int pageId = 0;
+                while (state.keepRunning()) {
+                    Page *page = pool.fixPage(pageId, dirty);
+                    if (page == nullptr) {
+                        state.skipWithError("fix failed");
+                        break;
+                    }
+                    pool.unfixPage(page, dirty);
+                    if (++pageId == cycle)
+                        pageId = 0;
+                }
+                // The pages left dirty are written back by the pool's
+                // destructor, after the timed loop.
+                state.setItemsProcessed(state.iterations());
+            });
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    BenchmarkSuite suite(argc, argv);
+    std::string directory = suite.getArguments().empty() ? "." : suite.getArguments()[0];
+    std::string diskFile = directory + "/storage_bench_disk.db";
+    std::string poolFile = directory + "/storage_bench_pool.db";
+    int poolPages = 2 * *std::max_element(std::begin(kPoolSizes), std::end(kPoolSizes));
+    if (!createFile(diskFile, kDiskPages) || !createFile(poolFile, poolPages)) {
+        fprintf(stderr, "cannot create data files in %s\n", directory.c_str());
+        return 1;
+    }
+
+    addPageBenchmarks(suite);
+    addDiskBenchmarks(suite, diskFile);
+    addBufferPoolBenchmarks(suite, poolFile);
+    int status = suite.run();
+    std::remove(diskFile.c_str());
+    std::remove(poolFile.c_str());
+    return status;
+}
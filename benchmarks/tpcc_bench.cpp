@@ -0,0 +1,1007 @@
+// Simplified TPC-C over the storage engine's record and index APIs: every
+// table is a HeapFile of fixed-layout rows with BPlusTree indexes on its
+// keys, as the query engine would store it, and the five transactions are
+// written directly against them.
+//
+// What is kept from the specification: the nine tables and their scaling
+// (10 districts per warehouse, --customers per district, --items items and
+// as many stock rows per warehouse), the initial orders, the transaction
+// mix (45% New-Order, 43% Payment, 4% each Order-Status, Delivery and
+// Stock-Level), NURand key choice, customer lookup by last name, remote
+// supply warehouses and remote customers, and the 1% of New-Orders that
+// roll back on an unused item number. Rows carry the columns the
+// transactions read or write; the rest is filler of roughly the specified
+// size. There are no think times or keying times, so every client runs
+// transactions back to back.
+//
+// The engine has no transactions, so isolation comes from a latch per
+// warehouse: a transaction latches the warehouses it touches, in warehouse
+// order, exclusively if it writes them. Each warehouse's rows live in their
+// own heap files, so no page is shared between warehouses. New-Order checks
+// its items before it writes anything, so a rollback has nothing to undo.
+//
+// For every warehouse count the database is loaded afresh, then every
+// thread count runs for --duration seconds on it; clients are spread over
+// the warehouses. The result is tpmC (New-Orders committed per minute) and
+// the abort rate of every transaction type.
+//
+// Usage: tpcc_bench [--warehouses=1,2,4] [--threads=1,4,8] [--duration=10]
+//                   [--items=100000] [--customers=3000] [--pool=16384]
+//                   [--dir=.] [--out=results.json]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "benchmark.h"
+#include "../storage_engine/bplustree.h"
+#include "../storage_engine/bufferpool.h"
+#include "../storage_engine/diskmanager.h"
+#include "../storage_engine/heapfilemanager.h"
+
+static const int kDistrictsPerWarehouse = 10;
+// Order ids per district, for composite keys.
+static const int64_t kOrderIdSpace = 100000000;
+static const int64_t kCustomerIdSpace = 100000;
+static const int kMaxOrderLines = 15;
+
+struct Options {
+    std::vector<int> warehouseCounts = {1};
+    std::vector<int> threadCounts = {1, 4};
+    double duration = 10;
+    int items = 100000;
+    int customers = 3000; // Per district; also the initial orders per district.
+    int poolSize = 16384;
+    std::string directory = ".";
+    std::string outFile;
+};
+
+// Rows. They are stored as their bytes, so they hold no pointers.
+
+struct WarehouseRow {
+    int32_t id;
+    double tax;
+    double ytd;
+    char name[10];
+    char address[80];
+};
+
+struct DistrictRow {
+    int32_t warehouseId, id;
+    int32_t nextOrderId;
+    double tax;
+    double ytd;
+    char name[10];
+    char address[80];
+};
+
+struct CustomerRow {
+    int32_t warehouseId, districtId, id;
+    int32_t lastNameNumber;
+    char last[16];
+    char first[16];
+    char credit[2]; // "GC" or "BC".
+    double creditLimit;
+    double discount;
+    double balance;
+    double ytdPayment;
+    int32_t paymentCount;
+    int32_t deliveryCount;
+    int64_t since;
+    char address[80];
+    char data[500];
+};
+
+struct HistoryRow {
+    int32_t customerId, customerDistrictId, customerWarehouseId;
+    int32_t districtId, warehouseId;
+    int64_t date;
+    double amount;
+    char data[24];
+};
+
+struct OrderRow {
+    int32_t warehouseId, districtId, id;
+    int32_t customerId;
+    int64_t entryDate;
+    int32_t carrierId; // 0 until delivered.
+    int32_t lineCount;
+    int32_t allLocal;
+};
+
+struct NewOrderRow {
+    int32_t warehouseId, districtId, orderId;
+};
+
+struct OrderLineRow {
+    int32_t warehouseId, districtId, orderId, number;
+    int32_t itemId;
+    int32_t supplyWarehouseId;
+    int64_t deliveryDate; // 0 until delivered.
+    int32_t quantity;
+    double amount;
+    char districtInfo[24];
+};
+
+struct ItemRow {
+    int32_t id;
+    int32_t imageId;
+    double price;
+    char name[24];
+    char data[50];
+};
+
+struct StockRow {
+    int32_t warehouseId, itemId;
+    int32_t quantity;
+    int32_t ytd;
+    int32_t orderCount;
+    int32_t remoteCount;
+    char districtInfo[kDistrictsPerWarehouse][24];
+    char data[50];
+};
+
+// A heap file of 'Row's with a unique index on the row key.
+template <typename Row>
+class Table {
+    static_assert(std::is_trivially_copyable<Row>::value, "rows are stored as their bytes");
+
+public:
+    explicit Table(BufferPool *pool) : heap_(pool) {}
+
+    bool insert(int64_t key, const Row &row, RecordId *rid = nullptr) {
+        std::vector<char> &record = bytesOf(row);
+        RecordId inserted = heap_.insertRecord(record);
+        if (inserted.pageId < 0 || !index_.insert(key, inserted))
+            return false;
+        if (rid != nullptr)
+            *rid = inserted;
+        return true;
+    }
+
+    bool find(int64_t key, RecordId &rid) const {
+        bool found = false;
+        index_.scan(key, key, [&](int64_t, RecordId match) {
+            rid = match;
+            found = true;
+            return false;
+        });
+        return found;
+    }
+
+    bool read(RecordId rid, Row &row) {
+        std::vector<char> &record = buffer();
+        if (!heap_.getRecord(rid, record) || record.size() != sizeof(Row))
+            return false;
+        memcpy(&row, record.data(), sizeof(Row));
+        return true;
+    }
+
+    bool get(int64_t key, Row &row, RecordId *rid = nullptr) {
+        RecordId found;
+        if (!find(key, found) || !read(found, row))
+            return false;
+        if (rid != nullptr)
+            *rid = found;
+        return true;
+    }
+
+    // Rewrites the row at 'rid', which has 'key'.
+    bool update(int64_t key, RecordId rid, const Row &row) {
+        RecordId moved{-1, -1};
+        if (!heap_.updateRecord(rid, bytesOf(row), &moved))
+            return false;
+        if (moved.pageId >= 0)
+            return index_.remove(key, rid) && index_.insert(key, moved);
+        return true;
+    }
+
+    bool remove(int64_t key, RecordId rid) { return heap_.deleteRecord(rid) && index_.remove(key, rid); }
+
+    const BPlusTree &getIndex() const { return index_; }
+
+private:
+    // Record bytes of the calling thread, as tables are read concurrently.
+    static std::vector<char> &buffer() {
+        thread_local std::vector<char> record;
+        return record;
+    }
+
+    static std::vector<char> &bytesOf(const Row &row) {
+        std::vector<char> &record = buffer();
+        record.resize(sizeof(Row));
+        memcpy(record.data(), &row, sizeof(Row));
+        return record;
+    }
+
+    HeapFile heap_;
+    BPlusTree index_;
+};
+
+// The rows of one warehouse, and the latch that isolates its transactions.
+struct Warehouse {
+    explicit Warehouse(BufferPool *pool)
+        : warehouse(pool), districts(pool), customers(pool), history(pool), orders(pool), newOrders(pool),
+          orderLines(pool), stock(pool) {}
+
+    // Keys, all within the warehouse.
+    static int64_t customerKey(int district, int customer) { return district * kCustomerIdSpace + customer; }
+    static int64_t customerNameKey(int district, int lastNameNumber, int customer) {
+        return (district * 1000LL + lastNameNumber) * kCustomerIdSpace + customer;
+    }
+    static int64_t orderKey(int district, int order) { return district * kOrderIdSpace + order; }
+    static int64_t customerOrderKey(int district, int customer, int order) {
+        return customerKey(district, customer) * kOrderIdSpace + order;
+    }
+    static int64_t orderLineKey(int district, int order, int number) {
+        return orderKey(district, order) * (kMaxOrderLines + 1) + number;
+    }
+
+    Table<WarehouseRow> warehouse;   // Key 0.
+    Table<DistrictRow> districts;    // District id.
+    Table<CustomerRow> customers;    // customerKey().
+    BPlusTree customersByName;       // customerNameKey().
+    Table<HistoryRow> history;       // Insertion number; never read.
+    Table<OrderRow> orders;          // orderKey().
+    BPlusTree ordersByCustomer;      // customerOrderKey().
+    Table<NewOrderRow> newOrders;    // orderKey().
+    Table<OrderLineRow> orderLines;  // orderLineKey().
+    Table<StockRow> stock;           // Item id.
+    int64_t historyCount = 0;
+    std::shared_mutex latch;
+};
+
+struct Database {
+    Database(const std::string &fileName, int poolSize, int warehouseCount, const Options &options)
+        : fileName(fileName), itemCount(options.items), customerCount(options.customers) {
+        std::remove(fileName.c_str());
+        disk.reset(new DiskManager(fileName));
+        pool.reset(new BufferPool(poolSize, disk.get()));
+        items.reset(new Table<ItemRow>(pool.get()));
+        for (int w = 0; w < warehouseCount; ++w)
+            warehouses.emplace_back(new Warehouse(pool.get()));
+    }
+
+    ~Database() {
+        warehouses.clear();
+        items.reset();
+        pool.reset();
+        disk.reset();
+        std::remove(fileName.c_str());
+    }
+
+    int getWarehouseCount() const { return static_cast<int>(warehouses.size()); }
+    // Warehouses are numbered from 1.
+    Warehouse &warehouse(int id) { return *warehouses[id - 1]; }
+
+    std::string fileName;
+    int itemCount;
+    int customerCount;
+    std::unique_ptr<DiskManager> disk;
+    std::unique_ptr<BufferPool> pool;
+    std::unique_ptr<Table<ItemRow>> items; // Read only once loaded.
+    std::vector<std::unique_ptr<Warehouse>> warehouses;
+};
+
+// Random input as the specification defines it (clause 2.1.6 and 4.3.2).
+class Random {
+public:
+    // The run-time NURand constants; the loader's differ from them within
+    // the bounds of clause 2.1.6.1.
+    Random(uint64_t seed, bool load)
+        : rng_(seed), lastNameC_(load ? 157 : 223), customerC_(load ? 259 : 367), itemC_(load ? 7911 : 5987) {}
+
+    int uniform(int low, int high) { return std::uniform_int_distribution<int>(low, high)(rng_); }
+
+    double uniformReal(double low, double high) { return std::uniform_real_distribution<double>(low, high)(rng_); }
+
+    int nonUniform(int a, int c, int low, int high) {
+        return (((uniform(0, a) | uniform(low, high)) + c) % (high - low + 1)) + low;
+    }
+
+    int customerId(int customers) { return nonUniform(1023, customerC_, 1, customers); }
+    int itemId(int items) { return nonUniform(8191, itemC_, 1, items); }
+    int lastNameNumber(int customers) { return nonUniform(255, lastNameC_, 0, std::min(999, customers - 1)); }
+
+    // Random letters into 'text' (length 'size'), between 'minimum' and
+    // size - 1 of them, NUL-terminated.
+    void text(char *text, int size, int minimum) {
+        int length = uniform(std::min(minimum, size - 1), size - 1);
+        for (int i = 0; i < length; ++i)
+            text[i] = static_cast<char>('a' + uniform(0, 25));
+        memset(text + length, 0, size - length);
+    }
+
+private:
+    std::mt19937_64 rng_;
+    int lastNameC_;
+    int customerC_;
+    int itemC_;
+};
+
+// The last name numbered 0..999, from three syllables.
+static void lastName(int number, char *name, size_t size) {
+    static const char *const kSyllables[] = {"BAR", "OUGHT", "ABLE", "PRI", "PRES",
+                                             "ESE", "ANTI", "CALLY", "ATION", "EING"};
+    snprintf(name, size, "%s%s%s", kSyllables[number / 100], kSyllables[number / 10 % 10], kSyllables[number % 10]);
+}
+
+static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// Loading (clause 4.3.3).
+
+static bool loadItems(Database &db) {
+    Random random(1, true);
+    for (int i = 1; i <= db.itemCount; ++i) {
+        ItemRow item = {};
+        item.id = i;
+        item.imageId = random.uniform(1, 10000);
+        item.price = random.uniformReal(1, 100);
+        random.text(item.name, sizeof(item.name), 14);
+        random.text(item.data, sizeof(item.data), 26);
+        if (!db.items->insert(i, item))
+            return false;
+    }
+    return true;
+}
+
+static bool loadWarehouse(Database &db, int w) {
+    Warehouse &wh = db.warehouse(w);
+    Random random(1000 + w, true);
+    WarehouseRow warehouse = {};
+    warehouse.id = w;
+    warehouse.tax = random.uniformReal(0, 0.2);
+    warehouse.ytd = 300000;
+    random.text(warehouse.name, sizeof(warehouse.name), 6);
+    random.text(warehouse.address, sizeof(warehouse.address), 40);
+    if (!wh.warehouse.insert(0, warehouse))
+        return false;
+
+    for (int i = 1; i <= db.itemCount; ++i) {
+        StockRow stock = {};
+        stock.warehouseId = w;
+        stock.itemId = i;
+        stock.quantity = random.uniform(10, 100);
+        for (int d = 0; d < kDistrictsPerWarehouse; ++d)
+            random.text(stock.districtInfo[d], sizeof(stock.districtInfo[d]), 23);
+        random.text(stock.data, sizeof(stock.data), 26);
+        if (!wh.stock.insert(i, stock))
+            return false;
+    }
+
+    int64_t date = now();
+    for (int d = 1; d <= kDistrictsPerWarehouse; ++d) {
+        DistrictRow district = {};
+        district.warehouseId = w;
+        district.id = d;
+        district.nextOrderId = db.customerCount + 1;
+        district.tax = random.uniformReal(0, 0.2);
+        district.ytd = 30000;
+        random.text(district.name, sizeof(district.name), 6);
+        random.text(district.address, sizeof(district.address), 40);
+        if (!wh.districts.insert(d, district))
+            return false;
+
+        for (int c = 1; c <= db.customerCount; ++c) {
+            CustomerRow customer = {};
+            customer.warehouseId = w;
+            customer.districtId = d;
+            customer.id = c;
+            // The first 1000 customers take every last name once.
+            customer.lastNameNumber = c <= 1000 ? c - 1 : random.lastNameNumber(db.customerCount);
+            lastName(customer.lastNameNumber, customer.last, sizeof(customer.last));
+            random.text(customer.first, sizeof(customer.first), 8);
+            memcpy(customer.credit, random.uniform(1, 10) == 1 ? "BC" : "GC", 2);
+            customer.creditLimit = 50000;
+            customer.discount = random.uniformReal(0, 0.5);
+            customer.balance = -10;
+            customer.ytdPayment = 10;
+            customer.paymentCount = 1;
+            customer.since = date;
+            random.text(customer.address, sizeof(customer.address), 40);
+            random.text(customer.data, sizeof(customer.data), 300);
+            RecordId rid;
+            if (!wh.customers.insert(Warehouse::customerKey(d, c), customer, &rid) ||
+                !wh.customersByName.insert(Warehouse::customerNameKey(d, customer.lastNameNumber, c), rid))
+                return false;
+
+            HistoryRow history = {};
+            history.customerId = c;
+            history.customerDistrictId = history.districtId = d;
+            history.customerWarehouseId = history.warehouseId = w;
+            history.date = date;
+            history.amount = 10;
+            random.text(history.data, sizeof(history.data), 12);
+            if (!wh.history.insert(wh.historyCount++, history))
+                return false;
+        }
+
+        // Orders go to the customers in a random order.
+        std::vector<int> customerIds(db.customerCount);
+        for (int c = 0; c < db.customerCount; ++c)
+            customerIds[c] = c + 1;
+        for (int i = db.customerCount - 1; i > 0; --i)
+            std::swap(customerIds[i], customerIds[random.uniform(0, i)]);
+        // The last 900 of 3000 are undelivered.
+        int firstUndelivered = db.customerCount - db.customerCount * 900 / 3000 + 1;
+        for (int o = 1; o <= db.customerCount; ++o) {
+            bool delivered = o < firstUndelivered;
+            OrderRow order = {};
+            order.warehouseId = w;
+            order.districtId = d;
+            order.id = o;
+            order.customerId = customerIds[o - 1];
+            order.entryDate = date;
+            order.carrierId = delivered ? random.uniform(1, 10) : 0;
+            order.lineCount = random.uniform(5, kMaxOrderLines);
+            order.allLocal = 1;
+            RecordId rid;
+            if (!wh.orders.insert(Warehouse::orderKey(d, o), order, &rid) ||
+                !wh.ordersByCustomer.insert(Warehouse::customerOrderKey(d, order.customerId, o), rid))
+                return false;
+            if (!delivered) {
+                NewOrderRow newOrder = {w, d, o};
+                if (!wh.newOrders.insert(Warehouse::orderKey(d, o), newOrder))
+                    return false;
+            }
+            for (int l = 1; l <= order.lineCount; ++l) {
+                OrderLineRow line = {};
+                line.warehouseId = line.supplyWarehouseId = w;
+                line.districtId = d;
+                line.orderId = o;
+                line.number = l;
+                line.itemId = random.uniform(1, db.itemCount);
+                line.deliveryDate = delivered ? date : 0;
+                line.quantity = 5;
+                line.amount = delivered ? 0 : random.uniformReal(0.01, 9999.99);
+                random.text(line.districtInfo, sizeof(line.districtInfo), 23);
+                if (!wh.orderLines.insert(Warehouse::orderLineKey(d, o, l), line))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Loads the warehouses in parallel, each into its own tables.
+static bool load(Database &db) {
+    if (!loadItems(db))
+        return false;
+    std::atomic<int> next(1);
+    std::atomic<bool> ok(true);
+    auto loader = [&]() {
+        for (int w = next++; w <= db.getWarehouseCount(); w = next++)
+            if (!loadWarehouse(db, w))
+                ok = false;
+    };
+    int threadCount = std::max(1, std::min<int>(db.getWarehouseCount(), std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t)
+        threads.emplace_back(loader);
+    for (auto &thread : threads)
+        thread.join();
+    return ok;
+}
+
+// Transactions (clause 2.4 to 2.8).
+
+enum class TransactionType { NEW_ORDER, PAYMENT, ORDER_STATUS, DELIVERY, STOCK_LEVEL };
+static const int kNumTransactionTypes = 5;
+static const char *const kTransactionNames[] = {"New-Order", "Payment", "Order-Status", "Delivery", "Stock-Level"};
+
+enum class Outcome { COMMITTED, ROLLED_BACK, FAILED };
+
+// Latches warehouses in id order, so transactions cannot deadlock.
+class WarehouseLatches {
+public:
+    WarehouseLatches(Database &db, std::set<int> ids, bool exclusive) : db_(db), ids_(ids), exclusive_(exclusive) {
+        for (int id : ids_) {
+            if (exclusive_)
+                db_.warehouse(id).latch.lock();
+            else
+                db_.warehouse(id).latch.lock_shared();
+        }
+    }
+
+    ~WarehouseLatches() {
+        for (int id : ids_) {
+            if (exclusive_)
+                db_.warehouse(id).latch.unlock();
+            else
+                db_.warehouse(id).latch.unlock_shared();
+        }
+    }
+
+private:
+    Database &db_;
+    std::set<int> ids_;
+    bool exclusive_;
+};
+
+// Picks a customer of district 'd' by id or, 60% of the time, by last name
+// (the middle one of those with the name, by id).
+static bool chooseCustomer(Database &db, Random &random, Warehouse &wh, int d, CustomerRow &customer,
+                           RecordId &rid) {
+    if (random.uniform(1, 100) > 60)
+        return wh.customers.get(Warehouse::customerKey(d, random.customerId(db.customerCount)), customer, &rid);
+    int name = random.lastNameNumber(db.customerCount);
+    std::vector<RecordId> matches;
+    wh.customersByName.scan(Warehouse::customerNameKey(d, name, 0),
+                            Warehouse::customerNameKey(d, name, kCustomerIdSpace - 1), [&](int64_t, RecordId match) {
+                                matches.push_back(match);
+                                return true;
+                            });
+    if (matches.empty())
+        return false;
+    rid = matches[(matches.size() - 1) / 2];
+    return wh.customers.read(rid, customer);
+}
+
+static Outcome newOrder(Database &db, Random &random, int w) {
+    int d = random.uniform(1, kDistrictsPerWarehouse);
+    int c = random.customerId(db.customerCount);
+    int lineCount = random.uniform(5, kMaxOrderLines);
+    bool rollback = random.uniform(1, 100) == 1;
+    struct Line {
+        int itemId, supplyWarehouseId, quantity;
+    } lines[kMaxOrderLines];
+    std::set<int> latched = {w};
+    bool allLocal = true;
+    for (int l = 0; l < lineCount; ++l) {
+        lines[l].itemId = rollback && l == lineCount - 1 ? db.itemCount + 1 : random.itemId(db.itemCount);
+        lines[l].supplyWarehouseId = w;
+        if (db.getWarehouseCount() > 1 && random.uniform(1, 100) == 1) {
+            do
+                lines[l].supplyWarehouseId = random.uniform(1, db.getWarehouseCount());
+            while (lines[l].supplyWarehouseId == w);
+        }
+        lines[l].quantity = random.uniform(1, 10);
+        latched.insert(lines[l].supplyWarehouseId);
+        allLocal = allLocal && lines[l].supplyWarehouseId == w;
+    }
+
+    // Items are read only, so they are checked before latching, and an
+    // unused item number rolls back before anything is written.
+    ItemRow items[kMaxOrderLines];
+    for (int l = 0; l < lineCount; ++l)
+        if (!db.items->get(lines[l].itemId, items[l]))
+            return lines[l].itemId > db.itemCount ? Outcome::ROLLED_BACK : Outcome::FAILED;
+
+    WarehouseLatches latch(db, latched, true);
+    Warehouse &wh = db.warehouse(w);
+    WarehouseRow warehouse;
+    DistrictRow district;
+    CustomerRow customer;
+    RecordId districtRid;
+    if (!wh.warehouse.get(0, warehouse) || !wh.districts.get(d, district, &districtRid) ||
+        !wh.customers.get(Warehouse::customerKey(d, c), customer))
+        return Outcome::FAILED;
+    int o = district.nextOrderId++;
+    if (!wh.districts.update(d, districtRid, district))
+        return Outcome::FAILED;
+
+    OrderRow order = {};
+    order.warehouseId = w;
+    order.districtId = d;
+    order.id = o;
+    order.customerId = c;
+    order.entryDate = now();
+    order.lineCount = lineCount;
+    order.allLocal = allLocal;
+    RecordId orderRid;
+    NewOrderRow newOrder = {w, d, o};
+    if (!wh.orders.insert(Warehouse::orderKey(d, o), order, &orderRid) ||
+        !wh.ordersByCustomer.insert(Warehouse::customerOrderKey(d, c, o), orderRid) ||
+        !wh.newOrders.insert(Warehouse::orderKey(d, o), newOrder))
+        return Outcome::FAILED;
+
+    double total = 0;
+    for (int l = 0; l < lineCount; ++l) {
+        Warehouse &supplier = db.warehouse(lines[l].supplyWarehouseId);
+        StockRow stock;
+        RecordId stockRid;
+        if (!supplier.stock.get(lines[l].itemId, stock, &stockRid))
+            return Outcome::FAILED;
+        stock.quantity += stock.quantity >= lines[l].quantity + 10 ? -lines[l].quantity : 91 - lines[l].quantity;
+        stock.ytd += lines[l].quantity;
+        ++stock.orderCount;
+        stock.remoteCount += lines[l].supplyWarehouseId != w;
+        if (!supplier.stock.update(lines[l].itemId, stockRid, stock))
+            return Outcome::FAILED;
+
+        OrderLineRow line = {};
+        line.warehouseId = w;
+        line.districtId = d;
+        line.orderId = o;
+        line.number = l + 1;
+        line.itemId = lines[l].itemId;
+        line.supplyWarehouseId = lines[l].supplyWarehouseId;
+        line.quantity = lines[l].quantity;
+        line.amount = lines[l].quantity * items[l].price;
+        memcpy(line.districtInfo, stock.districtInfo[d - 1], sizeof(line.districtInfo));
+        if (!wh.orderLines.insert(Warehouse::orderLineKey(d, o, l + 1), line))
+            return Outcome::FAILED;
+        total += line.amount;
+    }
+    total *= (1 - customer.discount) * (1 + warehouse.tax + district.tax);
+    doNotOptimize(total);
+    return Outcome::COMMITTED;
+}
+
+static Outcome payment(Database &db, Random &random, int w) {
+    int d = random.uniform(1, kDistrictsPerWarehouse);
+    // 15% of payments are for a customer of another warehouse.
+    int customerWarehouse = w, customerDistrict = d;
+    if (db.getWarehouseCount() > 1 && random.uniform(1, 100) <= 15) {
+        do
+            customerWarehouse = random.uniform(1, db.getWarehouseCount());
+        while (customerWarehouse == w);
+        customerDistrict = random.uniform(1, kDistrictsPerWarehouse);
+    }
+    double amount = random.uniformReal(1, 5000);
+
+    WarehouseLatches latch(db, {w, customerWarehouse}, true);
+    Warehouse &wh = db.warehouse(w);
+    WarehouseRow warehouse;
+    DistrictRow district;
+    RecordId warehouseRid, districtRid;
+    if (!wh.warehouse.get(0, warehouse, &warehouseRid) || !wh.districts.get(d, district, &districtRid))
+        return Outcome::FAILED;
+    warehouse.ytd += amount;
+    district.ytd += amount;
+    if (!wh.warehouse.update(0, warehouseRid, warehouse) || !wh.districts.update(d, districtRid, district))
+        return Outcome::FAILED;
+
+    Warehouse &customerWh = db.warehouse(customerWarehouse);
+    CustomerRow customer;
+    RecordId customerRid;
+    if (!chooseCustomer(db, random, customerWh, customerDistrict, customer, customerRid))
+        return Outcome::FAILED;
+    customer.balance -= amount;
+    customer.ytdPayment += amount;
+    ++customer.paymentCount;
+    if (memcmp(customer.credit, "BC", 2) == 0) {
+        // Bad credit: the payment is noted at the front of the data.
+        char note[64];
+        int length = snprintf(note, sizeof(note), "%d %d %d %d %d %.2f|", customer.id, customerDistrict,
+                              customerWarehouse, d, w, amount);
+        memmove(customer.data + length, customer.data, sizeof(customer.data) - length - 1);
+        memcpy(customer.data, note, length);
+    }
+    if (!customerWh.customers.update(Warehouse::customerKey(customerDistrict, customer.id), customerRid, customer))
+        return Outcome::FAILED;
+
+    HistoryRow history = {};
+    history.customerId = customer.id;
+    history.customerDistrictId = customerDistrict;
+    history.customerWarehouseId = customerWarehouse;
+    history.districtId = d;
+    history.warehouseId = w;
+    history.date = now();
+    history.amount = amount;
+    snprintf(history.data, sizeof(history.data), "%.10s    %.10s", warehouse.name, district.name);
+    return wh.history.insert(wh.historyCount++, history) ? Outcome::COMMITTED : Outcome::FAILED;
+}
+
+static Outcome orderStatus(Database &db, Random &random, int w) {
+    int d = random.uniform(1, kDistrictsPerWarehouse);
+    WarehouseLatches latch(db, {w}, false);
+    Warehouse &wh = db.warehouse(w);
+    CustomerRow customer;
+    RecordId customerRid;
+    if (!chooseCustomer(db, random, wh, d, customer, customerRid))
+        return Outcome::FAILED;
+
+    // The customer's latest order and its lines.
+    RecordId orderRid{-1, -1};
+    wh.ordersByCustomer.scan(Warehouse::customerOrderKey(d, customer.id, 0),
+                             Warehouse::customerOrderKey(d, customer.id, kOrderIdSpace - 1),
+                             [&](int64_t, RecordId rid) {
+                                 orderRid = rid;
+                                 return true;
+                             });
+    OrderRow order;
+    if (orderRid.pageId < 0 || !wh.orders.read(orderRid, order))
+        return Outcome::FAILED;
+    int lines = 0;
+    OrderLineRow line;
+    for (int l = 1; l <= order.lineCount; ++l)
+        lines += wh.orderLines.get(Warehouse::orderLineKey(d, order.id, l), line);
+    return lines == order.lineCount ? Outcome::COMMITTED : Outcome::FAILED;
+}
+
+static Outcome delivery(Database &db, Random &random, int w) {
+    int carrier = random.uniform(1, 10);
+    WarehouseLatches latch(db, {w}, true);
+    Warehouse &wh = db.warehouse(w);
+    int64_t date = now();
+    for (int d = 1; d <= kDistrictsPerWarehouse; ++d) {
+        // The district's oldest undelivered order; none is not an error.
+        int64_t newOrderKey = -1;
+        RecordId newOrderRid{-1, -1};
+        wh.newOrders.getIndex().scan(Warehouse::orderKey(d, 0), Warehouse::orderKey(d, kOrderIdSpace - 1),
+                                     [&](int64_t key, RecordId rid) {
+                                         newOrderKey = key;
+                                         newOrderRid = rid;
+                                         return false;
+                                     });
+        if (newOrderKey < 0)
+            continue;
+        if (!wh.newOrders.remove(newOrderKey, newOrderRid))
+            return Outcome::FAILED;
+
+        int o = static_cast<int>(newOrderKey % kOrderIdSpace);
+        OrderRow order;
+        RecordId orderRid;
+        if (!wh.orders.get(newOrderKey, order, &orderRid))
+            return Outcome::FAILED;
+        order.carrierId = carrier;
+        if (!wh.orders.update(newOrderKey, orderRid, order))
+            return Outcome::FAILED;
+
+        double total = 0;
+        for (int l = 1; l <= order.lineCount; ++l) {
+            int64_t key = Warehouse::orderLineKey(d, o, l);
+            OrderLineRow line;
+            RecordId lineRid;
+            if (!wh.orderLines.get(key, line, &lineRid))
+                return Outcome::FAILED;
+            line.deliveryDate = date;
+            total += line.amount;
+            if (!wh.orderLines.update(key, lineRid, line))
+                return Outcome::FAILED;
+        }
+
+        CustomerRow customer;
+        RecordId customerRid;
+        int64_t customerKey = Warehouse::customerKey(d, order.customerId);
+        if (!wh.customers.get(customerKey, customer, &customerRid))
+            return Outcome::FAILED;
+        customer.balance += total;
+        ++customer.deliveryCount;
+        if (!wh.customers.update(customerKey, customerRid, customer))
+            return Outcome::FAILED;
+    }
+    return Outcome::COMMITTED;
+}
+
+static Outcome stockLevel(Database &db, Random &random, int w) {
+    int d = random.uniform(1, kDistrictsPerWarehouse);
+    int threshold = random.uniform(10, 20);
+    WarehouseLatches latch(db, {w}, false);
+    Warehouse &wh = db.warehouse(w);
+    DistrictRow district;
+    if (!wh.districts.get(d, district))
+        return Outcome::FAILED;
+
+    // Distinct items of the district's last 20 orders that are low in stock.
+    std::set<int> itemIds;
+    OrderLineRow line;
+    wh.orderLines.getIndex().scan(Warehouse::orderLineKey(d, std::max(1, district.nextOrderId - 20), 0),
+                                  Warehouse::orderLineKey(d, district.nextOrderId - 1, kMaxOrderLines),
+                                  [&](int64_t, RecordId rid) {
+                                      if (wh.orderLines.read(rid, line))
+                                          itemIds.insert(line.itemId);
+                                      return true;
+                                  });
+    int low = 0;
+    StockRow stock;
+    for (int itemId : itemIds) {
+        if (!wh.stock.get(itemId, stock))
+            return Outcome::FAILED;
+        low += stock.quantity < threshold;
+    }
+    doNotOptimize(low);
+    return Outcome::COMMITTED;
+}
+
+struct Counts {
+    uint64_t outcomes[kNumTransactionTypes][3] = {}; // By type and Outcome.
+
+    uint64_t attempted(int type) const {
+        return outcomes[type][0] + outcomes[type][1] + outcomes[type][2];
+    }
+    void add(const Counts &other) {
+        for (int t = 0; t < kNumTransactionTypes; ++t)
+            for (int o = 0; o < 3; ++o)
+                outcomes[t][o] += other.outcomes[t][o];
+    }
+};
+
+struct RunResult {
+    int warehouses;
+    int threads;
+    double seconds;
+    Counts counts;
+
+    double tpmC() const {
+        return counts.outcomes[static_cast<int>(TransactionType::NEW_ORDER)][0] * 60 / seconds;
+    }
+    // Committed transactions of all types per minute.
+    double tpm() const {
+        uint64_t committed = 0;
+        for (int t = 0; t < kNumTransactionTypes; ++t)
+            committed += counts.outcomes[t][0];
+        return committed * 60 / seconds;
+    }
+    double abortRate(int type) const {
+        uint64_t attempted = counts.attempted(type);
+        return attempted ? 100.0 * (attempted - counts.outcomes[type][0]) / attempted : 0;
+    }
+};
+
+static RunResult run(Database &db, int threadCount, double duration) {
+    std::atomic<bool> stop(false);
+    std::vector<Counts> perThread(threadCount);
+    auto client = [&](int thread) {
+        // Clients are spread over the warehouses, as terminals are.
+        int w = thread % db.getWarehouseCount() + 1;
+        Random random(7919 * (thread + 1), false);
+        Counts &counts = perThread[thread];
+        while (!stop.load(std::memory_order_relaxed)) {
+            int pick = random.uniform(1, 100);
+            TransactionType type = pick <= 45   ? TransactionType::NEW_ORDER
+                                   : pick <= 88 ? TransactionType::PAYMENT
+                                   : pick <= 92 ? TransactionType::ORDER_STATUS
+                                   : pick <= 96 ? TransactionType::DELIVERY
+                                                : TransactionType::STOCK_LEVEL;
+            Outcome outcome = Outcome::FAILED;
+            switch (type) {
+            case TransactionType::NEW_ORDER: outcome = newOrder(db, random, w); break;
+            case TransactionType::PAYMENT: outcome = payment(db, random, w); break;
+            case TransactionType::ORDER_STATUS: outcome = orderStatus(db, random, w); break;
+            case TransactionType::DELIVERY: outcome = delivery(db, random, w); break;
+            case TransactionType::STOCK_LEVEL: outcome = stockLevel(db, random, w); break;
+            }
+            ++counts.outcomes[static_cast<int>(type)][static_cast<int>(outcome)];
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t)
+        threads.emplace_back(client, t);
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    stop = true;
+    for (auto &thread : threads)
+        thread.join();
+
+    RunResult result;
+    result.warehouses = db.getWarehouseCount();
+    result.threads = threadCount;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const Counts &counts : perThread)
+        result.counts.add(counts);
+    return result;
+}
+
+static void printResult(const RunResult &result) {
+    char line[200];
+    snprintf(line, sizeof(line), "%10d %7d %12.0f %12.0f", result.warehouses, result.threads, result.tpmC(),
+             result.tpm());
+    std::string text = line;
+    for (int t = 0; t < kNumTransactionTypes; ++t) {
+        snprintf(line, sizeof(line), " %12.2f%%", result.abortRate(t));
+        text += line;
+    }
+    std::cout << text << std::endl;
+}
+
+static void writeJson(const std::vector<RunResult> &results, const Options &options) {
+    std::ostringstream out;
+    out << "{\n  \"items\": " << options.items << ",\n  \"customers_per_district\": " << options.customers
+        << ",\n  \"duration\": " << options.duration << ",\n  \"runs\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const RunResult &result = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"warehouses\": " << result.warehouses << ", \"threads\": "
+            << result.threads << ", \"tpmC\": " << result.tpmC() << ", \"tpm\": " << result.tpm()
+            << ", \"transactions\": {";
+        for (int t = 0; t < kNumTransactionTypes; ++t) {
+            out << (t ? ", " : "") << "\"" << kTransactionNames[t] << "\": {\"committed\": "
+                << result.counts.outcomes[t][0] << ", \"rolled_back\": " << result.counts.outcomes[t][1]
+                << ", \"failed\": " << result.counts.outcomes[t][2] << ", \"abort_rate\": "
+                << result.abortRate(t) / 100 << "}";
+        }
+        out << "}}";
+    }
+    out << "\n  ]\n}\n";
+    std::ofstream file(options.outFile);
+    file << out.str();
+    if (!file)
+        std::cerr << "cannot write " << options.outFile << std::endl;
+}
+
+// Value of "--name=value" if 'arg' is that flag.
+static bool flagValue(const std::string &arg, const std::string &name, std::string &value) {
+    std::string prefix = "--" + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0)
+        return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+// Positive integers from "1,2,4"; false if there are none or any is invalid.
+static bool parseCounts(const std::string &value, std::vector<int> &counts) {
+    counts.clear();
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        int count = std::atoi(item.c_str());
+        if (count <= 0)
+            return false;
+        counts.push_back(count);
+    }
+    return !counts.empty();
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i], value;
+        bool ok = true;
+        if (flagValue(arg, "warehouses", value))
+            ok = parseCounts(value, options.warehouseCounts);
+        else if (flagValue(arg, "threads", value))
+            ok = parseCounts(value, options.threadCounts);
+        else if (flagValue(arg, "duration", value))
+            options.duration = std::atof(value.c_str());
+        else if (flagValue(arg, "items", value))
+            ok = (options.items = std::atoi(value.c_str())) > 0;
+        else if (flagValue(arg, "customers", value))
+            ok = (options.customers = std::atoi(value.c_str())) > 0;
+        else if (flagValue(arg, "pool", value))
+            ok = (options.poolSize = std::atoi(value.c_str())) > 0;
+        else if (flagValue(arg, "dir", value))
+            options.directory = value;
+        else if (flagValue(arg, "out", value))
+            options.outFile = value;
+        else
+            ok = false;
+        if (!ok) {
+            std::cerr << "invalid argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << options.items << " items, " << options.customers << " customers per district, " << options.duration
+              << " s per run, pool of " << options.poolSize << " frames" << std::endl;
+    std::vector<RunResult> results;
+    for (int warehouses : options.warehouseCounts) {
+        Database db(options.directory + "/tpcc.db", options.poolSize, warehouses, options);
+        auto loadStart = std::chrono::steady_clock::now();
+        if (!load(db)) {
+            std::cerr << "loading " << warehouses << " warehouses failed" << std::endl;
+            return 1;
+        }
+        double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+        char line[200];
+        snprintf(line, sizeof(line), "Loaded %d warehouses in %.2f s", warehouses, loadSeconds);
+        std::cout << line << std::endl;
+        snprintf(line, sizeof(line), "%10s %7s %12s %12s %13s %13s %13s %13s %13s", "warehouses", "threads", "tpmC",
+                 "tpm", "aborts: NO", "P", "OS", "D", "SL");
+        std::cout << line << std::endl;
+        for (int threads : options.threadCounts) {
+            results.push_back(run(db, threads, options.duration));
+            printResult(results.back());
+        }
+    }
+    if (!options.outFile.empty())
+        writeJson(results, options);
+    return 0;
+}
@@ -0,0 +1,570 @@
+// YCSB core workloads A-F against the storage engine: a HeapFile holds the
+// records and a BPlusTree maps their 64-bit keys to record ids, which is how
+// the query engine stores and indexes a table.
+//
+//   A  50% read, 50% update                  zipfian
+//   B  95% read,  5% update                  zipfian
+//   C  100% read                             zipfian
+//   D  95% read,  5% insert                  latest
+//   E  95% scan (1-100 records), 5% insert   zipfian
+//   F  50% read, 50% read-modify-write       zipfian
+//
+// Every workload loads --records records of --record-size bytes into a fresh
+// file, then runs --threads client threads for --duration seconds and
+// reports throughput and the p50, p99 and p99.9 latency of every operation.
+// Zipfian keys are scrambled as in YCSB, so the popular keys are spread over
+// the key space; "latest" favours the most recently inserted keys.
+//
+// Updates write a whole new record of the same size, so they stay in place.
+// HeapFile serializes its writers but does not latch pages against readers,
+// so reads and scans share a latch that writes take exclusively.
+//
+// Usage: ycsb_bench [--workloads=ABCDEF] [--records=100000] [--record-size=1000]
+//                   [--threads=4] [--duration=10] [--distribution=zipfian|uniform|latest]
+//                   [--pool=4096] [--dir=.] [--out=results.json] [--trace=FILE]
+//                   [--storage-latency] [--report-interval=SECONDS] [--chrome-trace=FILE]
+//
+// --trace records the buffer pool requests of the run phase for pool_sim,
+// in FILE, or in FILE.<workload> if several workloads run.
+// --storage-latency also times BufferPool::fixPage and reports the storage
+// latencies (StorageLatency) of every run phase; --report-interval prints
+// them to stderr every SECONDS while the benchmark runs.
+// --chrome-trace writes the engine events (EventTrace) of the run phase as
+// Chrome trace JSON, named like the --trace files; the events of every
+// thread are its last EventTrace::kDefaultEventsPerThread.
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../storage_engine/bplustree.h"
+#include "../storage_engine/bufferpool.h"
+#include "../storage_engine/diskmanager.h"
+#include "../storage_engine/event_trace.h"
+#include "../storage_engine/heapfilemanager.h"
+#include "../storage_engine/latency_histogram.h"
+#include "../storage_engine/storage_latency.h"
+
+enum class Operation { READ, UPDATE, INSERT, SCAN, READ_MODIFY_WRITE };
+static const int kNumOperations = 5;
+static const char *const kOperationNames[] = {"read", "update", "insert", "scan", "rmw"};
+
+enum class Distribution { ZIPFIAN, UNIFORM, LATEST };
+
+struct Workload {
+    char name;
+    double proportions[kNumOperations]; // By Operation.
+    Distribution distribution;
+};
+
+static const Workload kWorkloads[] = {
+    {'A', {0.50, 0.50, 0, 0, 0}, Distribution::ZIPFIAN},
+    {'B', {0.95, 0.05, 0, 0, 0}, Distribution::ZIPFIAN},
+    {'C', {1.00, 0, 0, 0, 0}, Distribution::ZIPFIAN},
+    {'D', {0.95, 0, 0.05, 0, 0}, Distribution::LATEST},
+    {'E', {0, 0, 0.05, 0.95, 0}, Distribution::ZIPFIAN},
+    {'F', {0.50, 0, 0, 0, 0.50}, Distribution::ZIPFIAN},
+};
+
+struct Options {
+    std::string workloads = "ABCDEF";
+    int64_t records = 100000;
+    int recordSize = 1000;
+    int threads = 4;
+    double duration = 10;
+    int poolSize = 4096;
+    int maxScanLength = 100;
+    std::string distribution; // Overrides the workloads' own if set.
+    std::string directory = ".";
+    std::string outFile;
+    std::string traceFile;
+    std::string chromeTraceFile;
+    bool storageLatency = false;
+    double reportInterval = 0;
+};
+
+// Zipfian ranks 0..n-1 with YCSB's constant 0.99, by the method of Gray et
+// al., "Quickly generating billion-record synthetic databases". zeta(n) is
+// extended incrementally when the item count grows.
+class ZipfianGenerator {
+public:
+    static constexpr double kTheta = 0.99;
+
+    explicit ZipfianGenerator(uint64_t items, double zetan = 0) : items_(0), zetan_(0) {
+        zeta2_ = 1 + std::pow(0.5, kTheta);
+        alpha_ = 1 / (1 - kTheta);
+        if (zetan > 0) {
+            items_ = items;
+            zetan_ = zetan;
+            updateEta();
+        } else {
+            grow(items);
+        }
+    }
+
+    template <typename Rng>
+    uint64_t next(Rng &rng, uint64_t items) {
+        if (items > items_)
+            grow(items);
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        double uz = u * zetan_;
+        if (uz < 1)
+            return 0;
+        if (uz < zeta2_)
+            return 1;
+        uint64_t rank = static_cast<uint64_t>(items_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+        return std::min(rank, items - 1);
+    }
+
+private:
+    void grow(uint64_t items) {
+        for (uint64_t i = items_ + 1; i <= items; ++i)
+            zetan_ += 1 / std::pow(static_cast<double>(i), kTheta);
+        items_ = items;
+        updateEta();
+    }
+
+    void updateEta() { eta_ = (1 - std::pow(2.0 / items_, 1 - kTheta)) / (1 - zeta2_ / zetan_); }
+
+    uint64_t items_;
+    double zetan_;
+    double zeta2_;
+    double alpha_;
+    double eta_;
+};
+
+static uint64_t fnvHash64(uint64_t value) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int i = 0; i < 8; ++i) {
+        hash ^= value & 0xff;
+        hash *= 1099511628211ULL;
+        value >>= 8;
+    }
+    return hash;
+}
+
+// Picks keys for one client thread.
+class KeyChooser {
+public:
+    // YCSB's scrambled zipfian draws from this many items (zeta precomputed)
+    // and hashes the rank onto the key space.
+    static constexpr uint64_t kScrambledItems = 10000000000ULL;
+    static constexpr double kScrambledZeta = 26.46902820178302;
+
+    KeyChooser(Distribution distribution, uint64_t records, uint64_t seed)
+        : distribution_(distribution), rng_(seed),
+          zipfian_(distribution == Distribution::LATEST ? records : kScrambledItems,
+                   distribution == Distribution::LATEST ? 0 : kScrambledZeta) {}
+
+    // A key among the 'inserted' keys 0..inserted-1.
+    int64_t next(uint64_t inserted) {
+        switch (distribution_) {
+        case Distribution::UNIFORM:
+            return static_cast<int64_t>(rng_() % inserted);
+        case Distribution::LATEST:
+            return static_cast<int64_t>(inserted - 1 - zipfian_.next(rng_, inserted));
+        case Distribution::ZIPFIAN:
+            break;
+        }
+        return static_cast<int64_t>(fnvHash64(zipfian_.next(rng_, kScrambledItems)) % inserted);
+    }
+
+    std::mt19937_64 &getRng() { return rng_; }
+
+private:
+    Distribution distribution_;
+    std::mt19937_64 rng_;
+    ZipfianGenerator zipfian_;
+};
+
+// The table: records in a heap file, indexed by key.
+class Store {
+public:
+    Store(const std::string &fileName, int poolSize, int recordSize)
+        : fileName_(fileName), recordSize_(recordSize) {
+        std::remove(fileName.c_str());
+        disk_.reset(new DiskManager(fileName));
+        pool_.reset(new BufferPool(poolSize, disk_.get()));
+        heap_.reset(new HeapFile(pool_.get()));
+    }
+
+    ~Store() {
+        heap_.reset();
+        pool_.reset();
+        disk_.reset();
+        std::remove(fileName_.c_str());
+    }
+
+    // Record of 'key': the key followed by filler derived from 'version'.
+    void makeRecord(int64_t key, uint64_t version, std::vector<char> &record) const {
+        record.resize(recordSize_);
+        memcpy(record.data(), &key, sizeof(key));
+        char fill = static_cast<char>('a' + (key + version) % 26);
+        memset(record.data() + sizeof(key), fill, recordSize_ - sizeof(key));
+    }
+
+    bool insert(int64_t key, std::vector<char> &record) {
+        std::unique_lock<std::shared_mutex> lock(latch_);
+        return insertLocked(key, record);
+    }
+
+    // Inserts under the next key, as counted by getInserted().
+    bool insertNext(std::vector<char> &record, uint64_t version) {
+        std::unique_lock<std::shared_mutex> lock(latch_);
+        int64_t key = static_cast<int64_t>(inserted_.load());
+        makeRecord(key, version, record);
+        return insertLocked(key, record);
+    }
+
+    bool read(int64_t key, std::vector<char> &record) {
+        std::shared_lock<std::shared_mutex> lock(latch_);
+        RecordId rid;
+        return find(key, rid) && heap_->getRecord(rid, record);
+    }
+
+    bool update(int64_t key, const std::vector<char> &record) {
+        std::unique_lock<std::shared_mutex> lock(latch_);
+        RecordId rid, moved{-1, -1};
+        if (!find(key, rid) || !heap_->updateRecord(rid, record, &moved))
+            return false;
+        if (moved.pageId >= 0) {
+            index_.remove(key, rid);
+            index_.insert(key, moved);
+        }
+        return true;
+    }
+
+    // Reads up to 'length' records from 'start' on, in key order; returns
+    // how many were read.
+    int scan(int64_t start, int length, std::vector<char> &record) {
+        std::shared_lock<std::shared_mutex> lock(latch_);
+        std::vector<RecordId> rids;
+        index_.scan(start, INT64_MAX, [&](int64_t, RecordId rid) {
+            rids.push_back(rid);
+            return static_cast<int>(rids.size()) < length;
+        });
+        int count = 0;
+        for (RecordId rid : rids)
+            count += heap_->getRecord(rid, record);
+        return count;
+    }
+
+    uint64_t getInserted() const { return inserted_.load(); }
+
+    BufferPool &getBufferPool() { return *pool_; }
+
+private:
+    bool insertLocked(int64_t key, std::vector<char> &record) {
+        RecordId rid = heap_->insertRecord(record);
+        if (rid.pageId < 0 || !index_.insert(key, rid))
+            return false;
+        ++inserted_;
+        return true;
+    }
+
+    bool find(int64_t key, RecordId &rid) const {
+        bool found = false;
+        index_.scan(key, key, [&](int64_t, RecordId match) {
+            rid = match;
+            found = true;
+            return false;
+        });
+        return found;
+    }
+
+    std::string fileName_;
+    int recordSize_;
+    std::unique_ptr<DiskManager> disk_;
+    std::unique_ptr<BufferPool> pool_;
+    std::unique_ptr<HeapFile> heap_;
+    BPlusTree index_;
+    std::shared_mutex latch_;
+    std::atomic<uint64_t> inserted_{0};
+};
+
+struct Result {
+    char workload;
+    double loadSeconds;
+    double runSeconds;
+    uint64_t failed;
+    LatencyHistogram all;
+    LatencyHistogram perOperation[kNumOperations];
+    std::vector<std::string> storageLatency; // StorageLatency of the run phase.
+};
+
+static Distribution parseDistribution(const std::string &name, Distribution fallback) {
+    if (name == "zipfian") return Distribution::ZIPFIAN;
+    if (name == "uniform") return Distribution::UNIFORM;
+    if (name == "latest") return Distribution::LATEST;
+    return fallback;
+}
+
+static Result runWorkload(const Workload &workload, const Options &options) {
+    Result result;
+    result.workload = workload.name;
+    result.failed = 0;
+    Store store(options.directory + "/ycsb_" + workload.name + ".db", options.poolSize, options.recordSize);
+
+    auto loadStart = std::chrono::steady_clock::now();
+    std::vector<char> record;
+    for (int64_t key = 0; key < options.records; ++key) {
+        store.makeRecord(key, 0, record);
+        if (!store.insert(key, record)) {
+            std::cerr << "load failed at key " << key << std::endl;
+            std::exit(1);
+        }
+    }
+    result.loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+
+    Distribution distribution = parseDistribution(options.distribution, workload.distribution);
+    std::atomic<bool> stop(false);
+    std::vector<Result> perThread(options.threads);
+    auto client = [&](int thread) {
+        Result &local = perThread[thread];
+        local.failed = 0;
+        KeyChooser keys(distribution, options.records, 1000 + thread);
+        std::uniform_real_distribution<double> pick(0, 1);
+        std::vector<char> record;
+        uint64_t version = 1;
+        while (!stop.load(std::memory_order_relaxed)) {
+            double p = pick(keys.getRng());
+            int op = 0;
+            while (op < kNumOperations - 1 && p >= workload.proportions[op]) {
+                p -= workload.proportions[op];
+                ++op;
+            }
+            auto start = std::chrono::steady_clock::now();
+            bool ok = true;
+            switch (static_cast<Operation>(op)) {
+            case Operation::READ:
+                ok = store.read(keys.next(store.getInserted()), record);
+                break;
+            case Operation::UPDATE: {
+                int64_t key = keys.next(store.getInserted());
+                store.makeRecord(key, version++, record);
+                ok = store.update(key, record);
+                break;
+            }
+            case Operation::INSERT:
+                ok = store.insertNext(record, version++);
+                break;
+            case Operation::SCAN: {
+                int length = 1 + static_cast<int>(keys.getRng()() % options.maxScanLength);
+                ok = store.scan(keys.next(store.getInserted()), length, record) > 0;
+                break;
+            }
+            case Operation::READ_MODIFY_WRITE: {
+                int64_t key = keys.next(store.getInserted());
+                ok = store.read(key, record);
+                store.makeRecord(key, version++, record);
+                ok = ok && store.update(key, record);
+                break;
+            }
+            }
+            uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            local.perOperation[op].record(nanoseconds);
+            local.failed += !ok;
+        }
+    };
+
+    PageTraceWriter trace;
+    if (!options.traceFile.empty()) {
+        std::string traceFile = options.traceFile;
+        if (options.workloads.size() > 1)
+            traceFile += std::string(".") + workload.name;
+        if (trace.open(traceFile))
+            store.getBufferPool().setPageTrace(&trace);
+        else
+            std::cerr << "cannot write " << traceFile << std::endl;
+    }
+
+    std::vector<LatencyHistogram> storageBefore;
+    for (int i = 0; i < kNumStorageOperations; ++i)
+        storageBefore.push_back(StorageLatency::snapshot(static_cast<StorageOperation>(i)));
+
+    if (!options.chromeTraceFile.empty())
+        EventTrace::start();
+    auto runStart = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < options.threads; ++t)
+        threads.emplace_back(client, t);
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+    stop = true;
+    for (auto &thread : threads)
+        thread.join();
+    store.getBufferPool().setPageTrace(nullptr);
+    result.runSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+    if (!options.chromeTraceFile.empty()) {
+        EventTrace::stop();
+        std::string traceFile = options.chromeTraceFile;
+        if (options.workloads.size() > 1)
+            traceFile += std::string(".") + workload.name;
+        if (!EventTrace::writeChromeTrace(traceFile))
+            std::cerr << "cannot write " << traceFile << std::endl;
+    }
+
+    if (options.storageLatency) {
+        std::vector<LatencyHistogram> storage;
+        for (int i = 0; i < kNumStorageOperations; ++i) {
+            storage.push_back(StorageLatency::snapshot(static_cast<StorageOperation>(i)));
+            storage.back().subtract(storageBefore[i]);
+        }
+        result.storageLatency = StorageLatency::format(storage);
+    }
+
+    for (const Result &local : perThread) {
+        result.failed += local.failed;
+        for (int op = 0; op < kNumOperations; ++op) {
+            result.perOperation[op].merge(local.perOperation[op]);
+            result.all.merge(local.perOperation[op]);
+        }
+    }
+    return result;
+}
+
+static void printResult(const Result &result) {
+    char line[160];
+    snprintf(line, sizeof(line), "Workload %c: %llu ops in %.2f s, %.0f ops/s, %llu failed (load %.2f s)",
+             result.workload, static_cast<unsigned long long>(result.all.getCount()), result.runSeconds,
+             result.all.getCount() / result.runSeconds, static_cast<unsigned long long>(result.failed),
+             result.loadSeconds);
+    std::cout << line << std::endl;
+    auto row = [&](const char *name, const LatencyHistogram &histogram) {
+        snprintf(line, sizeof(line), "  %-8s %10llu ops  p50 %9.1f us  p99 %9.1f us  p999 %9.1f us  max %9.1f us",
+                 name, static_cast<unsigned long long>(histogram.getCount()), histogram.getPercentile(50) / 1e3,
+                 histogram.getPercentile(99) / 1e3, histogram.getPercentile(99.9) / 1e3, histogram.getMax() / 1e3);
+        std::cout << line << std::endl;
+    };
+    for (int op = 0; op < kNumOperations; ++op)
+        if (result.perOperation[op].getCount() > 0)
+            row(kOperationNames[op], result.perOperation[op]);
+    row("all", result.all);
+    for (const std::string &storage : result.storageLatency)
+        std::cout << "  " << storage << std::endl;
+}
+
+static void writeJson(const std::vector<Result> &results, const Options &options) {
+    std::ostringstream out;
+    out << "{\n  \"records\": " << options.records << ",\n  \"record_size\": " << options.recordSize
+        << ",\n  \"threads\": " << options.threads << ",\n  \"workloads\": [";
+    auto latencies = [&](const LatencyHistogram &histogram) {
+        std::ostringstream json;
+        json << "{\"ops\": " << histogram.getCount() << ", \"p50_ns\": " << histogram.getPercentile(50)
+             << ", \"p99_ns\": " << histogram.getPercentile(99) << ", \"p999_ns\": " << histogram.getPercentile(99.9)
+             << ", \"max_ns\": " << histogram.getMax() << "}";
+        return json.str();
+    };
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &result = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << result.workload << "\", \"ops_per_second\": "
+            << result.all.getCount() / result.runSeconds << ", \"failed\": " << result.failed
+            << ", \"all\": " << latencies(result.all);
+        for (int op = 0; op < kNumOperations; ++op)
+            if (result.perOperation[op].getCount() > 0)
+                out << ", \"" << kOperationNames[op] << "\": " << latencies(result.perOperation[op]);
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    std::ofstream file(options.outFile);
+    file << out.str();
+    if (!file)
+        std::cerr << "cannot write " << options.outFile << std::endl;
+}
+
+// Value of "--name=value" if 'arg' is that flag.
+static bool flagValue(const std::string &arg, const std::string &name, std::string &value) {
+    std::string prefix = "--" + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0)
+        return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i], value;
+        if (flagValue(arg, "workloads", value))
+            options.workloads = value;
+        else if (flagValue(arg, "records", value))
+            options.records = std::max(1LL, std::atoll(value.c_str()));
+        else if (flagValue(arg, "record-size", value))
+            options.recordSize = std::atoi(value.c_str());
+        else if (flagValue(arg, "threads", value))
+            options.threads = std::max(1, std::atoi(value.c_str()));
+        else if (flagValue(arg, "duration", value))
+            options.duration = std::atof(value.c_str());
+        else if (flagValue(arg, "distribution", value))
+            options.distribution = value;
+        else if (flagValue(arg, "pool", value))
+            options.poolSize = std::max(1, std::atoi(value.c_str()));
+        else if (flagValue(arg, "dir", value))
+            options.directory = value;
+        else if (flagValue(arg, "out", value))
+            options.outFile = value;
+        else if (flagValue(arg, "trace", value))
+            options.traceFile = value;
+        else if (arg == "--storage-latency")
+            options.storageLatency = true;
+        else if (flagValue(arg, "report-interval", value))
+            options.reportInterval = std::atof(value.c_str());
+        else if (flagValue(arg, "chrome-trace", value))
+            options.chromeTraceFile = value;
+        else {
+            std::cerr << "unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+    int maxRecord = PAGE_SIZE - static_cast<int>(sizeof(PageHeader)) - static_cast<int>(sizeof(Slot));
+    if (options.recordSize < static_cast<int>(sizeof(int64_t)) || options.recordSize > maxRecord) {
+        std::cerr << "record size must be between " << sizeof(int64_t) << " and " << maxRecord << std::endl;
+        return 1;
+    }
+    if (!options.distribution.empty() && options.distribution != "zipfian" && options.distribution != "uniform" &&
+        options.distribution != "latest") {
+        std::cerr << "unknown distribution " << options.distribution << std::endl;
+        return 1;
+    }
+
+    std::cout << options.records << " records of " << options.recordSize << " bytes, " << options.threads
+              << " threads, " << options.duration << " s per workload, pool of " << options.poolSize << " frames"
+              << std::endl;
+    if (options.storageLatency)
+        StorageLatency::setEnabled(StorageOperation::FIX_PAGE, true);
+    std::unique_ptr<StorageLatencyReporter> reporter;
+    if (options.reportInterval > 0) {
+        reporter.reset(new StorageLatencyReporter(
+            std::chrono::milliseconds(static_cast<int64_t>(options.reportInterval * 1000)),
+            [](const std::vector<std::string> &lines) {
+                for (const std::string &line : lines)
+                    std::cerr << line << std::endl;
+            }));
+    }
+    std::vector<Result> results;
+    for (char name : options.workloads) {
+        const Workload *workload = nullptr;
+        for (const Workload &candidate : kWorkloads)
+            if (candidate.name == toupper(name))
+                workload = &candidate;
+        if (workload == nullptr) {
+            std::cerr << "unknown workload " << name << std::endl;
+            return 1;
+        }
+        results.push_back(runWorkload(*workload, options));
+        printResult(results.back());
+    }
+    if (!options.outFile.empty())
+        writeJson(results, options);
+    return 0;
+}
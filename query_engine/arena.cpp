@@ -0,0 +1,60 @@
+#include "arena.h"
+#include <algorithm>
+#include <new>
+#include "../storage_engine/memory_tracker.h"
+
+static thread_local Arena *currentArena = nullptr;
+
+Arena::Arena(size_t chunkSize)
+    : chunkSize_(std::max(chunkSize, kAlignment)), chunk_(0), used_(0)
+{
+}
+
+void *Arena::allocate(size_t bytes) {
+    bytes = (bytes + kAlignment - 1) & ~(kAlignment - 1);
+    ++stats_.allocations;
+    stats_.bytes += bytes;
+    // Chunks too small for this request are skipped until the next rewind.
+    while (chunk_ < chunks_.size() && used_ + bytes > chunks_[chunk_].size) {
+        ++chunk_;
+        used_ = 0;
+    }
+    if (chunk_ == chunks_.size()) {
+        size_t size = std::max(chunkSize_, bytes);
+        // operator new aligns to at least 16 bytes.
+        chunks_.push_back(Chunk{static_cast<char *>(::operator new(size)), size});
+        ++stats_.chunks;
+        stats_.reservedBytes += size;
+        MemoryTracker::allocated(MemorySubsystem::QUERY_ARENAS, size);
+        used_ = 0;
+    }
+    void *result = chunks_[chunk_].data + used_;
+    used_ += bytes;
+    return result;
+}
+
+void Arena::rewind() {
+    chunk_ = 0;
+    used_ = 0;
+}
+
+void Arena::release() {
+    for (const Chunk &chunk : chunks_) {
+        ::operator delete(chunk.data);
+        MemoryTracker::freed(MemorySubsystem::QUERY_ARENAS, chunk.size);
+    }
+    chunks_.clear();
+    rewind();
+}
+
+Arena *Arena::current() {
+    return currentArena;
+}
+
+ArenaScope::ArenaScope(Arena *arena) : previous_(currentArena) {
+    currentArena = arena;
+}
+
+ArenaScope::~ArenaScope() {
+    currentArena = previous_;
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// What an Arena handed out since it was created.
+struct ArenaStats {
+    uint64_t allocations = 0;   // allocate() calls.
+    uint64_t bytes = 0;         // Bytes handed out, rounded up to the alignment.
+    uint64_t chunks = 0;        // Chunks taken from the heap.
+    uint64_t reservedBytes = 0; // Bytes of those chunks.
+
+    ArenaStats &operator+=(const ArenaStats &other) {
+        allocations += other.allocations;
+        bytes += other.bytes;
+        chunks += other.chunks;
+        reservedBytes += other.reservedBytes;
+        return *this;
+    }
+};
+
+// Bump-pointer allocator for memory that dies together: allocating is an
+// add and a compare, freeing a single block is a no-op, and everything is
+// given back at once by rewind() (the chunks are kept for reuse) or
+// release(). Not thread-safe; every thread uses its own arena.
+//
+// The executor gives each worker an arena for the duration of a run and
+// installs it as the thread's current arena. Memory taken from it is valid
+// until the batch being processed has reached the sink: the arena is
+// rewound before the next batch, so steady-state execution does not call
+// malloc for its temporaries.
+class Arena {
+public:
+    // Every allocation is aligned for any fixed-width column type.
+    static const size_t kAlignment = 16;
+
+    explicit Arena(size_t chunkSize = 64 * 1024);
+    ~Arena() { release(); }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t bytes);
+
+    // Makes all memory handed out so far reusable, keeping the chunks.
+    void rewind();
+
+    // Returns the chunks to the heap.
+    void release();
+
+    const ArenaStats &getStats() const { return stats_; }
+
+    // The arena installed on the calling thread by an ArenaScope, or null.
+    static Arena *current();
+
+private:
+    friend class ArenaScope;
+
+    struct Chunk {
+        char *data;
+        size_t size;
+    };
+
+    size_t chunkSize_;
+    std::vector<Chunk> chunks_;
+    size_t chunk_; // Chunk being filled.
+    size_t used_;  // Bytes used in it.
+    ArenaStats stats_;
+};
+
+// Installs an arena as the calling thread's current arena for its lifetime.
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena *arena);
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+private:
+    Arena *previous_;
+};
+
+// STL allocator drawing from an arena, or from the heap when it has none.
+// A container keeps the allocator it was constructed with: assignment and
+// copies do not carry the arena along, so a copy of arena-backed data lives
+// on the heap and may outlive the arena.
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::false_type propagate_on_container_move_assignment;
+    typedef std::false_type propagate_on_container_swap;
+    typedef std::false_type is_always_equal;
+
+    ArenaAllocator(Arena *arena = nullptr) : arena_(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.getArena()) {}
+
+    T *allocate(size_t n) {
+        if (arena_ != nullptr)
+            return static_cast<T *>(arena_->allocate(n * sizeof(T)));
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t) {
+        if (arena_ == nullptr)
+            ::operator delete(p);
+    }
+
+    ArenaAllocator select_on_container_copy_construction() const { return ArenaAllocator(); }
+
+    Arena *getArena() const { return arena_; }
+
+private:
+    Arena *arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.getArena() == b.getArena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.getArena() != b.getArena();
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,222 @@
+#pragma once
+#include <cstring>
+#include <string>
+#include <vector>
+#include "arena.h"
+#include "types.h"
+
+// Number of rows the executor moves between operators at a time.
+// Small enough that a batch's columns stay in L1/L2, large enough to amortize
+// per-batch dispatch.
+const size_t kBatchSize = 1024;
+
+// One column of a batch. Fixed-width values are stored contiguously so that
+// kernels can run over them as plain arrays; VARCHAR values are kept as strings.
+//
+// Scratch columns that never leave an operator can keep their fixed-width
+// values in an arena. Such a column stays in its arena: moving it into
+// another column copies the values to the heap.
+class ColumnVector {
+public:
+    explicit ColumnVector(TypeId type = TypeId::BIGINT, Arena *arena = nullptr)
+        : type_(type), size_(0), data_(ArenaAllocator<char>(arena)) {}
+
+    ColumnVector(const ColumnVector &other) = default;
+    ColumnVector(ColumnVector &&other) noexcept
+        : type_(other.type_), size_(other.size_), data_(std::move(other.data_), ArenaAllocator<char>()),
+          strings_(std::move(other.strings_)) {}
+    ColumnVector &operator=(const ColumnVector &other) = default;
+    ColumnVector &operator=(ColumnVector &&other) = default;
+
+    Arena *getArena() const { return data_.get_allocator().getArena(); }
+
+    TypeId getType() const { return type_; }
+
+    // Changes the type; the contents become undefined.
+    void reset(TypeId type) {
+        type_ = type;
+        size_ = 0;
+        data_.clear();
+        strings_.clear();
+    }
+
+    size_t size() const { return size_; }
+
+    void resize(size_t n) {
+        size_ = n;
+        if (type_ == TypeId::VARCHAR)
+            strings_.resize(n);
+        else
+            data_.resize(n * typeWidth(type_));
+    }
+
+    void clear() { resize(0); }
+
+    // Raw access to the values. T must match the physical type of the column.
+    template <typename T> T* values() { return reinterpret_cast<T*>(data_.data()); }
+    template <typename T> const T* values() const { return reinterpret_cast<const T*>(data_.data()); }
+
+    // Slow, type-switching accessors for row-at-a-time code paths.
+    Value getValue(size_t row) const {
+        switch (type_) {
+        case TypeId::INTEGER: return Value::makeInteger(values<int32_t>()[row]);
+        case TypeId::DATE:    return Value::makeDate(values<int32_t>()[row]);
+        case TypeId::BIGINT:  return Value::makeBigint(values<int64_t>()[row]);
+        case TypeId::DOUBLE:  return Value::makeDouble(values<double>()[row]);
+        case TypeId::BOOLEAN: return Value::makeBoolean(values<uint8_t>()[row] != 0);
+        case TypeId::VARCHAR: return Value::makeVarchar(strings_[row]);
+        }
+        return Value();
+    }
+
+    void setValue(size_t row, const Value &value) {
+        switch (type_) {
+        case TypeId::INTEGER:
+        case TypeId::DATE:    values<int32_t>()[row] = static_cast<int32_t>(value.integer); break;
+        case TypeId::BIGINT:  values<int64_t>()[row] = value.type == TypeId::DOUBLE ? static_cast<int64_t>(value.real) : value.integer; break;
+        case TypeId::DOUBLE:  values<double>()[row] = value.asDouble(); break;
+        case TypeId::BOOLEAN: values<uint8_t>()[row] = value.integer ? 1 : 0; break;
+        case TypeId::VARCHAR: strings_[row] = value.text; break;
+        }
+    }
+
+    void append(const Value &value) {
+        resize(size_ + 1);
+        setValue(size_ - 1, value);
+    }
+
+    // Copies row 'from' of 'other' (same type) to the end of this column.
+    void appendFrom(const ColumnVector &other, size_t from) {
+        resize(size_ + 1);
+        copyRow(other, from, size_ - 1);
+    }
+
+    // Overwrites row 'to' with row 'from' of 'other' (same type).
+    void copyRow(const ColumnVector &other, size_t from, size_t to) {
+        if (type_ == TypeId::VARCHAR) {
+            strings_[to] = other.strings_[from];
+        } else {
+            size_t width = typeWidth(type_);
+            memcpy(&data_[to * width], &other.data_[from * width], width);
+        }
+    }
+
+    // Appends rows rows[0..n) of 'other' (same type) to this column.
+    void appendRows(const ColumnVector &other, const uint32_t *rows, size_t n) {
+        size_t start = size_;
+        resize(size_ + n);
+        switch (type_) {
+        case TypeId::INTEGER:
+        case TypeId::DATE:    gatherFixed(other.values<int32_t>(), values<int32_t>() + start, rows, n); break;
+        case TypeId::BIGINT:  gatherFixed(other.values<int64_t>(), values<int64_t>() + start, rows, n); break;
+        case TypeId::DOUBLE:  gatherFixed(other.values<double>(), values<double>() + start, rows, n); break;
+        case TypeId::BOOLEAN: gatherFixed(other.values<uint8_t>(), values<uint8_t>() + start, rows, n); break;
+        case TypeId::VARCHAR:
+            for (size_t i = 0; i < n; ++i)
+                strings_[start + i] = other.strings_[rows[i]];
+            break;
+        }
+    }
+
+    // Appends the first n rows of 'other' (same type) to this column.
+    void appendRange(const ColumnVector &other, size_t n) {
+        size_t start = size_;
+        resize(size_ + n);
+        if (type_ == TypeId::VARCHAR) {
+            for (size_t i = 0; i < n; ++i)
+                strings_[start + i] = other.strings_[i];
+        } else if (n > 0) {
+            size_t width = typeWidth(type_);
+            memcpy(&data_[start * width], other.data_.data(), n * width);
+        }
+    }
+
+    // Bytes held by the values.
+    size_t memoryBytes() const {
+        size_t bytes = data_.size();
+        for (const std::string &text : strings_)
+            bytes += sizeof(std::string) + text.size();
+        return bytes;
+    }
+
+private:
+    template <typename T>
+    static void gatherFixed(const T *in, T *out, const uint32_t *rows, size_t n) {
+        for (size_t i = 0; i < n; ++i)
+            out[i] = in[rows[i]];
+    }
+
+    TypeId type_;
+    size_t size_;
+    ArenaVector<char> data_;
+    std::vector<std::string> strings_;
+};
+
+template <> inline std::string* ColumnVector::values<std::string>() { return strings_.data(); }
+template <> inline const std::string* ColumnVector::values<std::string>() const { return strings_.data(); }
+
+// A horizontal slice of rows in columnar form.
+// When 'hasSelection' is set only the row positions listed in 'selection'
+// are live; filters narrow the selection instead of copying columns.
+struct Batch {
+    std::vector<ColumnVector> columns;
+    size_t count = 0;
+    bool hasSelection = false;
+    std::vector<uint32_t> selection;
+    // Position of the batch in its source's output, set by sources whose
+    // rows come in a meaningful order (index scans: key order). Operators
+    // keep it and keep the order of rows within the batch, so sinks can
+    // restore the order the parallel workers scrambled.
+    size_t sequence = 0;
+
+    // Number of live rows.
+    size_t activeCount() const { return hasSelection ? selection.size() : count; }
+
+    // Position of the i-th live row.
+    uint32_t rowAt(size_t i) const { return hasSelection ? selection[i] : static_cast<uint32_t>(i); }
+
+    // Drops the rows that are not selected, so that the columns hold exactly
+    // the live rows and no selection is needed.
+    void compact() {
+        if (!hasSelection)
+            return;
+        for (auto &column : columns) {
+            ColumnVector dense(column.getType());
+            dense.appendRows(column, selection.data(), selection.size());
+            column = std::move(dense);
+        }
+        count = selection.size();
+        hasSelection = false;
+        selection.clear();
+    }
+
+    // Appends the live rows of 'other', which must have the same column types.
+    // This batch itself must be dense (no selection).
+    void append(const Batch &other) {
+        if (columns.empty())
+            for (const auto &column : other.columns)
+                columns.emplace_back(column.getType());
+        for (size_t c = 0; c < columns.size(); ++c) {
+            if (other.hasSelection)
+                columns[c].appendRows(other.columns[c], other.selection.data(), other.selection.size());
+            else
+                columns[c].appendRange(other.columns[c], other.count);
+        }
+        count += other.activeCount();
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = selection.size() * sizeof(uint32_t);
+        for (const auto &column : columns)
+            bytes += column.memoryBytes();
+        return bytes;
+    }
+
+    void reset() {
+        for (auto &column : columns)
+            column.clear();
+        count = 0;
+        hasSelection = false;
+        selection.clear();
+    }
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Blocked Bloom filter over 64-bit key hashes (see hashing.h). A key sets
+// four bits of a single 64-bit word, so a lookup costs one memory access.
+// At 16 bits per key about 0.5% of absent keys pass. A filter that was never
+// sized lets every key pass.
+class BloomFilter {
+public:
+    // Sizes the filter for 'keys' keys and clears it.
+    void reset(size_t keys) {
+        size_t words = 1;
+        while (words * 64 < keys * kBitsPerKey)
+            words <<= 1;
+        words_.assign(words, 0);
+        mask_ = words - 1;
+    }
+
+    void insert(uint64_t hash) { words_[(hash >> 32) & mask_] |= pattern(hash); }
+
+    bool mayContain(uint64_t hash) const {
+        if (words_.empty())
+            return true;
+        uint64_t bits = pattern(hash);
+        return (words_[(hash >> 32) & mask_] & bits) == bits;
+    }
+
+private:
+    static const size_t kBitsPerKey = 16;
+
+    // The word is picked by the high half of the hash, the bits by the low half.
+    static uint64_t pattern(uint64_t hash) {
+        return (uint64_t(1) << (hash & 63)) | (uint64_t(1) << ((hash >> 6) & 63)) |
+               (uint64_t(1) << ((hash >> 12) & 63)) | (uint64_t(1) << ((hash >> 18) & 63));
+    }
+
+    std::vector<uint64_t> words_;
+    uint64_t mask_ = 0;
+};
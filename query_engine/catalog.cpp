@@ -0,0 +1,98 @@
+#include "catalog.h"
+#include "materialized_view.h"
+
+TableInfo* Catalog::createTable(const std::string &name, const Schema &schema) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tables_.count(name))
+        return nullptr;
+    std::unique_ptr<TableInfo> table(new TableInfo());
+    table->name = name;
+    table->schema = schema;
+    table->heap.reset(new HeapFile(bufferPool_));
+    TableInfo *result = table.get();
+    tables_[name] = std::move(table);
+    return result;
+}
+
+TableInfo* Catalog::getTable(const std::string &name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tables_.find(name);
+    return it == tables_.end() ? nullptr : it->second.get();
+}
+
+std::vector<std::string> Catalog::getTableNames() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> names;
+    for (const auto &entry : tables_)
+        names.push_back(entry.first);
+    return names;
+}
+
+IndexInfo* Catalog::createIndex(TableInfo *table, const std::string &name, int column, std::string &error) {
+    TypeId type = table->schema.getColumn(column).type;
+    if (type != TypeId::INTEGER && type != TypeId::BIGINT && type != TypeId::DATE) {
+        error = std::string("cannot index a column of type ") + typeName(type);
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (indexOwners_.count(name)) {
+        error = "index " + name + " already exists";
+        return nullptr;
+    }
+    std::unique_ptr<IndexInfo> index(new IndexInfo());
+    index->name = name;
+    index->column = column;
+    index->tree.reset(new BPlusTree());
+
+    BufferPool *bufferPool = table->heap->getBufferPool();
+    for (int pageId : table->heap->getPageIds()) {
+        Page *page = bufferPool->fixPage(pageId, false);
+        if (page == nullptr) {
+            error = "could not read page " + std::to_string(pageId) + " of " + table->name;
+            return nullptr;
+        }
+        for (int slot = 0; slot < page->getNumberOfSlots(); ++slot) {
+            int length;
+            const char *record = page->getRecordData(slot, length);
+            if (record != nullptr)
+                index->tree->insert(table->schema.decodeInteger(record, column), RecordId{pageId, slot});
+        }
+        bufferPool->unfixPage(page, false);
+    }
+
+    IndexInfo *result = index.get();
+    table->indexes.push_back(std::move(index));
+    indexOwners_[name] = table;
+    ++version_;
+    return result;
+}
+
+TableInfo* Catalog::createView(const std::string &name, std::shared_ptr<MaterializedView> view,
+                              std::string &error) {
+    TableInfo *table = createTable(name, view->getSchema());
+    if (table == nullptr) {
+        error = "table " + name + " already exists";
+        return nullptr;
+    }
+    if (!view->populate(table, error)) {
+        table->heap->freePages();
+        std::lock_guard<std::mutex> lock(mutex_);
+        tables_.erase(name);
+        return nullptr;
+    }
+    table->view = view;
+    view->getBase()->views.push_back(view.get());
+    ++version_;
+    return table;
+}
+
+bool Catalog::analyze(TableInfo *table, const AnalyzeOptions &options, std::string &error) {
+    std::shared_ptr<TableStatistics> statistics = analyzeTable(*table->heap, table->schema, options, error);
+    if (!statistics) {
+        error += " of " + table->name;
+        return false;
+    }
+    table->setStatistics(statistics);
+    ++version_;
+    return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../storage_engine/bplustree.h"
+#include "../storage_engine/heapfilemanager.h"
+#include "schema.h"
+#include "statistics.h"
+
+class MaterializedView;
+
+// B+ tree index on one integral column (INTEGER, BIGINT or DATE) of a table.
+struct IndexInfo {
+    std::string name;
+    int column;
+    std::unique_ptr<BPlusTree> tree;
+};
+
+struct TableInfo {
+    std::string name;
+    Schema schema;
+    std::unique_ptr<HeapFile> heap;
+    // Changed only by CREATE INDEX, which must not run concurrently with
+    // other statements on the table.
+    std::vector<std::unique_ptr<IndexInfo>> indexes;
+    // Materialized views over this table, brought up to date by every
+    // insert, update and delete. Changed only by CREATE MATERIALIZED VIEW,
+    // under the same rule as 'indexes'.
+    std::vector<MaterializedView *> views;
+    // Set if the table stores a materialized view. Only the view writes its
+    // rows; statements may read them but not change them.
+    std::shared_ptr<MaterializedView> view;
+
+    // Result of the last ANALYZE, or null. Swapped atomically so that
+    // planning can run while ANALYZE replaces it.
+    std::shared_ptr<const TableStatistics> getStatistics() const { return std::atomic_load(&statistics_); }
+    void setStatistics(std::shared_ptr<const TableStatistics> statistics) {
+        std::atomic_store(&statistics_, statistics);
+    }
+
+private:
+    std::shared_ptr<const TableStatistics> statistics_;
+};
+
+// Maps table names to their schema, heap file, indexes and statistics.
+// Tables live in the database's single file and share its buffer pool. The
+// catalog itself is kept in memory only.
+class Catalog {
+public:
+    explicit Catalog(BufferPool *bufferPool) : bufferPool_(bufferPool), version_(0) {}
+
+    // Returns nullptr if a table called 'name' already exists.
+    TableInfo* createTable(const std::string &name, const Schema &schema);
+
+    // Returns nullptr if there is no such table.
+    TableInfo* getTable(const std::string &name) const;
+
+    std::vector<std::string> getTableNames() const;
+
+    // Creates an index called 'name' on 'column' of 'table' and fills it from
+    // the table's rows. Returns nullptr and sets 'error' if the name is taken,
+    // the column cannot be indexed or a page of the table cannot be read.
+    IndexInfo* createIndex(TableInfo *table, const std::string &name, int column, std::string &error);
+
+    // Creates a table called 'name' that stores 'view' and fills it from the
+    // view's base table. Returns nullptr and sets 'error', leaving no table
+    // behind, if the name is taken or the view could not be filled.
+    TableInfo* createView(const std::string &name, std::shared_ptr<MaterializedView> view, std::string &error);
+
+    // Collects fresh statistics for 'table' (see analyzeTable()). Returns
+    // false and sets 'error', keeping the old statistics, if a page of the
+    // table cannot be read.
+    bool analyze(TableInfo *table, const AnalyzeOptions &options, std::string &error);
+
+    // Bumped by every change that can make an existing plan stale or
+    // suboptimal (new indexes, views or statistics).
+    uint64_t getVersion() const { return version_; }
+
+private:
+    BufferPool *bufferPool_;
+    std::map<std::string, std::unique_ptr<TableInfo>> tables_;
+    std::map<std::string, TableInfo *> indexOwners_; // Index name to table.
+    std::atomic<uint64_t> version_;
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,45 @@
+#include "cost_model.h"
+#include <algorithm>
+#include <cmath>
+
+double CostModel::pagesTouched(double pages, double rows) {
+    if (pages <= 1)
+        return std::min(pages, rows);
+    return pages * (1 - std::pow(1 - 1 / pages, rows));
+}
+
+double CostModel::scanCost(double pages, double rows, size_t predicates) const {
+    return pages * sequentialPageCost + rows * (tupleCost + predicates * operatorCost);
+}
+
+double CostModel::indexScanCost(double height, double pages, double rows, double matches,
+                                size_t predicates) const {
+    matches = std::min(matches, rows);
+    // Entries come in key order, not page order, so every page they lead to
+    // is a random read.
+    return height * randomPageCost + matches * indexTupleCost +
+           pagesTouched(pages, matches) * randomPageCost + matches * (tupleCost + predicates * operatorCost);
+}
+
+double CostModel::bitmapScanCost(double height, double pages, double rows, double matches,
+                                 size_t predicates) const {
+    matches = std::min(matches, rows);
+    double touched = pagesTouched(pages, matches);
+    double density = pages > 0 ? touched / pages : 1;
+    double pageCost = randomPageCost - (randomPageCost - sequentialPageCost) * density;
+    return height * randomPageCost + matches * indexTupleCost + sortCost(matches) + touched * pageCost +
+           matches * (tupleCost + predicates * operatorCost);
+}
+
+double CostModel::hashJoinCost(double buildRows, double probeRows, double outputRows) const {
+    return buildRows * (tupleCost + operatorCost) + probeRows * operatorCost + outputRows * tupleCost;
+}
+
+double CostModel::mergeJoinCost(double innerRows, double outerRows, double outputRows) const {
+    return innerRows * tupleCost + (innerRows + outerRows) * operatorCost / 2 + outputRows * tupleCost;
+}
+
+double CostModel::sortCost(double rows) const {
+    // About one comparison per row and level.
+    return rows * std::log2(std::max(2.0, rows)) * operatorCost;
+}
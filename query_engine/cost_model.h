@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+
+// Cost estimates used by the planner to choose access paths and join
+// orders. The unit is one sequential page read; the other constants are
+// relative to it and can be tuned through DatabaseOptions.
+struct CostModel {
+    double sequentialPageCost = 1.0;
+    double randomPageCost = 4.0;
+    double tupleCost = 0.01;       // Decoding a row and passing it on.
+    double indexTupleCost = 0.005; // Visiting one index entry.
+    double operatorCost = 0.0025;  // Evaluating one predicate or hashing one key.
+
+    // Full scan of a table of 'pages' pages and 'rows' rows, evaluating
+    // 'predicates' conjuncts on every row.
+    double scanCost(double pages, double rows, size_t predicates) const;
+
+    // Index range scan through an index 'height' levels deep that finds
+    // 'matches' of the 'rows' rows of a table of 'pages' pages, fetching
+    // them in key order and evaluating 'predicates' conjuncts on each.
+    double indexScanCost(double height, double pages, double rows, double matches, size_t predicates) const;
+
+    // Bitmap heap scan: the same index range, but the 'matches' record ids
+    // are sorted by page and every page is read once, in file order. The
+    // denser the pages touched, the closer their reads get to sequential.
+    double bitmapScanCost(double height, double pages, double rows, double matches, size_t predicates) const;
+
+    // Hash join building on 'buildRows' rows, probed with 'probeRows' rows
+    // and producing 'outputRows' rows.
+    double hashJoinCost(double buildRows, double probeRows, double outputRows) const;
+
+    // Merge join of 'innerRows' rows already sorted on the key with
+    // 'outerRows' sorted rows, producing 'outputRows' rows. Unlike a hash
+    // join nothing is hashed: the sides are only compared in step.
+    double mergeJoinCost(double innerRows, double outerRows, double outputRows) const;
+
+    // Sorting 'rows' rows.
+    double sortCost(double rows) const;
+
+    // Distinct pages touched when fetching 'rows' random rows of a table of
+    // 'pages' pages (Cardenas' formula).
+    static double pagesTouched(double pages, double rows);
+};
@@ -0,0 +1,566 @@
+#include "database.h"
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+Value QueryResult::getValue(size_t row, size_t column) const {
+    for (const Batch &batch : batches) {
+        if (row < batch.count)
+            return batch.columns[column].getValue(row);
+        row -= batch.count;
+    }
+    return Value();
+}
+
+static std::string valueText(const Value &value) {
+    if (value.type == TypeId::DATE)
+        return formatDate(static_cast<int32_t>(value.integer));
+    if (value.type == TypeId::BOOLEAN)
+        return value.integer ? "true" : "false";
+    return value.toString();
+}
+
+std::string QueryResult::toString() const {
+    if (!ok)
+        return "error: " + error + "\n";
+    std::ostringstream out;
+    if (columnNames.empty()) {
+        out << rowCount << " row(s)\n";
+        return out.str();
+    }
+    for (size_t c = 0; c < columnNames.size(); ++c)
+        out << (c ? " | " : "") << columnNames[c];
+    out << "\n";
+    for (const Batch &batch : batches) {
+        for (size_t r = 0; r < batch.count; ++r) {
+            for (size_t c = 0; c < columnNames.size(); ++c)
+                out << (c ? " | " : "") << valueText(batch.columns[c].getValue(r));
+            out << "\n";
+        }
+    }
+    return out.str();
+}
+
+static QueryResult errorResult(const std::string &error) {
+    QueryResult result;
+    result.ok = false;
+    result.error = error;
+    return result;
+}
+
+// Cache key: the SQL text with runs of whitespace outside string literals
+// collapsed, so formatting differences do not defeat the cache.
+static std::string normalizeSql(const std::string &sql) {
+    std::string key;
+    bool quoted = false, space = false;
+    for (char c : sql) {
+        if (!quoted && isspace(static_cast<unsigned char>(c))) {
+            space = true;
+            continue;
+        }
+        if (space && !key.empty())
+            key += ' ';
+        space = false;
+        if (c == '\'')
+            quoted = !quoted;
+        key += c;
+    }
+    return key;
+}
+
+// A parameter value in a result cache key: its type and exact value.
+static std::string parameterKey(const Value &value) {
+    std::string key(1, '\0');
+    key += std::to_string(static_cast<int>(value.type)) + ':';
+    if (value.type == TypeId::VARCHAR)
+        return key + value.text;
+    if (value.type == TypeId::DOUBLE) {
+        uint64_t bits;
+        memcpy(&bits, &value.real, sizeof(bits));
+        return key + std::to_string(bits);
+    }
+    return key + std::to_string(value.integer);
+}
+
+// The catalog is not persisted, so pages left by an earlier run are garbage.
+static const std::string &recreateFile(const std::string &fileName) {
+    std::remove(fileName.c_str());
+    return fileName;
+}
+
+// 'options' drawing their memory from 'governor'.
+static AggregateOptions governedBy(AggregateOptions options, MemoryGovernor *governor) {
+    options.governor = governor;
+    return options;
+}
+
+Database::Database(const std::string &fileName, const DatabaseOptions &options)
+    : options_(options), memoryGovernor_(options.memoryLimit), diskManager_(recreateFile(fileName)),
+      bufferPool_(options.bufferPoolSize, &diskManager_, &memoryGovernor_), catalog_(&bufferPool_),
+      executor_(options.executor), planner_(&catalog_, governedBy(options.aggregate, &memoryGovernor_), options.cost),
+      planCacheHits_(0), planCacheMisses_(0), statementCount_(0), resultCacheBytes_(0), resultCacheHits_(0),
+      resultCacheMisses_(0)
+{
+    options_.aggregate.governor = &memoryGovernor_;
+    resultCacheReclaimerId_ = memoryGovernor_.addReclaimer(
+        [this](size_t bytes) { return releaseCachedResults(bytes); });
+    if (!options.pageTraceFile.empty() && pageTrace_.open(options.pageTraceFile))
+        bufferPool_.setPageTrace(&pageTrace_);
+}
+
+Database::~Database() {
+    memoryGovernor_.removeReclaimer(resultCacheReclaimerId_);
+    releaseCachedResults(SIZE_MAX);
+    planCache_.clear();
+    bufferPool_.flushAllPages();
+    bufferPool_.setPageTrace(nullptr);
+}
+
+std::shared_ptr<PreparedStatement> Database::prepare(const std::string &sql, std::string &error) {
+    uint64_t version = catalog_.getVersion();
+    std::unique_ptr<Statement> statement = SqlParser::parse(sql, error);
+    if (!statement)
+        return nullptr;
+    std::unique_ptr<QueryPlan> plan = planner_.plan(*statement, error);
+    if (!plan)
+        return nullptr;
+    auto prepared = std::make_shared<PreparedStatement>();
+    prepared->sql_ = sql;
+    prepared->plan_ = std::move(plan);
+    prepared->catalogVersion_ = version;
+    return prepared;
+}
+
+QueryResult Database::execute(const std::string &sql, const std::vector<Value> &parameters) {
+    std::string key = normalizeSql(sql);
+    std::shared_ptr<PreparedStatement> prepared;
+    {
+        std::lock_guard<std::mutex> lock(planCacheMutex_);
+        auto it = planCacheIndex_.find(key);
+        if (it != planCacheIndex_.end()) {
+            planCache_.splice(planCache_.begin(), planCache_, it->second);
+            prepared = *it->second;
+            ++planCacheHits_;
+        } else {
+            ++planCacheMisses_;
+        }
+    }
+
+    if (!prepared) {
+        std::string error;
+        prepared = prepare(sql, error);
+        if (!prepared)
+            return errorResult(error);
+        // DDL changes the catalog, which cached plans were built against.
+        StatementKind kind = prepared->plan_->kind;
+        bool cacheable = kind != StatementKind::CREATE_TABLE && kind != StatementKind::CREATE_INDEX &&
+                         kind != StatementKind::CREATE_VIEW && kind != StatementKind::ANALYZE;
+        std::lock_guard<std::mutex> lock(planCacheMutex_);
+        if (cacheable && options_.planCacheCapacity > 0 && !planCacheIndex_.count(key)) {
+            planCache_.push_front(prepared);
+            planCacheIndex_[key] = planCache_.begin();
+            if (planCache_.size() > options_.planCacheCapacity) {
+                planCacheIndex_.erase(normalizeSql(planCache_.back()->sql_));
+                planCache_.pop_back();
+            }
+        }
+    }
+    return execute(*prepared, parameters);
+}
+
+QueryResult Database::execute(PreparedStatement &statement, const std::vector<Value> &parameters) {
+    std::lock_guard<std::mutex> lock(statement.mutex_);
+    std::string error;
+    uint64_t version = catalog_.getVersion();
+    if (statement.catalogVersion_ != version) {
+        // A new index or new statistics may change the best plan.
+        std::unique_ptr<Statement> parsed = SqlParser::parse(statement.sql_, error);
+        std::unique_ptr<QueryPlan> replanned = parsed ? planner_.plan(*parsed, error) : nullptr;
+        if (!replanned)
+            return errorResult(error);
+        statement.plan_ = std::move(replanned);
+        statement.catalogVersion_ = version;
+    }
+    QueryPlan &plan = *statement.plan_;
+    if (!plan.parameters->bind(parameters, error))
+        return errorResult(error);
+
+    if (plan.explain == ExplainMode::PLAN)
+        return explainResult(plan, nullptr);
+    QueryMemory memory;
+    QueryMemoryScope memoryScope(&memory);
+    std::shared_ptr<QueryProfile> profile;
+    bool pipelined = !plan.pipelines.empty();
+    if (pipelined && (plan.explain == ExplainMode::ANALYZE ||
+                      (options_.profileInterval > 0 && ++statementCount_ % options_.profileInterval == 0)))
+        profile = std::make_shared<QueryProfile>();
+
+    // Profiled statements run, so that the profile means something.
+    QueryResult result;
+    std::string cacheKey;
+    std::vector<uint64_t> versions;
+    if (options_.resultCacheBytes > 0 && plan.kind == StatementKind::SELECT && !profile) {
+        cacheKey = normalizeSql(statement.sql_);
+        for (const Value &value : parameters)
+            cacheKey += parameterKey(value);
+        // Read before the query runs: a change made while it runs leaves
+        // the cached result behind.
+        for (TableInfo *table : plan.readTables)
+            versions.push_back(table->heap->getModificationCount());
+        if (findCachedResult(cacheKey, versions, result))
+            return result;
+    }
+
+    switch (plan.kind) {
+    case StatementKind::SELECT:       result = runSelect(plan, profile.get()); break;
+    case StatementKind::INSERT:       result = runInsert(plan); break;
+    case StatementKind::UPDATE:       result = runUpdate(plan, profile.get()); break;
+    case StatementKind::DELETE:       result = runDelete(plan, profile.get()); break;
+    case StatementKind::CREATE_TABLE: result = runCreateTable(plan); break;
+    case StatementKind::CREATE_INDEX: result = runCreateIndex(plan); break;
+    case StatementKind::CREATE_VIEW:  result = runCreateView(plan); break;
+    case StatementKind::ANALYZE:      result = runAnalyze(plan); break;
+    }
+    if (profile)
+        profile->peakMemoryBytes = memory.getPeak();
+    if (result.ok && plan.explain == ExplainMode::ANALYZE)
+        return explainResult(plan, profile.get());
+    if (result.ok && !cacheKey.empty())
+        cacheResult(cacheKey, versions, result);
+    result.profile = profile;
+    result.peakMemoryBytes = memory.getPeak();
+    return result;
+}
+
+bool Database::findCachedResult(const std::string &key, const std::vector<uint64_t> &versions,
+                                QueryResult &result) {
+    std::lock_guard<std::mutex> lock(resultCacheMutex_);
+    auto it = resultCacheIndex_.find(key);
+    if (it != resultCacheIndex_.end() && it->second->versions != versions) {
+        eraseCachedResult(it->second);
+        it = resultCacheIndex_.end();
+    }
+    if (it == resultCacheIndex_.end()) {
+        ++resultCacheMisses_;
+        return false;
+    }
+    resultCache_.splice(resultCache_.begin(), resultCache_, it->second);
+    result = it->second->result;
+    ++resultCacheHits_;
+    return true;
+}
+
+void Database::cacheResult(const std::string &key, const std::vector<uint64_t> &versions,
+                           const QueryResult &result) {
+    size_t bytes = key.size();
+    for (const Batch &batch : result.batches)
+        bytes += batch.memoryBytes();
+    if (bytes > options_.resultCacheBytes)
+        return;
+    std::lock_guard<std::mutex> lock(resultCacheMutex_);
+    auto it = resultCacheIndex_.find(key);
+    if (it != resultCacheIndex_.end())
+        eraseCachedResult(it->second);
+    while (resultCacheBytes_ + bytes > options_.resultCacheBytes)
+        eraseCachedResult(std::prev(resultCache_.end()));
+    // A cache never takes memory from others; the result is not kept if
+    // the governor has none to spare.
+    if (!memoryGovernor_.tryReserve(bytes, false))
+        return;
+    resultCache_.push_front(CachedResult{key, result, versions, bytes});
+    resultCacheIndex_[key] = resultCache_.begin();
+    resultCacheBytes_ += bytes;
+    MemoryTracker::allocated(MemorySubsystem::RESULT_CACHE, bytes);
+}
+
+void Database::eraseCachedResult(std::list<CachedResult>::iterator it) {
+    resultCacheBytes_ -= it->bytes;
+    memoryGovernor_.release(it->bytes);
+    MemoryTracker::freed(MemorySubsystem::RESULT_CACHE, it->bytes);
+    resultCacheIndex_.erase(it->key);
+    resultCache_.erase(it);
+}
+
+size_t Database::releaseCachedResults(size_t bytes) {
+    std::lock_guard<std::mutex> lock(resultCacheMutex_);
+    size_t freed = 0;
+    while (freed < bytes && !resultCache_.empty()) {
+        freed += resultCache_.back().bytes;
+        eraseCachedResult(std::prev(resultCache_.end()));
+    }
+    return freed;
+}
+
+std::unique_ptr<ResultCursor> Database::openCursor(const std::string &sql, const std::vector<Value> &parameters,
+                                                   std::string &error) {
+    std::unique_ptr<Statement> statement = SqlParser::parse(sql, error);
+    std::unique_ptr<QueryPlan> plan = statement ? planner_.plan(*statement, error) : nullptr;
+    if (!plan)
+        return nullptr;
+    std::unique_ptr<ResultCursor> cursor(new ResultCursor());
+    cursor->stream_ = std::make_shared<StreamSink>(options_.cursorBatches);
+    if (plan->kind != StatementKind::SELECT || plan->explain != ExplainMode::NONE) {
+        // Nothing to stream: replay the complete result.
+        QueryResult result = execute(sql, parameters);
+        if (!result.ok) {
+            error = result.error;
+            return nullptr;
+        }
+        cursor->columnNames_ = result.columnNames;
+        cursor->columnTypes_ = result.columnTypes;
+        cursor->stream_ = std::make_shared<StreamSink>(std::max<size_t>(1, result.batches.size()));
+        cursor->stream_->prepare(1);
+        for (Batch &batch : result.batches)
+            cursor->stream_->consume(batch, 0);
+        cursor->stream_->finish();
+        return cursor;
+    }
+    if (!plan->parameters->bind(parameters, error))
+        return nullptr;
+
+    cursor->columnNames_ = plan->columnNames;
+    cursor->columnTypes_ = plan->columnTypes;
+    cursor->remaining_ = plan->limit < 0 ? SIZE_MAX : static_cast<size_t>(plan->limit);
+    cursor->plan_ = std::move(plan);
+    QueryPlan *running = cursor->plan_.get();
+    std::shared_ptr<StreamSink> stream = cursor->stream_;
+    cursor->thread_ = std::thread([this, running, stream]() {
+        std::string error;
+        if (running->streamable) {
+            std::vector<Pipeline> pipelines = running->pipelines;
+            pipelines.back().sink = stream;
+            // A pipeline that fails before the last one never reaches the
+            // stream, whose reader would wait forever.
+            if (!executor_.run(pipelines, error))
+                stream->fail(error);
+            return;
+        }
+        // Sorted rows are only known once all of them are.
+        if (!executor_.run(running->pipelines, error)) {
+            running->output->clear();
+            stream->prepare(1);
+            stream->fail(error);
+            return;
+        }
+        stream->prepare(1);
+        for (Batch &batch : *running->output)
+            if (!stream->consume(batch, 0))
+                break;
+        stream->finish();
+    });
+    return cursor;
+}
+
+bool ResultCursor::next(Batch &batch) {
+    if (remaining_ == 0 || !stream_->next(batch))
+        return false;
+    if (batch.count > remaining_) {
+        for (auto &column : batch.columns)
+            column.resize(remaining_);
+        batch.count = remaining_;
+    }
+    // Drop the hidden sort columns.
+    batch.columns.resize(columnNames_.size());
+    remaining_ -= batch.count;
+    if (remaining_ == 0)
+        stream_->close();
+    return true;
+}
+
+std::string ResultCursor::getError() const {
+    return stream_->getError();
+}
+
+void ResultCursor::close() {
+    stream_->close();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+QueryResult Database::explainResult(const QueryPlan &plan, const QueryProfile *profile) {
+    QueryResult result;
+    result.columnNames.push_back("plan");
+    result.columnTypes.push_back(TypeId::VARCHAR);
+    Batch batch;
+    batch.columns.emplace_back(TypeId::VARCHAR);
+    for (const std::string &line : profile ? profile->format() : explainPipelines(plan.pipelines))
+        batch.columns[0].append(Value::makeVarchar(line));
+    batch.count = batch.columns[0].size();
+    result.rowCount = batch.count;
+    result.batches.push_back(std::move(batch));
+    return result;
+}
+
+QueryResult Database::runSelect(QueryPlan &plan, QueryProfile *profile) {
+    std::string error;
+    bool ok = executor_.run(plan.pipelines, error, profile);
+    if (!ok) {
+        plan.output->clear();
+        return errorResult(error);
+    }
+    QueryResult result;
+    result.columnNames = plan.columnNames;
+    result.columnTypes = plan.columnTypes;
+    result.batches = std::move(*plan.output);
+    plan.output->clear();
+
+    size_t remaining = plan.limit < 0 ? SIZE_MAX : static_cast<size_t>(plan.limit);
+    size_t kept = 0;
+    for (Batch &batch : result.batches) {
+        if (remaining == 0)
+            break;
+        if (batch.count > remaining) {
+            for (auto &column : batch.columns)
+                column.resize(remaining);
+            batch.count = remaining;
+        }
+        // Drop the hidden sort columns.
+        batch.columns.resize(plan.columnNames.size());
+        remaining -= batch.count;
+        result.rowCount += batch.count;
+        ++kept;
+    }
+    result.batches.resize(kept);
+    return result;
+}
+
+QueryResult Database::runInsert(QueryPlan &plan) {
+    QueryResult result;
+    Batch none;
+    std::vector<Value> row;
+    std::vector<char> record;
+    for (const auto &values : plan.insertRows) {
+        row.clear();
+        for (const auto &value : values)
+            row.push_back(value->evaluateRow(none, 0));
+        plan.table->schema.serializeRow(row, record);
+        RecordId rid = plan.table->heap->insertRecord(record);
+        if (rid.pageId < 0)
+            return errorResult("could not store row in " + plan.table->name);
+        for (const auto &index : plan.table->indexes)
+            index->tree->insert(row[index->column].integer, rid);
+        for (MaterializedView *view : plan.table->views)
+            if (!view->apply(row, 1))
+                return errorResult("could not update materialized views of " + plan.table->name);
+        ++result.rowCount;
+    }
+    return result;
+}
+
+QueryResult Database::runUpdate(QueryPlan &plan, QueryProfile *profile) {
+    // All matching rows are collected before the first one is changed, so a
+    // row that moves to a later page is not updated twice.
+    std::string error;
+    bool ok = executor_.run(plan.pipelines, error, profile);
+    if (!ok) {
+        plan.output->clear();
+        return errorResult(error);
+    }
+    std::vector<Batch> batches = std::move(*plan.output);
+    plan.output->clear();
+
+    QueryResult result;
+    const Schema &schema = plan.table->schema;
+    std::vector<Value> row(schema.size()), oldRow;
+    std::vector<char> record;
+    for (const Batch &batch : batches) {
+        std::vector<ColumnVector> scratch(plan.assignments.size());
+        std::vector<const ColumnVector *> values(plan.assignments.size());
+        for (size_t a = 0; a < plan.assignments.size(); ++a)
+            values[a] = plan.assignments[a].second->evaluate(batch, scratch[a]);
+
+        const int64_t *rids = batch.columns[0].values<int64_t>();
+        for (size_t r = 0; r < batch.count; ++r) {
+            for (size_t c = 0; c < schema.size(); ++c)
+                row[c] = batch.columns[c + 1].getValue(r);
+            if (!plan.table->views.empty())
+                oldRow = row;
+            for (size_t a = 0; a < plan.assignments.size(); ++a)
+                row[plan.assignments[a].first] = values[a]->getValue(r);
+            schema.serializeRow(row, record);
+            RecordId rid = decodeRecordId(rids[r]), newRid;
+            if (!plan.table->heap->updateRecord(rid, record, &newRid))
+                return errorResult("could not update row in " + plan.table->name);
+            // A row that grew may have moved to another page.
+            for (const auto &index : plan.table->indexes) {
+                int64_t oldKey = batch.columns[index->column + 1].getValue(r).integer;
+                int64_t newKey = row[index->column].integer;
+                if (oldKey == newKey && rid.pageId == newRid.pageId && rid.slotId == newRid.slotId)
+                    continue;
+                index->tree->remove(oldKey, rid);
+                index->tree->insert(newKey, newRid);
+            }
+            for (MaterializedView *view : plan.table->views)
+                if (!view->apply(oldRow, -1) || !view->apply(row, 1))
+                    return errorResult("could not update materialized views of " + plan.table->name);
+            ++result.rowCount;
+        }
+    }
+    return result;
+}
+
+QueryResult Database::runDelete(QueryPlan &plan, QueryProfile *profile) {
+    std::string error;
+    bool ok = executor_.run(plan.pipelines, error, profile);
+    if (!ok) {
+        plan.output->clear();
+        return errorResult(error);
+    }
+    std::vector<Batch> batches = std::move(*plan.output);
+    plan.output->clear();
+
+    QueryResult result;
+    std::vector<Value> row(plan.rowColumns.size());
+    for (const Batch &batch : batches) {
+        const int64_t *rids = batch.columns[0].values<int64_t>();
+        for (size_t r = 0; r < batch.count; ++r) {
+            RecordId rid = decodeRecordId(rids[r]);
+            if (!plan.table->heap->deleteRecord(rid))
+                continue;
+            for (size_t i = 0; i < plan.keyColumns.size(); ++i)
+                plan.table->indexes[i]->tree->remove(batch.columns[plan.keyColumns[i]].getValue(r).integer, rid);
+            if (!plan.rowColumns.empty()) {
+                for (size_t c = 0; c < row.size(); ++c)
+                    row[c] = batch.columns[plan.rowColumns[c]].getValue(r);
+                for (MaterializedView *view : plan.table->views)
+                    if (!view->apply(row, -1))
+                        return errorResult("could not update materialized views of " + plan.table->name);
+            }
+            ++result.rowCount;
+        }
+    }
+    return result;
+}
+
+QueryResult Database::runCreateTable(QueryPlan &plan) {
+    if (catalog_.createTable(plan.tableName, plan.schema) == nullptr)
+        return errorResult("table " + plan.tableName + " already exists");
+    return QueryResult();
+}
+
+QueryResult Database::runCreateIndex(QueryPlan &plan) {
+    std::string error;
+    if (catalog_.createIndex(plan.table, plan.indexName, plan.indexColumn, error) == nullptr)
+        return errorResult(error);
+    return QueryResult();
+}
+
+QueryResult Database::runCreateView(QueryPlan &plan) {
+    std::string error;
+    if (catalog_.createView(plan.tableName, plan.view, error) == nullptr)
+        return errorResult(error);
+    return QueryResult();
+}
+
+QueryResult Database::runAnalyze(QueryPlan &plan) {
+    std::string error;
+    if (plan.table != nullptr) {
+        if (!catalog_.analyze(plan.table, options_.analyze, error))
+            return errorResult(error);
+        return QueryResult();
+    }
+    for (const std::string &name : catalog_.getTableNames())
+        if (!catalog_.analyze(catalog_.getTable(name), options_.analyze, error))
+            return errorResult(error);
+    return QueryResult();
+}
@@ -0,0 +1,219 @@
+#pragma once
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../storage_engine/bufferpool.h"
+#include "../storage_engine/diskmanager.h"
+#include "../storage_engine/memory_governor.h"
+#include "catalog.h"
+#include "executor.h"
+#include "planner.h"
+
+struct QueryResult {
+    bool ok = true;
+    std::string error;
+
+    // SELECT results, in dense batches.
+    std::vector<std::string> columnNames;
+    std::vector<TypeId> columnTypes;
+    std::vector<Batch> batches;
+
+    // Rows returned by a SELECT or changed by INSERT, UPDATE and DELETE.
+    size_t rowCount = 0;
+
+    // Set for statements picked by DatabaseOptions::profileInterval.
+    std::shared_ptr<QueryProfile> profile;
+
+    // Most query memory (worker arenas, operator hash tables and buffers)
+    // the statement held at once.
+    int64_t peakMemoryBytes = 0;
+
+    Value getValue(size_t row, size_t column) const;
+
+    // Error message or the rows as a text table.
+    std::string toString() const;
+};
+
+// A parsed and planned statement. Executions of the same statement are
+// serialized because they share the plan's sinks and parameter slots.
+class PreparedStatement {
+public:
+    const std::string &getSql() const { return sql_; }
+    int getNumParameters() const { return static_cast<int>(plan_->parameters->types.size()); }
+    const QueryPlan &getPlan() const { return *plan_; }
+
+private:
+    friend class Database;
+
+    std::string sql_;
+    std::unique_ptr<QueryPlan> plan_;
+    uint64_t catalogVersion_ = 0; // The plan is rebuilt once the catalog changes.
+    std::mutex mutex_;
+};
+
+// Rows of a statement, handed out batch by batch while the query is still
+// running (see Database::openCursor). The Database must outlive the cursor.
+class ResultCursor {
+public:
+    ~ResultCursor() { close(); }
+
+    const std::vector<std::string> &getColumnNames() const { return columnNames_; }
+    const std::vector<TypeId> &getColumnTypes() const { return columnTypes_; }
+
+    // Stores the next batch of rows (dense, at most kBatchSize rows) in
+    // 'batch', waiting for the query to produce it. Returns false after the
+    // last row, or once the query failed.
+    bool next(Batch &batch);
+
+    // Why the query failed once next() returned false; empty if it did not.
+    std::string getError() const;
+
+    // Stops the query; rows not read yet are dropped.
+    void close();
+
+private:
+    friend class Database;
+
+    std::vector<std::string> columnNames_;
+    std::vector<TypeId> columnTypes_;
+    std::unique_ptr<QueryPlan> plan_;
+    std::shared_ptr<StreamSink> stream_;
+    std::thread thread_;
+    size_t remaining_ = SIZE_MAX; // Rows left before the LIMIT.
+};
+
+struct DatabaseOptions {
+    int bufferPoolSize = 1024;
+    ExecutorOptions executor;
+    AggregateOptions aggregate;
+    CostModel cost;
+    AnalyzeOptions analyze;
+    // Number of prepared plans kept for repeated SQL text.
+    size_t planCacheCapacity = 128;
+    // Profile every n-th SELECT, UPDATE and DELETE and attach the profile to
+    // its result; 0 profiles only EXPLAIN ANALYZE.
+    size_t profileInterval = 0;
+    // Batches a cursor's query may produce ahead of its reader.
+    size_t cursorBatches = 4;
+    // Memory for cached SELECT results; 0 disables the result cache.
+    size_t resultCacheBytes = 0;
+    // Memory shared by buffer pool frames, aggregation buffers and cached
+    // results; 0 for no limit. Aggregations spill, and frames and cached
+    // results are freed, to stay within it.
+    size_t memoryLimit = 0;
+    // File to record the buffer pool's page requests in, for the pool
+    // simulator; empty records nothing.
+    std::string pageTraceFile;
+};
+
+// Entry point of the SQL front-end: owns the storage stack, the catalog and
+// an LRU cache of prepared plans keyed by SQL text, so a statement that is
+// executed again skips parsing and planning. Prepared plans are rebuilt when
+// CREATE INDEX or ANALYZE changes what the planner would choose. Optionally
+// it also keeps SELECT results by SQL text and parameter values, each valid
+// as long as none of the tables it read has been modified. Materialized
+// views are updated by the statements that change their base tables. All of
+// the memory above is reserved from one MemoryGovernor, so that a query
+// that needs memory for its aggregation takes it from the caches instead of
+// growing the process. The catalog is not persisted yet, so the database
+// file is recreated when a Database is opened.
+class Database {
+public:
+    explicit Database(const std::string &fileName, const DatabaseOptions &options = DatabaseOptions());
+    ~Database();
+
+    // Parses, plans (or takes the cached plan of) and runs one statement.
+    QueryResult execute(const std::string &sql, const std::vector<Value> &parameters = std::vector<Value>());
+
+    // Returns nullptr and sets 'error' if the statement is invalid.
+    std::shared_ptr<PreparedStatement> prepare(const std::string &sql, std::string &error);
+
+    QueryResult execute(PreparedStatement &statement,
+                        const std::vector<Value> &parameters = std::vector<Value>());
+
+    // Runs one statement in the background and returns a cursor over its
+    // rows. A SELECT whose rows need no sorting streams them: the first
+    // batch is available as soon as it is produced, and the query pauses
+    // while DatabaseOptions::cursorBatches batches wait to be read, so
+    // memory does not grow with the result. Other statements run to
+    // completion first. The statement is planned for the cursor alone,
+    // so a cursor that stays open never holds up a cached plan. Returns
+    // nullptr and sets 'error' if the statement fails to plan or run.
+    std::unique_ptr<ResultCursor> openCursor(const std::string &sql, const std::vector<Value> &parameters,
+                                             std::string &error);
+
+    Catalog &getCatalog() { return catalog_; }
+    BufferPool &getBufferPool() { return bufferPool_; }
+    MemoryGovernor &getMemoryGovernor() { return memoryGovernor_; }
+    QueryExecutor &getExecutor() { return executor_; }
+
+    size_t getPlanCacheHits() const { return planCacheHits_; }
+    size_t getPlanCacheMisses() const { return planCacheMisses_; }
+    size_t getResultCacheHits() const { return resultCacheHits_; }
+    size_t getResultCacheMisses() const { return resultCacheMisses_; }
+    size_t getResultCacheBytes() const { return resultCacheBytes_; }
+
+private:
+    QueryResult runSelect(QueryPlan &plan, QueryProfile *profile);
+    QueryResult runInsert(QueryPlan &plan);
+    QueryResult runUpdate(QueryPlan &plan, QueryProfile *profile);
+    QueryResult runDelete(QueryPlan &plan, QueryProfile *profile);
+    QueryResult runCreateTable(QueryPlan &plan);
+    QueryResult runCreateIndex(QueryPlan &plan);
+    QueryResult runCreateView(QueryPlan &plan);
+    QueryResult runAnalyze(QueryPlan &plan);
+    // The plan, one row per line, with the counters of 'profile' if not null.
+    static QueryResult explainResult(const QueryPlan &plan, const QueryProfile *profile);
+
+    // A SELECT result cached under 'key', computed when the tables it read
+    // had the modification counts 'versions'.
+    struct CachedResult {
+        std::string key;
+        QueryResult result;
+        std::vector<uint64_t> versions;
+        size_t bytes;
+    };
+
+    // Copies the result cached under 'key' into 'result' if the tables it
+    // read still have the modification counts 'versions'; drops it if not.
+    bool findCachedResult(const std::string &key, const std::vector<uint64_t> &versions, QueryResult &result);
+    // Caches 'result', evicting the least recently used results to stay
+    // within DatabaseOptions::resultCacheBytes.
+    void cacheResult(const std::string &key, const std::vector<uint64_t> &versions, const QueryResult &result);
+    // Drops a cached result; resultCacheMutex_ must be held.
+    void eraseCachedResult(std::list<CachedResult>::iterator it);
+    // Drops least recently used results until 'bytes' are freed; the
+    // governor's reclaimer. Returns the bytes freed.
+    size_t releaseCachedResults(size_t bytes);
+
+    DatabaseOptions options_;
+    MemoryGovernor memoryGovernor_;
+    DiskManager diskManager_;
+    BufferPool bufferPool_;
+    PageTraceWriter pageTrace_;
+    Catalog catalog_;
+    QueryExecutor executor_;
+    Planner planner_;
+
+    // Most recently used first.
+    std::list<std::shared_ptr<PreparedStatement>> planCache_;
+    std::unordered_map<std::string, std::list<std::shared_ptr<PreparedStatement>>::iterator> planCacheIndex_;
+    size_t planCacheHits_;
+    size_t planCacheMisses_;
+    std::atomic<size_t> statementCount_; // For profile sampling.
+    std::mutex planCacheMutex_;
+
+    // Most recently used first.
+    std::list<CachedResult> resultCache_;
+    std::unordered_map<std::string, std::list<CachedResult>::iterator> resultCacheIndex_;
+    size_t resultCacheBytes_;
+    size_t resultCacheHits_;
+    size_t resultCacheMisses_;
+    std::mutex resultCacheMutex_;
+    int resultCacheReclaimerId_;
+};
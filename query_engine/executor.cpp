@@ -0,0 +1,380 @@
+#include "executor.h"
+#include "../storage_engine/event_trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Parses a sysfs CPU list such as "0-3,8-11".
+static std::vector<int> parseCpuList(const std::string &list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string part;
+    while (std::getline(stream, part, ',')) {
+        if (part.empty())
+            continue;
+        size_t dash = part.find('-');
+        int first = std::stoi(part.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(part.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+NumaTopology NumaTopology::detect() {
+    NumaTopology topology;
+    for (int node = 0;; ++node) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file.is_open())
+            break;
+        std::string list;
+        std::getline(file, list);
+        std::vector<int> cpus = parseCpuList(list);
+        if (!cpus.empty())
+            topology.cpusPerNode.push_back(cpus);
+    }
+    if (topology.cpusPerNode.empty())
+        topology.cpusPerNode.push_back(std::vector<int>());
+    return topology;
+}
+
+MorselDispatcher::MorselDispatcher(size_t numUnits, size_t morselSize, int numNodes)
+    : morselSize_(morselSize == 0 ? 1 : morselSize), numNodes_(numNodes < 1 ? 1 : numNodes),
+      ranges_(new NodeRange[numNodes < 1 ? 1 : numNodes]), cancelled_(false)
+{
+    for (int node = 0; node < numNodes_; ++node) {
+        ranges_[node].next = numUnits * node / numNodes_;
+        ranges_[node].end = numUnits * (node + 1) / numNodes_;
+    }
+}
+
+bool MorselDispatcher::next(int node, Morsel &morsel) {
+    for (int i = 0; i < numNodes_; ++i) {
+        if (cancelled_.load(std::memory_order_relaxed))
+            return false;
+        NodeRange &range = ranges_[(node + i) % numNodes_];
+        if (range.next.load(std::memory_order_relaxed) >= range.end)
+            continue;
+        size_t begin = range.next.fetch_add(morselSize_);
+        if (begin >= range.end)
+            continue;
+        morsel.begin = begin;
+        morsel.end = std::min(begin + morselSize_, range.end);
+        return true;
+    }
+    return false;
+}
+
+QueryExecutor::QueryExecutor(const ExecutorOptions &options)
+    : options_(options), topology_(NumaTopology::detect())
+{
+    if (options_.numWorkers <= 0) {
+        unsigned hardware = std::thread::hardware_concurrency();
+        options_.numWorkers = hardware == 0 ? 1 : static_cast<int>(hardware);
+    }
+}
+
+static thread_local QueryStatus *currentQueryStatus = nullptr;
+
+std::string QueryStatus::getError() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+}
+
+void QueryStatus::fail(const std::string &error) {
+    QueryStatus *status = currentQueryStatus;
+    if (status == nullptr)
+        return;
+    std::lock_guard<std::mutex> lock(status->mutex_);
+    if (status->failed_.load(std::memory_order_relaxed))
+        return;
+    status->error_ = error;
+    status->failed_.store(true, std::memory_order_release);
+}
+
+QueryStatus *QueryStatus::current() {
+    return currentQueryStatus;
+}
+
+QueryStatusScope::QueryStatusScope(QueryStatus *status) : previous_(currentQueryStatus) {
+    currentQueryStatus = status;
+}
+
+QueryStatusScope::~QueryStatusScope() {
+    currentQueryStatus = previous_;
+}
+
+bool QueryExecutor::run(const std::vector<Pipeline> &pipelines, std::string &error, QueryProfile *profile) {
+    for (const auto &pipeline : pipelines) {
+        PipelineProfile *pipelineProfile = nullptr;
+        if (profile != nullptr) {
+            profile->pipelines.emplace_back();
+            pipelineProfile = &profile->pipelines.back();
+        }
+        if (!run(pipeline, error, pipelineProfile))
+            return false;
+    }
+    return true;
+}
+
+namespace {
+
+// Charges the time and buffer pool activity of the calling thread between
+// consecutive calls to the stage that was running.
+class StageTimer {
+public:
+    StageTimer() { restart(); }
+
+    void restart() {
+        start_ = std::chrono::steady_clock::now();
+        io_ = BufferPool::getThreadCounters();
+    }
+
+    void charge(StageProfile &stage) {
+        auto now = std::chrono::steady_clock::now();
+        const IoCounters &io = BufferPool::getThreadCounters();
+        stage.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_).count();
+        stage.io += io - io_;
+        start_ = now;
+        io_ = io;
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+    IoCounters io_;
+};
+
+void mergeStage(StageProfile &into, const StageProfile &from) {
+    into.nanoseconds += from.nanoseconds;
+    into.batches += from.batches;
+    into.rowsIn += from.rowsIn;
+    into.rowsOut += from.rowsOut;
+    into.io += from.io;
+}
+
+} // namespace
+
+bool QueryExecutor::run(const Pipeline &pipeline, std::string &error, PipelineProfile *profile) {
+    QueryStatus status;
+    QueryStatusScope statusScope(&status);
+    int numWorkers = options_.numWorkers;
+    int numNodes = topology_.getNumNodes();
+    auto wallStart = std::chrono::steady_clock::now();
+    size_t numStages = pipeline.operators.size() + 2;
+    // Every worker counts into its own copy; they are merged at the end.
+    std::vector<std::vector<StageProfile>> workerStages(profile ? numWorkers : 0,
+                                                        std::vector<StageProfile>(numStages));
+    if (profile) {
+        profile->stages.assign(numStages, StageProfile());
+        profile->stages[0].name = pipeline.source->getName();
+        for (size_t i = 0; i < pipeline.operators.size(); ++i)
+            profile->stages[i + 1].name = pipeline.operators[i]->getName();
+        profile->stages.back().name = pipeline.sink->getName();
+    }
+
+#ifdef DBENGINE_TRACING
+    // Stage names for the trace: the pipeline's event is named after its
+    // source, the events of every batch after their operator. Interning
+    // takes a lock, so it is left out while no trace is recording; a trace
+    // started during the run sees the stages as "stage".
+    std::vector<const char *> traceNames;
+    if (EventTrace::isRecording()) {
+        traceNames.push_back(EventTrace::intern(pipeline.source->getName()));
+        for (const auto &op : pipeline.operators)
+            traceNames.push_back(EventTrace::intern(op->getName()));
+        traceNames.push_back(EventTrace::intern(pipeline.sink->getName()));
+    }
+    auto traceName = [&](size_t stage) { return stage < traceNames.size() ? traceNames[stage] : "stage"; };
+#endif
+    TRACE_SCOPE("executor", traceName(0));
+
+    StageTimer callerTimer;
+    {
+        TRACE_SCOPE("executor", "prepare");
+        pipeline.source->prepare();
+    }
+    if (profile)
+        callerTimer.charge(profile->stages[0]);
+    MorselDispatcher dispatcher(pipeline.source->getNumUnits(), options_.morselSize, numNodes);
+    pipeline.sink->prepare(numWorkers);
+
+    // Every worker's scratch memory comes from its own arena, rewound before
+    // each batch and released when the run ends. Workers charge what they
+    // allocate to the caller's query.
+    std::vector<ArenaStats> workerArenas(numWorkers);
+    QueryMemory *memory = QueryMemory::current();
+    auto work = [&](int workerId) {
+        int node = workerId % numNodes;
+        QueryMemoryScope memoryScope(memory);
+        QueryStatusScope statusScope(&status);
+        Arena arena(options_.arenaChunkSize);
+        ArenaScope scope(&arena);
+#ifdef __linux__
+        const std::vector<int> &cpus = topology_.cpusPerNode[node];
+        if (options_.pinWorkers && !cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[(workerId / numNodes) % cpus.size()], &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+#endif
+        auto pushBatch = [&](Batch &batch) {
+            arena.rewind();
+            for (size_t i = 0; i < pipeline.operators.size(); ++i) {
+                TRACE_SCOPE_ARG("executor", traceName(i + 1), "rows", batch.activeCount());
+                pipeline.operators[i]->execute(batch);
+                if (batch.activeCount() == 0)
+                    return true;
+            }
+            TRACE_SCOPE_ARG("executor", traceName(numStages - 1), "rows", batch.activeCount());
+            return pipeline.sink->consume(batch, workerId);
+        };
+
+        // Same as pushBatch, timing every stage.
+        StageProfile *stages = profile ? workerStages[workerId].data() : nullptr;
+        StageTimer timer;
+        auto pushProfiledBatch = [&](Batch &batch) {
+            arena.rewind();
+            timer.charge(stages[0]);
+            ++stages[0].batches;
+            stages[0].rowsOut += batch.activeCount();
+            for (size_t i = 0; i < pipeline.operators.size(); ++i) {
+                StageProfile &stage = stages[i + 1];
+                ++stage.batches;
+                stage.rowsIn += batch.activeCount();
+                pipeline.operators[i]->execute(batch);
+                timer.charge(stage);
+                stage.rowsOut += batch.activeCount();
+                if (batch.activeCount() == 0)
+                    return true;
+            }
+            StageProfile &sink = stages[numStages - 1];
+            ++sink.batches;
+            sink.rowsIn += batch.activeCount();
+            bool more = pipeline.sink->consume(batch, workerId);
+            timer.charge(sink);
+            return more;
+        };
+
+        Morsel morsel;
+        while (!status.hasFailed() && dispatcher.next(node, morsel)) {
+            TRACE_SCOPE_ARG("executor", "morsel", "begin", morsel.begin);
+            bool more;
+            if (stages) {
+                timer.restart();
+                more = pipeline.source->produce(morsel.begin, morsel.end, pushProfiledBatch);
+                timer.charge(stages[0]);
+            } else {
+                more = pipeline.source->produce(morsel.begin, morsel.end, pushBatch);
+            }
+            if (!more) {
+                dispatcher.cancel();
+                break;
+            }
+        }
+        workerArenas[workerId] = arena.getStats();
+    };
+
+    // All workers get their own thread so that pinning never touches the caller.
+    std::vector<std::thread> threads;
+    for (int w = 0; w < numWorkers; ++w)
+        threads.emplace_back(work, w);
+    for (auto &thread : threads)
+        thread.join();
+
+    callerTimer.restart();
+    {
+        TRACE_SCOPE("executor", "finish");
+        pipeline.sink->finish();
+    }
+    ArenaStats arenaStats;
+    for (const ArenaStats &stats : workerArenas)
+        arenaStats += stats;
+    {
+        std::lock_guard<std::mutex> lock(arenaMutex_);
+        arenaStats_ += arenaStats;
+    }
+    if (profile) {
+        profile->arena = arenaStats;
+        callerTimer.charge(profile->stages.back());
+        for (const auto &stages : workerStages)
+            for (size_t i = 0; i < numStages; ++i)
+                mergeStage(profile->stages[i], stages[i]);
+        profile->wallNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - wallStart).count();
+    }
+    if (status.hasFailed()) {
+        error = status.getError();
+        return false;
+    }
+    return true;
+}
+
+ArenaStats QueryExecutor::getArenaStats() const {
+    std::lock_guard<std::mutex> lock(arenaMutex_);
+    return arenaStats_;
+}
+
+static std::string formatMilliseconds(uint64_t nanoseconds) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.3f ms", nanoseconds / 1e6);
+    return text;
+}
+
+std::vector<std::string> QueryProfile::format() const {
+    std::vector<std::string> lines;
+    for (size_t p = 0; p < pipelines.size(); ++p) {
+        const PipelineProfile &pipeline = pipelines[p];
+        std::string header = "Pipeline " + std::to_string(p + 1) + " (" + formatMilliseconds(pipeline.wallNanoseconds);
+        const ArenaStats &arena = pipeline.arena;
+        if (arena.allocations > 0 && pipeline.wallNanoseconds > 0) {
+            char rate[96];
+            snprintf(rate, sizeof(rate), ", arena %llu allocations %.1f KB, %.1f MB/s",
+                     static_cast<unsigned long long>(arena.allocations), arena.bytes / 1024.0,
+                     arena.bytes * 1e3 / pipeline.wallNanoseconds);
+            header += rate;
+        }
+        lines.push_back(header + ")");
+        for (size_t i = 0; i < pipeline.stages.size(); ++i) {
+            const StageProfile &stage = pipeline.stages[i];
+            std::string line = "  " + stage.name + ": " + formatMilliseconds(stage.nanoseconds);
+            if (i == 0)
+                line += ", rows " + std::to_string(stage.rowsOut);
+            else if (i + 1 < pipeline.stages.size())
+                line += ", rows " + std::to_string(stage.rowsIn) + " -> " + std::to_string(stage.rowsOut);
+            else
+                line += ", rows " + std::to_string(stage.rowsIn);
+            const IoCounters &io = stage.io;
+            if (io.hits || io.misses || io.pagesRead || io.pagesWritten)
+                line += ", pages hit " + std::to_string(io.hits) + " missed " + std::to_string(io.misses) +
+                        " read " + std::to_string(io.pagesRead) + " written " + std::to_string(io.pagesWritten);
+            lines.push_back(line);
+        }
+    }
+    if (peakMemoryBytes > 0) {
+        char line[64];
+        snprintf(line, sizeof(line), "Peak query memory %.1f KB", peakMemoryBytes / 1024.0);
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+std::vector<std::string> explainPipelines(const std::vector<Pipeline> &pipelines) {
+    std::vector<std::string> lines;
+    for (size_t p = 0; p < pipelines.size(); ++p) {
+        const Pipeline &pipeline = pipelines[p];
+        lines.push_back("Pipeline " + std::to_string(p + 1));
+        lines.push_back("  " + pipeline.source->getName());
+        for (const auto &op : pipeline.operators)
+            lines.push_back("  " + op->getName());
+        lines.push_back("  " + pipeline.sink->getName());
+    }
+    return lines;
+}
@@ -0,0 +1,247 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../storage_engine/bufferpool.h"
+#include "arena.h"
+#include "batch.h"
+#include "bloom_filter.h"
+
+// Morsel-driven execution.
+//
+// A query is a sequence of pipelines. Each pipeline has a Source that can
+// split its input into small units (pages of a table, materialized batches),
+// a chain of Operators that transform batches, and a Sink that ends the
+// pipeline (hash table build, aggregation, result collection...). Every
+// worker thread runs the whole pipeline on the morsels it pulls from a
+// shared MorselDispatcher, so there is no static assignment of work: a worker
+// that finishes early simply grabs the next morsel.
+
+// Produces the input of a pipeline.
+class Source {
+public:
+    virtual ~Source() {}
+
+    // Called once before every run, so a pipeline can be executed again
+    // (e.g. by a cached plan) and see the current state of its input.
+    virtual void prepare() {}
+
+    // Hint that the pipeline needs at most 'rows' rows from this source in
+    // total (a LIMIT with nothing in between that drops rows). Sources that
+    // can stop early use it to read less; others ignore it.
+    virtual void setRowLimit(size_t rows) { (void)rows; }
+
+    // Hint that rows whose key in output column 'column' is ruled out by
+    // 'filter' will be dropped later anyway (an inner join whose build side
+    // does not have the key). The filter is filled before this source runs.
+    // Sources that can check it before decoding a whole row use it.
+    virtual void addKeyFilter(std::shared_ptr<const BloomFilter> filter, int column) {
+        (void)filter;
+        (void)column;
+    }
+
+    // Number of units (e.g. pages) the input is split into.
+    virtual size_t getNumUnits() const = 0;
+
+    // Produces the batches of units [begin, end) and passes each to 'consumer'.
+    // Returns false if 'consumer' asked to stop by returning false, or after
+    // reporting a failure with QueryStatus::fail().
+    // Called concurrently by all workers.
+    virtual bool produce(size_t begin, size_t end,
+                         const std::function<bool(Batch &)> &consumer) const = 0;
+
+    virtual std::string getName() const = 0;
+};
+
+// A streaming transformation of batches.
+// Operators are shared by all workers and must not keep mutable state.
+class Operator {
+public:
+    virtual ~Operator() {}
+
+    // Transforms 'batch' in place (it may replace the batch's columns).
+    virtual void execute(Batch &batch) const = 0;
+
+    virtual std::string getName() const = 0;
+};
+
+// End of a pipeline.
+class Sink {
+public:
+    virtual ~Sink() {}
+
+    // Called once, before any worker starts.
+    virtual void prepare(int numWorkers) = 0;
+
+    // Consumes one batch for worker 'workerId'. Workers call this concurrently,
+    // each with its own id. Returns false once the sink needs no more input.
+    virtual bool consume(Batch &batch, int workerId) = 0;
+
+    // Called once, after all workers are done.
+    virtual void finish() = 0;
+
+    virtual std::string getName() const = 0;
+};
+
+struct Pipeline {
+    std::shared_ptr<Source> source;
+    std::vector<std::shared_ptr<Operator>> operators;
+    std::shared_ptr<Sink> sink;
+};
+
+// The outcome of one run of a pipeline. A stage that cannot produce correct
+// output (a page it cannot fix, a spill file it cannot read back) reports it
+// with QueryStatus::fail() and stops; the executor then hands out no more
+// morsels and QueryExecutor::run() returns the first error reported. The
+// executor installs the run's status on the caller and on every worker.
+class QueryStatus {
+public:
+    QueryStatus() : failed_(false) {}
+
+    QueryStatus(const QueryStatus &) = delete;
+    QueryStatus &operator=(const QueryStatus &) = delete;
+
+    bool hasFailed() const { return failed_.load(std::memory_order_acquire); }
+    std::string getError() const;
+
+    // Records 'error' in the QueryStatus installed on the calling thread,
+    // unless an earlier error was recorded there.
+    static void fail(const std::string &error);
+
+    // The QueryStatus installed on the calling thread, or null.
+    static QueryStatus *current();
+
+private:
+    mutable std::mutex mutex_;
+    std::atomic<bool> failed_;
+    std::string error_;
+};
+
+// Installs a QueryStatus (or null) on the calling thread for its lifetime.
+class QueryStatusScope {
+public:
+    explicit QueryStatusScope(QueryStatus *status);
+    ~QueryStatusScope();
+
+    QueryStatusScope(const QueryStatusScope &) = delete;
+    QueryStatusScope &operator=(const QueryStatusScope &) = delete;
+
+private:
+    QueryStatus *previous_;
+};
+
+// Counters of one stage (source, operator or sink) of a profiled pipeline,
+// summed over all workers. Time spent in Source::prepare() is charged to
+// the source and time in Sink::finish() to the sink.
+struct StageProfile {
+    std::string name;
+    uint64_t nanoseconds = 0;
+    uint64_t batches = 0;
+    uint64_t rowsIn = 0;  // Operators and sink.
+    uint64_t rowsOut = 0; // Source and operators.
+    IoCounters io;
+};
+
+struct PipelineProfile {
+    uint64_t wallNanoseconds = 0;
+    std::vector<StageProfile> stages; // Source, operators, sink.
+    ArenaStats arena;                 // Worker arenas, summed.
+};
+
+// What a run of a query's pipelines spent where. Profiling reads the clock
+// and the thread's buffer pool counters at every stage boundary, about a
+// hundred nanoseconds per batch and stage, so it can stay on for a sample
+// of the queries.
+struct QueryProfile {
+    std::vector<PipelineProfile> pipelines;
+    int64_t peakMemoryBytes = 0; // See QueryMemory.
+
+    // One line per pipeline and per stage, indented under its pipeline.
+    std::vector<std::string> format() const;
+};
+
+// The stages of 'pipelines' in the layout of QueryProfile::format().
+std::vector<std::string> explainPipelines(const std::vector<Pipeline> &pipelines);
+
+// A contiguous range of source units.
+struct Morsel {
+    size_t begin;
+    size_t end;
+};
+
+// NUMA nodes and the CPUs that belong to them, read from sysfs.
+// Machines without that information are treated as a single node.
+struct NumaTopology {
+    std::vector<std::vector<int>> cpusPerNode;
+
+    int getNumNodes() const { return static_cast<int>(cpusPerNode.size()); }
+
+    static NumaTopology detect();
+};
+
+// Hands out morsels to workers.
+//
+// The unit range is split into one contiguous home range per NUMA node, so a
+// given page range is always processed first by the same node's workers.
+// A worker takes morsels from its own node's range and only steals from
+// other nodes once that range is exhausted. Handing out a morsel is a single
+// atomic increment.
+class MorselDispatcher {
+public:
+    MorselDispatcher(size_t numUnits, size_t morselSize, int numNodes);
+
+    // Stores the next morsel for a worker on 'node'. Returns false when all
+    // units have been handed out or the dispatcher was cancelled.
+    bool next(int node, Morsel &morsel);
+
+    // Stops handing out morsels (e.g. once a LIMIT is satisfied).
+    void cancel() { cancelled_ = true; }
+
+private:
+    struct NodeRange {
+        std::atomic<size_t> next;
+        size_t end;
+    };
+
+    size_t morselSize_;
+    int numNodes_;
+    std::unique_ptr<NodeRange[]> ranges_;
+    std::atomic<bool> cancelled_;
+};
+
+struct ExecutorOptions {
+    int numWorkers = 0;      // 0 means one per hardware thread.
+    size_t morselSize = 16;  // Units (pages) per morsel.
+    size_t arenaChunkSize = 64 * 1024; // Bytes per chunk of a worker's arena.
+    bool pinWorkers = false; // Pin each worker to a CPU of its NUMA node.
+};
+
+class QueryExecutor {
+public:
+    explicit QueryExecutor(const ExecutorOptions &options = ExecutorOptions());
+
+    // Runs one pipeline to completion on all workers. Fills 'profile' if it
+    // is not null. Returns false and sets 'error' if a stage failed; the
+    // sink is finished either way, but its output is incomplete.
+    bool run(const Pipeline &pipeline, std::string &error, PipelineProfile *profile = nullptr);
+
+    // Runs pipelines in order; later pipelines may probe state built by
+    // earlier ones. Appends one entry per pipeline to 'profile' if it is not
+    // null. Stops at the first pipeline that fails.
+    bool run(const std::vector<Pipeline> &pipelines, std::string &error, QueryProfile *profile = nullptr);
+
+    int getNumWorkers() const { return options_.numWorkers; }
+
+    // Worker arena use of all runs so far. Sampled twice, the difference
+    // over the time in between is the allocation rate.
+    ArenaStats getArenaStats() const;
+
+private:
+    ExecutorOptions options_;
+    NumaTopology topology_;
+    mutable std::mutex arenaMutex_;
+    ArenaStats arenaStats_;
+};
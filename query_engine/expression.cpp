@@ -0,0 +1,525 @@
+#include "expression.h"
+#include <cmath>
+
+bool commonType(TypeId a, TypeId b, TypeId &result) {
+    if (a == b) {
+        result = a;
+        return true;
+    }
+    if (!isNumeric(a) || !isNumeric(b))
+        return false;
+    if (a == TypeId::DOUBLE || b == TypeId::DOUBLE)
+        result = TypeId::DOUBLE;
+    else if (a == TypeId::BIGINT || b == TypeId::BIGINT)
+        result = TypeId::BIGINT;
+    else
+        result = TypeId::DATE; // INTEGER combined with DATE.
+    return true;
+}
+
+static bool isComparison(BinaryOp op) {
+    return op == BinaryOp::EQ || op == BinaryOp::NE || op == BinaryOp::LT ||
+           op == BinaryOp::LE || op == BinaryOp::GT || op == BinaryOp::GE;
+}
+
+static CompareOp toCompareOp(BinaryOp op) {
+    switch (op) {
+    case BinaryOp::NE: return CompareOp::NE;
+    case BinaryOp::LT: return CompareOp::LT;
+    case BinaryOp::LE: return CompareOp::LE;
+    case BinaryOp::GT: return CompareOp::GT;
+    case BinaryOp::GE: return CompareOp::GE;
+    default:           return CompareOp::EQ;
+    }
+}
+
+static bool isLogical(BinaryOp op) {
+    return op == BinaryOp::AND || op == BinaryOp::OR;
+}
+
+static const char *opSymbol(BinaryOp op) {
+    switch (op) {
+    case BinaryOp::ADD: return "+";
+    case BinaryOp::SUB: return "-";
+    case BinaryOp::MUL: return "*";
+    case BinaryOp::DIV: return "/";
+    case BinaryOp::EQ:  return "=";
+    case BinaryOp::NE:  return "<>";
+    case BinaryOp::LT:  return "<";
+    case BinaryOp::LE:  return "<=";
+    case BinaryOp::GT:  return ">";
+    case BinaryOp::GE:  return ">=";
+    case BinaryOp::AND: return "AND";
+    case BinaryOp::OR:  return "OR";
+    }
+    return "?";
+}
+
+PhysicalValue toPhysical(const Value &value) {
+    PhysicalValue physical;
+    physical.i64 = 0;
+    switch (value.type) {
+    case TypeId::INTEGER:
+    case TypeId::DATE:    physical.i32 = static_cast<int32_t>(value.integer); break;
+    case TypeId::BIGINT:  physical.i64 = value.integer; break;
+    case TypeId::DOUBLE:  physical.f64 = value.real; break;
+    case TypeId::BOOLEAN: physical.u8 = value.integer ? 1 : 0; break;
+    case TypeId::VARCHAR: break;
+    }
+    return physical;
+}
+
+// Kernel selection. These switches run once per node at construction time.
+
+template <typename T>
+static BinaryKernelFn selectArithmeticKernel(BinaryOp op, bool lc, bool rc) {
+    switch (op) {
+    case BinaryOp::ADD: return selectBinaryKernel<T, T, AddOp>(lc, rc);
+    case BinaryOp::SUB: return selectBinaryKernel<T, T, SubOp>(lc, rc);
+    case BinaryOp::MUL: return selectBinaryKernel<T, T, MulOp>(lc, rc);
+    case BinaryOp::DIV: return selectBinaryKernel<T, T, DivOp>(lc, rc);
+    default:            return nullptr;
+    }
+}
+
+template <typename T>
+static BinaryKernelFn selectComparisonKernel(BinaryOp op, bool lc, bool rc) {
+    switch (op) {
+    case BinaryOp::EQ: return selectBinaryKernel<T, uint8_t, EqOp>(lc, rc);
+    case BinaryOp::NE: return selectBinaryKernel<T, uint8_t, NeOp>(lc, rc);
+    case BinaryOp::LT: return selectBinaryKernel<T, uint8_t, LtOp>(lc, rc);
+    case BinaryOp::LE: return selectBinaryKernel<T, uint8_t, LeOp>(lc, rc);
+    case BinaryOp::GT: return selectBinaryKernel<T, uint8_t, GtOp>(lc, rc);
+    case BinaryOp::GE: return selectBinaryKernel<T, uint8_t, GeOp>(lc, rc);
+    default:           return nullptr;
+    }
+}
+
+static BinaryKernelFn selectKernel(BinaryOp op, TypeId operandType, bool lc, bool rc) {
+    if (isLogical(op)) {
+        if (operandType != TypeId::BOOLEAN)
+            return nullptr;
+        return op == BinaryOp::AND ? selectBinaryKernel<uint8_t, uint8_t, AndOp>(lc, rc)
+                                   : selectBinaryKernel<uint8_t, uint8_t, OrOp>(lc, rc);
+    }
+    if (isComparison(op)) {
+        switch (operandType) {
+        case TypeId::INTEGER:
+        case TypeId::DATE:    return selectComparisonKernel<int32_t>(op, lc, rc);
+        case TypeId::BIGINT:  return selectComparisonKernel<int64_t>(op, lc, rc);
+        case TypeId::DOUBLE:  return selectComparisonKernel<double>(op, lc, rc);
+        case TypeId::BOOLEAN: return selectComparisonKernel<uint8_t>(op, lc, rc);
+        case TypeId::VARCHAR: return selectComparisonKernel<std::string>(op, lc, rc);
+        }
+        return nullptr;
+    }
+    switch (operandType) {
+    case TypeId::INTEGER:
+    case TypeId::DATE:   return selectArithmeticKernel<int32_t>(op, lc, rc);
+    case TypeId::BIGINT: return selectArithmeticKernel<int64_t>(op, lc, rc);
+    case TypeId::DOUBLE: return selectArithmeticKernel<double>(op, lc, rc);
+    default:             return nullptr;
+    }
+}
+
+template <typename From>
+static CastKernelFn selectCastKernelFrom(TypeId to) {
+    switch (to) {
+    case TypeId::INTEGER:
+    case TypeId::DATE:   return &castKernel<From, int32_t>;
+    case TypeId::BIGINT: return &castKernel<From, int64_t>;
+    case TypeId::DOUBLE: return &castKernel<From, double>;
+    default:             return nullptr;
+    }
+}
+
+static CastKernelFn selectCastKernel(TypeId from, TypeId to) {
+    switch (from) {
+    case TypeId::INTEGER:
+    case TypeId::DATE:   return selectCastKernelFrom<int32_t>(to);
+    case TypeId::BIGINT: return selectCastKernelFrom<int64_t>(to);
+    case TypeId::DOUBLE: return selectCastKernelFrom<double>(to);
+    default:             return nullptr;
+    }
+}
+
+static const void *columnData(const ColumnVector &column) {
+    if (column.getType() == TypeId::VARCHAR)
+        return column.values<std::string>();
+    return column.values<char>();
+}
+
+static void *columnData(ColumnVector &column) {
+    if (column.getType() == TypeId::VARCHAR)
+        return column.values<std::string>();
+    return column.values<char>();
+}
+
+// Row-at-a-time helpers used by evaluateRow() and constant folding.
+
+static Value castValue(const Value &value, TypeId type) {
+    Value result;
+    result.type = type;
+    if (type == TypeId::DOUBLE)
+        result.real = value.asDouble();
+    else if (type == TypeId::VARCHAR)
+        result.text = value.toString();
+    else
+        result.integer = value.type == TypeId::DOUBLE ? static_cast<int64_t>(value.real) : value.integer;
+    return result;
+}
+
+template <typename T>
+static bool compareValues(BinaryOp op, const T &a, const T &b) {
+    switch (op) {
+    case BinaryOp::EQ: return a == b;
+    case BinaryOp::NE: return a != b;
+    case BinaryOp::LT: return a < b;
+    case BinaryOp::LE: return a <= b;
+    case BinaryOp::GT: return a > b;
+    case BinaryOp::GE: return a >= b;
+    default:           return false;
+    }
+}
+
+static Value applyRow(BinaryOp op, TypeId resultType, const Value &a, const Value &b) {
+    if (isLogical(op))
+        return Value::makeBoolean(op == BinaryOp::AND ? (a.integer && b.integer) : (a.integer || b.integer));
+    if (isComparison(op)) {
+        switch (a.type) {
+        case TypeId::DOUBLE:  return Value::makeBoolean(compareValues(op, a.real, b.real));
+        case TypeId::VARCHAR: return Value::makeBoolean(compareValues(op, a.text, b.text));
+        default:              return Value::makeBoolean(compareValues(op, a.integer, b.integer));
+        }
+    }
+    Value result;
+    result.type = resultType;
+    if (resultType == TypeId::DOUBLE) {
+        switch (op) {
+        case BinaryOp::ADD: result.real = a.real + b.real; break;
+        case BinaryOp::SUB: result.real = a.real - b.real; break;
+        case BinaryOp::MUL: result.real = a.real * b.real; break;
+        case BinaryOp::DIV: result.real = b.real == 0 ? 0 : a.real / b.real; break;
+        default: break;
+        }
+    } else {
+        switch (op) {
+        case BinaryOp::ADD: result.integer = a.integer + b.integer; break;
+        case BinaryOp::SUB: result.integer = a.integer - b.integer; break;
+        case BinaryOp::MUL: result.integer = a.integer * b.integer; break;
+        case BinaryOp::DIV: result.integer = DivOp::apply(a.integer, b.integer); break;
+        default: break;
+        }
+        if (resultType == TypeId::INTEGER || resultType == TypeId::DATE)
+            result.integer = static_cast<int32_t>(result.integer);
+    }
+    return result;
+}
+
+Expression::Expression(ExpressionKind kind, TypeId type)
+    : kind_(kind), type_(type), op_(BinaryOp::ADD), columnIndex_(-1),
+      binaryKernel_(nullptr), castKernel_(nullptr), filterInput_(-1)
+{
+    physical_.i64 = 0;
+}
+
+std::unique_ptr<Expression> Expression::makeColumn(int index, TypeId type) {
+    std::unique_ptr<Expression> expr(new Expression(ExpressionKind::COLUMN, type));
+    expr->columnIndex_ = index;
+    return expr;
+}
+
+std::unique_ptr<Expression> Expression::makeConstant(const Value &value) {
+    std::unique_ptr<Expression> expr(new Expression(ExpressionKind::CONSTANT, value.type));
+    expr->setConstant(value);
+    return expr;
+}
+
+std::unique_ptr<Expression> Expression::makeParameter(std::shared_ptr<ParameterValues> parameters,
+                                                      int index) {
+    std::unique_ptr<Expression> expr(new Expression(ExpressionKind::PARAMETER, parameters->types[index]));
+    expr->columnIndex_ = index;
+    expr->parameters_ = parameters;
+    return expr;
+}
+
+void Expression::setConstant(const Value &value) {
+    constant_ = value;
+    physical_ = toPhysical(value);
+}
+
+const void *Expression::constantData() const {
+    if (kind_ == ExpressionKind::PARAMETER) {
+        if (type_ == TypeId::VARCHAR)
+            return &parameters_->values[columnIndex_].text;
+        return &parameters_->physical[columnIndex_];
+    }
+    if (type_ == TypeId::VARCHAR)
+        return &constant_.text;
+    return &physical_;
+}
+
+const Value &Expression::constantValue() const {
+    if (kind_ == ExpressionKind::PARAMETER)
+        return parameters_->values[columnIndex_];
+    return constant_;
+}
+
+// Whether 'value' converts to 'type' without losing its fraction or range.
+static bool convertsExactly(const Value &value, TypeId type) {
+    if (type == TypeId::DOUBLE || type == TypeId::VARCHAR || type == TypeId::BOOLEAN)
+        return true;
+    int64_t integer = value.integer;
+    if (value.type == TypeId::DOUBLE) {
+        // 2^63 itself does not fit.
+        if (!(value.real >= -9223372036854775808.0 && value.real < 9223372036854775808.0) ||
+            value.real != std::trunc(value.real))
+            return false;
+        integer = static_cast<int64_t>(value.real);
+    }
+    return type == TypeId::BIGINT || (integer >= INT32_MIN && integer <= INT32_MAX);
+}
+
+bool ParameterValues::bind(const std::vector<Value> &args, std::string &error) {
+    if (args.size() != types.size()) {
+        error = "expected " + std::to_string(types.size()) + " parameters, got " + std::to_string(args.size());
+        return false;
+    }
+    values.resize(args.size());
+    physical.resize(args.size());
+    for (size_t i = 0; i < args.size(); ++i) {
+        TypeId common;
+        if (!commonType(args[i].type, types[i], common)) {
+            error = std::string("parameter ") + std::to_string(i + 1) + " must be " + typeName(types[i]);
+            return false;
+        }
+        if (!convertsExactly(args[i], types[i])) {
+            error = std::string("parameter ") + std::to_string(i + 1) + " (" + args[i].toString() +
+                    ") does not convert to " + typeName(types[i]) + " exactly";
+            return false;
+        }
+        values[i] = castValue(args[i], types[i]);
+        physical[i] = toPhysical(values[i]);
+    }
+    return true;
+}
+
+std::unique_ptr<Expression> Expression::makeCast(std::unique_ptr<Expression> child, TypeId type) {
+    if (!child)
+        return nullptr;
+    TypeId from = child->getType();
+    if (from == type)
+        return child;
+    // INTEGER and DATE share a representation; only the logical type changes.
+    bool sameRepresentation = (from == TypeId::INTEGER || from == TypeId::DATE) &&
+                              (type == TypeId::INTEGER || type == TypeId::DATE);
+    if (child->kind_ == ExpressionKind::CONSTANT) {
+        if (!sameRepresentation && (!isNumeric(from) || !isNumeric(type)))
+            return nullptr;
+        return makeConstant(castValue(child->constant_, type));
+    }
+    CastKernelFn kernel = nullptr;
+    if (!sameRepresentation) {
+        kernel = selectCastKernel(from, type);
+        if (kernel == nullptr)
+            return nullptr;
+    }
+    std::unique_ptr<Expression> expr(new Expression(ExpressionKind::CAST, type));
+    expr->castKernel_ = kernel;
+    expr->children_[0] = std::move(child);
+    return expr;
+}
+
+std::unique_ptr<Expression> Expression::makeBinary(BinaryOp op, std::unique_ptr<Expression> lhs,
+                                                   std::unique_ptr<Expression> rhs) {
+    if (!lhs || !rhs)
+        return nullptr;
+    TypeId operandType;
+    if (!commonType(lhs->getType(), rhs->getType(), operandType))
+        return nullptr;
+    lhs = makeCast(std::move(lhs), operandType);
+    rhs = makeCast(std::move(rhs), operandType);
+    if (!lhs || !rhs)
+        return nullptr;
+
+    bool lc = lhs->isConstantLike();
+    bool rc = rhs->isConstantLike();
+    BinaryKernelFn kernel = selectKernel(op, operandType, lc, rc);
+    if (kernel == nullptr)
+        return nullptr;
+    TypeId resultType = (isComparison(op) || isLogical(op)) ? TypeId::BOOLEAN : operandType;
+
+    if (lhs->kind_ == ExpressionKind::CONSTANT && rhs->kind_ == ExpressionKind::CONSTANT)
+        return makeConstant(applyRow(op, resultType, castValue(lhs->constant_, operandType),
+                                     castValue(rhs->constant_, operandType)));
+
+    std::unique_ptr<Expression> expr(new Expression(ExpressionKind::BINARY, resultType));
+    expr->op_ = op;
+    expr->binaryKernel_ = kernel;
+    if (isComparison(op) && lc != rc) {
+        CompareOp compare = toCompareOp(op);
+        expr->filterInput_ = lc ? 1 : 0;
+        expr->filterKernel_ = getFilterKernel(operandType, lc ? mirrorCompareOp(compare) : compare);
+    }
+    expr->children_[0] = std::move(lhs);
+    expr->children_[1] = std::move(rhs);
+    return expr;
+}
+
+const ColumnVector *Expression::evaluate(const Batch &batch, ColumnVector &scratch) const {
+    size_t n = batch.count;
+    switch (kind_) {
+    case ExpressionKind::COLUMN:
+        return &batch.columns[columnIndex_];
+
+    case ExpressionKind::CONSTANT:
+    case ExpressionKind::PARAMETER:
+        // Only reached for a constant at the root; parents use constantData().
+        scratch.reset(type_);
+        scratch.resize(n);
+        for (size_t i = 0; i < n; ++i)
+            scratch.setValue(i, constantValue());
+        return &scratch;
+
+    case ExpressionKind::CAST: {
+        const ColumnVector *input = children_[0]->evaluate(batch, scratch);
+        if (castKernel_ == nullptr) {
+            // Same physical representation; relabel the values.
+            if (input != &scratch) {
+                scratch.reset(type_);
+                scratch.resize(n);
+                memcpy(scratch.values<char>(), input->values<char>(), n * typeWidth(type_));
+            } else {
+                ColumnVector relabeled(type_, scratch.getArena());
+                relabeled.resize(n);
+                memcpy(relabeled.values<char>(), scratch.values<char>(), n * typeWidth(type_));
+                scratch = std::move(relabeled);
+            }
+            return &scratch;
+        }
+        ColumnVector result(type_, scratch.getArena());
+        result.resize(n);
+        castKernel_(columnData(*input), columnData(result), n);
+        scratch = std::move(result);
+        return &scratch;
+    }
+
+    case ExpressionKind::BINARY: {
+        const Expression *lhs = children_[0].get();
+        const Expression *rhs = children_[1].get();
+        if (lhs->isConstantLike() && rhs->isConstantLike()) {
+            // A placeholder with a constant or another placeholder: the
+            // kernels expect at least one column, so compute the one value
+            // and repeat it.
+            Value value = applyRow(op_, type_, lhs->constantValue(), rhs->constantValue());
+            scratch.reset(type_);
+            scratch.resize(n);
+            for (size_t i = 0; i < n; ++i)
+                scratch.setValue(i, value);
+            return &scratch;
+        }
+        // Operands only live until the kernel ran.
+        ColumnVector lhsScratch(type_, Arena::current()), rhsScratch(type_, Arena::current());
+        const void *lhsData = lhs->isConstantLike()
+                                  ? lhs->constantData()
+                                  : columnData(*lhs->evaluate(batch, lhsScratch));
+        const void *rhsData = rhs->isConstantLike()
+                                  ? rhs->constantData()
+                                  : columnData(*rhs->evaluate(batch, rhsScratch));
+        scratch.reset(type_);
+        scratch.resize(n);
+        binaryKernel_(lhsData, rhsData, columnData(scratch), n);
+        return &scratch;
+    }
+    }
+    return nullptr;
+}
+
+void Expression::select(Batch &batch) const {
+    if (kind_ == ExpressionKind::BINARY && op_ == BinaryOp::AND) {
+        // The right side only looks at rows the left side kept.
+        children_[0]->select(batch);
+        if (batch.activeCount() > 0)
+            children_[1]->select(batch);
+        return;
+    }
+    if (filterKernel_.select != nullptr) {
+        ColumnVector scratch(type_, Arena::current());
+        const void *values = children_[filterInput_]->evaluate(batch, scratch)->values<char>();
+        const void *constant = children_[1 - filterInput_]->constantData();
+        if (!batch.hasSelection) {
+            batch.selection.resize(batch.count);
+            batch.selection.resize(filterKernel_.select(values, constant, batch.count, batch.selection.data()));
+            batch.hasSelection = true;
+        } else {
+            batch.selection.resize(filterKernel_.refine(values, constant, batch.selection.data(),
+                                                        batch.selection.size()));
+        }
+        return;
+    }
+
+    ColumnVector scratch(type_, Arena::current());
+    const uint8_t *flags = evaluate(batch, scratch)->values<uint8_t>();
+    if (!batch.hasSelection) {
+        batch.selection.resize(batch.count);
+        batch.selection.resize(flagsToSelection(flags, batch.count, batch.selection.data()));
+        batch.hasSelection = true;
+        return;
+    }
+    size_t out = 0;
+    for (size_t i = 0; i < batch.selection.size(); ++i) {
+        uint32_t row = batch.selection[i];
+        batch.selection[out] = row;
+        out += flags[row] != 0;
+    }
+    batch.selection.resize(out);
+}
+
+Value Expression::evaluateRow(const Batch &batch, size_t row) const {
+    switch (kind_) {
+    case ExpressionKind::COLUMN:
+        return batch.columns[columnIndex_].getValue(row);
+    case ExpressionKind::CONSTANT:
+    case ExpressionKind::PARAMETER:
+        return constantValue();
+    case ExpressionKind::CAST:
+        return castValue(children_[0]->evaluateRow(batch, row), type_);
+    case ExpressionKind::BINARY:
+        return applyRow(op_, type_, children_[0]->evaluateRow(batch, row),
+                        children_[1]->evaluateRow(batch, row));
+    }
+    return Value();
+}
+
+std::unique_ptr<Expression> Expression::clone() const {
+    std::unique_ptr<Expression> copy(new Expression(kind_, type_));
+    copy->op_ = op_;
+    copy->columnIndex_ = columnIndex_;
+    copy->constant_ = constant_;
+    copy->physical_ = physical_;
+    copy->parameters_ = parameters_;
+    copy->binaryKernel_ = binaryKernel_;
+    copy->castKernel_ = castKernel_;
+    copy->filterKernel_ = filterKernel_;
+    copy->filterInput_ = filterInput_;
+    for (int i = 0; i < 2; ++i)
+        if (children_[i])
+            copy->children_[i] = children_[i]->clone();
+    return copy;
+}
+
+std::string Expression::toString() const {
+    switch (kind_) {
+    case ExpressionKind::COLUMN:
+        return "#" + std::to_string(columnIndex_);
+    case ExpressionKind::CONSTANT:
+        return type_ == TypeId::VARCHAR ? "'" + constant_.text + "'" : constant_.toString();
+    case ExpressionKind::PARAMETER:
+        return "?" + std::to_string(columnIndex_ + 1);
+    case ExpressionKind::CAST:
+        return std::string("CAST(") + children_[0]->toString() + " AS " + typeName(type_) + ")";
+    case ExpressionKind::BINARY:
+        return "(" + children_[0]->toString() + " " + opSymbol(op_) + " " + children_[1]->toString() + ")";
+    }
+    return "";
+}
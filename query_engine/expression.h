@@ -0,0 +1,117 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "batch.h"
+#include "kernels.h"
+#include "simd_filter.h"
+
+enum class ExpressionKind { COLUMN, CONSTANT, PARAMETER, BINARY, CAST };
+
+enum class BinaryOp { ADD, SUB, MUL, DIV, EQ, NE, LT, LE, GT, GE, AND, OR };
+
+// A fixed-width value in the physical form the kernels read.
+union PhysicalValue {
+    int32_t i32;
+    int64_t i64;
+    double f64;
+    uint8_t u8;
+};
+
+PhysicalValue toPhysical(const Value &value);
+
+// Values bound to the placeholders of a prepared statement. Parameter
+// expressions read from here, so a plan can run again with new values
+// without being rebuilt. 'types' is fixed when the plan is built.
+struct ParameterValues {
+    std::vector<TypeId> types;
+    std::vector<Value> values;
+    std::vector<PhysicalValue> physical;
+
+    // Converts 'args' to the parameter types. Returns false on a count or
+    // type mismatch, or if a value would lose its fraction or range.
+    bool bind(const std::vector<Value> &args, std::string &error);
+};
+
+// Scalar expression tree evaluated a batch at a time.
+//
+// All type resolution and kernel selection happens when a node is built: each
+// binary or cast node stores a pointer to the one template instantiation that
+// matches its operand types and shapes, so evaluate() does no per-row work
+// besides the kernel loop itself. Constant subtrees are folded on construction.
+class Expression {
+public:
+    static std::unique_ptr<Expression> makeColumn(int index, TypeId type);
+    static std::unique_ptr<Expression> makeConstant(const Value &value);
+
+    // Placeholder 'index' of 'parameters'. Behaves like a constant operand
+    // (same kernel shapes) but is never folded; an operation whose operands
+    // are both constant or placeholders is computed once per batch.
+    static std::unique_ptr<Expression> makeParameter(std::shared_ptr<ParameterValues> parameters,
+                                                     int index);
+
+    // Builds 'lhs op rhs', casting operands to a common type where needed.
+    // Returns nullptr if the operand types are incompatible with 'op'.
+    static std::unique_ptr<Expression> makeBinary(BinaryOp op, std::unique_ptr<Expression> lhs,
+                                                  std::unique_ptr<Expression> rhs);
+
+    // Returns nullptr if 'child' cannot be converted to 'type'.
+    static std::unique_ptr<Expression> makeCast(std::unique_ptr<Expression> child, TypeId type);
+
+    ExpressionKind getKind() const { return kind_; }
+    TypeId getType() const { return type_; }
+    BinaryOp getOp() const { return op_; }
+    int getColumnIndex() const { return columnIndex_; }
+    int getParameterIndex() const { return columnIndex_; }
+    const Value &getConstant() const { return constant_; }
+    const Expression *getChild(int i) const { return children_[i].get(); }
+    int getNumChildren() const { return (children_[0] ? 1 : 0) + (children_[1] ? 1 : 0); }
+
+    // Evaluates the expression for all batch.count rows. Returns either one of
+    // the batch's own columns (for column references) or 'scratch'.
+    const ColumnVector *evaluate(const Batch &batch, ColumnVector &scratch) const;
+
+    // Narrows the batch's selection to the rows for which this BOOLEAN
+    // expression is true. AND is applied one side after the other, and
+    // comparisons of a fixed-width value with a constant go through the SIMD
+    // filter kernels.
+    void select(Batch &batch) const;
+
+    // Row-at-a-time interpretation that switches on node kind, operator and
+    // type for every value. Kept for single-row callers and as a baseline.
+    Value evaluateRow(const Batch &batch, size_t row) const;
+
+    std::unique_ptr<Expression> clone() const;
+
+    std::string toString() const;
+
+private:
+    Expression(ExpressionKind kind, TypeId type);
+
+    bool isConstantLike() const {
+        return kind_ == ExpressionKind::CONSTANT || kind_ == ExpressionKind::PARAMETER;
+    }
+
+    // Pointer to the physical constant value, as the kernels expect it.
+    const void *constantData() const;
+    const Value &constantValue() const;
+    void setConstant(const Value &value);
+
+    ExpressionKind kind_;
+    TypeId type_;
+    BinaryOp op_;
+    int columnIndex_; // Column or parameter index.
+    Value constant_;
+    PhysicalValue physical_;
+    std::shared_ptr<ParameterValues> parameters_;
+    std::unique_ptr<Expression> children_[2];
+    BinaryKernelFn binaryKernel_;
+    CastKernelFn castKernel_;
+    // Comparisons with one constant-like side: filter kernel for select()
+    // and which child is the non-constant one.
+    FilterKernel filterKernel_;
+    int filterInput_;
+};
+
+// Common type two operands are converted to before a binary operation.
+// Returns false if there is none.
+bool commonType(TypeId a, TypeId b, TypeId &result);
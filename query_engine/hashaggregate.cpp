@@ -0,0 +1,406 @@
+#include "hashaggregate.h"
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <thread>
+#include "arena.h"
+#include "hashing.h"
+
+static size_t roundUpToPowerOfTwo(size_t n) {
+    size_t result = 1;
+    while (result < n)
+        result <<= 1;
+    return result;
+}
+
+static AggregateState initialState(bool integral) {
+    AggregateState state;
+    state.count = 0;
+    if (integral) {
+        state.integerSum = 0;
+        state.integerMin = std::numeric_limits<int64_t>::max();
+        state.integerMax = std::numeric_limits<int64_t>::min();
+    } else {
+        state.sum = 0;
+        state.min = std::numeric_limits<double>::infinity();
+        state.max = -std::numeric_limits<double>::infinity();
+    }
+    return state;
+}
+
+static void mergeState(AggregateState &into, const AggregateState &from, bool integral) {
+    into.count += from.count;
+    if (integral) {
+        into.integerSum += from.integerSum;
+        if (from.integerMin < into.integerMin) into.integerMin = from.integerMin;
+        if (from.integerMax > into.integerMax) into.integerMax = from.integerMax;
+    } else {
+        into.sum += from.sum;
+        if (from.min < into.min) into.min = from.min;
+        if (from.max > into.max) into.max = from.max;
+    }
+}
+
+AggregateHashTable::AggregateHashTable(const std::vector<AggregateState> &initial, size_t capacity, bool fixed)
+    : initial_(initial), numAggregates_(initial.size()), fixed_(fixed), size_(0)
+{
+    size_t slots = roundUpToPowerOfTwo(capacity < 16 ? 16 : capacity);
+    mask_ = slots - 1;
+    keys_.resize(slots);
+    occupied_.assign(slots, 0);
+    states_.resize(slots * numAggregates_);
+}
+
+AggregateState* AggregateHashTable::findOrInsert(int64_t key, uint64_t hash) {
+    size_t slot = hash & mask_;
+    while (occupied_[slot]) {
+        if (keys_[slot] == key)
+            return statesAt(slot);
+        slot = (slot + 1) & mask_;
+    }
+    // Key is absent; keep the load factor at or below 3/4.
+    if ((size_ + 1) * 4 > capacity() * 3) {
+        if (fixed_)
+            return nullptr;
+        grow();
+        return findOrInsert(key, hash);
+    }
+    occupied_[slot] = 1;
+    keys_[slot] = key;
+    AggregateState *states = statesAt(slot);
+    std::copy(initial_.begin(), initial_.end(), states);
+    size_++;
+    return states;
+}
+
+void AggregateHashTable::grow() {
+    QueryStateVector<int64_t> oldKeys;
+    QueryStateVector<char> oldOccupied;
+    QueryStateVector<AggregateState> oldStates;
+    oldKeys.swap(keys_);
+    oldOccupied.swap(occupied_);
+    oldStates.swap(states_);
+
+    size_t slots = oldKeys.size() * 2;
+    mask_ = slots - 1;
+    keys_.resize(slots);
+    occupied_.assign(slots, 0);
+    states_.resize(slots * numAggregates_);
+    for (size_t i = 0; i < oldKeys.size(); ++i) {
+        if (!oldOccupied[i])
+            continue;
+        size_t slot = hashKey(oldKeys[i]) & mask_;
+        while (occupied_[slot])
+            slot = (slot + 1) & mask_;
+        occupied_[slot] = 1;
+        keys_[slot] = oldKeys[i];
+        std::copy(&oldStates[i * numAggregates_], &oldStates[(i + 1) * numAggregates_],
+                  &states_[slot * numAggregates_]);
+    }
+}
+
+void AggregateHashTable::clear() {
+    std::fill(occupied_.begin(), occupied_.end(), 0);
+    size_ = 0;
+}
+
+PartitionedHashAggregator::PartitionedHashAggregator(const std::vector<AggregateCall> &aggregates,
+                                                     const AggregateOptions &options)
+    : aggregates_(aggregates), options_(options), bufferedBytes_(0), spilledPages_(0), failed_(false)
+{
+    if (options_.numWorkers < 1)
+        options_.numWorkers = 1;
+    for (const AggregateCall &aggregate : aggregates_)
+        initialStates_.push_back(initialState(aggregate.integral));
+    workers_.resize(options_.numWorkers);
+    for (auto &worker : workers_) {
+        worker.local.reset(new AggregateHashTable(initialStates_, options_.localTableCapacity, true));
+        worker.partitions.resize(kNumPartitions);
+    }
+    spilledPageIds_.resize(kNumPartitions);
+}
+
+PartitionedHashAggregator::~PartitionedHashAggregator() {
+    for (auto &worker : workers_)
+        releaseReservation(worker);
+    if (spillFile_) {
+        spillFile_.reset();
+        std::remove(options_.spillFileName.c_str());
+    }
+}
+
+bool PartitionedHashAggregator::consume(int workerId, const int64_t *keys,
+                                        const AggregateInput *inputs, size_t count) {
+    WorkerState &worker = workers_[workerId];
+    size_t numAggregates = aggregates_.size();
+    for (size_t row = 0; row < count; ++row) {
+        int64_t key = keys[row];
+        uint64_t hash = hashKey(key);
+        AggregateState *states = worker.local->findOrInsert(key, hash);
+        if (states == nullptr) {
+            // Local table is full: push its groups out to the partitions and start over.
+            flushLocal(worker);
+            states = worker.local->findOrInsert(key, hash);
+        }
+        for (size_t a = 0; a < numAggregates; ++a) {
+            AggregateState &state = states[a];
+            state.count++;
+            if (inputs[a].integers != nullptr) {
+                int64_t value = inputs[a].integers[row];
+                state.integerSum += value;
+                if (value < state.integerMin) state.integerMin = value;
+                if (value > state.integerMax) state.integerMax = value;
+            } else if (inputs[a].reals != nullptr) {
+                double value = inputs[a].reals[row];
+                state.sum += value;
+                if (value < state.min) state.min = value;
+                if (value > state.max) state.max = value;
+            }
+        }
+    }
+    return !hasFailed();
+}
+
+void PartitionedHashAggregator::flushLocal(WorkerState &worker) {
+    AggregateHashTable &local = *worker.local;
+    size_t numAggregates = aggregates_.size();
+    for (size_t slot = 0; slot < local.capacity(); ++slot) {
+        if (!local.isOccupied(slot))
+            continue;
+        int64_t key = local.keyAt(slot);
+        PartitionBuffer &buffer = worker.partitions[partitionOf(hashKey(key))];
+        buffer.keys.push_back(key);
+        AggregateState *states = local.statesAt(slot);
+        buffer.states.insert(buffer.states.end(), states, states + numAggregates);
+    }
+    size_t flushedBytes = local.size() * entrySize();
+    local.clear();
+    bool granted = options_.governor == nullptr || options_.governor->tryReserve(flushedBytes);
+    if (granted)
+        worker.reservedBytes += flushedBytes;
+    if (bufferedBytes_.fetch_add(flushedBytes) + flushedBytes > options_.memoryBudget || !granted)
+        spillWorker(worker);
+}
+
+void PartitionedHashAggregator::releaseReservation(WorkerState &worker) {
+    if (options_.governor != nullptr && worker.reservedBytes > 0)
+        options_.governor->release(worker.reservedBytes);
+    worker.reservedBytes = 0;
+}
+
+void PartitionedHashAggregator::spillWorker(WorkerState &worker) {
+    size_t numAggregates = aggregates_.size();
+    size_t size = entrySize();
+    int maxRecord = PAGE_SIZE - static_cast<int>(sizeof(PageHeader)) - static_cast<int>(sizeof(Slot));
+    size_t entriesPerPage = maxRecord / size;
+    // Flushes run in the workers, whose arenas hold the packed records.
+    ArenaVector<char> record(entriesPerPage * size, Arena::current());
+    Page page;
+
+    std::lock_guard<std::mutex> lock(spillMutex_);
+    if (failed_)
+        return;
+    if (entriesPerPage == 0) {
+        failLocked("too many aggregates to spill");
+        return;
+    }
+    if (!spillFile_)
+        spillFile_.reset(new DiskManager(options_.spillFileName));
+
+    size_t releasedBytes = 0;
+    for (int p = 0; p < kNumPartitions; ++p) {
+        PartitionBuffer &buffer = worker.partitions[p];
+        size_t total = buffer.keys.size();
+        for (size_t start = 0; start < total; start += entriesPerPage) {
+            size_t n = std::min(entriesPerPage, total - start);
+            // Pack the entries as [key][states...] into one record per page.
+            char *out = record.data();
+            for (size_t i = start; i < start + n; ++i) {
+                memcpy(out, &buffer.keys[i], sizeof(int64_t));
+                memcpy(out + sizeof(int64_t), &buffer.states[i * numAggregates],
+                       numAggregates * sizeof(AggregateState));
+                out += size;
+            }
+            page.clear();
+            int pageId = spillFile_->getNumberOfPages();
+            page.setPageId(pageId);
+            page.insertRecord(record.data(), static_cast<int>(n * size));
+            if (!spillFile_->writePage(pageId, page)) {
+                failLocked("could not write spill page " + std::to_string(pageId) + " of the aggregation");
+                return;
+            }
+            spilledPageIds_[p].push_back(pageId);
+            spilledPages_++;
+        }
+        releasedBytes += total * size;
+        QueryStateVector<int64_t>().swap(buffer.keys);
+        QueryStateVector<AggregateState>().swap(buffer.states);
+    }
+    bufferedBytes_ -= releasedBytes;
+    releaseReservation(worker);
+}
+
+void PartitionedHashAggregator::mergePartition(int partition, AggregateResult &out) {
+    size_t numAggregates = aggregates_.size();
+    size_t expected = 0;
+    for (auto &worker : workers_)
+        expected += worker.partitions[partition].keys.size();
+    AggregateHashTable table(initialStates_, expected, false);
+
+    auto mergeEntry = [&](int64_t key, const AggregateState *states) {
+        AggregateState *into = table.findOrInsert(key, hashKey(key));
+        for (size_t a = 0; a < numAggregates; ++a)
+            mergeState(into[a], states[a], aggregates_[a].integral);
+    };
+
+    for (auto &worker : workers_) {
+        PartitionBuffer &buffer = worker.partitions[partition];
+        for (size_t i = 0; i < buffer.keys.size(); ++i)
+            mergeEntry(buffer.keys[i], &buffer.states[i * numAggregates]);
+        QueryStateVector<int64_t>().swap(buffer.keys);
+        QueryStateVector<AggregateState>().swap(buffer.states);
+    }
+
+    if (!spilledPageIds_[partition].empty()) {
+        Page page;
+        std::vector<char> record(PAGE_SIZE);
+        std::vector<AggregateState> states(numAggregates);
+        size_t size = entrySize();
+        for (int pageId : spilledPageIds_[partition]) {
+            int length;
+            {
+                std::lock_guard<std::mutex> lock(spillMutex_);
+                if (!spillFile_->readPage(pageId, page)) {
+                    failLocked("could not read spill page " + std::to_string(pageId) + " of the aggregation");
+                    return;
+                }
+            }
+            length = page.getRecord(0, record.data());
+            for (int offset = 0; offset + static_cast<int>(size) <= length; offset += size) {
+                int64_t key;
+                memcpy(&key, record.data() + offset, sizeof(int64_t));
+                memcpy(states.data(), record.data() + offset + sizeof(int64_t),
+                       numAggregates * sizeof(AggregateState));
+                mergeEntry(key, states.data());
+            }
+        }
+    }
+
+    out.values.resize(numAggregates);
+    out.integers.resize(numAggregates);
+    for (size_t slot = 0; slot < table.capacity(); ++slot) {
+        if (!table.isOccupied(slot))
+            continue;
+        out.keys.push_back(table.keyAt(slot));
+        AggregateState *states = table.statesAt(slot);
+        for (size_t a = 0; a < numAggregates; ++a)
+            finalize(a, states[a], out);
+    }
+}
+
+std::string PartitionedHashAggregator::getError() const {
+    std::lock_guard<std::mutex> lock(spillMutex_);
+    return error_;
+}
+
+void PartitionedHashAggregator::failLocked(const std::string &error) {
+    if (failed_)
+        return;
+    error_ = error;
+    failed_.store(true, std::memory_order_release);
+}
+
+void PartitionedHashAggregator::finalize(size_t a, const AggregateState &state, AggregateResult &out) const {
+    const AggregateCall &aggregate = aggregates_[a];
+    if (aggregate.hasIntegralResult()) {
+        int64_t value = 0;
+        switch (aggregate.function) {
+        case AggregateFunction::COUNT: value = state.count; break;
+        case AggregateFunction::SUM:   value = state.integerSum; break;
+        case AggregateFunction::MIN:   value = state.integerMin; break;
+        case AggregateFunction::MAX:   value = state.integerMax; break;
+        case AggregateFunction::AVG:   break;
+        }
+        out.integers[a].push_back(value);
+        return;
+    }
+    double value = 0;
+    switch (aggregate.function) {
+    case AggregateFunction::COUNT: value = static_cast<double>(state.count); break;
+    case AggregateFunction::SUM:   value = state.sum; break;
+    case AggregateFunction::MIN:   value = state.min; break;
+    case AggregateFunction::MAX:   value = state.max; break;
+    case AggregateFunction::AVG:
+        if (state.count)
+            value = (aggregate.integral ? static_cast<double>(state.integerSum) : state.sum) / state.count;
+        break;
+    }
+    out.values[a].push_back(value);
+}
+
+AggregateResult PartitionedHashAggregator::finish() {
+    for (auto &worker : workers_)
+        flushLocal(worker);
+
+    // Partitions are disjoint in key space, so they merge without any locking.
+    std::vector<AggregateResult> perPartition(kNumPartitions);
+    std::atomic<int> nextPartition(0);
+    QueryMemory *memory = QueryMemory::current();
+    auto mergeLoop = [&]() {
+        QueryMemoryScope scope(memory);
+        int p;
+        while ((p = nextPartition.fetch_add(1)) < kNumPartitions)
+            mergePartition(p, perPartition[p]);
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < options_.numWorkers; ++t)
+        threads.emplace_back(mergeLoop);
+    mergeLoop();
+    for (auto &thread : threads)
+        thread.join();
+    // The partition buffers have been merged and freed.
+    for (auto &worker : workers_)
+        releaseReservation(worker);
+
+    AggregateResult result;
+    result.values.resize(aggregates_.size());
+    result.integers.resize(aggregates_.size());
+    for (auto &part : perPartition) {
+        result.keys.insert(result.keys.end(), part.keys.begin(), part.keys.end());
+        for (size_t a = 0; a < part.values.size(); ++a) {
+            result.values[a].insert(result.values[a].end(), part.values[a].begin(), part.values[a].end());
+            result.integers[a].insert(result.integers[a].end(), part.integers[a].begin(), part.integers[a].end());
+        }
+    }
+    return result;
+}
+
+AggregateResult PartitionedHashAggregator::aggregate(const std::vector<AggregateCall> &aggregates,
+                                                     const int64_t *keys, const AggregateInput *inputs,
+                                                     size_t count, const AggregateOptions &options) {
+    PartitionedHashAggregator aggregator(aggregates, options);
+    int numWorkers = options.numWorkers < 1 ? 1 : options.numWorkers;
+    size_t chunk = (count + numWorkers - 1) / numWorkers;
+
+    auto work = [&](int workerId) {
+        size_t begin = workerId * chunk;
+        size_t end = std::min(count, begin + chunk);
+        if (begin >= end)
+            return;
+        std::vector<AggregateInput> slice(aggregates.size());
+        for (size_t a = 0; a < aggregates.size(); ++a) {
+            if (inputs[a].integers != nullptr)
+                slice[a].integers = inputs[a].integers + begin;
+            if (inputs[a].reals != nullptr)
+                slice[a].reals = inputs[a].reals + begin;
+        }
+        aggregator.consume(workerId, keys + begin, slice.data(), end - begin);
+    };
+    std::vector<std::thread> threads;
+    for (int w = 1; w < numWorkers; ++w)
+        threads.emplace_back(work, w);
+    work(0);
+    for (auto &thread : threads)
+        thread.join();
+    return aggregator.finish();
+}
@@ -0,0 +1,188 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../storage_engine/diskmanager.h"
+#include "../storage_engine/memory_governor.h"
+#include "../storage_engine/memory_tracker.h"
+
+// Hash tables and buffers of an operator, charged to the running query.
+template <typename T>
+using QueryStateVector = TrackedVector<T, MemorySubsystem::QUERY_STATE>;
+
+// Aggregate functions supported by the hash aggregation.
+enum class AggregateFunction { COUNT, SUM, MIN, MAX, AVG };
+
+// One aggregate computed by PartitionedHashAggregator.
+struct AggregateCall {
+    AggregateFunction function;
+    // Integral input: sums and extremes are kept as int64, so they stay exact
+    // beyond 2^53.
+    bool integral;
+
+    // Whether the finalized values go to AggregateResult::integers.
+    bool hasIntegralResult() const {
+        return function == AggregateFunction::COUNT || (integral && function != AggregateFunction::AVG);
+    }
+};
+
+// Running state of one aggregate for one group.
+// All functions share the same state so that partial results can be merged
+// without knowing which function produced them; integral aggregates use the
+// int64 members.
+struct AggregateState {
+    int64_t count;
+    union { double sum; int64_t integerSum; };
+    union { double min; int64_t integerMin; };
+    union { double max; int64_t integerMax; };
+};
+
+// Input column of one aggregate: 'integers' for an integral aggregate,
+// 'reals' otherwise, and neither for COUNT(*).
+struct AggregateInput {
+    const int64_t *integers = nullptr;
+    const double *reals = nullptr;
+};
+
+// Tuning knobs for PartitionedHashAggregator.
+struct AggregateOptions {
+    int numWorkers = 1;                        // Number of threads feeding consume().
+    size_t memoryBudget = 64 * 1024 * 1024;    // Bytes of partition buffers kept in memory before spilling.
+    size_t localTableCapacity = 1024;          // Groups in each thread-local pre-aggregation table.
+    std::string spillFileName = "hashagg.spill";
+    // If set, partition buffers are also reserved from it, and a worker whose
+    // reservation is refused spills its partitions.
+    MemoryGovernor *governor = nullptr;
+};
+
+// Columnar result of an aggregation: one key per group and, for every
+// aggregate, one finalized value per group in 'integers' if the aggregate
+// has an integral result and in 'values' if not.
+struct AggregateResult {
+    std::vector<int64_t> keys;
+    std::vector<std::vector<double>> values;
+    std::vector<std::vector<int64_t>> integers;
+};
+
+// Open-addressing table mapping a 64-bit group key to its aggregate states.
+class AggregateHashTable {
+public:
+    // A fixed table never grows; findOrInsert returns nullptr once it is full.
+    // New groups start with a copy of 'initial', one state per aggregate.
+    AggregateHashTable(const std::vector<AggregateState> &initial, size_t capacity, bool fixed);
+
+    // Returns the states of 'key', inserting freshly initialized states if absent.
+    AggregateState* findOrInsert(int64_t key, uint64_t hash);
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return keys_.size(); }
+
+    // Slot iteration (slots may be empty).
+    bool isOccupied(size_t slot) const { return occupied_[slot]; }
+    int64_t keyAt(size_t slot) const { return keys_[slot]; }
+    AggregateState* statesAt(size_t slot) { return &states_[slot * numAggregates_]; }
+
+    void clear();
+
+private:
+    void grow();
+
+    std::vector<AggregateState> initial_;
+    size_t numAggregates_;
+    bool fixed_;
+    size_t size_;
+    size_t mask_;
+    QueryStateVector<int64_t> keys_;
+    QueryStateVector<char> occupied_;
+    QueryStateVector<AggregateState> states_;
+};
+
+// Parallel GROUP BY on a 64-bit key.
+//
+// Phase 1: every worker pre-aggregates into a small, cache-resident table of
+// its own. When that table fills up its groups are flushed into per-worker
+// radix partitions chosen by the high bits of the key hash, so no two workers
+// ever touch the same memory. If the buffered partitions exceed the memory
+// budget, or the governor refuses to grant them, the flushing worker writes
+// its partitions to spill pages.
+//
+// Phase 2: finish() hands out partitions to worker threads; each partition is
+// merged from all workers' buffers and its spilled pages independently.
+class PartitionedHashAggregator {
+public:
+    static const int kRadixBits = 6;
+    static const int kNumPartitions = 1 << kRadixBits;
+    // Most aggregates per group: a spilled group must fit on a spill page.
+    static constexpr size_t kMaxAggregates =
+        (PAGE_SIZE - sizeof(PageHeader) - sizeof(Slot) - sizeof(int64_t)) / sizeof(AggregateState);
+
+    PartitionedHashAggregator(const std::vector<AggregateCall> &aggregates, const AggregateOptions &options);
+    ~PartitionedHashAggregator();
+
+    // Feeds 'count' rows to the worker 'workerId'. inputs[i] is the input
+    // column of aggregate i.
+    // Each worker id must only be used by one thread at a time.
+    // Returns false once the aggregation has failed.
+    bool consume(int workerId, const int64_t *keys, const AggregateInput *inputs, size_t count);
+
+    // Merges all partitions (in parallel) and returns the finalized groups,
+    // which are incomplete if the aggregation failed.
+    AggregateResult finish();
+
+    // Whether a spill page could not be written or read back, and why.
+    bool hasFailed() const { return failed_.load(std::memory_order_acquire); }
+    std::string getError() const;
+
+    // Number of pages written to the spill file so far.
+    int getSpilledPages() const { return spilledPages_.load(); }
+
+    // Convenience wrapper: splits the input evenly over options.numWorkers threads.
+    static AggregateResult aggregate(const std::vector<AggregateCall> &aggregates,
+                                     const int64_t *keys, const AggregateInput *inputs,
+                                     size_t count, const AggregateOptions &options);
+
+private:
+    struct PartitionBuffer {
+        QueryStateVector<int64_t> keys;
+        QueryStateVector<AggregateState> states;
+    };
+
+    struct WorkerState {
+        std::unique_ptr<AggregateHashTable> local;
+        std::vector<PartitionBuffer> partitions;
+        size_t reservedBytes = 0; // Granted by the governor for the partitions.
+    };
+
+    static int partitionOf(uint64_t hash) {
+        return static_cast<int>(hash >> (64 - kRadixBits));
+    }
+
+    size_t entrySize() const { return sizeof(int64_t) + aggregates_.size() * sizeof(AggregateState); }
+
+    void flushLocal(WorkerState &worker);
+    void spillWorker(WorkerState &worker);
+    // Gives the worker's reservation back to the governor.
+    void releaseReservation(WorkerState &worker);
+    void mergePartition(int partition, AggregateResult &out);
+    // Appends the finalized value of aggregate 'a' to 'out'.
+    void finalize(size_t a, const AggregateState &state, AggregateResult &out) const;
+    // Records the first failure; spillMutex_ must be held.
+    void failLocked(const std::string &error);
+
+    std::vector<AggregateCall> aggregates_;
+    std::vector<AggregateState> initialStates_;
+    AggregateOptions options_;
+    std::vector<WorkerState> workers_;
+    std::atomic<size_t> bufferedBytes_;
+    std::atomic<int> spilledPages_;
+
+    // Spill file shared by all workers; DiskManager is not thread-safe.
+    mutable std::mutex spillMutex_;
+    std::unique_ptr<DiskManager> spillFile_;
+    std::vector<std::vector<int>> spilledPageIds_; // Per partition.
+    std::atomic<bool> failed_;
+    std::string error_; // Guarded by spillMutex_.
+};
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+
+// 64-bit finalizer from MurmurHash3.
+// Every input bit affects the high bits of the result, which the radix
+// partitioning and the hash tables built on top of it rely on.
+inline uint64_t hashKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Compile-time specialized batch kernels.
+//
+// Each kernel is a template over the physical value type and an operator
+// functor, so the loop body is a single inlined expression with no per-row
+// dispatch and the compiler can vectorize it. Operand shapes (vector/vector,
+// vector/constant, constant/vector) are separate instantiations so that a
+// constant never has to be broadcast into a column first.
+
+struct AddOp { template <typename T> static T apply(T a, T b) { return a + b; } };
+struct SubOp { template <typename T> static T apply(T a, T b) { return a - b; } };
+struct MulOp { template <typename T> static T apply(T a, T b) { return a * b; } };
+struct DivOp {
+    // Integer division by zero yields 0 instead of trapping, and dividing the
+    // smallest value by -1 wraps around to itself instead of overflowing.
+    template <typename T> static T apply(T a, T b) {
+        return b == T(0) ? T(0) : b == T(-1) ? negate(a) : a / b;
+    }
+    static int32_t negate(int32_t a) { return static_cast<int32_t>(0u - static_cast<uint32_t>(a)); }
+    static int64_t negate(int64_t a) { return static_cast<int64_t>(0ull - static_cast<uint64_t>(a)); }
+    static double negate(double a) { return -a; }
+};
+
+struct EqOp { template <typename T> static uint8_t apply(const T &a, const T &b) { return a == b; } };
+struct NeOp { template <typename T> static uint8_t apply(const T &a, const T &b) { return a != b; } };
+struct LtOp { template <typename T> static uint8_t apply(const T &a, const T &b) { return a < b; } };
+struct LeOp { template <typename T> static uint8_t apply(const T &a, const T &b) { return a <= b; } };
+struct GtOp { template <typename T> static uint8_t apply(const T &a, const T &b) { return a > b; } };
+struct GeOp { template <typename T> static uint8_t apply(const T &a, const T &b) { return a >= b; } };
+
+// Logical operators on 0/1 bytes; bitwise forms keep the loops branch-free.
+struct AndOp { static uint8_t apply(uint8_t a, uint8_t b) { return a & b; } };
+struct OrOp  { static uint8_t apply(uint8_t a, uint8_t b) { return a | b; } };
+
+// Type-erased entry point stored in a compiled expression. 'lhs' and 'rhs'
+// point either to n values or, for constant operands, to a single value.
+typedef void (*BinaryKernelFn)(const void *lhs, const void *rhs, void *out, size_t n);
+typedef void (*CastKernelFn)(const void *in, void *out, size_t n);
+
+template <typename T, typename R, typename Op>
+void binaryVectorVector(const void *lhs, const void *rhs, void *out, size_t n) {
+    const T *a = static_cast<const T *>(lhs);
+    const T *b = static_cast<const T *>(rhs);
+    R *r = static_cast<R *>(out);
+    for (size_t i = 0; i < n; ++i)
+        r[i] = Op::apply(a[i], b[i]);
+}
+
+template <typename T, typename R, typename Op>
+void binaryVectorConstant(const void *lhs, const void *rhs, void *out, size_t n) {
+    const T *a = static_cast<const T *>(lhs);
+    const T b = *static_cast<const T *>(rhs);
+    R *r = static_cast<R *>(out);
+    for (size_t i = 0; i < n; ++i)
+        r[i] = Op::apply(a[i], b);
+}
+
+template <typename T, typename R, typename Op>
+void binaryConstantVector(const void *lhs, const void *rhs, void *out, size_t n) {
+    const T a = *static_cast<const T *>(lhs);
+    const T *b = static_cast<const T *>(rhs);
+    R *r = static_cast<R *>(out);
+    for (size_t i = 0; i < n; ++i)
+        r[i] = Op::apply(a, b[i]);
+}
+
+template <typename From, typename To>
+void castKernel(const void *in, void *out, size_t n) {
+    const From *a = static_cast<const From *>(in);
+    To *r = static_cast<To *>(out);
+    for (size_t i = 0; i < n; ++i)
+        r[i] = static_cast<To>(a[i]);
+}
+
+// Picks the instantiation for an operand shape.
+template <typename T, typename R, typename Op>
+BinaryKernelFn selectBinaryKernel(bool lhsConstant, bool rhsConstant) {
+    if (lhsConstant && !rhsConstant)
+        return &binaryConstantVector<T, R, Op>;
+    if (rhsConstant && !lhsConstant)
+        return &binaryVectorConstant<T, R, Op>;
+    return &binaryVectorVector<T, R, Op>;
+}
+
+// Writes the positions of non-zero flags to 'selection' and returns how many
+// there are. Branch-free: every position is stored, the cursor only advances
+// on a match.
+inline size_t flagsToSelection(const uint8_t *flags, size_t n, uint32_t *selection) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        selection[count] = static_cast<uint32_t>(i);
+        count += flags[i] != 0;
+    }
+    return count;
+}
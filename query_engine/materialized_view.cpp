@@ -0,0 +1,130 @@
+#include "materialized_view.h"
+
+MaterializedView::MaterializedView(TableInfo *base, std::unique_ptr<Expression> filter,
+                                   std::unique_ptr<Expression> key,
+                                   std::vector<std::unique_ptr<Expression>> inputs,
+                                   std::vector<AggregateSpec> aggregates, std::vector<int> columns,
+                                   const Schema &schema)
+    : base_(base), table_(nullptr), filter_(std::move(filter)), key_(std::move(key)), inputs_(std::move(inputs)),
+      aggregates_(std::move(aggregates)), columns_(std::move(columns)), schema_(schema)
+{
+    base_->schema.initBatch(row_);
+    for (auto &column : row_.columns)
+        column.resize(1);
+    row_.count = 1;
+}
+
+bool MaterializedView::populate(TableInfo *table, std::string &error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    table_ = table;
+    if (!key_) {
+        Group &group = groups_[0];
+        group.rid = RecordId{-1, -1};
+        group.rows = 0;
+        group.states.assign(aggregates_.size(), State{0, 0, 0});
+        if (!store(0, group)) {
+            error = "could not store rows of view " + table->name;
+            return false;
+        }
+    }
+
+    BufferPool *bufferPool = base_->heap->getBufferPool();
+    std::vector<Value> row;
+    for (int pageId : base_->heap->getPageIds()) {
+        Page *page = bufferPool->fixPage(pageId, false);
+        if (page == nullptr) {
+            error = "could not read page " + std::to_string(pageId) + " of " + base_->name;
+            return false;
+        }
+        bool ok = true;
+        for (int slot = 0; ok && slot < page->getNumberOfSlots(); ++slot) {
+            int length;
+            const char *record = page->getRecordData(slot, length);
+            if (record != nullptr && base_->schema.deserializeRow(record, length, row))
+                ok = add(row, 1);
+        }
+        bufferPool->unfixPage(page, false);
+        if (!ok) {
+            error = "could not store rows of view " + table->name;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MaterializedView::apply(const std::vector<Value> &row, int sign) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return add(row, sign);
+}
+
+bool MaterializedView::add(const std::vector<Value> &row, int sign) {
+    for (size_t c = 0; c < row.size(); ++c)
+        row_.columns[c].setValue(0, row[c]);
+    if (filter_ && !filter_->evaluateRow(row_, 0).integer)
+        return true;
+    int64_t key = key_ ? key_->evaluateRow(row_, 0).integer : 0;
+
+    auto it = groups_.find(key);
+    if (it == groups_.end()) {
+        it = groups_.emplace(key, Group()).first;
+        it->second.rid = RecordId{-1, -1};
+        it->second.rows = 0;
+        it->second.states.assign(aggregates_.size(), State{0, 0, 0});
+    }
+    Group &group = it->second;
+    group.rows += sign;
+    for (size_t a = 0; a < aggregates_.size(); ++a) {
+        const AggregateSpec &spec = aggregates_[a];
+        State &state = group.states[a];
+        state.count += sign;
+        if (spec.inputColumn < 0)
+            continue;
+        Value value = inputs_[spec.inputColumn]->evaluateRow(row_, 0);
+        if (spec.inputType == TypeId::DOUBLE)
+            state.realSum += sign * value.asDouble();
+        else
+            state.integerSum += sign * value.integer;
+    }
+    return store(key, group);
+}
+
+bool MaterializedView::store(int64_t key, Group &group) {
+    HeapFile &heap = *table_->heap;
+    if (group.rows <= 0 && key_) {
+        bool ok = group.rid.pageId < 0 || heap.deleteRecord(group.rid);
+        groups_.erase(key);
+        return ok;
+    }
+
+    values_.clear();
+    for (int column : columns_) {
+        if (column < 0) {
+            values_.push_back(Value::makeBigint(key));
+            continue;
+        }
+        const AggregateSpec &spec = aggregates_[column];
+        const State &state = group.states[column];
+        bool real = spec.inputType == TypeId::DOUBLE;
+        switch (spec.function) {
+        case AggregateFunction::COUNT:
+            values_.push_back(Value::makeBigint(state.count));
+            break;
+        case AggregateFunction::AVG: {
+            double sum = real ? state.realSum : static_cast<double>(state.integerSum);
+            values_.push_back(Value::makeDouble(state.count > 0 ? sum / state.count : 0));
+            break;
+        }
+        default:
+            values_.push_back(real ? Value::makeDouble(state.realSum) : Value::makeBigint(state.integerSum));
+            break;
+        }
+    }
+    schema_.serializeRow(values_, record_);
+
+    if (group.rid.pageId < 0) {
+        group.rid = heap.insertRecord(record_);
+        return group.rid.pageId >= 0;
+    }
+    // View rows have a fixed size, so they are rewritten in place.
+    return heap.updateRecord(group.rid, record_);
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "catalog.h"
+#include "expression.h"
+#include "operators.h"
+
+// Materialized aggregate view: the result of
+//
+//   SELECT key, aggregates FROM base [WHERE filter] [GROUP BY key]
+//
+// stored as an ordinary table with one row per group, so reading it costs
+// O(groups) however large the base table grows. Instead of recomputing the
+// query, every row inserted into, deleted from or updated in the base table
+// is applied to its group as a delta. That is why only COUNT, SUM and AVG
+// are allowed: MIN and MAX cannot be taken back when a row goes away.
+//
+// Expressions are evaluated over single base rows, in the base table's
+// column order. Like the GROUP BY of a query, the key is integral and a view
+// without a key has one global group, which exists even when it is empty.
+// Sums of integral inputs are kept as int64, so they stay exact however many
+// deltas are applied.
+class MaterializedView {
+public:
+    // 'filter' (or null) picks the base rows that count. 'key' is null for a
+    // single global group. The AggregateSpec input columns index 'inputs'.
+    // 'columns' gives, for every column of 'schema', the aggregate it shows
+    // or -1 for the key.
+    MaterializedView(TableInfo *base, std::unique_ptr<Expression> filter, std::unique_ptr<Expression> key,
+                     std::vector<std::unique_ptr<Expression>> inputs, std::vector<AggregateSpec> aggregates,
+                     std::vector<int> columns, const Schema &schema);
+
+    TableInfo* getBase() const { return base_; }
+    const Schema &getSchema() const { return schema_; }
+
+    // Makes 'table', which has getSchema() and no rows, the storage of the
+    // view and fills it from the rows the base table has now. Returns false
+    // and sets 'error' if a base page could not be read or a row could not
+    // be written.
+    bool populate(TableInfo *table, std::string &error);
+
+    // Applies base row 'row' being inserted (sign 1) or deleted (sign -1);
+    // an update is a deletion of the old row and an insertion of the new one.
+    // Returns false if the view's row could not be written.
+    bool apply(const std::vector<Value> &row, int sign);
+
+private:
+    // Running state of one aggregate of a group.
+    struct State {
+        int64_t count;
+        int64_t integerSum; // Of integral inputs.
+        double realSum;     // Of DOUBLE inputs.
+    };
+
+    struct Group {
+        RecordId rid;    // {-1, -1} until the group's row is stored.
+        int64_t rows;
+        std::vector<State> states;
+    };
+
+    // apply() with mutex_ held.
+    bool add(const std::vector<Value> &row, int sign);
+
+    // Writes or, once its last row is gone, removes the row of a group.
+    bool store(int64_t key, Group &group);
+
+    TableInfo *base_;
+    TableInfo *table_;
+    std::unique_ptr<Expression> filter_;
+    std::unique_ptr<Expression> key_;
+    std::vector<std::unique_ptr<Expression>> inputs_;
+    std::vector<AggregateSpec> aggregates_;
+    std::vector<int> columns_;
+    Schema schema_;
+
+    // Statements changing the base table concurrently apply their rows one
+    // at a time.
+    std::mutex mutex_;
+    std::unordered_map<int64_t, Group> groups_;
+    Batch row_;  // The row being applied, as a one-row batch.
+    std::vector<Value> values_;
+    std::vector<char> record_;
+};
@@ -0,0 +1,992 @@
+#include "operators.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <thread>
+#include "hashing.h"
+
+int64_t integerValueAt(const ColumnVector &column, size_t row) {
+    switch (column.getType()) {
+    case TypeId::INTEGER:
+    case TypeId::DATE:    return column.values<int32_t>()[row];
+    case TypeId::BIGINT:  return column.values<int64_t>()[row];
+    case TypeId::BOOLEAN: return column.values<uint8_t>()[row];
+    case TypeId::DOUBLE:  return static_cast<int64_t>(column.values<double>()[row]);
+    case TypeId::VARCHAR: return 0;
+    }
+    return 0;
+}
+
+static double doubleValueAt(const ColumnVector &column, size_t row) {
+    if (column.getType() == TypeId::DOUBLE)
+        return column.values<double>()[row];
+    return static_cast<double>(integerValueAt(column, row));
+}
+
+uint64_t hashValueAt(const ColumnVector &column, size_t row) {
+    switch (column.getType()) {
+    case TypeId::VARCHAR:
+        return hashKey(std::hash<std::string>()(column.values<std::string>()[row]));
+    case TypeId::DOUBLE: {
+        uint64_t bits;
+        memcpy(&bits, &column.values<double>()[row], sizeof(bits));
+        return hashKey(bits);
+    }
+    default:
+        // All integral types hash through int64 so that INTEGER and BIGINT keys match.
+        return hashKey(static_cast<uint64_t>(integerValueAt(column, row)));
+    }
+}
+
+int compareValuesAt(const ColumnVector &a, size_t rowA, const ColumnVector &b, size_t rowB) {
+    if (a.getType() == TypeId::VARCHAR || b.getType() == TypeId::VARCHAR) {
+        int c = a.values<std::string>()[rowA].compare(b.values<std::string>()[rowB]);
+        return c < 0 ? -1 : (c > 0 ? 1 : 0);
+    }
+    if (a.getType() == TypeId::DOUBLE || b.getType() == TypeId::DOUBLE) {
+        double x = doubleValueAt(a, rowA), y = doubleValueAt(b, rowB);
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+    int64_t x = integerValueAt(a, rowA), y = integerValueAt(b, rowB);
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Copies the live rows of a column into 'out' as int64/double arrays, with
+// one type switch per batch instead of per row.
+template <typename In, typename Out>
+static void gatherAs(const ColumnVector &column, const Batch &batch, Out *out) {
+    const In *in = column.values<In>();
+    size_t n = batch.activeCount();
+    if (batch.hasSelection) {
+        for (size_t i = 0; i < n; ++i)
+            out[i] = static_cast<Out>(in[batch.selection[i]]);
+    } else {
+        for (size_t i = 0; i < n; ++i)
+            out[i] = static_cast<Out>(in[i]);
+    }
+}
+
+template <typename Out>
+static void gatherNumeric(const ColumnVector &column, const Batch &batch, Out *out) {
+    switch (column.getType()) {
+    case TypeId::INTEGER:
+    case TypeId::DATE:    gatherAs<int32_t>(column, batch, out); break;
+    case TypeId::BIGINT:  gatherAs<int64_t>(column, batch, out); break;
+    case TypeId::DOUBLE:  gatherAs<double>(column, batch, out); break;
+    case TypeId::BOOLEAN: gatherAs<uint8_t>(column, batch, out); break;
+    case TypeId::VARCHAR: std::fill(out, out + batch.activeCount(), Out(0)); break;
+    }
+}
+
+TableScanSource::TableScanSource(HeapFile *file, const Schema &schema, const std::vector<int> &columns,
+                                 bool withRecordIds)
+    : file_(file), schema_(schema), columns_(columns), withRecordIds_(withRecordIds),
+      batchCapacity_(kBatchSize), pageIds_(file->getPageIds()), filtered_(columns.size(), false)
+{
+}
+
+void TableScanSource::addKeyFilter(std::shared_ptr<const BloomFilter> filter, int column) {
+    size_t c = column - (withRecordIds_ ? 1 : 0);
+    if (column < 0 || c >= columns_.size())
+        return;
+    keyFilters_.push_back(KeyFilter{filter, column});
+    filtered_[c] = true;
+}
+
+std::string TableScanSource::getName() const {
+    std::string name = "TableScan";
+    for (size_t i = 0; i < keyFilters_.size(); ++i) {
+        int c = keyFilters_[i].column - (withRecordIds_ ? 1 : 0);
+        name += (i == 0 ? " (Bloom filter on " : ", ") + schema_.getColumn(columns_[c]).name;
+    }
+    return keyFilters_.empty() ? name : name + ")";
+}
+
+// Fails the query: 'pageId' could not be fixed because every frame of the
+// buffer pool is pinned or the page cannot be read.
+static void failFixPage(int pageId) {
+    QueryStatus::fail("could not fix page " + std::to_string(pageId) + " in the buffer pool");
+}
+
+bool TableScanSource::produce(size_t begin, size_t end,
+                              const std::function<bool(Batch &)> &consumer) const {
+    BufferPool *bufferPool = file_->getBufferPool();
+    Batch batch;
+    auto startBatch = [&]() {
+        batch.columns.clear();
+        if (withRecordIds_) {
+            batch.columns.emplace_back(TypeId::BIGINT);
+            batch.columns.back().resize(kBatchSize);
+        }
+        for (int column : columns_) {
+            batch.columns.emplace_back(schema_.getColumn(column).type);
+            batch.columns.back().resize(kBatchSize);
+        }
+        batch.count = 0;
+        batch.hasSelection = false;
+        batch.selection.clear();
+    };
+    auto emit = [&]() {
+        for (auto &column : batch.columns)
+            column.resize(batch.count);
+        bool more = consumer(batch);
+        startBatch();
+        return more;
+    };
+
+    startBatch();
+    for (size_t i = begin; i < end; ++i) {
+        Page *page = bufferPool->fixPage(pageIds_[i], false);
+        if (page == nullptr) {
+            failFixPage(pageIds_[i]);
+            return false;
+        }
+        for (int slot = 0; slot < page->getNumberOfSlots(); ++slot) {
+            // Decode straight from the fixed page instead of copying the record.
+            int length;
+            const char *record = page->getRecordData(slot, length);
+            if (record == nullptr)
+                continue;
+            size_t first = withRecordIds_ ? 1 : 0;
+            bool match = true;
+            for (size_t f = 0; f < keyFilters_.size() && match; ++f) {
+                ColumnVector &key = batch.columns[keyFilters_[f].column];
+                schema_.decodeColumn(record, columns_[keyFilters_[f].column - first], key, batch.count);
+                match = keyFilters_[f].filter->mayContain(hashValueAt(key, batch.count));
+            }
+            if (!match)
+                continue;
+            if (withRecordIds_)
+                batch.columns[0].values<int64_t>()[batch.count] = encodeRecordId(RecordId{pageIds_[i], slot});
+            for (size_t c = 0; c < columns_.size(); ++c)
+                if (!filtered_[c])
+                    schema_.decodeColumn(record, columns_[c], batch.columns[first + c], batch.count);
+            if (++batch.count < batchCapacity_)
+                continue;
+            // The page is not pinned while the batch is passed on, so a
+            // consumer that waits (a streaming cursor) holds no pins.
+            bufferPool->unfixPage(page, false);
+            if (!emit())
+                return false;
+            page = bufferPool->fixPage(pageIds_[i], false);
+            if (page == nullptr) {
+                failFixPage(pageIds_[i]);
+                return false;
+            }
+        }
+        bufferPool->unfixPage(page, false);
+    }
+    if (batch.count > 0)
+        return emit();
+    return true;
+}
+
+IndexScanSource::IndexScanSource(const BPlusTree *index, const std::string &indexName, HeapFile *file,
+                                 const Schema &schema, const std::vector<int> &columns, bool withRecordIds,
+                                 std::vector<IndexBound> lower, std::vector<IndexBound> upper)
+    : index_(index), indexName_(indexName), file_(file), schema_(schema), columns_(columns),
+      withRecordIds_(withRecordIds), lower_(std::move(lower)), upper_(std::move(upper)), rowLimit_(SIZE_MAX)
+{
+}
+
+// Key range [low, high] that satisfies all bounds. Returns false if the
+// range is empty.
+static bool evaluateIndexRange(const std::vector<IndexBound> &lower, const std::vector<IndexBound> &upper,
+                               int64_t &low, int64_t &high) {
+    low = INT64_MIN;
+    high = INT64_MAX;
+    Batch none;
+    for (const IndexBound &bound : lower) {
+        int64_t v = bound.value->evaluateRow(none, 0).integer;
+        if (!bound.inclusive) {
+            if (v == INT64_MAX)
+                return false;
+            ++v;
+        }
+        low = std::max(low, v);
+    }
+    for (const IndexBound &bound : upper) {
+        int64_t v = bound.value->evaluateRow(none, 0).integer;
+        if (!bound.inclusive) {
+            if (v == INT64_MIN)
+                return false;
+            --v;
+        }
+        high = std::min(high, v);
+    }
+    return low <= high;
+}
+
+void IndexScanSource::prepare() {
+    recordIds_.clear();
+    int64_t low, high;
+    if (!evaluateIndexRange(lower_, upper_, low, high))
+        return;
+    index_->scan(low, high, [&](int64_t, RecordId rid) {
+        recordIds_.push_back(rid);
+        return recordIds_.size() < rowLimit_;
+    });
+}
+
+bool IndexScanSource::produce(size_t begin, size_t end,
+                              const std::function<bool(Batch &)> &consumer) const {
+    BufferPool *bufferPool = file_->getBufferPool();
+    size_t first = begin * kBatchSize, last = std::min(end * kBatchSize, recordIds_.size());
+    size_t offset = withRecordIds_ ? 1 : 0;
+    for (size_t start = first; start < last; start += kBatchSize) {
+        size_t stop = std::min(start + kBatchSize, last);
+        Batch batch;
+        if (withRecordIds_)
+            batch.columns.emplace_back(TypeId::BIGINT);
+        for (int column : columns_)
+            batch.columns.emplace_back(schema_.getColumn(column).type);
+        for (auto &column : batch.columns)
+            column.resize(stop - start);
+
+        // Key order: consecutive entries often share a page, which then
+        // stays fixed. Entries whose record is gone are skipped.
+        Page *page = nullptr;
+        for (size_t i = start; i < stop; ++i) {
+            RecordId rid = recordIds_[i];
+            if (page == nullptr || page->getPageId() != rid.pageId) {
+                if (page != nullptr)
+                    bufferPool->unfixPage(page, false);
+                page = bufferPool->fixPage(rid.pageId, false);
+                if (page == nullptr) {
+                    failFixPage(rid.pageId);
+                    return false;
+                }
+            }
+            int length;
+            const char *record = page->getRecordData(rid.slotId, length);
+            if (record == nullptr)
+                continue;
+            if (withRecordIds_)
+                batch.columns[0].values<int64_t>()[batch.count] = encodeRecordId(rid);
+            for (size_t c = 0; c < columns_.size(); ++c)
+                schema_.decodeColumn(record, columns_[c], batch.columns[offset + c], batch.count);
+            ++batch.count;
+        }
+        if (page != nullptr)
+            bufferPool->unfixPage(page, false);
+        for (auto &column : batch.columns)
+            column.resize(batch.count);
+        batch.sequence = start / kBatchSize;
+        if (batch.count > 0 && !consumer(batch))
+            return false;
+    }
+    return true;
+}
+
+BitmapHeapScanSource::BitmapHeapScanSource(const BPlusTree *index, const std::string &indexName, HeapFile *file,
+                                           const Schema &schema, const std::vector<int> &columns,
+                                           bool withRecordIds, std::vector<IndexBound> lower,
+                                           std::vector<IndexBound> upper)
+    : index_(index), indexName_(indexName), file_(file), schema_(schema), columns_(columns),
+      withRecordIds_(withRecordIds), lower_(std::move(lower)), upper_(std::move(upper)), rowLimit_(SIZE_MAX)
+{
+}
+
+void BitmapHeapScanSource::prepare() {
+    pageIds_.clear();
+    slots_.clear();
+    int64_t low, high;
+    if (!evaluateIndexRange(lower_, upper_, low, high))
+        return;
+    std::vector<int64_t> rids;
+    index_->scan(low, high, [&](int64_t, RecordId rid) {
+        rids.push_back(encodeRecordId(rid));
+        return rids.size() < rowLimit_;
+    });
+    std::sort(rids.begin(), rids.end());
+    for (int64_t value : rids) {
+        RecordId rid = decodeRecordId(value);
+        if (pageIds_.empty() || pageIds_.back() != rid.pageId) {
+            pageIds_.push_back(rid.pageId);
+            slots_.emplace_back();
+        }
+        std::vector<uint64_t> &bits = slots_.back();
+        size_t word = static_cast<size_t>(rid.slotId) / 64;
+        if (bits.size() <= word)
+            bits.resize(word + 1, 0);
+        bits[word] |= uint64_t(1) << (rid.slotId % 64);
+    }
+}
+
+bool BitmapHeapScanSource::produce(size_t begin, size_t end,
+                                   const std::function<bool(Batch &)> &consumer) const {
+    BufferPool *bufferPool = file_->getBufferPool();
+    bufferPool->prefetchPages(std::vector<int>(pageIds_.begin() + begin, pageIds_.begin() + end));
+
+    Batch batch;
+    auto startBatch = [&]() {
+        batch.columns.clear();
+        if (withRecordIds_) {
+            batch.columns.emplace_back(TypeId::BIGINT);
+            batch.columns.back().resize(kBatchSize);
+        }
+        for (int column : columns_) {
+            batch.columns.emplace_back(schema_.getColumn(column).type);
+            batch.columns.back().resize(kBatchSize);
+        }
+        batch.count = 0;
+    };
+    auto emit = [&]() {
+        for (auto &column : batch.columns)
+            column.resize(batch.count);
+        bool more = consumer(batch);
+        startBatch();
+        return more;
+    };
+
+    startBatch();
+    size_t offset = withRecordIds_ ? 1 : 0;
+    for (size_t i = begin; i < end; ++i) {
+        Page *page = bufferPool->fixPage(pageIds_[i], false);
+        if (page == nullptr) {
+            failFixPage(pageIds_[i]);
+            return false;
+        }
+        const std::vector<uint64_t> &bits = slots_[i];
+        for (size_t word = 0; word < bits.size(); ++word) {
+            for (uint64_t set = bits[word]; set != 0; set &= set - 1) {
+                int slot = static_cast<int>(word * 64 + __builtin_ctzll(set));
+                // Entries whose record is gone are skipped.
+                int length;
+                const char *record = page->getRecordData(slot, length);
+                if (record == nullptr)
+                    continue;
+                if (withRecordIds_)
+                    batch.columns[0].values<int64_t>()[batch.count] = encodeRecordId(RecordId{pageIds_[i], slot});
+                for (size_t c = 0; c < columns_.size(); ++c)
+                    schema_.decodeColumn(record, columns_[c], batch.columns[offset + c], batch.count);
+                if (++batch.count < kBatchSize)
+                    continue;
+                // As in TableScanSource, no pin is held while the batch is passed on.
+                bufferPool->unfixPage(page, false);
+                if (!emit())
+                    return false;
+                page = bufferPool->fixPage(pageIds_[i], false);
+                if (page == nullptr) {
+                    failFixPage(pageIds_[i]);
+                    return false;
+                }
+            }
+        }
+        bufferPool->unfixPage(page, false);
+    }
+    if (batch.count > 0)
+        return emit();
+    return true;
+}
+
+bool BatchSource::produce(size_t begin, size_t end,
+                          const std::function<bool(Batch &)> &consumer) const {
+    for (size_t i = begin; i < end; ++i) {
+        // Operators modify batches in place, so each worker gets a copy.
+        Batch batch = (*batches_)[i];
+        if (!consumer(batch))
+            return false;
+    }
+    return true;
+}
+
+void ProjectionOperator::execute(Batch &batch) const {
+    std::vector<ColumnVector> results(expressions_.size());
+    for (size_t i = 0; i < expressions_.size(); ++i) {
+        ColumnVector scratch;
+        const ColumnVector *result = expressions_[i]->evaluate(batch, scratch);
+        if (result == &scratch)
+            results[i] = std::move(scratch);
+        else
+            results[i] = *result;
+    }
+    batch.columns = std::move(results);
+}
+
+void FetchOperator::execute(Batch &batch) const {
+    size_t first = batch.columns.size();
+    for (int column : columns_) {
+        batch.columns.emplace_back(schema_.getColumn(column).type);
+        batch.columns.back().resize(batch.count);
+    }
+
+    // (record id, batch position), ordered by page and slot.
+    size_t n = batch.activeCount();
+    const int64_t *rids = batch.columns[ridColumn_].values<int64_t>();
+    ArenaVector<std::pair<int64_t, uint32_t>> rows(n, Arena::current());
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t row = batch.rowAt(i);
+        rows[i] = std::make_pair(rids[row], row);
+    }
+    std::sort(rows.begin(), rows.end());
+
+    BufferPool *bufferPool = file_->getBufferPool();
+    ArenaVector<char> gone(batch.count, 0, Arena::current());
+    size_t numGone = 0;
+    for (size_t i = 0; i < n;) {
+        int pageId = decodeRecordId(rows[i].first).pageId;
+        size_t end = i;
+        while (end < n && decodeRecordId(rows[end].first).pageId == pageId)
+            ++end;
+        Page *page = bufferPool->fixPage(pageId, false);
+        if (page == nullptr) {
+            failFixPage(pageId);
+            batch.hasSelection = true;
+            batch.selection.clear();
+            return;
+        }
+        for (; i < end; ++i) {
+            int length;
+            const char *record = page->getRecordData(decodeRecordId(rows[i].first).slotId, length);
+            if (record == nullptr) {
+                gone[rows[i].second] = 1;
+                ++numGone;
+                continue;
+            }
+            for (size_t c = 0; c < columns_.size(); ++c)
+                schema_.decodeColumn(record, columns_[c], batch.columns[first + c], rows[i].second);
+        }
+        bufferPool->unfixPage(page, false);
+    }
+    if (numGone == 0)
+        return;
+    // Rows whose record was deleted since their id was read drop out, in
+    // the order they had.
+    std::vector<uint32_t> selection;
+    selection.reserve(n - numGone);
+    for (size_t i = 0; i < n; ++i)
+        if (!gone[batch.rowAt(i)])
+            selection.push_back(batch.rowAt(i));
+    batch.selection = std::move(selection);
+    batch.hasSelection = true;
+}
+
+void CollectSink::prepare(int numWorkers) {
+    perWorker_.assign(numWorkers, std::vector<Batch>());
+    produced_ = 0;
+    output_->clear();
+}
+
+bool CollectSink::consume(Batch &batch, int workerId) {
+    size_t n = batch.activeCount();
+    size_t before = produced_.fetch_add(n);
+    if (before >= limit_)
+        return false;
+    batch.compact();
+    perWorker_[workerId].push_back(std::move(batch));
+    return before + n < limit_;
+}
+
+void CollectSink::finish() {
+    for (auto &batches : perWorker_)
+        for (auto &batch : batches)
+            output_->push_back(std::move(batch));
+    perWorker_.clear();
+    if (ordered_)
+        std::stable_sort(output_->begin(), output_->end(),
+                         [](const Batch &a, const Batch &b) { return a.sequence < b.sequence; });
+}
+
+void StreamSink::prepare(int numWorkers) {
+    (void)numWorkers;
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.clear();
+    // A stream closed before its run started (a cursor closed at once)
+    // stays closed; one closed during an earlier run opens again.
+    if (finished_)
+        closed_ = false;
+    finished_ = false;
+    error_.clear();
+}
+
+bool StreamSink::consume(Batch &batch, int workerId) {
+    (void)workerId;
+    batch.compact();
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return queue_.size() < capacity_ || closed_; });
+    if (closed_)
+        return false;
+    queue_.push_back(std::move(batch));
+    changed_.notify_all();
+    return true;
+}
+
+void StreamSink::finish() {
+    QueryStatus *status = QueryStatus::current();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (status != nullptr && status->hasFailed())
+        failLocked(status->getError());
+    finished_ = true;
+    changed_.notify_all();
+}
+
+void StreamSink::fail(const std::string &error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    failLocked(error);
+    changed_.notify_all();
+}
+
+void StreamSink::failLocked(const std::string &error) {
+    if (error_.empty())
+        error_ = error;
+    queue_.clear();
+    finished_ = true;
+}
+
+std::string StreamSink::getError() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+}
+
+bool StreamSink::next(Batch &batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return !queue_.empty() || finished_ || closed_; });
+    if (queue_.empty() || closed_)
+        return false;
+    batch = std::move(queue_.front());
+    queue_.pop_front();
+    changed_.notify_all();
+    return true;
+}
+
+void StreamSink::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    queue_.clear();
+    changed_.notify_all();
+}
+
+void TopNSink::prepare(int numWorkers) {
+    candidates_.assign(numWorkers, Candidates());
+    output_->clear();
+}
+
+bool TopNSink::less(const Batch &a, uint32_t rowA, const Batch &b, uint32_t rowB) const {
+    for (const auto &key : keys_) {
+        int c = compareValuesAt(a.columns[key.column], rowA, b.columns[key.column], rowB);
+        if (c != 0)
+            return key.ascending ? c < 0 : c > 0;
+    }
+    return false;
+}
+
+bool TopNSink::consume(Batch &batch, int workerId) {
+    if (limit_ == 0)
+        return false;
+    Candidates &mine = candidates_[workerId];
+    Batch &rows = mine.rows;
+    if (rows.columns.empty()) {
+        for (const auto &column : batch.columns)
+            rows.columns.emplace_back(column.getType());
+    }
+    auto worse = [&](uint32_t x, uint32_t y) { return less(rows, x, rows, y); };
+
+    size_t n = batch.activeCount();
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t row = batch.rowAt(i);
+        if (mine.heap.size() < limit_) {
+            for (size_t c = 0; c < rows.columns.size(); ++c)
+                rows.columns[c].appendFrom(batch.columns[c], row);
+            mine.heap.push_back(static_cast<uint32_t>(rows.count++));
+            std::push_heap(mine.heap.begin(), mine.heap.end(), worse);
+            continue;
+        }
+        uint32_t worst = mine.heap.front();
+        if (!less(batch, row, rows, worst))
+            continue;
+        // Replace the worst row in place and restore the heap.
+        for (size_t c = 0; c < rows.columns.size(); ++c)
+            rows.columns[c].copyRow(batch.columns[c], row, worst);
+        std::pop_heap(mine.heap.begin(), mine.heap.end(), worse);
+        mine.heap.back() = worst;
+        std::push_heap(mine.heap.begin(), mine.heap.end(), worse);
+    }
+    return true;
+}
+
+void TopNSink::finish() {
+    Batch all;
+    for (auto &mine : candidates_)
+        if (mine.rows.count > 0)
+            all.append(mine.rows);
+    candidates_.clear();
+
+    std::vector<uint32_t> order(all.count);
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = static_cast<uint32_t>(i);
+    size_t n = std::min(limit_, order.size());
+    std::partial_sort(order.begin(), order.begin() + n, order.end(),
+                      [&](uint32_t x, uint32_t y) { return less(all, x, all, y); });
+
+    for (size_t start = 0; start < n; start += kBatchSize) {
+        size_t count = std::min(kBatchSize, n - start);
+        Batch batch;
+        for (const auto &column : all.columns) {
+            batch.columns.emplace_back(column.getType());
+            batch.columns.back().appendRows(column, order.data() + start, count);
+        }
+        batch.count = count;
+        output_->push_back(std::move(batch));
+    }
+}
+
+void SortSink::prepare(int numWorkers) {
+    runs_.assign(numWorkers, Batch());
+    output_->clear();
+}
+
+bool SortSink::consume(Batch &batch, int workerId) {
+    runs_[workerId].append(batch);
+    return true;
+}
+
+void SortSink::finish() {
+    auto less = [this](const Batch &a, uint32_t rowA, const Batch &b, uint32_t rowB) {
+        for (const auto &key : keys_) {
+            int c = compareValuesAt(a.columns[key.column], rowA, b.columns[key.column], rowB);
+            if (c != 0)
+                return key.ascending ? c < 0 : c > 0;
+        }
+        return false;
+    };
+
+    // Sort every worker's run on its own thread.
+    std::vector<std::thread> threads;
+    for (auto &run : runs_) {
+        if (run.count == 0)
+            continue;
+        threads.emplace_back([&run, &less]() {
+            std::vector<uint32_t> order(run.count);
+            for (size_t i = 0; i < order.size(); ++i)
+                order[i] = static_cast<uint32_t>(i);
+            std::stable_sort(order.begin(), order.end(),
+                             [&](uint32_t x, uint32_t y) { return less(run, x, run, y); });
+            run.selection = std::move(order);
+            run.hasSelection = true;
+            run.compact();
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    // K-way merge of the sorted runs.
+    typedef std::pair<size_t, uint32_t> Cursor; // (run, row)
+    auto greater = [&](const Cursor &x, const Cursor &y) {
+        return less(runs_[y.first], y.second, runs_[x.first], x.second);
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(greater)> heap(greater);
+    for (size_t r = 0; r < runs_.size(); ++r)
+        if (runs_[r].count > 0)
+            heap.push(Cursor(r, 0));
+
+    Batch current;
+    while (!heap.empty()) {
+        Cursor top = heap.top();
+        heap.pop();
+        const Batch &run = runs_[top.first];
+        if (current.columns.empty())
+            for (const auto &column : run.columns)
+                current.columns.emplace_back(column.getType());
+        for (size_t c = 0; c < run.columns.size(); ++c)
+            current.columns[c].appendFrom(run.columns[c], top.second);
+        if (++current.count == kBatchSize) {
+            output_->push_back(std::move(current));
+            current = Batch();
+        }
+        if (top.second + 1 < run.count)
+            heap.push(Cursor(top.first, top.second + 1));
+    }
+    if (current.count > 0)
+        output_->push_back(std::move(current));
+    runs_.clear();
+}
+
+void HashJoinBuildSink::prepare(int numWorkers) {
+    perWorker_.assign(numWorkers, Batch());
+    rows_ = Batch();
+}
+
+bool HashJoinBuildSink::consume(Batch &batch, int workerId) {
+    perWorker_[workerId].append(batch);
+    return true;
+}
+
+void HashJoinBuildSink::finish() {
+    for (auto &part : perWorker_)
+        if (part.count > 0)
+            rows_.append(part);
+    perWorker_.clear();
+
+    size_t n = rows_.count;
+    size_t numBuckets = 16;
+    while (numBuckets < 2 * n)
+        numBuckets <<= 1;
+    mask_ = numBuckets - 1;
+    buckets_.assign(numBuckets, -1);
+    next_.assign(n, -1);
+    hashes_.resize(n);
+    bloomFilter_->reset(n);
+    if (n == 0)
+        return;
+    const ColumnVector &keys = rows_.columns[keyColumn_];
+    for (size_t row = 0; row < n; ++row) {
+        uint64_t hash = hashValueAt(keys, row);
+        hashes_[row] = hash;
+        next_[row] = buckets_[hash & mask_];
+        buckets_[hash & mask_] = static_cast<int64_t>(row);
+        bloomFilter_->insert(hash);
+    }
+}
+
+void HashJoinProbeOperator::execute(Batch &batch) const {
+    const Batch &rows = build_->getRows();
+    ArenaVector<uint32_t> probeRows(Arena::current()), buildRows(Arena::current());
+    if (rows.count > 0) {
+        const ColumnVector &keys = batch.columns[keyColumn_];
+        const ColumnVector &buildKeys = rows.columns[build_->getKeyColumn()];
+        size_t n = batch.activeCount();
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t row = batch.rowAt(i);
+            uint64_t hash = hashValueAt(keys, row);
+            for (int64_t b = build_->firstInBucket(hash); b != -1; b = build_->nextInChain(b)) {
+                if (build_->hashAt(b) == hash && compareValuesAt(keys, row, buildKeys, b) == 0) {
+                    probeRows.push_back(row);
+                    buildRows.push_back(static_cast<uint32_t>(b));
+                }
+            }
+        }
+    }
+
+    Batch out;
+    for (const auto &column : batch.columns) {
+        out.columns.emplace_back(column.getType());
+        out.columns.back().appendRows(column, probeRows.data(), probeRows.size());
+    }
+    for (const auto &column : rows.columns) {
+        out.columns.emplace_back(column.getType());
+        out.columns.back().appendRows(column, buildRows.data(), buildRows.size());
+    }
+    out.count = probeRows.size();
+    out.sequence = batch.sequence;
+    batch = std::move(out);
+}
+
+void MergeJoinBuildSink::prepare(int numWorkers) {
+    perWorker_.assign(numWorkers, std::vector<Batch>());
+    rows_ = Batch();
+}
+
+bool MergeJoinBuildSink::consume(Batch &batch, int workerId) {
+    perWorker_[workerId].push_back(std::move(batch));
+    return true;
+}
+
+void MergeJoinBuildSink::finish() {
+    std::vector<Batch> batches;
+    for (auto &part : perWorker_)
+        for (auto &batch : part)
+            batches.push_back(std::move(batch));
+    perWorker_.clear();
+    std::sort(batches.begin(), batches.end(),
+              [](const Batch &a, const Batch &b) { return a.sequence < b.sequence; });
+    for (const Batch &batch : batches)
+        rows_.append(batch);
+    if (rows_.count == 0)
+        return;
+
+    const ColumnVector &keys = rows_.columns[keyColumn_];
+    bool sorted = true;
+    for (size_t row = 1; row < rows_.count && sorted; ++row)
+        sorted = compareValuesAt(keys, row - 1, keys, row) <= 0;
+    if (sorted)
+        return;
+    std::vector<uint32_t> order(rows_.count);
+    for (size_t row = 0; row < order.size(); ++row)
+        order[row] = static_cast<uint32_t>(row);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b) { return compareValuesAt(keys, a, keys, b) < 0; });
+    Batch sortedRows;
+    for (const auto &column : rows_.columns) {
+        sortedRows.columns.emplace_back(column.getType());
+        sortedRows.columns.back().appendRows(column, order.data(), order.size());
+    }
+    sortedRows.count = rows_.count;
+    rows_ = std::move(sortedRows);
+}
+
+void MergeJoinOperator::execute(Batch &batch) const {
+    const Batch &rows = inner_->getRows();
+    const ColumnVector &keys = batch.columns[keyColumn_];
+    ArenaVector<uint32_t> outer(batch.activeCount(), Arena::current());
+    for (size_t i = 0; i < outer.size(); ++i)
+        outer[i] = batch.rowAt(i);
+    bool sorted = true;
+    for (size_t i = 1; i < outer.size() && sorted; ++i)
+        sorted = compareValuesAt(keys, outer[i - 1], keys, outer[i]) <= 0;
+    if (!sorted)
+        std::stable_sort(outer.begin(), outer.end(),
+                         [&](uint32_t a, uint32_t b) { return compareValuesAt(keys, a, keys, b) < 0; });
+
+    ArenaVector<uint32_t> outerRows(Arena::current()), innerRows(Arena::current());
+    if (rows.count > 0 && !outer.empty()) {
+        const ColumnVector &innerKeys = rows.columns[inner_->getKeyColumn()];
+        size_t n = rows.count;
+        // Seek to the first inner row not below the smallest outer key.
+        size_t low = 0, high = n;
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (compareValuesAt(innerKeys, mid, keys, outer[0]) < 0)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        size_t inner = low;
+        for (size_t i = 0; i < outer.size() && inner < n;) {
+            int c = compareValuesAt(keys, outer[i], innerKeys, inner);
+            if (c < 0) {
+                ++i;
+                continue;
+            }
+            if (c > 0) {
+                ++inner;
+                continue;
+            }
+            size_t mark = inner;
+            while (inner < n && compareValuesAt(keys, outer[i], innerKeys, inner) == 0)
+                ++inner;
+            // Every outer row with this key restores the cursor to the mark.
+            size_t first = i;
+            for (; i < outer.size() && compareValuesAt(keys, outer[first], keys, outer[i]) == 0; ++i) {
+                for (size_t j = mark; j < inner; ++j) {
+                    outerRows.push_back(outer[i]);
+                    innerRows.push_back(static_cast<uint32_t>(j));
+                }
+            }
+        }
+    }
+
+    Batch out;
+    for (const auto &column : batch.columns) {
+        out.columns.emplace_back(column.getType());
+        out.columns.back().appendRows(column, outerRows.data(), outerRows.size());
+    }
+    for (const auto &column : rows.columns) {
+        out.columns.emplace_back(column.getType());
+        out.columns.back().appendRows(column, innerRows.data(), innerRows.size());
+    }
+    out.count = outerRows.size();
+    out.sequence = batch.sequence;
+    batch = std::move(out);
+}
+
+HashAggregateSink::HashAggregateSink(int keyColumn, TypeId keyType,
+                                     const std::vector<AggregateSpec> &aggregates,
+                                     const AggregateOptions &options)
+    : keyColumn_(keyColumn), keyType_(keyType), aggregates_(aggregates), options_(options),
+      output_(std::make_shared<std::vector<Batch>>())
+{
+    // Concurrent aggregations must not share a spill file.
+    options_.spillFileName += "." + std::to_string(reinterpret_cast<uintptr_t>(this));
+}
+
+TypeId HashAggregateSink::resultType(const AggregateSpec &spec) {
+    if (spec.function == AggregateFunction::COUNT)
+        return TypeId::BIGINT;
+    if (spec.function == AggregateFunction::AVG || spec.inputType == TypeId::DOUBLE)
+        return TypeId::DOUBLE;
+    return TypeId::BIGINT;
+}
+
+void HashAggregateSink::prepare(int numWorkers) {
+    options_.numWorkers = numWorkers;
+    std::vector<AggregateCall> calls;
+    for (const auto &spec : aggregates_)
+        calls.push_back({spec.function, spec.inputColumn >= 0 && spec.inputType != TypeId::DOUBLE});
+    aggregator_.reset(new PartitionedHashAggregator(calls, options_));
+    output_->clear();
+}
+
+bool HashAggregateSink::consume(Batch &batch, int workerId) {
+    size_t n = batch.activeCount();
+    Arena *arena = Arena::current();
+    ArenaVector<int64_t> keys(n, 0, arena);
+    if (keyColumn_ >= 0)
+        gatherNumeric(batch.columns[keyColumn_], batch, keys.data());
+
+    // Integral inputs are gathered as int64, the others as double.
+    std::vector<ArenaVector<int64_t>> integers;
+    std::vector<ArenaVector<double>> reals;
+    for (size_t a = 0; a < aggregates_.size(); ++a) {
+        integers.emplace_back(arena);
+        reals.emplace_back(arena);
+    }
+    std::vector<AggregateInput> inputs(aggregates_.size());
+    for (size_t a = 0; a < aggregates_.size(); ++a) {
+        const AggregateSpec &spec = aggregates_[a];
+        if (spec.inputColumn < 0)
+            continue;
+        const ColumnVector &column = batch.columns[spec.inputColumn];
+        if (spec.inputType != TypeId::DOUBLE) {
+            integers[a].resize(n);
+            gatherNumeric(column, batch, integers[a].data());
+            inputs[a].integers = integers[a].data();
+        } else {
+            reals[a].resize(n);
+            gatherNumeric(column, batch, reals[a].data());
+            inputs[a].reals = reals[a].data();
+        }
+    }
+    if (!aggregator_->consume(workerId, keys.data(), inputs.data(), n)) {
+        QueryStatus::fail(aggregator_->getError());
+        return false;
+    }
+    return true;
+}
+
+void HashAggregateSink::finish() {
+    AggregateResult result = aggregator_->finish();
+    bool failed = aggregator_->hasFailed();
+    if (failed)
+        QueryStatus::fail(aggregator_->getError());
+    aggregator_.reset();
+    if (failed)
+        return;
+    if (keyColumn_ < 0 && result.keys.empty()) {
+        // A global aggregate over no rows still produces one row.
+        result.keys.push_back(0);
+        for (auto &values : result.values)
+            values.push_back(0);
+        for (auto &values : result.integers)
+            values.push_back(0);
+    }
+
+    size_t numGroups = result.keys.size();
+    for (size_t start = 0; start < numGroups; start += kBatchSize) {
+        size_t n = std::min(kBatchSize, numGroups - start);
+        Batch batch;
+        if (keyColumn_ >= 0) {
+            batch.columns.emplace_back(keyType_);
+            ColumnVector &keys = batch.columns.back();
+            keys.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                Value key = Value::makeBigint(result.keys[start + i]);
+                keys.setValue(i, key);
+            }
+        }
+        for (size_t a = 0; a < aggregates_.size(); ++a) {
+            TypeId type = resultType(aggregates_[a]);
+            batch.columns.emplace_back(type);
+            ColumnVector &column = batch.columns.back();
+            column.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                Value value = type == TypeId::DOUBLE ? Value::makeDouble(result.values[a][start + i])
+                                                     : Value::makeBigint(result.integers[a][start + i]);
+                column.setValue(i, value);
+            }
+        }
+        batch.count = n;
+        output_->push_back(std::move(batch));
+    }
+}
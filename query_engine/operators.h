@@ -0,0 +1,448 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "../storage_engine/bplustree.h"
+#include "../storage_engine/heapfilemanager.h"
+#include "executor.h"
+#include "expression.h"
+#include "hashaggregate.h"
+#include "schema.h"
+
+// Materialized intermediate result shared between a sink and the source of a
+// later pipeline. The sink fills it in finish().
+typedef std::shared_ptr<std::vector<Batch>> BatchList;
+
+// A record id packed into a BIGINT column value.
+inline int64_t encodeRecordId(RecordId rid) {
+    return (static_cast<int64_t>(rid.pageId) << 32) | static_cast<uint32_t>(rid.slotId);
+}
+
+inline RecordId decodeRecordId(int64_t value) {
+    return RecordId{static_cast<int>(value >> 32), static_cast<int>(value & 0xffffffff)};
+}
+
+// Reads the records of a heap file. One unit is one page.
+class TableScanSource : public Source {
+public:
+    // Decodes the schema columns listed in 'columns', in that order. With
+    // 'withRecordIds' the first output column is the encoded record id.
+    TableScanSource(HeapFile *file, const Schema &schema, const std::vector<int> &columns,
+                    bool withRecordIds = false);
+
+    // Caps the rows per batch, so the scan stops after fixing only the pages
+    // those rows live on instead of a full batch worth of pages.
+    void setRowLimit(size_t rows) override { batchCapacity_ = std::max<size_t>(1, std::min(rows, kBatchSize)); }
+
+    // Key columns under a filter are decoded first; a row the filter rules
+    // out is skipped before its other columns are decoded.
+    void addKeyFilter(std::shared_ptr<const BloomFilter> filter, int column) override;
+
+    void prepare() override { pageIds_ = file_->getPageIds(); }
+    size_t getNumUnits() const override { return pageIds_.size(); }
+    bool produce(size_t begin, size_t end, const std::function<bool(Batch &)> &consumer) const override;
+    std::string getName() const override;
+
+private:
+    struct KeyFilter {
+        std::shared_ptr<const BloomFilter> filter;
+        int column; // Output column.
+    };
+
+    HeapFile *file_;
+    Schema schema_;
+    std::vector<int> columns_;
+    bool withRecordIds_;
+    size_t batchCapacity_;
+    std::vector<int> pageIds_; // Snapshot taken when a run starts.
+    std::vector<KeyFilter> keyFilters_;
+    std::vector<bool> filtered_; // Per entry of columns_: decoded by a key filter.
+};
+
+// One end of an index range: a constant or placeholder the key is compared
+// with, so a cached plan picks up new parameter values.
+struct IndexBound {
+    std::unique_ptr<Expression> value; // Integral, constant-like.
+    bool inclusive;
+};
+
+// Reads the records whose key in 'index' satisfies every bound in 'lower'
+// (key >= or > bound) and 'upper' (key <= or < bound), in key order. The
+// matching record ids are looked up when a run starts; one unit is up to
+// kBatchSize of them and becomes one batch whose sequence is the unit.
+// Output columns are laid out as in TableScanSource.
+class IndexScanSource : public Source {
+public:
+    IndexScanSource(const BPlusTree *index, const std::string &indexName, HeapFile *file,
+                    const Schema &schema, const std::vector<int> &columns, bool withRecordIds,
+                    std::vector<IndexBound> lower, std::vector<IndexBound> upper);
+
+    // Stops the index range read after 'rows' entries.
+    void setRowLimit(size_t rows) override { rowLimit_ = rows; }
+
+    void prepare() override;
+    size_t getNumUnits() const override { return (recordIds_.size() + kBatchSize - 1) / kBatchSize; }
+    bool produce(size_t begin, size_t end, const std::function<bool(Batch &)> &consumer) const override;
+    std::string getName() const override { return "IndexScan " + indexName_; }
+
+private:
+    const BPlusTree *index_;
+    std::string indexName_;
+    HeapFile *file_;
+    Schema schema_;
+    std::vector<int> columns_;
+    bool withRecordIds_;
+    std::vector<IndexBound> lower_;
+    std::vector<IndexBound> upper_;
+    size_t rowLimit_;
+    std::vector<RecordId> recordIds_; // Matches when the run started, in key order.
+};
+
+// Reads the same records as IndexScanSource, but in physical order: when a
+// run starts the matching record ids are sorted into one slot bitmap per
+// heap page, and each page is then fixed once. The pages of a morsel are
+// prefetched with one vectored read per run of consecutive pages. One unit
+// is one heap page; output columns are laid out as in TableScanSource.
+class BitmapHeapScanSource : public Source {
+public:
+    BitmapHeapScanSource(const BPlusTree *index, const std::string &indexName, HeapFile *file,
+                         const Schema &schema, const std::vector<int> &columns, bool withRecordIds,
+                         std::vector<IndexBound> lower, std::vector<IndexBound> upper);
+
+    // Stops the index range read after 'rows' entries.
+    void setRowLimit(size_t rows) override { rowLimit_ = rows; }
+
+    void prepare() override;
+    size_t getNumUnits() const override { return pageIds_.size(); }
+    bool produce(size_t begin, size_t end, const std::function<bool(Batch &)> &consumer) const override;
+    std::string getName() const override { return "BitmapHeapScan " + indexName_; }
+
+private:
+    const BPlusTree *index_;
+    std::string indexName_;
+    HeapFile *file_;
+    Schema schema_;
+    std::vector<int> columns_;
+    bool withRecordIds_;
+    std::vector<IndexBound> lower_;
+    std::vector<IndexBound> upper_;
+    size_t rowLimit_;
+    std::vector<int> pageIds_;                 // Pages with matches, ascending.
+    std::vector<std::vector<uint64_t>> slots_; // Bitmap of matching slots per page.
+};
+
+// Replays materialized batches. One unit is one batch.
+class BatchSource : public Source {
+public:
+    explicit BatchSource(BatchList batches) : batches_(batches) {}
+
+    size_t getNumUnits() const override { return batches_->size(); }
+    bool produce(size_t begin, size_t end, const std::function<bool(Batch &)> &consumer) const override;
+    std::string getName() const override { return "BatchSource"; }
+
+private:
+    BatchList batches_;
+};
+
+class FilterOperator : public Operator {
+public:
+    explicit FilterOperator(std::unique_ptr<Expression> predicate) : predicate_(std::move(predicate)) {}
+
+    void execute(Batch &batch) const override { predicate_->select(batch); }
+    std::string getName() const override { return "Filter " + predicate_->toString(); }
+
+private:
+    std::unique_ptr<Expression> predicate_;
+};
+
+// Replaces the batch's columns with the results of 'expressions'.
+class ProjectionOperator : public Operator {
+public:
+    explicit ProjectionOperator(std::vector<std::unique_ptr<Expression>> expressions)
+        : expressions_(std::move(expressions)) {}
+
+    void execute(Batch &batch) const override;
+    std::string getName() const override { return "Projection"; }
+
+private:
+    std::vector<std::unique_ptr<Expression>> expressions_;
+};
+
+// Late materialization: appends the schema columns 'columns' of the records
+// whose ids are in column 'ridColumn'. Only live rows are fetched, after the
+// filters and joins before it have discarded the rest, and rows are grouped
+// by page so every page is fixed once per batch. Rows whose record has been
+// deleted since its id was read are dropped.
+class FetchOperator : public Operator {
+public:
+    FetchOperator(HeapFile *file, const Schema &schema, int ridColumn, const std::vector<int> &columns)
+        : file_(file), schema_(schema), ridColumn_(ridColumn), columns_(columns) {}
+
+    void execute(Batch &batch) const override;
+    std::string getName() const override { return "Fetch"; }
+
+private:
+    HeapFile *file_;
+    Schema schema_;
+    int ridColumn_;
+    std::vector<int> columns_;
+};
+
+// Collects all rows that reach it or, with a limit, about the first 'limit'
+// rows: once that many have arrived it asks the workers to stop, so the
+// sources stop reading. The output may hold a few more rows than 'limit'.
+// With 'ordered' the output batches are put back in source order (by
+// Batch::sequence); which rows come first then matters, so there must be no
+// limit.
+class CollectSink : public Sink {
+public:
+    explicit CollectSink(size_t limit = SIZE_MAX, bool ordered = false)
+        : limit_(limit), ordered_(ordered), produced_(0), output_(std::make_shared<std::vector<Batch>>()) {}
+
+    void prepare(int numWorkers) override;
+    bool consume(Batch &batch, int workerId) override;
+    void finish() override;
+    std::string getName() const override { return "Collect"; }
+
+    BatchList getOutput() const { return output_; }
+
+private:
+    size_t limit_;
+    bool ordered_;
+    std::atomic<size_t> produced_;
+    std::vector<std::vector<Batch>> perWorker_;
+    BatchList output_;
+};
+
+struct SortKey {
+    int column;
+    bool ascending;
+};
+
+// Sorts all rows that reach it. Workers buffer rows separately; finish()
+// sorts the per-worker runs in parallel and merges them.
+class SortSink : public Sink {
+public:
+    explicit SortSink(const std::vector<SortKey> &keys)
+        : keys_(keys), output_(std::make_shared<std::vector<Batch>>()) {}
+
+    void prepare(int numWorkers) override;
+    bool consume(Batch &batch, int workerId) override;
+    void finish() override;
+    std::string getName() const override { return "Sort"; }
+
+    BatchList getOutput() const { return output_; }
+
+private:
+    std::vector<SortKey> keys_;
+    std::vector<Batch> runs_;
+    BatchList output_;
+};
+
+// Hands batches to a reader on another thread (a ResultCursor) through a
+// queue of at most 'capacity' batches. Workers wait in consume() while the
+// queue is full, so the pipeline runs only as fast as the reader takes rows
+// and no more than the queued batches are buffered. Sources release their
+// page pins before passing a batch on, so a waiting worker holds none.
+class StreamSink : public Sink {
+public:
+    explicit StreamSink(size_t capacity)
+        : capacity_(std::max<size_t>(1, capacity)), finished_(false), closed_(false) {}
+
+    void prepare(int numWorkers) override;
+    bool consume(Batch &batch, int workerId) override;
+    void finish() override;
+    std::string getName() const override { return "Stream"; }
+
+    // Takes the next batch, waiting until one is queued. Returns false once
+    // the pipeline finished and the queue is empty, or after close().
+    bool next(Batch &batch);
+
+    // Drops the queued batches and makes waiting and later consume() calls
+    // return false, so the workers stop. The next prepare() after the run
+    // finished opens the stream again.
+    void close();
+
+    // Ends the stream with 'error' instead of the rows not read yet, for a
+    // query that failed. finish() does the same when the run it ends failed.
+    void fail(const std::string &error);
+    // The error the stream ended with, or empty.
+    std::string getError() const;
+
+private:
+    void failLocked(const std::string &error);
+
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<Batch> queue_;
+    bool finished_;
+    bool closed_;
+    std::string error_;
+};
+
+// ORDER BY ... LIMIT n. Each worker keeps only its best n rows in a bounded
+// max-heap whose top is the worst row kept, so most input rows are rejected
+// with a single comparison; finish() merges the per-worker candidates.
+class TopNSink : public Sink {
+public:
+    TopNSink(const std::vector<SortKey> &keys, size_t limit)
+        : keys_(keys), limit_(limit), output_(std::make_shared<std::vector<Batch>>()) {}
+
+    void prepare(int numWorkers) override;
+    bool consume(Batch &batch, int workerId) override;
+    void finish() override;
+    std::string getName() const override { return "TopN " + std::to_string(limit_); }
+
+    BatchList getOutput() const { return output_; }
+
+private:
+    struct Candidates {
+        Batch rows;                 // Dense; at most limit_ rows.
+        std::vector<uint32_t> heap; // Row indices, worst row first.
+    };
+
+    // True if row 'rowA' of 'a' sorts before row 'rowB' of 'b'.
+    bool less(const Batch &a, uint32_t rowA, const Batch &b, uint32_t rowB) const;
+
+    std::vector<SortKey> keys_;
+    size_t limit_;
+    std::vector<Candidates> candidates_;
+    BatchList output_;
+};
+
+// Build side of a hash join: collects the build rows and, in finish(),
+// chains them into a hash table on 'keyColumn'. It also fills a Bloom filter
+// of the key hashes, which the probe side's scan can use to drop rows that
+// have no match before decoding them.
+class HashJoinBuildSink : public Sink {
+public:
+    explicit HashJoinBuildSink(int keyColumn)
+        : keyColumn_(keyColumn), mask_(0), bloomFilter_(std::make_shared<BloomFilter>()) {}
+
+    void prepare(int numWorkers) override;
+    bool consume(Batch &batch, int workerId) override;
+    void finish() override;
+    std::string getName() const override { return "HashJoinBuild"; }
+
+    const Batch &getRows() const { return rows_; }
+    int getKeyColumn() const { return keyColumn_; }
+
+    // Chain traversal: first row whose key hash lands in the bucket of
+    // 'hash', then the following rows of that bucket; -1 ends a chain.
+    int64_t firstInBucket(uint64_t hash) const { return buckets_.empty() ? -1 : buckets_[hash & mask_]; }
+    int64_t nextInChain(int64_t row) const { return next_[row]; }
+    uint64_t hashAt(int64_t row) const { return hashes_[row]; }
+
+    std::shared_ptr<const BloomFilter> getBloomFilter() const { return bloomFilter_; }
+
+private:
+    int keyColumn_;
+    std::vector<Batch> perWorker_;
+    Batch rows_;
+    QueryStateVector<uint64_t> hashes_;
+    QueryStateVector<int64_t> buckets_;
+    QueryStateVector<int64_t> next_;
+    uint64_t mask_;
+    std::shared_ptr<BloomFilter> bloomFilter_;
+};
+
+// Probe side of an inner hash join. Output columns are the probe columns
+// followed by the build columns.
+class HashJoinProbeOperator : public Operator {
+public:
+    HashJoinProbeOperator(std::shared_ptr<const HashJoinBuildSink> build, int keyColumn)
+        : build_(build), keyColumn_(keyColumn) {}
+
+    void execute(Batch &batch) const override;
+    std::string getName() const override { return "HashJoinProbe"; }
+
+private:
+    std::shared_ptr<const HashJoinBuildSink> build_;
+    int keyColumn_;
+};
+
+// Inner side of a merge join: keeps the rows sorted on 'keyColumn'. Input
+// that arrives in key order from an ordered source (by Batch::sequence) is
+// only concatenated; anything else is sorted in finish().
+class MergeJoinBuildSink : public Sink {
+public:
+    explicit MergeJoinBuildSink(int keyColumn) : keyColumn_(keyColumn) {}
+
+    void prepare(int numWorkers) override;
+    bool consume(Batch &batch, int workerId) override;
+    void finish() override;
+    std::string getName() const override { return "MergeJoinBuild"; }
+
+    const Batch &getRows() const { return rows_; }
+    int getKeyColumn() const { return keyColumn_; }
+
+private:
+    int keyColumn_;
+    std::vector<std::vector<Batch>> perWorker_;
+    Batch rows_;
+};
+
+// Outer side of an inner merge join. Every batch is merged on its own with
+// the sorted inner rows: a binary search finds where its smallest key starts
+// and both sides then advance in step. For a run of equal outer keys the
+// inner cursor is marked at the first matching row and restored there for
+// each further outer row, which handles many-to-many matches. Batches whose
+// keys are not ascending are merged through a sorted permutation, in which
+// case the output is in key order instead of input order. Output columns
+// are the outer columns followed by the inner columns.
+class MergeJoinOperator : public Operator {
+public:
+    MergeJoinOperator(std::shared_ptr<const MergeJoinBuildSink> inner, int keyColumn)
+        : inner_(inner), keyColumn_(keyColumn) {}
+
+    void execute(Batch &batch) const override;
+    std::string getName() const override { return "MergeJoin"; }
+
+private:
+    std::shared_ptr<const MergeJoinBuildSink> inner_;
+    int keyColumn_;
+};
+
+struct AggregateSpec {
+    AggregateFunction function;
+    int inputColumn;  // -1 for COUNT(*).
+    TypeId inputType;
+};
+
+// GROUP BY on one integral column (or, with keyColumn -1, a single global
+// group), backed by PartitionedHashAggregator. Output columns are the key
+// followed by one column per aggregate.
+class HashAggregateSink : public Sink {
+public:
+    HashAggregateSink(int keyColumn, TypeId keyType, const std::vector<AggregateSpec> &aggregates,
+                      const AggregateOptions &options);
+
+    void prepare(int numWorkers) override;
+    bool consume(Batch &batch, int workerId) override;
+    void finish() override;
+    std::string getName() const override { return "HashAggregate"; }
+
+    BatchList getOutput() const { return output_; }
+
+    // Type of the output column of an aggregate.
+    static TypeId resultType(const AggregateSpec &spec);
+
+private:
+    int keyColumn_;
+    TypeId keyType_;
+    std::vector<AggregateSpec> aggregates_;
+    AggregateOptions options_;
+    std::unique_ptr<PartitionedHashAggregator> aggregator_;
+    BatchList output_;
+};
+
+// Helpers shared by operators that hash or compare values of any type.
+uint64_t hashValueAt(const ColumnVector &column, size_t row);
+int compareValuesAt(const ColumnVector &a, size_t rowA, const ColumnVector &b, size_t rowB);
+int64_t integerValueAt(const ColumnVector &column, size_t row);
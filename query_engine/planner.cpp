@@ -0,0 +1,1361 @@
+#include "planner.h"
+#include <algorithm>
+
+namespace {
+
+// A column visible to expressions at some point of a plan.
+struct ScopeColumn {
+    std::string table; // Alias of the table it comes from; empty for derived columns.
+    std::string name;  // Empty if the column cannot be referenced by name.
+    std::string text;  // Expression text of derived columns (group keys, aggregates).
+    TypeId type;
+};
+
+typedef std::vector<ScopeColumn> Scope;
+
+const int kUnknownColumn = -1;
+const int kAmbiguousColumn = -2;
+
+int findColumn(const Scope &scope, const std::string &table, const std::string &name) {
+    int found = kUnknownColumn;
+    for (size_t i = 0; i < scope.size(); ++i) {
+        if (scope[i].name != name || (!table.empty() && scope[i].table != table))
+            continue;
+        if (found != kUnknownColumn)
+            return kAmbiguousColumn;
+        found = static_cast<int>(i);
+    }
+    return found;
+}
+
+void collectColumns(const AstExpr *e, std::vector<const AstExpr *> &out) {
+    if (e == nullptr)
+        return;
+    if (e->kind == AstKind::COLUMN)
+        out.push_back(e);
+    collectColumns(e->lhs.get(), out);
+    collectColumns(e->rhs.get(), out);
+}
+
+void collectAggregates(const AstExpr *e, std::vector<const AstExpr *> &out) {
+    if (e == nullptr)
+        return;
+    if (e->kind == AstKind::AGGREGATE) {
+        for (const AstExpr *seen : out)
+            if (seen->toString() == e->toString())
+                return;
+        out.push_back(e);
+        return;
+    }
+    collectAggregates(e->lhs.get(), out);
+    collectAggregates(e->rhs.get(), out);
+}
+
+void splitConjuncts(const AstExpr *e, std::vector<const AstExpr *> &out) {
+    if (e == nullptr)
+        return;
+    if (e->kind == AstKind::BINARY && e->op == BinaryOp::AND) {
+        splitConjuncts(e->lhs.get(), out);
+        splitConjuncts(e->rhs.get(), out);
+        return;
+    }
+    out.push_back(e);
+}
+
+bool isIntegral(TypeId type) {
+    return type == TypeId::INTEGER || type == TypeId::BIGINT || type == TypeId::DATE ||
+           type == TypeId::BOOLEAN;
+}
+
+Value defaultValue(TypeId type) {
+    switch (type) {
+    case TypeId::INTEGER: return Value::makeInteger(0);
+    case TypeId::BIGINT:  return Value::makeBigint(0);
+    case TypeId::DOUBLE:  return Value::makeDouble(0);
+    case TypeId::DATE:    return Value::makeDate(0);
+    case TypeId::BOOLEAN: return Value::makeBoolean(false);
+    case TypeId::VARCHAR: return Value::makeVarchar("");
+    }
+    return Value::makeBigint(0);
+}
+
+// Turns AST expressions into executable expressions over a scope.
+class Binder {
+public:
+    explicit Binder(std::shared_ptr<ParameterValues> parameters) : parameters_(parameters) {}
+
+    // 'hint' is the type the context expects, if known. Placeholders take it
+    // as their type and string literals compared with dates become dates.
+    std::unique_ptr<Expression> bind(const AstExpr &ast, const Scope &scope, const TypeId *hint,
+                                     std::string &error) const;
+
+    // Binds and converts the result to 'type'.
+    std::unique_ptr<Expression> bindAs(const AstExpr &ast, const Scope &scope, TypeId type,
+                                       std::string &error) const;
+
+    // ANDs the bound conjuncts together; returns nullptr for an empty list.
+    std::unique_ptr<Expression> bindConjunction(const std::vector<const AstExpr *> &conjuncts,
+                                                const Scope &scope, std::string &error) const;
+
+private:
+    std::shared_ptr<ParameterValues> parameters_;
+};
+
+std::unique_ptr<Expression> Binder::bind(const AstExpr &ast, const Scope &scope, const TypeId *hint,
+                                         std::string &error) const {
+    if (ast.kind != AstKind::COLUMN) {
+        // Group keys and aggregates computed by an earlier pipeline.
+        std::string text = ast.toString();
+        for (size_t i = 0; i < scope.size(); ++i)
+            if (!scope[i].text.empty() && scope[i].text == text)
+                return Expression::makeColumn(static_cast<int>(i), scope[i].type);
+    }
+
+    switch (ast.kind) {
+    case AstKind::COLUMN: {
+        int index = findColumn(scope, ast.table, ast.name);
+        if (index == kUnknownColumn) {
+            error = "unknown column " + ast.toString();
+            return nullptr;
+        }
+        if (index == kAmbiguousColumn) {
+            error = "ambiguous column " + ast.toString();
+            return nullptr;
+        }
+        return Expression::makeColumn(index, scope[index].type);
+    }
+    case AstKind::LITERAL:
+        if (hint != nullptr && *hint == TypeId::DATE && ast.literal.type == TypeId::VARCHAR) {
+            int32_t days;
+            if (!parseDate(ast.literal.text, days)) {
+                error = "invalid date '" + ast.literal.text + "'";
+                return nullptr;
+            }
+            return Expression::makeConstant(Value::makeDate(days));
+        }
+        return Expression::makeConstant(ast.literal);
+    case AstKind::PARAMETER:
+        parameters_->types[ast.parameterIndex] = hint != nullptr ? *hint : TypeId::BIGINT;
+        return Expression::makeParameter(parameters_, ast.parameterIndex);
+    case AstKind::AGGREGATE:
+        error = "aggregate " + ast.toString() + " is not allowed here";
+        return nullptr;
+    case AstKind::STAR:
+        error = "* is not allowed here";
+        return nullptr;
+    case AstKind::BINARY:
+        break;
+    }
+
+    bool logical = ast.op == BinaryOp::AND || ast.op == BinaryOp::OR;
+    bool arithmetic = ast.op == BinaryOp::ADD || ast.op == BinaryOp::SUB ||
+                      ast.op == BinaryOp::MUL || ast.op == BinaryOp::DIV;
+    const TypeId *childHint = arithmetic ? hint : nullptr;
+    auto untyped = [](const AstExpr &e) {
+        return e.kind == AstKind::PARAMETER ||
+               (e.kind == AstKind::LITERAL && e.literal.type == TypeId::VARCHAR);
+    };
+
+    std::unique_ptr<Expression> lhs, rhs;
+    if (logical) {
+        lhs = bind(*ast.lhs, scope, nullptr, error);
+        rhs = lhs ? bind(*ast.rhs, scope, nullptr, error) : nullptr;
+    } else if (untyped(*ast.lhs) && !untyped(*ast.rhs)) {
+        // Type the placeholder or literal from the other operand.
+        rhs = bind(*ast.rhs, scope, childHint, error);
+        if (rhs) {
+            TypeId type = rhs->getType();
+            lhs = bind(*ast.lhs, scope, &type, error);
+        }
+    } else {
+        lhs = bind(*ast.lhs, scope, childHint, error);
+        if (lhs) {
+            TypeId type = lhs->getType();
+            rhs = bind(*ast.rhs, scope, &type, error);
+        }
+    }
+    if (!lhs || !rhs)
+        return nullptr;
+    TypeId common;
+    if (!logical && commonType(lhs->getType(), rhs->getType(), common)) {
+        // A placeholder takes the widest type of its operation and context,
+        // as a literal would, rather than being cast to it.
+        TypeId widened;
+        if (arithmetic && hint != nullptr && isNumeric(*hint) && commonType(common, *hint, widened))
+            common = widened;
+        if (ast.lhs->kind == AstKind::PARAMETER && lhs->getType() != common)
+            lhs = bind(*ast.lhs, scope, &common, error);
+        if (ast.rhs->kind == AstKind::PARAMETER && rhs->getType() != common)
+            rhs = bind(*ast.rhs, scope, &common, error);
+    }
+    std::unique_ptr<Expression> result = Expression::makeBinary(ast.op, std::move(lhs), std::move(rhs));
+    if (!result)
+        error = "type mismatch in " + ast.toString();
+    return result;
+}
+
+std::unique_ptr<Expression> Binder::bindAs(const AstExpr &ast, const Scope &scope, TypeId type,
+                                           std::string &error) const {
+    std::unique_ptr<Expression> result = bind(ast, scope, &type, error);
+    if (!result || result->getType() == type)
+        return result;
+    TypeId from = result->getType();
+    result = Expression::makeCast(std::move(result), type);
+    if (!result)
+        error = std::string("cannot convert ") + typeName(from) + " to " + typeName(type);
+    return result;
+}
+
+std::unique_ptr<Expression> Binder::bindConjunction(const std::vector<const AstExpr *> &conjuncts,
+                                                    const Scope &scope, std::string &error) const {
+    std::unique_ptr<Expression> result;
+    for (const AstExpr *conjunct : conjuncts) {
+        TypeId boolean = TypeId::BOOLEAN;
+        std::unique_ptr<Expression> e = bind(*conjunct, scope, &boolean, error);
+        if (!e)
+            return nullptr;
+        if (e->getType() != TypeId::BOOLEAN) {
+            error = "condition " + conjunct->toString() + " is not BOOLEAN";
+            return nullptr;
+        }
+        result = result ? Expression::makeBinary(BinaryOp::AND, std::move(result), std::move(e))
+                        : std::move(e);
+    }
+    return result;
+}
+
+// A conjunct of the form 'column op value', where 'value' is a literal or
+// placeholder, normalized so that the column is on the left.
+struct ColumnComparison {
+    const AstExpr *conjunct;
+    int column; // Position in the scope it was matched against.
+    CompareOp op;
+    const AstExpr *value;
+};
+
+bool matchComparison(const AstExpr *e, const Scope &scope, ColumnComparison &out) {
+    if (e->kind != AstKind::BINARY)
+        return false;
+    CompareOp op;
+    switch (e->op) {
+    case BinaryOp::EQ: op = CompareOp::EQ; break;
+    case BinaryOp::NE: op = CompareOp::NE; break;
+    case BinaryOp::LT: op = CompareOp::LT; break;
+    case BinaryOp::LE: op = CompareOp::LE; break;
+    case BinaryOp::GT: op = CompareOp::GT; break;
+    case BinaryOp::GE: op = CompareOp::GE; break;
+    default:           return false;
+    }
+    const AstExpr *column = e->lhs.get(), *value = e->rhs.get();
+    if (column->kind != AstKind::COLUMN) {
+        std::swap(column, value);
+        op = mirrorCompareOp(op);
+    }
+    if (column->kind != AstKind::COLUMN || (value->kind != AstKind::LITERAL && value->kind != AstKind::PARAMETER))
+        return false;
+    int index = findColumn(scope, column->table, column->name);
+    if (index < 0)
+        return false;
+    out = ColumnComparison{e, index, op, value};
+    return true;
+}
+
+// Literal of a comparison as the column's type would see it; false for
+// placeholders and for literals the binder would reject.
+bool comparisonValue(const ColumnComparison &comparison, TypeId columnType, Value &value) {
+    if (comparison.value->kind != AstKind::LITERAL)
+        return false;
+    value = comparison.value->literal;
+    if (columnType == TypeId::DATE && value.type == TypeId::VARCHAR) {
+        int32_t days;
+        if (!parseDate(value.text, days))
+            return false;
+        value = Value::makeDate(days);
+    }
+    return true;
+}
+
+// Estimated fraction of the rows of a table (whose columns 'scope' lists
+// in schema order) that satisfy 'conjunct'.
+double conjunctSelectivity(const AstExpr *conjunct, const Scope &scope, const TableStatistics *stats) {
+    ColumnComparison comparison;
+    if (!matchComparison(conjunct, scope, comparison))
+        return kDefaultRangeSelectivity;
+    Value value;
+    bool known = comparisonValue(comparison, scope[comparison.column].type, value);
+    if (stats != nullptr)
+        return stats->selectivity(comparison.column, comparison.op, known ? &value : nullptr);
+    switch (comparison.op) {
+    case CompareOp::EQ: return kDefaultEqualitySelectivity;
+    case CompareOp::NE: return 1 - kDefaultEqualitySelectivity;
+    default:            return kDefaultRangeSelectivity;
+    }
+}
+
+// Tables without statistics are assumed to be this dense.
+const double kDefaultRowsPerPage = 50;
+
+// How a table is read, and what that is expected to cost and produce.
+struct AccessPath {
+    const IndexInfo *index = nullptr;    // Null for a full scan.
+    bool bitmap = false;                 // Fetch the heap in page order.
+    std::vector<ColumnComparison> bounds; // Conjuncts the index range enforces.
+    std::shared_ptr<const TableStatistics> stats;
+    double pages = 1;
+    double rows = 1;         // All rows.
+    double filteredRows = 1; // Rows left after all single-table conjuncts.
+    double cost = 0;
+    double orderedCost = 0;  // Plain index scan of the same range, in key order.
+};
+
+Scope tableScope(const TableInfo &table, const std::string &alias) {
+    Scope scope;
+    for (const Column &column : table.schema.getColumns())
+        scope.push_back(ScopeColumn{alias, column.name, "", column.type});
+    return scope;
+}
+
+// Picks a full scan, an index range scan or a bitmap heap scan of 'table'
+// for its single-table 'conjuncts', whichever the cost model finds cheaper.
+// With statistics the choice is cost-based; without them an index is used
+// only for an equality, with a plain index scan.
+// Conjuncts the chosen index range enforces exactly are removed from
+// 'conjuncts', so no filter evaluates them again.
+AccessPath chooseAccessPath(const TableInfo &table, const std::string &alias,
+                            std::vector<const AstExpr *> &conjuncts, const CostModel &cost) {
+    AccessPath path;
+    Scope scope = tableScope(table, alias);
+    path.stats = table.getStatistics();
+    path.pages = std::max(1, table.heap->getNumberOfPages());
+    double rowsPerPage = path.stats ? path.stats->rowsPerPage() : kDefaultRowsPerPage;
+    path.rows = std::max(1.0, rowsPerPage * path.pages);
+    double selectivity = 1;
+    for (const AstExpr *conjunct : conjuncts)
+        selectivity *= conjunctSelectivity(conjunct, scope, path.stats.get());
+    path.filteredRows = std::max(1.0, path.rows * selectivity);
+    path.cost = cost.scanCost(path.pages, path.rows, conjuncts.size());
+
+    for (const auto &index : table.indexes) {
+        std::vector<ColumnComparison> bounds;
+        double matched = 1;
+        bool equality = false;
+        for (const AstExpr *conjunct : conjuncts) {
+            ColumnComparison comparison;
+            if (!matchComparison(conjunct, scope, comparison) || comparison.column != index->column ||
+                comparison.op == CompareOp::NE)
+                continue;
+            // Integral values only, so that the range is exact.
+            Value value;
+            if (comparison.value->kind == AstKind::LITERAL &&
+                (!comparisonValue(comparison, scope[comparison.column].type, value) ||
+                 value.type == TypeId::DOUBLE || value.type == TypeId::VARCHAR || value.type == TypeId::BOOLEAN))
+                continue;
+            bounds.push_back(comparison);
+            matched *= conjunctSelectivity(conjunct, scope, path.stats.get());
+            equality |= comparison.op == CompareOp::EQ;
+        }
+        if (bounds.empty())
+            continue;
+        int height = index->tree->getHeight();
+        size_t predicates = conjuncts.size() - bounds.size();
+        double indexCost = cost.indexScanCost(height, path.pages, path.rows, path.rows * matched, predicates);
+        double bitmapCost = cost.bitmapScanCost(height, path.pages, path.rows, path.rows * matched, predicates);
+        double best = std::min(indexCost, bitmapCost);
+        bool better = path.stats ? best < path.cost : equality && path.index == nullptr;
+        if (better) {
+            path.index = index.get();
+            path.bounds = bounds;
+            path.cost = path.stats ? best : indexCost;
+            path.orderedCost = indexCost;
+            path.bitmap = path.stats && bitmapCost < indexCost;
+        }
+    }
+
+    for (const ColumnComparison &bound : path.bounds)
+        conjuncts.erase(std::find(conjuncts.begin(), conjuncts.end(), bound.conjunct));
+    return path;
+}
+
+// Source for 'path' that decodes 'columns' of 'table'. Returns nullptr and
+// sets 'error' if an index bound cannot be bound.
+std::shared_ptr<Source> makeSource(const AccessPath &path, const TableInfo &table, const std::vector<int> &columns,
+                                   bool withRecordIds, const Binder &binder, std::string &error) {
+    if (path.index == nullptr)
+        return std::make_shared<TableScanSource>(table.heap.get(), table.schema, columns, withRecordIds);
+    std::vector<IndexBound> lower, upper;
+    TypeId type = table.schema.getColumn(path.index->column).type;
+    for (const ColumnComparison &bound : path.bounds) {
+        std::unique_ptr<Expression> value = binder.bind(*bound.value, Scope(), &type, error);
+        if (!value)
+            return nullptr;
+        bool inclusive = bound.op == CompareOp::EQ || bound.op == CompareOp::LE || bound.op == CompareOp::GE;
+        if (bound.op == CompareOp::EQ)
+            lower.push_back(IndexBound{value->clone(), true});
+        if (bound.op == CompareOp::GT || bound.op == CompareOp::GE)
+            lower.push_back(IndexBound{std::move(value), inclusive});
+        else
+            upper.push_back(IndexBound{std::move(value), inclusive});
+    }
+    if (path.bitmap)
+        return std::make_shared<BitmapHeapScanSource>(path.index->tree.get(), path.index->name, table.heap.get(),
+                                                      table.schema, columns, withRecordIds, std::move(lower),
+                                                      std::move(upper));
+    return std::make_shared<IndexScanSource>(path.index->tree.get(), path.index->name, table.heap.get(),
+                                             table.schema, columns, withRecordIds, std::move(lower),
+                                             std::move(upper));
+}
+
+// An equality between columns of two tables, usable as a hash join key.
+struct JoinEdge {
+    int a, b; // Positions in the scope of all tables.
+    const AstExpr *conjunct;
+};
+
+// True if 'edge' links table 't' to one of the tables in 'before'.
+bool joinsTable(const JoinEdge &edge, const std::vector<int> &owner, uint64_t before, int t) {
+    uint64_t a = uint64_t(1) << owner[edge.a], b = uint64_t(1) << owner[edge.b];
+    uint64_t bit = uint64_t(1) << t;
+    return (a == bit && (before & b)) || (b == bit && (before & a));
+}
+
+// Estimated distinct values of the column at position 'column' in the scope
+// of all tables, after that table's filters, which can leave fewer distinct
+// values than rows. Needs statistics.
+double distinctValues(const std::vector<AccessPath> &paths, const std::vector<int> &owner,
+                      const std::vector<int> &ownerColumn, int column) {
+    const AccessPath &path = paths[owner[column]];
+    return std::max(1.0, std::min(path.stats->columns[ownerColumn[column]].distinctCount, path.filteredRows));
+}
+
+// Exhaustive join ordering is exponential in the number of tables.
+const size_t kMaxReorderedTables = 10;
+
+// Cheapest left-deep join order according to the cost model, by dynamic
+// programming over sets of tables. Every table after the first must be
+// linked to an earlier one by an edge. 'owner' and 'ownerColumn' map
+// positions in the scope of all tables to table and column. Returns an
+// empty order if the tables cannot all be joined that way.
+std::vector<int> chooseJoinOrder(const std::vector<AccessPath> &paths, const std::vector<JoinEdge> &edges,
+                                 const std::vector<int> &owner, const std::vector<int> &ownerColumn,
+                                 const CostModel &cost) {
+    // A key equality keeps 1 / max(distinct values of either side) of the
+    // cross product.
+    auto distinct = [&](int column) { return distinctValues(paths, owner, ownerColumn, column); };
+    std::vector<double> edgeSelectivity;
+    for (const JoinEdge &edge : edges)
+        edgeSelectivity.push_back(1 / std::max(distinct(edge.a), distinct(edge.b)));
+
+    struct Plan {
+        double cost = -1; // Negative: no plan for this set yet.
+        double rows = 0;
+        int last = -1;    // Table joined last.
+    };
+    size_t n = paths.size();
+    std::vector<Plan> best(size_t(1) << n);
+    for (size_t t = 0; t < n; ++t)
+        best[size_t(1) << t] = Plan{paths[t].cost, paths[t].filteredRows, static_cast<int>(t)};
+    for (uint64_t set = 1; set < best.size(); ++set) {
+        if (best[set].cost < 0)
+            continue;
+        for (size_t t = 0; t < n; ++t) {
+            if (set & (uint64_t(1) << t))
+                continue;
+            double selectivity = 1;
+            bool linked = false;
+            for (size_t e = 0; e < edges.size(); ++e) {
+                if (joinsTable(edges[e], owner, set, static_cast<int>(t))) {
+                    linked = true;
+                    selectivity *= edgeSelectivity[e];
+                }
+            }
+            if (!linked)
+                continue;
+            const AccessPath &path = paths[t];
+            double rows = std::max(1.0, best[set].rows * path.filteredRows * selectivity);
+            double total = best[set].cost + path.cost + cost.hashJoinCost(path.filteredRows, best[set].rows, rows);
+            Plan &next = best[set | (uint64_t(1) << t)];
+            if (next.cost < 0 || total < next.cost)
+                next = Plan{total, rows, static_cast<int>(t)};
+        }
+    }
+
+    std::vector<int> order;
+    uint64_t set = best.size() - 1;
+    if (best[set].cost < 0)
+        return order;
+    for (; set != 0; set &= ~(uint64_t(1) << best[set].last))
+        order.insert(order.begin(), best[set].last);
+    return order;
+}
+
+} // namespace
+
+std::unique_ptr<QueryPlan> Planner::plan(const Statement &statement, std::string &error) const {
+    std::unique_ptr<QueryPlan> plan(new QueryPlan());
+    plan->kind = statement.kind;
+    plan->explain = statement.explain;
+    plan->parameters = std::make_shared<ParameterValues>();
+    plan->parameters->types.assign(statement.numParameters, TypeId::BIGINT);
+
+    bool ok = false;
+    switch (statement.kind) {
+    case StatementKind::SELECT:
+        ok = planSelect(*statement.select, *plan, error);
+        break;
+    case StatementKind::INSERT:
+        ok = planInsert(*statement.insert, *plan, error);
+        break;
+    case StatementKind::UPDATE:
+        ok = planUpdate(*statement.update, *plan, error);
+        break;
+    case StatementKind::DELETE:
+        ok = planDelete(*statement.remove, *plan, error);
+        break;
+    case StatementKind::CREATE_TABLE:
+        plan->tableName = statement.createTable->table;
+        plan->schema = Schema(statement.createTable->columns);
+        ok = true;
+        break;
+    case StatementKind::CREATE_INDEX: {
+        const CreateIndexStatement &create = *statement.createIndex;
+        plan->table = catalog_->getTable(create.table);
+        plan->tableName = create.table;
+        plan->indexName = create.index;
+        if (plan->table == nullptr) {
+            error = "unknown table " + create.table;
+            break;
+        }
+        if (plan->table->view) {
+            error = "cannot index materialized view " + create.table;
+            break;
+        }
+        plan->indexColumn = plan->table->schema.findColumn(create.column);
+        if (plan->indexColumn < 0) {
+            error = "unknown column " + create.column;
+            break;
+        }
+        ok = true;
+        break;
+    }
+    case StatementKind::CREATE_VIEW:
+        ok = planCreateView(*statement.createView, *plan, error);
+        break;
+    case StatementKind::ANALYZE:
+        plan->tableName = statement.analyze->table;
+        if (!plan->tableName.empty()) {
+            plan->table = catalog_->getTable(plan->tableName);
+            if (plan->table == nullptr) {
+                error = "unknown table " + plan->tableName;
+                break;
+            }
+        }
+        ok = true;
+        break;
+    }
+    return ok ? std::move(plan) : nullptr;
+}
+
+bool Planner::planSelect(const SelectStatement &select, QueryPlan &plan, std::string &error) const {
+    Binder binder(plan.parameters);
+
+    // Tables in join order: the FROM table first.
+    std::vector<const TableRef *> refs(1, &select.from);
+    for (const auto &join : select.joins)
+        refs.push_back(&join.table);
+    if (refs.size() > 64) {
+        error = "too many tables";
+        return false;
+    }
+    std::vector<TableInfo *> tables;
+    for (const TableRef *ref : refs) {
+        TableInfo *table = catalog_->getTable(ref->name);
+        if (table == nullptr) {
+            error = "unknown table " + ref->name;
+            return false;
+        }
+        for (size_t i = 0; i < tables.size(); ++i) {
+            if (refs[i]->alias == ref->alias) {
+                error = "duplicate table name " + ref->alias;
+                return false;
+            }
+        }
+        tables.push_back(table);
+    }
+
+    // Every column of every table, to find out which ones a query touches.
+    Scope all;
+    std::vector<int> owner, ownerColumn;
+    for (size_t t = 0; t < tables.size(); ++t) {
+        const auto &columns = tables[t]->schema.getColumns();
+        for (size_t c = 0; c < columns.size(); ++c) {
+            all.push_back(ScopeColumn{refs[t]->alias, columns[c].name, "", columns[c].type});
+            owner.push_back(static_cast<int>(t));
+            ownerColumn.push_back(static_cast<int>(c));
+        }
+    }
+    auto tablesOf = [&](const AstExpr *e) {
+        std::vector<const AstExpr *> columns;
+        collectColumns(e, columns);
+        uint64_t mask = 0;
+        for (const AstExpr *column : columns) {
+            int index = findColumn(all, column->table, column->name);
+            if (index >= 0)
+                mask |= uint64_t(1) << owner[index];
+        }
+        return mask;
+    };
+
+    // Decode only referenced columns. Unresolvable names (e.g. ORDER BY on a
+    // select alias) are skipped here and reported when binding.
+    std::vector<std::vector<bool>> used(tables.size());
+    for (size_t t = 0; t < tables.size(); ++t)
+        used[t].assign(tables[t]->schema.size(), false);
+    std::vector<const AstExpr *> columnRefs;
+    bool star = false;
+    for (const auto &item : select.items) {
+        star |= item.expr->kind == AstKind::STAR;
+        collectColumns(item.expr.get(), columnRefs);
+    }
+    for (const auto &join : select.joins)
+        collectColumns(join.condition.get(), columnRefs);
+    collectColumns(select.where.get(), columnRefs);
+    for (const auto &group : select.groupBy)
+        collectColumns(group.get(), columnRefs);
+    for (const auto &order : select.orderBy)
+        collectColumns(order.expr.get(), columnRefs);
+    auto mark = [&](const std::vector<const AstExpr *> &refs, std::vector<std::vector<bool>> &flags) {
+        for (const AstExpr *column : refs) {
+            // Ambiguous names mark every candidate, so binding reports them.
+            for (size_t i = 0; i < all.size(); ++i) {
+                if (all[i].name == column->name && (column->table.empty() || all[i].table == column->table))
+                    flags[owner[i]][ownerColumn[i]] = true;
+            }
+        }
+    };
+    mark(columnRefs, used);
+    if (star) {
+        for (auto &columns : used)
+            columns.assign(columns.size(), true);
+    }
+
+    // Distribute the WHERE and ON conjuncts. All joins are inner joins, so
+    // the two are interchangeable: single-table conjuncts are pushed into
+    // that table's scan, equalities between columns of two tables are
+    // candidate hash join keys, and the rest is evaluated after the joins.
+    std::vector<std::vector<const AstExpr *>> pushed(tables.size());
+    std::vector<JoinEdge> edges;
+    std::vector<const AstExpr *> residual;
+    auto distribute = [&](const AstExpr *conjunct) {
+        uint64_t mask = tablesOf(conjunct);
+        if (mask == 0) {
+            pushed[0].push_back(conjunct);
+            return;
+        }
+        if ((mask & (mask - 1)) == 0) {
+            int t = 0;
+            while (!(mask & (uint64_t(1) << t)))
+                ++t;
+            pushed[t].push_back(conjunct);
+            return;
+        }
+        if (conjunct->kind == AstKind::BINARY && conjunct->op == BinaryOp::EQ &&
+            conjunct->lhs->kind == AstKind::COLUMN && conjunct->rhs->kind == AstKind::COLUMN) {
+            int a = findColumn(all, conjunct->lhs->table, conjunct->lhs->name);
+            int b = findColumn(all, conjunct->rhs->table, conjunct->rhs->name);
+            TypeId ta = a >= 0 ? all[a].type : TypeId::VARCHAR, tb = b >= 0 ? all[b].type : TypeId::INTEGER;
+            bool compatible = (ta == TypeId::VARCHAR) == (tb == TypeId::VARCHAR) &&
+                              (ta == TypeId::DOUBLE) == (tb == TypeId::DOUBLE);
+            if (a >= 0 && b >= 0 && owner[a] != owner[b] && compatible) {
+                edges.push_back(JoinEdge{a, b, conjunct});
+                return;
+            }
+        }
+        residual.push_back(conjunct);
+    };
+    std::vector<const AstExpr *> whereConjuncts;
+    splitConjuncts(select.where.get(), whereConjuncts);
+    for (const AstExpr *conjunct : whereConjuncts) {
+        std::vector<const AstExpr *> aggregates;
+        collectAggregates(conjunct, aggregates);
+        if (!aggregates.empty()) {
+            error = "aggregates are not allowed in WHERE";
+            return false;
+        }
+        distribute(conjunct);
+    }
+    for (const auto &join : select.joins) {
+        std::vector<const AstExpr *> conjuncts;
+        splitConjuncts(join.condition.get(), conjuncts);
+        for (const AstExpr *conjunct : conjuncts)
+            distribute(conjunct);
+    }
+
+    // Access path of every table: full scan or index range scan.
+    std::vector<AccessPath> paths;
+    for (size_t t = 0; t < tables.size(); ++t)
+        paths.push_back(chooseAccessPath(*tables[t], refs[t]->alias, pushed[t], cost_));
+
+    // Join order: the first table is the probe side of the pipeline that
+    // ends in the final sink, every later one the build side of a hash join
+    // whose key is an equality with a table before it.
+    std::vector<int> order;
+    bool analyzed = true;
+    for (const AccessPath &path : paths)
+        analyzed = analyzed && path.stats != nullptr;
+    if (tables.size() > 1 && analyzed && tables.size() <= kMaxReorderedTables)
+        order = chooseJoinOrder(paths, edges, owner, ownerColumn, cost_);
+    if (order.empty()) {
+        // Syntactic order: FROM table first, then the JOINs as written.
+        for (size_t t = 0; t < tables.size(); ++t)
+            order.push_back(static_cast<int>(t));
+    }
+    std::vector<bool> isKey(edges.size(), false);
+    std::vector<int> buildKeys(tables.size(), -1), probeKeys(tables.size(), -1);
+    uint64_t joined = uint64_t(1) << order[0];
+    for (size_t k = 1; k < order.size(); ++k) {
+        int t = order[k];
+        for (size_t e = 0; e < edges.size() && buildKeys[t] < 0; ++e) {
+            if (!joinsTable(edges[e], owner, joined, t))
+                continue;
+            isKey[e] = true;
+            buildKeys[t] = owner[edges[e].a] == t ? edges[e].a : edges[e].b;
+            probeKeys[t] = owner[edges[e].a] == t ? edges[e].b : edges[e].a;
+        }
+        if (buildKeys[t] < 0) {
+            error = "JOIN " + refs[t]->alias + " needs an equality between columns of both sides";
+            return false;
+        }
+        joined |= uint64_t(1) << t;
+    }
+    for (size_t e = 0; e < edges.size(); ++e)
+        if (!isKey[e])
+            residual.push_back(edges[e].conjunct);
+
+    // Late materialization: scans decode only the columns that filters and
+    // join keys read, plus the record id. The other columns are fetched for
+    // the surviving rows once all filters and joins have run. This only pays
+    // off when something can discard rows before the fetch.
+    std::vector<std::vector<bool>> early(tables.size());
+    for (size_t t = 0; t < tables.size(); ++t) {
+        early[t].assign(tables[t]->schema.size(), false);
+        std::vector<const AstExpr *> refs;
+        for (const AstExpr *conjunct : pushed[t])
+            collectColumns(conjunct, refs);
+        mark(refs, early);
+    }
+    std::vector<const AstExpr *> residualRefs;
+    for (const AstExpr *conjunct : residual)
+        collectColumns(conjunct, residualRefs);
+    mark(residualRefs, early);
+    for (size_t k = 1; k < order.size(); ++k) {
+        int t = order[k];
+        early[owner[buildKeys[t]]][ownerColumn[buildKeys[t]]] = true;
+        early[owner[probeKeys[t]]][ownerColumn[probeKeys[t]]] = true;
+    }
+
+    std::vector<Scope> local(tables.size());
+    std::vector<std::vector<int>> scanColumns(tables.size()), lateColumns(tables.size());
+    std::vector<bool> late(tables.size(), false);
+    for (size_t t = 0; t < tables.size(); ++t) {
+        bool discards = !pushed[t].empty() || tables.size() > 1;
+        for (size_t c = 0; c < used[t].size() && discards; ++c)
+            late[t] = late[t] || (used[t][c] && !early[t][c]);
+        if (late[t])
+            local[t].push_back(ScopeColumn{refs[t]->alias, "", "", TypeId::BIGINT});
+    }
+    for (size_t i = 0; i < all.size(); ++i) {
+        int t = owner[i];
+        if (!used[t][ownerColumn[i]])
+            continue;
+        if (late[t] && !early[t][ownerColumn[i]]) {
+            lateColumns[t].push_back(ownerColumn[i]);
+            continue;
+        }
+        local[t].push_back(all[i]);
+        scanColumns[t].push_back(ownerColumn[i]);
+    }
+
+    // Translate key positions in 'all' to positions in the local scopes.
+    auto localIndex = [&](int index) {
+        return findColumn(local[owner[index]], all[index].table, all[index].name);
+    };
+
+    std::vector<std::shared_ptr<Source>> scans(tables.size());
+    auto makeScan = [&](size_t t, Pipeline &pipeline) {
+        scans[t] = makeSource(paths[t], *tables[t], scanColumns[t], late[t], binder, error);
+        if (!scans[t])
+            return false;
+        pipeline.source = scans[t];
+        std::unique_ptr<Expression> filter = binder.bindConjunction(pushed[t], local[t], error);
+        if (!pushed[t].empty() && !filter)
+            return false;
+        if (filter)
+            pipeline.operators.push_back(std::make_shared<FilterOperator>(std::move(filter)));
+        return true;
+    };
+
+    // A plain index scan delivers its table in the order of the indexed
+    // column, and the probe pipeline keeps the order of its first table.
+    // Where both sides of a join arrive sorted on the join key, a merge join
+    // replaces the hash table, and an ascending ORDER BY on the first
+    // table's key needs no sort. A bitmap heap scan loses that order; it is
+    // given up for a plain index scan when the hash tables and sort spared
+    // are worth more than the extra page reads.
+    auto orderable = [&](int index) {
+        const AccessPath &path = paths[owner[index]];
+        return path.index != nullptr && path.index->column == ownerColumn[index];
+    };
+    auto reorderCost = [&](int t) { return paths[t].bitmap ? paths[t].orderedCost - paths[t].cost : 0.0; };
+    std::vector<const AstExpr *> aggregates;
+    for (const auto &item : select.items)
+        collectAggregates(item.expr.get(), aggregates);
+    for (const auto &order : select.orderBy)
+        collectAggregates(order.expr.get(), aggregates);
+    int orderColumn = -1;
+    if (select.orderBy.size() == 1 && select.orderBy[0].ascending && aggregates.empty() && select.groupBy.empty()) {
+        // Positions and aliases name a select item.
+        const AstExpr *e = select.orderBy[0].expr.get();
+        if (e->kind == AstKind::LITERAL && isIntegral(e->literal.type) && e->literal.type != TypeId::BOOLEAN) {
+            size_t position = static_cast<size_t>(e->literal.integer - 1);
+            e = position < select.items.size() && !star ? select.items[position].expr.get() : nullptr;
+        } else if (e->kind == AstKind::COLUMN && e->table.empty()) {
+            for (const auto &item : select.items)
+                if (item.alias == e->name)
+                    e = item.expr.get();
+        }
+        orderColumn = e && e->kind == AstKind::COLUMN ? findColumn(all, e->table, e->name) : -1;
+        if (orderColumn >= 0 && (owner[orderColumn] != order[0] || !orderable(orderColumn)))
+            orderColumn = -1;
+    }
+    std::vector<bool> merge(tables.size(), false);
+    double gain = -reorderCost(order[0]);
+    bool ordered = orderColumn >= 0;
+    if (ordered)
+        gain += cost_.sortCost(paths[order[0]].filteredRows);
+    for (size_t k = 1; k < order.size(); ++k) {
+        int t = order[k];
+        if (owner[probeKeys[t]] != order[0] || !orderable(probeKeys[t]) || !orderable(buildKeys[t]))
+            continue;
+        double inner = paths[t].filteredRows, outer = paths[order[0]].filteredRows;
+        double saved = cost_.hashJoinCost(inner, outer, 0) - cost_.mergeJoinCost(inner, outer, 0) - reorderCost(t);
+        if (saved < 0)
+            continue;
+        merge[t] = true;
+        ordered = true;
+        gain += saved;
+    }
+    if (ordered && gain >= 0) {
+        for (size_t t = 0; t < tables.size(); ++t) {
+            if (!merge[t] && static_cast<int>(t) != order[0])
+                continue;
+            paths[t].cost = paths[t].bitmap ? paths[t].orderedCost : paths[t].cost;
+            paths[t].bitmap = false;
+        }
+    } else {
+        merge.assign(tables.size(), false);
+        orderColumn = -1;
+    }
+
+    // Build sides, then the probe pipeline.
+    std::vector<std::shared_ptr<HashJoinBuildSink>> builds(tables.size());
+    std::vector<std::shared_ptr<MergeJoinBuildSink>> mergeBuilds(tables.size());
+    for (size_t k = 1; k < order.size(); ++k) {
+        int t = order[k];
+        Pipeline pipeline;
+        if (!makeScan(t, pipeline))
+            return false;
+        if (merge[t]) {
+            mergeBuilds[t] = std::make_shared<MergeJoinBuildSink>(localIndex(buildKeys[t]));
+            pipeline.sink = mergeBuilds[t];
+        } else {
+            builds[t] = std::make_shared<HashJoinBuildSink>(localIndex(buildKeys[t]));
+            pipeline.sink = builds[t];
+        }
+        plan.pipelines.push_back(pipeline);
+    }
+    Pipeline current;
+    if (!makeScan(order[0], current))
+        return false;
+    Scope scope = local[order[0]];
+    for (size_t k = 1; k < order.size(); ++k) {
+        int t = order[k];
+        int probeKey = findColumn(scope, all[probeKeys[t]].table, all[probeKeys[t]].name);
+        if (merge[t]) {
+            current.operators.push_back(std::make_shared<MergeJoinOperator>(mergeBuilds[t], probeKey));
+        } else {
+            current.operators.push_back(std::make_shared<HashJoinProbeOperator>(builds[t], probeKey));
+            // Semi-join reduction: the scan of the first table drops rows
+            // whose key misses the build side's Bloom filter before decoding
+            // them. Skipped when statistics say it would drop less than a
+            // tenth of the keys, which is about the distinct count error.
+            const AccessPath &build = paths[t], &probe = paths[order[0]];
+            bool drops = !build.stats || !probe.stats ||
+                         distinctValues(paths, owner, ownerColumn, buildKeys[t]) <
+                             0.9 * distinctValues(paths, owner, ownerColumn, probeKeys[t]);
+            if (owner[probeKeys[t]] == order[0] && drops)
+                scans[order[0]]->addKeyFilter(builds[t]->getBloomFilter(), localIndex(probeKeys[t]));
+        }
+        scope.insert(scope.end(), local[t].begin(), local[t].end());
+    }
+    if (!residual.empty()) {
+        std::unique_ptr<Expression> filter = binder.bindConjunction(residual, scope, error);
+        if (!filter)
+            return false;
+        current.operators.push_back(std::make_shared<FilterOperator>(std::move(filter)));
+    }
+    for (size_t t = 0; t < tables.size(); ++t) {
+        if (!late[t])
+            continue;
+        int rid = 0;
+        while (scope[rid].table != refs[t]->alias || !scope[rid].name.empty())
+            ++rid;
+        current.operators.push_back(std::make_shared<FetchOperator>(
+            tables[t]->heap.get(), tables[t]->schema, rid, lateColumns[t]));
+        for (int c : lateColumns[t]) {
+            const Column &column = tables[t]->schema.getColumn(c);
+            scope.push_back(ScopeColumn{refs[t]->alias, column.name, "", column.type});
+        }
+    }
+
+    // Aggregation: project the group key and aggregate arguments, aggregate,
+    // and continue with a pipeline over the aggregated rows.
+    if (!aggregates.empty() || !select.groupBy.empty()) {
+        if (star) {
+            error = "SELECT * cannot be combined with aggregation";
+            return false;
+        }
+        if (select.groupBy.size() > 1) {
+            error = "only one GROUP BY expression is supported";
+            return false;
+        }
+        std::vector<std::unique_ptr<Expression>> inputs;
+        Scope aggregated;
+        int keyColumn = -1;
+        TypeId keyType = TypeId::BIGINT;
+        if (!select.groupBy.empty()) {
+            const AstExpr &group = *select.groupBy[0];
+            std::unique_ptr<Expression> key = binder.bind(group, scope, nullptr, error);
+            if (!key)
+                return false;
+            keyType = key->getType();
+            if (!isIntegral(keyType)) {
+                error = std::string("GROUP BY needs an integral expression, not ") + typeName(keyType);
+                return false;
+            }
+            ScopeColumn column{"", "", group.toString(), keyType};
+            if (group.kind == AstKind::COLUMN) {
+                const ScopeColumn &source = scope[key->getColumnIndex()];
+                column.table = source.table;
+                column.name = source.name;
+                column.text.clear();
+            }
+            aggregated.push_back(column);
+            inputs.push_back(std::move(key));
+            keyColumn = 0;
+        }
+        if (aggregates.size() > PartitionedHashAggregator::kMaxAggregates) {
+            error = "too many aggregates (at most " + std::to_string(PartitionedHashAggregator::kMaxAggregates) +
+                    ")";
+            return false;
+        }
+        std::vector<AggregateSpec> specs;
+        for (const AstExpr *aggregate : aggregates) {
+            AggregateSpec spec{aggregate->function, -1, TypeId::BIGINT};
+            // There are no NULLs, so COUNT(x) is COUNT(*).
+            if (aggregate->function != AggregateFunction::COUNT) {
+                std::unique_ptr<Expression> input = binder.bind(*aggregate->lhs, scope, nullptr, error);
+                if (!input)
+                    return false;
+                if (!isNumeric(input->getType())) {
+                    error = "cannot aggregate " + aggregate->lhs->toString() + " of type " +
+                            typeName(input->getType());
+                    return false;
+                }
+                spec.inputColumn = static_cast<int>(inputs.size());
+                spec.inputType = input->getType();
+                inputs.push_back(std::move(input));
+            }
+            specs.push_back(spec);
+            aggregated.push_back(ScopeColumn{"", "", aggregate->toString(),
+                                             HashAggregateSink::resultType(spec)});
+        }
+        current.operators.push_back(std::make_shared<ProjectionOperator>(std::move(inputs)));
+        auto sink = std::make_shared<HashAggregateSink>(keyColumn, keyType, specs, aggregateOptions_);
+        current.sink = sink;
+        plan.pipelines.push_back(current);
+
+        current = Pipeline();
+        current.source = std::make_shared<BatchSource>(sink->getOutput());
+        scope = aggregated;
+    }
+
+    // Final projection: the select items, then hidden sort columns.
+    std::vector<std::unique_ptr<Expression>> outputs;
+    std::vector<int> itemColumn(select.items.size(), -1);
+    for (size_t i = 0; i < select.items.size(); ++i) {
+        const SelectItem &item = select.items[i];
+        if (item.expr->kind == AstKind::STAR) {
+            // Table and schema order, whatever order the columns were decoded in.
+            for (const ScopeColumn &column : all) {
+                int c = findColumn(scope, column.table, column.name);
+                outputs.push_back(Expression::makeColumn(c, column.type));
+                plan.columnNames.push_back(column.name);
+                plan.columnTypes.push_back(column.type);
+            }
+            continue;
+        }
+        std::unique_ptr<Expression> e = binder.bind(*item.expr, scope, nullptr, error);
+        if (!e)
+            return false;
+        itemColumn[i] = static_cast<int>(outputs.size());
+        plan.columnNames.push_back(item.alias.empty() ? item.expr->toString() : item.alias);
+        plan.columnTypes.push_back(e->getType());
+        outputs.push_back(std::move(e));
+    }
+
+    std::vector<SortKey> keys;
+    for (const auto &order : select.orderBy) {
+        const AstExpr &e = *order.expr;
+        int column = -1;
+        if (e.kind == AstKind::LITERAL && isIntegral(e.literal.type) && e.literal.type != TypeId::BOOLEAN) {
+            if (e.literal.integer < 1 || e.literal.integer > static_cast<int64_t>(plan.columnNames.size())) {
+                error = "ORDER BY position " + e.toString() + " is out of range";
+                return false;
+            }
+            column = static_cast<int>(e.literal.integer - 1);
+        }
+        for (size_t i = 0; column < 0 && i < select.items.size(); ++i) {
+            const SelectItem &item = select.items[i];
+            if (itemColumn[i] < 0)
+                continue;
+            bool alias = e.kind == AstKind::COLUMN && e.table.empty() && e.name == item.alias;
+            if (alias || e.toString() == item.expr->toString())
+                column = itemColumn[i];
+        }
+        if (column < 0) {
+            std::unique_ptr<Expression> hidden = binder.bind(e, scope, nullptr, error);
+            if (!hidden)
+                return false;
+            column = static_cast<int>(outputs.size());
+            outputs.push_back(std::move(hidden));
+        }
+        keys.push_back(SortKey{column, order.ascending});
+    }
+
+    // Push the limit into the last sink: a Top-N heap for ORDER BY, or a
+    // collector that stops the scan once enough rows arrived.
+    current.operators.push_back(std::make_shared<ProjectionOperator>(std::move(outputs)));
+    size_t limit = select.limit < 0 ? SIZE_MAX : static_cast<size_t>(select.limit);
+    if (orderColumn >= 0) {
+        // Rows come in ORDER BY order; the collector only puts the batches
+        // back in order. The first rows must all be there, so it cannot stop
+        // early, but a scan with nothing to discard can stop at the limit.
+        auto sink = std::make_shared<CollectSink>(SIZE_MAX, true);
+        plan.output = sink->getOutput();
+        current.sink = sink;
+        if (select.limit >= 0 && scans.size() == 1 && pushed[0].empty() && residual.empty())
+            scans[0]->setRowLimit(limit);
+    } else if (keys.empty()) {
+        auto sink = std::make_shared<CollectSink>(limit);
+        plan.output = sink->getOutput();
+        plan.streamable = true;
+        current.sink = sink;
+        // Every scanned row reaches the sink, so the scan needs no more rows
+        // than the limit.
+        if (select.limit >= 0 && scans.size() == 1 && pushed[0].empty() && residual.empty() &&
+            aggregates.empty() && select.groupBy.empty())
+            scans[0]->setRowLimit(limit);
+    } else if (select.limit >= 0) {
+        auto sink = std::make_shared<TopNSink>(keys, limit);
+        plan.output = sink->getOutput();
+        current.sink = sink;
+    } else {
+        auto sink = std::make_shared<SortSink>(keys);
+        plan.output = sink->getOutput();
+        current.sink = sink;
+    }
+    plan.pipelines.push_back(current);
+    plan.limit = select.limit;
+    plan.readTables = tables;
+    return true;
+}
+
+bool Planner::planInsert(const InsertStatement &insert, QueryPlan &plan, std::string &error) const {
+    Binder binder(plan.parameters);
+    plan.table = catalog_->getTable(insert.table);
+    if (plan.table == nullptr) {
+        error = "unknown table " + insert.table;
+        return false;
+    }
+    if (plan.table->view) {
+        error = "materialized view " + insert.table + " cannot be changed directly";
+        return false;
+    }
+    const Schema &schema = plan.table->schema;
+
+    // Position in the VALUES rows of each table column, or -1.
+    std::vector<int> position(schema.size(), -1);
+    if (insert.columns.empty()) {
+        for (size_t c = 0; c < schema.size(); ++c)
+            position[c] = static_cast<int>(c);
+    }
+    for (size_t i = 0; i < insert.columns.size(); ++i) {
+        int c = schema.findColumn(insert.columns[i]);
+        if (c < 0) {
+            error = "unknown column " + insert.columns[i];
+            return false;
+        }
+        if (position[c] >= 0) {
+            error = "column " + insert.columns[i] + " listed twice";
+            return false;
+        }
+        position[c] = static_cast<int>(i);
+    }
+    size_t width = insert.columns.empty() ? schema.size() : insert.columns.size();
+
+    Scope none;
+    for (const auto &row : insert.rows) {
+        if (row.size() != width) {
+            error = "INSERT has " + std::to_string(row.size()) + " values for " +
+                    std::to_string(width) + " columns";
+            return false;
+        }
+        std::vector<std::unique_ptr<Expression>> values;
+        for (size_t c = 0; c < schema.size(); ++c) {
+            TypeId type = schema.getColumn(c).type;
+            if (position[c] < 0) {
+                values.push_back(Expression::makeConstant(defaultValue(type)));
+                continue;
+            }
+            std::unique_ptr<Expression> value = binder.bindAs(*row[position[c]], none, type, error);
+            if (!value)
+                return false;
+            values.push_back(std::move(value));
+        }
+        plan.insertRows.push_back(std::move(values));
+    }
+    return true;
+}
+
+bool Planner::planUpdate(const UpdateStatement &update, QueryPlan &plan, std::string &error) const {
+    Binder binder(plan.parameters);
+    plan.table = catalog_->getTable(update.table);
+    if (plan.table == nullptr) {
+        error = "unknown table " + update.table;
+        return false;
+    }
+    if (plan.table->view) {
+        error = "materialized view " + update.table + " cannot be changed directly";
+        return false;
+    }
+    const Schema &schema = plan.table->schema;
+
+    // Rows are rewritten whole, so the scan decodes every column after the
+    // record id.
+    Scope scope(1, ScopeColumn{"", "", "", TypeId::BIGINT});
+    std::vector<int> columns;
+    for (size_t c = 0; c < schema.size(); ++c) {
+        scope.push_back(ScopeColumn{update.table, schema.getColumn(c).name, "", schema.getColumn(c).type});
+        columns.push_back(static_cast<int>(c));
+    }
+    for (const auto &assignment : update.assignments) {
+        int c = schema.findColumn(assignment.first);
+        if (c < 0) {
+            error = "unknown column " + assignment.first;
+            return false;
+        }
+        std::unique_ptr<Expression> value = binder.bindAs(*assignment.second, scope, schema.getColumn(c).type, error);
+        if (!value)
+            return false;
+        plan.assignments.emplace_back(c, std::move(value));
+    }
+
+    Pipeline pipeline;
+    std::vector<const AstExpr *> conjuncts;
+    splitConjuncts(update.where.get(), conjuncts);
+    AccessPath path = chooseAccessPath(*plan.table, update.table, conjuncts, cost_);
+    pipeline.source = makeSource(path, *plan.table, columns, true, binder, error);
+    if (!pipeline.source)
+        return false;
+    if (!conjuncts.empty()) {
+        std::unique_ptr<Expression> filter = binder.bindConjunction(conjuncts, scope, error);
+        if (!filter)
+            return false;
+        pipeline.operators.push_back(std::make_shared<FilterOperator>(std::move(filter)));
+    }
+    auto sink = std::make_shared<CollectSink>();
+    plan.output = sink->getOutput();
+    pipeline.sink = sink;
+    plan.pipelines.push_back(pipeline);
+    return true;
+}
+
+bool Planner::planDelete(const DeleteStatement &remove, QueryPlan &plan, std::string &error) const {
+    Binder binder(plan.parameters);
+    plan.table = catalog_->getTable(remove.table);
+    if (plan.table == nullptr) {
+        error = "unknown table " + remove.table;
+        return false;
+    }
+    if (plan.table->view) {
+        error = "materialized view " + remove.table + " cannot be changed directly";
+        return false;
+    }
+    const Schema &schema = plan.table->schema;
+
+    // Only the record id, the columns the WHERE clause reads and the index
+    // keys, which are needed to remove the index entries.
+    std::vector<const AstExpr *> columnRefs;
+    collectColumns(remove.where.get(), columnRefs);
+    std::vector<bool> needed(schema.size(), false);
+    for (size_t c = 0; c < schema.size(); ++c) {
+        for (const AstExpr *ref : columnRefs)
+            needed[c] = needed[c] || ref->name == schema.getColumn(c).name;
+    }
+    for (const auto &index : plan.table->indexes)
+        needed[index->column] = true;
+    // Views need the whole deleted rows.
+    if (!plan.table->views.empty())
+        needed.assign(schema.size(), true);
+    Scope scope(1, ScopeColumn{"", "", "", TypeId::BIGINT});
+    std::vector<int> columns;
+    std::vector<int> position(schema.size(), -1);
+    for (size_t c = 0; c < schema.size(); ++c) {
+        if (!needed[c])
+            continue;
+        const Column &column = schema.getColumn(c);
+        position[c] = static_cast<int>(scope.size());
+        scope.push_back(ScopeColumn{remove.table, column.name, "", column.type});
+        columns.push_back(static_cast<int>(c));
+    }
+    for (const auto &index : plan.table->indexes)
+        plan.keyColumns.push_back(position[index->column]);
+    if (!plan.table->views.empty())
+        plan.rowColumns = position;
+
+    Pipeline pipeline;
+    std::vector<const AstExpr *> conjuncts;
+    splitConjuncts(remove.where.get(), conjuncts);
+    AccessPath path = chooseAccessPath(*plan.table, remove.table, conjuncts, cost_);
+    pipeline.source = makeSource(path, *plan.table, columns, true, binder, error);
+    if (!pipeline.source)
+        return false;
+    if (!conjuncts.empty()) {
+        std::unique_ptr<Expression> filter = binder.bindConjunction(conjuncts, scope, error);
+        if (!filter)
+            return false;
+        pipeline.operators.push_back(std::make_shared<FilterOperator>(std::move(filter)));
+    }
+    auto sink = std::make_shared<CollectSink>();
+    plan.output = sink->getOutput();
+    pipeline.sink = sink;
+    plan.pipelines.push_back(pipeline);
+    return true;
+}
+
+bool Planner::planCreateView(const CreateViewStatement &create, QueryPlan &plan, std::string &error) const {
+    const SelectStatement &select = *create.select;
+    Binder binder(plan.parameters);
+    if (!select.joins.empty() || !select.orderBy.empty() || select.limit >= 0) {
+        error = "a materialized view cannot have JOIN, ORDER BY or LIMIT";
+        return false;
+    }
+    if (!plan.parameters->types.empty()) {
+        error = "a materialized view cannot have placeholders";
+        return false;
+    }
+    if (select.groupBy.size() > 1) {
+        error = "only one GROUP BY expression is supported";
+        return false;
+    }
+    plan.table = catalog_->getTable(select.from.name);
+    if (plan.table == nullptr) {
+        error = "unknown table " + select.from.name;
+        return false;
+    }
+    if (plan.table->view) {
+        error = "cannot define a materialized view over materialized view " + select.from.name;
+        return false;
+    }
+    plan.tableName = create.view;
+
+    // The view's expressions see one whole base row at a time.
+    const Schema &schema = plan.table->schema;
+    Scope scope;
+    for (const Column &column : schema.getColumns())
+        scope.push_back(ScopeColumn{select.from.alias, column.name, "", column.type});
+    std::vector<const AstExpr *> conjuncts;
+    splitConjuncts(select.where.get(), conjuncts);
+    std::unique_ptr<Expression> filter = binder.bindConjunction(conjuncts, scope, error);
+    if (!filter && !conjuncts.empty())
+        return false;
+    std::unique_ptr<Expression> key;
+    std::string keyText;
+    if (!select.groupBy.empty()) {
+        key = binder.bind(*select.groupBy[0], scope, nullptr, error);
+        if (!key)
+            return false;
+        if (!isIntegral(key->getType())) {
+            error = std::string("GROUP BY needs an integral expression, not ") + typeName(key->getType());
+            return false;
+        }
+        keyText = select.groupBy[0]->toString();
+    }
+
+    // Every item is the key or a single aggregate, so that each view column
+    // can be recomputed from its group's running state alone.
+    std::vector<std::unique_ptr<Expression>> inputs;
+    std::vector<AggregateSpec> specs;
+    std::vector<int> columns;
+    std::vector<Column> viewColumns;
+    for (const SelectItem &item : select.items) {
+        const AstExpr &e = *item.expr;
+        Column column{item.alias, TypeId::BIGINT};
+        if (key && e.toString() == keyText) {
+            columns.push_back(-1);
+            column.type = key->getType();
+            if (column.name.empty() && e.kind == AstKind::COLUMN)
+                column.name = e.name;
+        } else if (e.kind == AstKind::AGGREGATE) {
+            if (e.function == AggregateFunction::MIN || e.function == AggregateFunction::MAX) {
+                error = "a materialized view can only COUNT, SUM and AVG, not " + e.toString();
+                return false;
+            }
+            AggregateSpec spec{e.function, -1, TypeId::BIGINT};
+            // There are no NULLs, so COUNT(x) is COUNT(*).
+            if (e.function != AggregateFunction::COUNT) {
+                std::unique_ptr<Expression> input = binder.bind(*e.lhs, scope, nullptr, error);
+                if (!input)
+                    return false;
+                if (!isNumeric(input->getType())) {
+                    error = "cannot aggregate " + e.lhs->toString() + " of type " + typeName(input->getType());
+                    return false;
+                }
+                spec.inputColumn = static_cast<int>(inputs.size());
+                spec.inputType = input->getType();
+                inputs.push_back(std::move(input));
+            }
+            columns.push_back(static_cast<int>(specs.size()));
+            specs.push_back(spec);
+            column.type = HashAggregateSink::resultType(spec);
+        } else {
+            error = "view column " + e.toString() + " is neither the GROUP BY key nor an aggregate";
+            return false;
+        }
+        if (column.name.empty()) {
+            error = "view column " + e.toString() + " needs a name";
+            return false;
+        }
+        for (const Column &other : viewColumns) {
+            if (other.name == column.name) {
+                error = "view column " + column.name + " listed twice";
+                return false;
+            }
+        }
+        viewColumns.push_back(column);
+    }
+    plan.schema = Schema(viewColumns);
+    plan.view = std::make_shared<MaterializedView>(plan.table, std::move(filter), std::move(key), std::move(inputs),
+                                                   std::move(specs), std::move(columns), plan.schema);
+    return true;
+}
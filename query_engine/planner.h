@@ -0,0 +1,97 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "catalog.h"
+#include "cost_model.h"
+#include "executor.h"
+#include "expression.h"
+#include "materialized_view.h"
+#include "operators.h"
+#include "sql_parser.h"
+
+// Executable form of a statement. A plan is built once and can then run any
+// number of times; the values of its placeholders are bound into
+// 'parameters' before each run.
+struct QueryPlan {
+    StatementKind kind;
+    ExplainMode explain = ExplainMode::NONE;
+    std::shared_ptr<ParameterValues> parameters;
+
+    // SELECT, UPDATE and DELETE: pipelines to run in order. 'output' holds
+    // the rows reaching the last sink once they have run.
+    std::vector<Pipeline> pipelines;
+    BatchList output;
+
+    // SELECT: the visible result columns. Output batches may carry extra
+    // trailing columns that were only needed for sorting.
+    std::vector<std::string> columnNames;
+    std::vector<TypeId> columnTypes;
+    int64_t limit = -1;
+    // SELECT: the last sink only collects the rows, in no particular order,
+    // so a cursor can stream them from the last pipeline instead.
+    bool streamable = false;
+    // SELECT: every table read, in FROM clause order.
+    std::vector<TableInfo *> readTables;
+
+    // INSERT, UPDATE, DELETE, CREATE INDEX and ANALYZE of one table; the base
+    // table of CREATE MATERIALIZED VIEW.
+    TableInfo *table = nullptr;
+
+    // INSERT: one constant expression per table column for every row.
+    std::vector<std::vector<std::unique_ptr<Expression>>> insertRows;
+
+    // UPDATE: new value of each assigned column, evaluated over the output
+    // batches, whose layout is [record id, table columns...].
+    std::vector<std::pair<int, std::unique_ptr<Expression>>> assignments;
+
+    // DELETE: output batch column holding the key of each of the table's
+    // indexes, in the order of TableInfo::indexes.
+    std::vector<int> keyColumns;
+    // DELETE from a table with materialized views: output batch column of
+    // every table column, so the deleted rows can be taken out of the views.
+    std::vector<int> rowColumns;
+
+    // CREATE TABLE, CREATE INDEX, CREATE MATERIALIZED VIEW and ANALYZE,
+    // which leaves it empty to analyze every table.
+    std::string tableName;
+    Schema schema;
+
+    // CREATE INDEX.
+    std::string indexName;
+    int indexColumn = -1;
+
+    // CREATE MATERIALIZED VIEW: the view over 'table', not yet stored.
+    std::shared_ptr<MaterializedView> view;
+};
+
+// Planner. It pushes single-table predicates down into the scans, decodes
+// only the columns a query references, turns joins into left-deep hash joins
+// and executes GROUP BY with the partitioned hash aggregator.
+//
+// Access paths and join order are cost-based: each table is read with a full
+// scan or an index range scan, whichever 'cost' estimates cheaper, and once
+// every joined table has been analyzed the join order with the lowest
+// estimated cost is chosen. Without statistics, joins run in the order
+// written (probing with the FROM table) and an index is used only for an
+// equality predicate.
+class Planner {
+public:
+    Planner(const Catalog *catalog, const AggregateOptions &aggregateOptions,
+            const CostModel &cost = CostModel())
+        : catalog_(catalog), aggregateOptions_(aggregateOptions), cost_(cost) {}
+
+    // Returns nullptr and sets 'error' if the statement cannot be planned.
+    std::unique_ptr<QueryPlan> plan(const Statement &statement, std::string &error) const;
+
+private:
+    bool planSelect(const SelectStatement &select, QueryPlan &plan, std::string &error) const;
+    bool planInsert(const InsertStatement &insert, QueryPlan &plan, std::string &error) const;
+    bool planUpdate(const UpdateStatement &update, QueryPlan &plan, std::string &error) const;
+    bool planDelete(const DeleteStatement &remove, QueryPlan &plan, std::string &error) const;
+    bool planCreateView(const CreateViewStatement &create, QueryPlan &plan, std::string &error) const;
+
+    const Catalog *catalog_;
+    AggregateOptions aggregateOptions_;
+    CostModel cost_;
+};
@@ -0,0 +1,134 @@
+#include "schema.h"
+#include <cstring>
+
+static int fixedWidth(TypeId type) {
+    // A VARCHAR occupies an (offset, length) pair in the fixed section.
+    return type == TypeId::VARCHAR ? 2 * sizeof(uint16_t) : static_cast<int>(typeWidth(type));
+}
+
+Schema::Schema(const std::vector<Column> &columns) : columns_(columns), fixedSize_(0) {
+    for (const auto &column : columns_) {
+        offsets_.push_back(fixedSize_);
+        fixedSize_ += fixedWidth(column.type);
+    }
+}
+
+int Schema::findColumn(const std::string &name) const {
+    for (size_t i = 0; i < columns_.size(); ++i)
+        if (columns_[i].name == name)
+            return static_cast<int>(i);
+    return -1;
+}
+
+void Schema::serializeRow(const std::vector<Value> &row, std::vector<char> &record) const {
+    size_t varLength = 0;
+    for (size_t i = 0; i < columns_.size(); ++i)
+        if (columns_[i].type == TypeId::VARCHAR)
+            varLength += row[i].text.size();
+    record.assign(fixedSize_ + varLength, 0);
+
+    uint16_t varOffset = static_cast<uint16_t>(fixedSize_);
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        char *slot = record.data() + offsets_[i];
+        const Value &value = row[i];
+        switch (columns_[i].type) {
+        case TypeId::INTEGER:
+        case TypeId::DATE: {
+            int32_t v = static_cast<int32_t>(value.integer);
+            memcpy(slot, &v, sizeof(v));
+            break;
+        }
+        case TypeId::BIGINT: {
+            int64_t v = value.type == TypeId::DOUBLE ? static_cast<int64_t>(value.real) : value.integer;
+            memcpy(slot, &v, sizeof(v));
+            break;
+        }
+        case TypeId::DOUBLE: {
+            double v = value.asDouble();
+            memcpy(slot, &v, sizeof(v));
+            break;
+        }
+        case TypeId::BOOLEAN:
+            *slot = value.integer ? 1 : 0;
+            break;
+        case TypeId::VARCHAR: {
+            uint16_t length = static_cast<uint16_t>(value.text.size());
+            memcpy(slot, &varOffset, sizeof(varOffset));
+            memcpy(slot + sizeof(varOffset), &length, sizeof(length));
+            memcpy(record.data() + varOffset, value.text.data(), length);
+            varOffset += length;
+            break;
+        }
+        }
+    }
+}
+
+bool Schema::deserializeRow(const char *record, int length, std::vector<Value> &row) const {
+    if (length < fixedSize_)
+        return false;
+    row.resize(columns_.size());
+    ColumnVector scratch;
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        scratch.reset(columns_[i].type);
+        scratch.resize(1);
+        decodeColumn(record, i, scratch, 0);
+        row[i] = scratch.getValue(0);
+    }
+    return true;
+}
+
+void Schema::decodeColumn(const char *record, size_t column, ColumnVector &out, size_t row) const {
+    const char *slot = record + offsets_[column];
+    switch (columns_[column].type) {
+    case TypeId::INTEGER:
+    case TypeId::DATE:
+        memcpy(&out.values<int32_t>()[row], slot, sizeof(int32_t));
+        break;
+    case TypeId::BIGINT:
+        memcpy(&out.values<int64_t>()[row], slot, sizeof(int64_t));
+        break;
+    case TypeId::DOUBLE:
+        memcpy(&out.values<double>()[row], slot, sizeof(double));
+        break;
+    case TypeId::BOOLEAN:
+        out.values<uint8_t>()[row] = static_cast<uint8_t>(*slot);
+        break;
+    case TypeId::VARCHAR: {
+        uint16_t offset, length;
+        memcpy(&offset, slot, sizeof(offset));
+        memcpy(&length, slot + sizeof(offset), sizeof(length));
+        out.values<std::string>()[row].assign(record + offset, length);
+        break;
+    }
+    }
+}
+
+int64_t Schema::decodeInteger(const char *record, size_t column) const {
+    const char *slot = record + offsets_[column];
+    switch (columns_[column].type) {
+    case TypeId::INTEGER:
+    case TypeId::DATE: {
+        int32_t v;
+        memcpy(&v, slot, sizeof(v));
+        return v;
+    }
+    case TypeId::BIGINT: {
+        int64_t v;
+        memcpy(&v, slot, sizeof(v));
+        return v;
+    }
+    case TypeId::BOOLEAN:
+        return static_cast<uint8_t>(*slot);
+    default:
+        return 0;
+    }
+}
+
+void Schema::initBatch(Batch &batch) const {
+    batch.columns.clear();
+    for (const auto &column : columns_)
+        batch.columns.emplace_back(column.type);
+    batch.count = 0;
+    batch.hasSelection = false;
+    batch.selection.clear();
+}
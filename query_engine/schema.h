@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "batch.h"
+
+struct Column {
+    std::string name;
+    TypeId type;
+};
+
+// Describes the columns of a table and the byte layout of its records.
+//
+// Record layout: a fixed-size section holding every column at a precomputed
+// offset, followed by the bytes of the VARCHAR values. A VARCHAR column's
+// fixed slot holds the (uint16 offset, uint16 length) of its bytes, so any
+// single column can be decoded without looking at the others.
+class Schema {
+public:
+    Schema() : fixedSize_(0) {}
+    explicit Schema(const std::vector<Column> &columns);
+
+    size_t size() const { return columns_.size(); }
+    const Column &getColumn(size_t i) const { return columns_[i]; }
+    const std::vector<Column> &getColumns() const { return columns_; }
+
+    // Returns the index of the column called 'name', or -1.
+    int findColumn(const std::string &name) const;
+
+    // Encodes 'row' (one value per column, already of the column's type).
+    void serializeRow(const std::vector<Value> &row, std::vector<char> &record) const;
+
+    // Decodes every column of a record. Returns false if the record is too short.
+    bool deserializeRow(const char *record, int length, std::vector<Value> &row) const;
+
+    // Decodes column 'column' of a record into row 'row' of 'out'.
+    void decodeColumn(const char *record, size_t column, ColumnVector &out, size_t row) const;
+
+    // Value of an integral column (INTEGER, BIGINT, DATE, BOOLEAN) of a record.
+    int64_t decodeInteger(const char *record, size_t column) const;
+
+    // Creates one empty batch column per schema column.
+    void initBatch(Batch &batch) const;
+
+private:
+    std::vector<Column> columns_;
+    std::vector<int> offsets_; // Offset of each column in the fixed section.
+    int fixedSize_;
+};
@@ -0,0 +1,386 @@
+#include "simd_filter.h"
+#include <algorithm>
+#include "kernels.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define DBENGINE_X86_SIMD 1
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#define TARGET_AVX512 __attribute__((target("avx512f,popcnt")))
+#endif
+
+namespace {
+
+template <CompareOp Op> struct ScalarOp;
+template <> struct ScalarOp<CompareOp::EQ> { typedef EqOp type; };
+template <> struct ScalarOp<CompareOp::NE> { typedef NeOp type; };
+template <> struct ScalarOp<CompareOp::LT> { typedef LtOp type; };
+template <> struct ScalarOp<CompareOp::LE> { typedef LeOp type; };
+template <> struct ScalarOp<CompareOp::GT> { typedef GtOp type; };
+template <> struct ScalarOp<CompareOp::GE> { typedef GeOp type; };
+
+// Rows [begin, n) of the word that starts at 'base'.
+template <typename T, CompareOp Op>
+inline uint64_t scalarWord(const T *a, T b, size_t base, size_t begin, size_t n) {
+    typedef typename ScalarOp<Op>::type F;
+    uint64_t bits = 0;
+    for (size_t i = begin; i < n; ++i)
+        bits |= static_cast<uint64_t>(F::apply(a[i], b)) << (i - base);
+    return bits;
+}
+
+// Branch-free: every row number is stored, the cursor only advances on a match.
+template <typename T, CompareOp Op>
+inline size_t scalarSelect(const T *a, T b, size_t begin, size_t n, uint32_t *selection, size_t count) {
+    typedef typename ScalarOp<Op>::type F;
+    for (size_t i = begin; i < n; ++i) {
+        selection[count] = static_cast<uint32_t>(i);
+        count += F::apply(a[i], b);
+    }
+    return count;
+}
+
+template <typename T, CompareOp Op>
+void compareBitmapScalar(const void *column, const void *constant, size_t n, uint64_t *bitmap) {
+    const T *a = static_cast<const T *>(column);
+    const T b = *static_cast<const T *>(constant);
+    for (size_t base = 0; base < n; base += 64)
+        bitmap[base / 64] = scalarWord<T, Op>(a, b, base, base, std::min(n, base + 64));
+}
+
+template <typename T, CompareOp Op>
+size_t compareSelectScalar(const void *column, const void *constant, size_t n, uint32_t *selection) {
+    return scalarSelect<T, Op>(static_cast<const T *>(column), *static_cast<const T *>(constant), 0, n,
+                               selection, 0);
+}
+
+template <typename T, CompareOp Op>
+size_t compareRefineScalar(const void *column, const void *constant, uint32_t *selection, size_t n) {
+    typedef typename ScalarOp<Op>::type F;
+    const T *a = static_cast<const T *>(column);
+    const T b = *static_cast<const T *>(constant);
+    size_t out = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t row = selection[i];
+        selection[out] = row;
+        out += F::apply(a[row], b);
+    }
+    return out;
+}
+
+#ifdef DBENGINE_X86_SIMD
+
+// Per-type AVX2 operations. mask8<Op>() returns one bit for each of the 8
+// rows at 'p'; 64-bit types need two 4-lane compares for that.
+struct Avx2Int32 {
+    typedef int32_t T;
+    typedef __m256i V;
+    TARGET_AVX2 static V load(const T *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    TARGET_AVX2 static V broadcast(T v) { return _mm256_set1_epi32(v); }
+    TARGET_AVX2 static uint32_t eq(V a, V b) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))); }
+    TARGET_AVX2 static uint32_t gt(V a, V b) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b))); }
+    template <CompareOp Op>
+    TARGET_AVX2 static uint32_t mask8(const T *p, V b);
+};
+
+struct Avx2Int64 {
+    typedef int64_t T;
+    typedef __m256i V;
+    TARGET_AVX2 static V load(const T *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+    TARGET_AVX2 static V broadcast(T v) { return _mm256_set1_epi64x(v); }
+    TARGET_AVX2 static uint32_t eq(V a, V b) { return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(a, b))); }
+    TARGET_AVX2 static uint32_t gt(V a, V b) { return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, b))); }
+    template <CompareOp Op>
+    TARGET_AVX2 static uint32_t mask8(const T *p, V b);
+};
+
+// Integers only have == and >; the other operators are derived from them.
+template <typename Ops, CompareOp Op>
+TARGET_AVX2 inline uint32_t avx2IntegerMask(typename Ops::V a, typename Ops::V b, uint32_t all) {
+    switch (Op) {
+    case CompareOp::EQ: return Ops::eq(a, b);
+    case CompareOp::NE: return ~Ops::eq(a, b) & all;
+    case CompareOp::GT: return Ops::gt(a, b);
+    case CompareOp::LT: return Ops::gt(b, a);
+    case CompareOp::LE: return ~Ops::gt(a, b) & all;
+    case CompareOp::GE: return ~Ops::gt(b, a) & all;
+    }
+    return 0;
+}
+
+template <CompareOp Op>
+TARGET_AVX2 uint32_t Avx2Int32::mask8(const T *p, V b) {
+    return avx2IntegerMask<Avx2Int32, Op>(load(p), b, 0xff);
+}
+
+template <CompareOp Op>
+TARGET_AVX2 uint32_t Avx2Int64::mask8(const T *p, V b) {
+    return avx2IntegerMask<Avx2Int64, Op>(load(p), b, 0xf) |
+           (avx2IntegerMask<Avx2Int64, Op>(load(p + 4), b, 0xf) << 4);
+}
+
+template <CompareOp Op>
+TARGET_AVX2 inline uint32_t avx2DoubleMask(__m256d a, __m256d b) {
+    // Ordered predicates, except NE, which like the scalar != is true for NaN.
+    switch (Op) {
+    case CompareOp::EQ: return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ));
+    case CompareOp::NE: return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_NEQ_UQ));
+    case CompareOp::LT: return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ));
+    case CompareOp::LE: return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ));
+    case CompareOp::GT: return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ));
+    case CompareOp::GE: return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ));
+    }
+    return 0;
+}
+
+struct Avx2Double {
+    typedef double T;
+    typedef __m256d V;
+    TARGET_AVX2 static V broadcast(T v) { return _mm256_set1_pd(v); }
+    template <CompareOp Op>
+    TARGET_AVX2 static uint32_t mask8(const T *p, V b) {
+        return avx2DoubleMask<Op>(_mm256_loadu_pd(p), b) | (avx2DoubleMask<Op>(_mm256_loadu_pd(p + 4), b) << 4);
+    }
+};
+
+// For every 8-bit mask, the lane permutation that moves the selected lanes
+// of an 8 x int32 vector to the front.
+struct CompressTable {
+    alignas(32) uint32_t lanes[256][8];
+
+    CompressTable() {
+        for (int mask = 0; mask < 256; ++mask) {
+            int count = 0;
+            for (int lane = 0; lane < 8; ++lane)
+                if (mask & (1 << lane))
+                    lanes[mask][count++] = lane;
+            while (count < 8)
+                lanes[mask][count++] = 0;
+        }
+    }
+};
+
+const CompressTable kCompress;
+
+template <typename Ops, CompareOp Op>
+TARGET_AVX2 void compareBitmapAvx2(const void *column, const void *constant, size_t n, uint64_t *bitmap) {
+    typedef typename Ops::T T;
+    const T *a = static_cast<const T *>(column);
+    const T b = *static_cast<const T *>(constant);
+    typename Ops::V vb = Ops::broadcast(b);
+    size_t full = n / 64;
+    for (size_t w = 0; w < full; ++w) {
+        uint64_t bits = 0;
+        for (size_t j = 0; j < 64; j += 8)
+            bits |= static_cast<uint64_t>(Ops::template mask8<Op>(a + w * 64 + j, vb)) << j;
+        bitmap[w] = bits;
+    }
+    if (full * 64 < n)
+        bitmap[full] = scalarWord<T, Op>(a, b, full * 64, full * 64, n);
+}
+
+template <typename Ops, CompareOp Op>
+TARGET_AVX2 size_t compareSelectAvx2(const void *column, const void *constant, size_t n, uint32_t *selection) {
+    typedef typename Ops::T T;
+    const T *a = static_cast<const T *>(column);
+    const T b = *static_cast<const T *>(constant);
+    typename Ops::V vb = Ops::broadcast(b);
+    __m256i rows = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i step = _mm256_set1_epi32(8);
+    size_t count = 0, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint32_t mask = Ops::template mask8<Op>(a + i, vb);
+        __m256i lanes = _mm256_load_si256(reinterpret_cast<const __m256i *>(kCompress.lanes[mask]));
+        // Stores all 8 lanes; count <= i, so they stay below row i + 8.
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(selection + count),
+                            _mm256_permutevar8x32_epi32(rows, lanes));
+        count += __builtin_popcount(mask);
+        rows = _mm256_add_epi32(rows, step);
+    }
+    return scalarSelect<T, Op>(a, b, i, n, selection, count);
+}
+
+// AVX-512 compares straight into mask registers for every operator and
+// compresses the selected row numbers in one instruction.
+template <CompareOp Op> struct Avx512Predicate;
+template <> struct Avx512Predicate<CompareOp::EQ> { enum { integer = _MM_CMPINT_EQ, real = _CMP_EQ_OQ }; };
+template <> struct Avx512Predicate<CompareOp::NE> { enum { integer = _MM_CMPINT_NE, real = _CMP_NEQ_UQ }; };
+template <> struct Avx512Predicate<CompareOp::LT> { enum { integer = _MM_CMPINT_LT, real = _CMP_LT_OQ }; };
+template <> struct Avx512Predicate<CompareOp::LE> { enum { integer = _MM_CMPINT_LE, real = _CMP_LE_OQ }; };
+template <> struct Avx512Predicate<CompareOp::GT> { enum { integer = _MM_CMPINT_NLE, real = _CMP_GT_OQ }; };
+template <> struct Avx512Predicate<CompareOp::GE> { enum { integer = _MM_CMPINT_NLT, real = _CMP_GE_OQ }; };
+
+// mask16<Op>() returns one bit for each of the 16 rows at 'p'.
+struct Avx512Int32 {
+    typedef int32_t T;
+    typedef __m512i V;
+    TARGET_AVX512 static V broadcast(T v) { return _mm512_set1_epi32(v); }
+    template <CompareOp Op>
+    TARGET_AVX512 static uint32_t mask16(const T *p, V b) {
+        return _mm512_cmp_epi32_mask(_mm512_loadu_si512(p), b, Avx512Predicate<Op>::integer);
+    }
+};
+
+struct Avx512Int64 {
+    typedef int64_t T;
+    typedef __m512i V;
+    TARGET_AVX512 static V broadcast(T v) { return _mm512_set1_epi64(v); }
+    template <CompareOp Op>
+    TARGET_AVX512 static uint32_t mask16(const T *p, V b) {
+        uint32_t low = _mm512_cmp_epi64_mask(_mm512_loadu_si512(p), b, Avx512Predicate<Op>::integer);
+        uint32_t high = _mm512_cmp_epi64_mask(_mm512_loadu_si512(p + 8), b, Avx512Predicate<Op>::integer);
+        return low | (high << 8);
+    }
+};
+
+struct Avx512Double {
+    typedef double T;
+    typedef __m512d V;
+    TARGET_AVX512 static V broadcast(T v) { return _mm512_set1_pd(v); }
+    template <CompareOp Op>
+    TARGET_AVX512 static uint32_t mask16(const T *p, V b) {
+        uint32_t low = _mm512_cmp_pd_mask(_mm512_loadu_pd(p), b, Avx512Predicate<Op>::real);
+        uint32_t high = _mm512_cmp_pd_mask(_mm512_loadu_pd(p + 8), b, Avx512Predicate<Op>::real);
+        return low | (high << 8);
+    }
+};
+
+template <typename Ops, CompareOp Op>
+TARGET_AVX512 void compareBitmapAvx512(const void *column, const void *constant, size_t n, uint64_t *bitmap) {
+    typedef typename Ops::T T;
+    const T *a = static_cast<const T *>(column);
+    const T b = *static_cast<const T *>(constant);
+    typename Ops::V vb = Ops::broadcast(b);
+    size_t full = n / 64;
+    for (size_t w = 0; w < full; ++w) {
+        uint64_t bits = 0;
+        for (size_t j = 0; j < 64; j += 16)
+            bits |= static_cast<uint64_t>(Ops::template mask16<Op>(a + w * 64 + j, vb)) << j;
+        bitmap[w] = bits;
+    }
+    if (full * 64 < n)
+        bitmap[full] = scalarWord<T, Op>(a, b, full * 64, full * 64, n);
+}
+
+template <typename Ops, CompareOp Op>
+TARGET_AVX512 size_t compareSelectAvx512(const void *column, const void *constant, size_t n, uint32_t *selection) {
+    typedef typename Ops::T T;
+    const T *a = static_cast<const T *>(column);
+    const T b = *static_cast<const T *>(constant);
+    typename Ops::V vb = Ops::broadcast(b);
+    __m512i rows = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i step = _mm512_set1_epi32(16);
+    size_t count = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __mmask16 mask = static_cast<__mmask16>(Ops::template mask16<Op>(a + i, vb));
+        // Compressing in a register and storing all 16 lanes is faster than a
+        // masked compress-store; count <= i keeps the store below row i + 16.
+        _mm512_storeu_si512(selection + count, _mm512_maskz_compress_epi32(mask, rows));
+        count += __builtin_popcount(mask);
+        rows = _mm512_add_epi32(rows, step);
+    }
+    return scalarSelect<T, Op>(a, b, i, n, selection, count);
+}
+
+#endif // DBENGINE_X86_SIMD
+
+template <typename T, CompareOp Op>
+FilterKernel scalarKernel() {
+    FilterKernel kernel;
+    kernel.bitmap = &compareBitmapScalar<T, Op>;
+    kernel.select = &compareSelectScalar<T, Op>;
+    kernel.refine = &compareRefineScalar<T, Op>;
+    return kernel;
+}
+
+#ifdef DBENGINE_X86_SIMD
+// Scalar kernel with the bitmap and select members replaced by the wide
+// versions for 'level'. Refinement gathers scattered rows, so it stays scalar.
+template <typename Avx2Ops, typename Avx512Ops, CompareOp Op>
+FilterKernel vectorKernel(SimdLevel level) {
+    FilterKernel kernel = scalarKernel<typename Avx2Ops::T, Op>();
+    if (level == SimdLevel::AVX512) {
+        kernel.bitmap = &compareBitmapAvx512<Avx512Ops, Op>;
+        kernel.select = &compareSelectAvx512<Avx512Ops, Op>;
+    } else if (level == SimdLevel::AVX2) {
+        kernel.bitmap = &compareBitmapAvx2<Avx2Ops, Op>;
+        kernel.select = &compareSelectAvx2<Avx2Ops, Op>;
+    }
+    return kernel;
+}
+#endif
+
+template <CompareOp Op>
+FilterKernel kernelFor(TypeId type, SimdLevel level) {
+#ifdef DBENGINE_X86_SIMD
+    switch (type) {
+    case TypeId::INTEGER:
+    case TypeId::DATE:   return vectorKernel<Avx2Int32, Avx512Int32, Op>(level);
+    case TypeId::BIGINT: return vectorKernel<Avx2Int64, Avx512Int64, Op>(level);
+    case TypeId::DOUBLE: return vectorKernel<Avx2Double, Avx512Double, Op>(level);
+    default:             return FilterKernel();
+    }
+#else
+    (void)level;
+    switch (type) {
+    case TypeId::INTEGER:
+    case TypeId::DATE:   return scalarKernel<int32_t, Op>();
+    case TypeId::BIGINT: return scalarKernel<int64_t, Op>();
+    case TypeId::DOUBLE: return scalarKernel<double, Op>();
+    default:             return FilterKernel();
+    }
+#endif
+}
+
+} // namespace
+
+SimdLevel detectSimdLevel() {
+#ifdef DBENGINE_X86_SIMD
+    static const SimdLevel level = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return SimdLevel::AVX512;
+        if (__builtin_cpu_supports("avx2"))
+            return SimdLevel::AVX2;
+        return SimdLevel::SCALAR;
+    }();
+    return level;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+const char *simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::SCALAR: return "scalar";
+    case SimdLevel::AVX2:   return "avx2";
+    case SimdLevel::AVX512: return "avx512";
+    }
+    return "?";
+}
+
+FilterKernel getFilterKernel(TypeId type, CompareOp op, SimdLevel level) {
+    level = std::min(level, detectSimdLevel());
+    switch (op) {
+    case CompareOp::EQ: return kernelFor<CompareOp::EQ>(type, level);
+    case CompareOp::NE: return kernelFor<CompareOp::NE>(type, level);
+    case CompareOp::LT: return kernelFor<CompareOp::LT>(type, level);
+    case CompareOp::LE: return kernelFor<CompareOp::LE>(type, level);
+    case CompareOp::GT: return kernelFor<CompareOp::GT>(type, level);
+    case CompareOp::GE: return kernelFor<CompareOp::GE>(type, level);
+    }
+    return FilterKernel();
+}
+
+size_t bitmapToSelection(const uint64_t *bitmap, size_t n, uint32_t *selection, uint32_t base) {
+    size_t count = 0;
+    for (size_t w = 0; w * 64 < n; ++w) {
+        uint64_t bits = bitmap[w];
+        uint32_t offset = base + static_cast<uint32_t>(w * 64);
+        while (bits) {
+            selection[count++] = offset + static_cast<uint32_t>(__builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+    return count;
+}
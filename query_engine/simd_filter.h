@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "types.h"
+
+// Comparison filters over fixed-width columns (INTEGER, DATE, BIGINT,
+// DOUBLE) against a constant, with AVX2 and AVX-512 implementations chosen
+// at run time and a portable scalar fallback.
+//
+// Each kernel can produce a bitmap (one bit per row, 64 rows per word) or
+// write the matching row numbers straight into a selection vector, which the
+// wide kernels do by compressing a vector of row numbers with the compare
+// mask. When a batch already has a selection, the refine kernel narrows it in
+// place instead, since only the selected rows need to be compared.
+
+enum class CompareOp { EQ, NE, LT, LE, GT, GE };
+
+enum class SimdLevel { SCALAR, AVX2, AVX512 };
+
+// Best level supported by both the CPU and the compiler. Detected once.
+SimdLevel detectSimdLevel();
+
+const char *simdLevelName(SimdLevel level);
+
+// Sets bit i of bitmap[i / 64] iff column[i] op *constant, for i < n. Bits
+// past n in the last word are zero.
+typedef void (*CompareBitmapFn)(const void *column, const void *constant, size_t n, uint64_t *bitmap);
+
+// Writes every i < n with column[i] op *constant to 'selection' in order and
+// returns the count. 'selection' must have room for n entries.
+typedef size_t (*CompareSelectFn)(const void *column, const void *constant, size_t n, uint32_t *selection);
+
+// Keeps the rows of selection[0..n) for which column[row] op *constant and
+// returns how many are left.
+typedef size_t (*CompareRefineFn)(const void *column, const void *constant, uint32_t *selection, size_t n);
+
+struct FilterKernel {
+    CompareBitmapFn bitmap = nullptr;
+    CompareSelectFn select = nullptr;
+    CompareRefineFn refine = nullptr;
+};
+
+// Kernel for 'type' at 'level' (capped at what the CPU supports). Members are
+// null if 'type' is not a fixed-width numeric type.
+FilterKernel getFilterKernel(TypeId type, CompareOp op, SimdLevel level = detectSimdLevel());
+
+// Writes base + i for every set bit i to 'selection' and returns the count.
+size_t bitmapToSelection(const uint64_t *bitmap, size_t n, uint32_t *selection, uint32_t base = 0);
+
+// The operator with its operands swapped: (c < x) is (x > c).
+inline CompareOp mirrorCompareOp(CompareOp op) {
+    switch (op) {
+    case CompareOp::LT: return CompareOp::GT;
+    case CompareOp::LE: return CompareOp::GE;
+    case CompareOp::GT: return CompareOp::LT;
+    case CompareOp::GE: return CompareOp::LE;
+    default:            return op;
+    }
+}
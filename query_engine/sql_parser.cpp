@@ -0,0 +1,773 @@
+#include "sql_parser.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+// Civil-date conversion (proleptic Gregorian calendar).
+static int32_t daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+bool parseDate(const std::string &text, int32_t &days) {
+    int year, month, day;
+    char extra;
+    if (std::sscanf(text.c_str(), "%d-%d-%d%c", &year, &month, &day, &extra) != 3)
+        return false;
+    if (month < 1 || month > 12 || day < 1 || day > 31)
+        return false;
+    days = daysFromCivil(year, month, day);
+    return true;
+}
+
+std::string formatDate(int32_t days) {
+    int z = days + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int dayOfEra = z - era * 146097;
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int year = yearOfEra + era * 400;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int mp = (5 * dayOfYear + 2) / 153;
+    int day = dayOfYear - (153 * mp + 2) / 5 + 1;
+    int month = mp + (mp < 10 ? 3 : -9);
+    year += month <= 2;
+    char buffer[40];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
+    return buffer;
+}
+
+static std::string lower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+static const char *functionName(AggregateFunction function) {
+    switch (function) {
+    case AggregateFunction::COUNT: return "count";
+    case AggregateFunction::SUM:   return "sum";
+    case AggregateFunction::MIN:   return "min";
+    case AggregateFunction::MAX:   return "max";
+    case AggregateFunction::AVG:   return "avg";
+    }
+    return "?";
+}
+
+static const char *binarySymbol(BinaryOp op) {
+    switch (op) {
+    case BinaryOp::ADD: return "+";
+    case BinaryOp::SUB: return "-";
+    case BinaryOp::MUL: return "*";
+    case BinaryOp::DIV: return "/";
+    case BinaryOp::EQ:  return "=";
+    case BinaryOp::NE:  return "<>";
+    case BinaryOp::LT:  return "<";
+    case BinaryOp::LE:  return "<=";
+    case BinaryOp::GT:  return ">";
+    case BinaryOp::GE:  return ">=";
+    case BinaryOp::AND: return "and";
+    case BinaryOp::OR:  return "or";
+    }
+    return "?";
+}
+
+std::unique_ptr<AstExpr> AstExpr::clone() const {
+    std::unique_ptr<AstExpr> copy(new AstExpr(kind));
+    copy->table = table;
+    copy->name = name;
+    copy->literal = literal;
+    copy->parameterIndex = parameterIndex;
+    copy->op = op;
+    copy->function = function;
+    if (lhs)
+        copy->lhs = lhs->clone();
+    if (rhs)
+        copy->rhs = rhs->clone();
+    return copy;
+}
+
+std::string AstExpr::toString() const {
+    switch (kind) {
+    case AstKind::COLUMN:
+        return table.empty() ? name : table + "." + name;
+    case AstKind::LITERAL:
+        if (literal.type == TypeId::VARCHAR)
+            return "'" + literal.text + "'";
+        if (literal.type == TypeId::DATE)
+            return "date '" + formatDate(static_cast<int32_t>(literal.integer)) + "'";
+        return literal.toString();
+    case AstKind::PARAMETER:
+        return "?";
+    case AstKind::STAR:
+        return "*";
+    case AstKind::AGGREGATE:
+        return std::string(functionName(function)) + "(" + lhs->toString() + ")";
+    case AstKind::BINARY: {
+        auto side = [](const AstExpr &e) {
+            return e.kind == AstKind::BINARY ? "(" + e.toString() + ")" : e.toString();
+        };
+        return side(*lhs) + " " + binarySymbol(op) + " " + side(*rhs);
+    }
+    }
+    return "";
+}
+
+namespace {
+
+enum class TokenType { IDENTIFIER, NUMBER, STRING, SYMBOL, PARAMETER, END };
+
+struct Token {
+    TokenType type;
+    std::string text;  // Upper-cased for identifiers, raw otherwise.
+    std::string raw;
+};
+
+bool tokenize(const std::string &sql, ArenaVector<Token> &tokens, std::string &error) {
+    size_t i = 0;
+    while (i < sql.size()) {
+        char c = sql[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            ++i;
+        } else if (c == '-' && i + 1 < sql.size() && sql[i + 1] == '-') {
+            while (i < sql.size() && sql[i] != '\n')
+                ++i;
+        } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t start = i;
+            while (i < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[i])) || sql[i] == '_'))
+                ++i;
+            std::string raw = sql.substr(start, i - start);
+            std::string upper = raw;
+            std::transform(upper.begin(), upper.end(), upper.begin(),
+                           [](unsigned char ch) { return static_cast<char>(std::toupper(ch)); });
+            tokens.push_back(Token{TokenType::IDENTIFIER, upper, raw});
+        } else if (std::isdigit(static_cast<unsigned char>(c)) ||
+                   (c == '.' && i + 1 < sql.size() && std::isdigit(static_cast<unsigned char>(sql[i + 1])))) {
+            size_t start = i;
+            while (i < sql.size() && (std::isdigit(static_cast<unsigned char>(sql[i])) || sql[i] == '.' ||
+                                      sql[i] == 'e' || sql[i] == 'E'))
+                ++i;
+            std::string text = sql.substr(start, i - start);
+            tokens.push_back(Token{TokenType::NUMBER, text, text});
+        } else if (c == '\'') {
+            std::string text;
+            ++i;
+            while (true) {
+                if (i >= sql.size()) {
+                    error = "unterminated string literal";
+                    return false;
+                }
+                if (sql[i] == '\'') {
+                    if (i + 1 < sql.size() && sql[i + 1] == '\'') {
+                        text += '\'';
+                        i += 2;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                text += sql[i++];
+            }
+            tokens.push_back(Token{TokenType::STRING, text, text});
+        } else if (c == '?') {
+            tokens.push_back(Token{TokenType::PARAMETER, "?", "?"});
+            ++i;
+        } else {
+            static const char *twoChar[] = {"<=", ">=", "<>", "!="};
+            std::string symbol(1, c);
+            for (const char *op : twoChar)
+                if (sql.compare(i, 2, op) == 0)
+                    symbol = op;
+            if (symbol.size() == 1 && std::string("(),.;*+-/=<>").find(c) == std::string::npos) {
+                error = std::string("unexpected character '") + c + "'";
+                return false;
+            }
+            tokens.push_back(Token{TokenType::SYMBOL, symbol, symbol});
+            i += symbol.size();
+        }
+    }
+    tokens.push_back(Token{TokenType::END, "", ""});
+    return true;
+}
+
+class Parser {
+public:
+    Parser(ArenaVector<Token> tokens) : tokens_(std::move(tokens)), pos_(0), numParameters_(0) {}
+
+    std::unique_ptr<Statement> parseStatement(std::string &error);
+
+private:
+    const Token &peek(size_t ahead = 0) const {
+        return tokens_[std::min(pos_ + ahead, tokens_.size() - 1)];
+    }
+    bool isKeyword(const char *keyword, size_t ahead = 0) const {
+        return peek(ahead).type == TokenType::IDENTIFIER && peek(ahead).text == keyword;
+    }
+    bool isSymbol(const char *symbol) const {
+        return peek().type == TokenType::SYMBOL && peek().text == symbol;
+    }
+    bool acceptKeyword(const char *keyword) {
+        if (!isKeyword(keyword))
+            return false;
+        ++pos_;
+        return true;
+    }
+    bool acceptSymbol(const char *symbol) {
+        if (!isSymbol(symbol))
+            return false;
+        ++pos_;
+        return true;
+    }
+    bool expectKeyword(const char *keyword) {
+        if (acceptKeyword(keyword))
+            return true;
+        fail(std::string("expected ") + keyword);
+        return false;
+    }
+    bool expectSymbol(const char *symbol) {
+        if (acceptSymbol(symbol))
+            return true;
+        fail(std::string("expected '") + symbol + "'");
+        return false;
+    }
+    void fail(const std::string &message) {
+        if (error_.empty())
+            error_ = message + (peek().type == TokenType::END ? " at end of input" : " near '" + peek().raw + "'");
+    }
+    bool isReserved(const Token &token) const;
+    bool parseIdentifier(std::string &name);
+
+    std::unique_ptr<SelectStatement> parseSelect();
+    std::unique_ptr<InsertStatement> parseInsert();
+    std::unique_ptr<UpdateStatement> parseUpdate();
+    std::unique_ptr<DeleteStatement> parseDelete();
+    std::unique_ptr<CreateTableStatement> parseCreateTable();
+    std::unique_ptr<CreateIndexStatement> parseCreateIndex();
+    std::unique_ptr<CreateViewStatement> parseCreateView();
+    bool parseTableRef(TableRef &ref);
+
+    std::unique_ptr<AstExpr> parseExpr() { return parseOr(); }
+    std::unique_ptr<AstExpr> parseOr();
+    std::unique_ptr<AstExpr> parseAnd();
+    std::unique_ptr<AstExpr> parseNot();
+    std::unique_ptr<AstExpr> parseComparison();
+    std::unique_ptr<AstExpr> parseAdditive();
+    std::unique_ptr<AstExpr> parseTerm();
+    std::unique_ptr<AstExpr> parseUnary();
+    std::unique_ptr<AstExpr> parsePrimary();
+
+    static std::unique_ptr<AstExpr> makeBinary(BinaryOp op, std::unique_ptr<AstExpr> lhs,
+                                               std::unique_ptr<AstExpr> rhs) {
+        std::unique_ptr<AstExpr> expr(new AstExpr(AstKind::BINARY));
+        expr->op = op;
+        expr->lhs = std::move(lhs);
+        expr->rhs = std::move(rhs);
+        return expr;
+    }
+    static std::unique_ptr<AstExpr> makeLiteral(const Value &value) {
+        std::unique_ptr<AstExpr> expr(new AstExpr(AstKind::LITERAL));
+        expr->literal = value;
+        return expr;
+    }
+
+    ArenaVector<Token> tokens_;
+    size_t pos_;
+    int numParameters_;
+    std::string error_;
+};
+
+bool Parser::isReserved(const Token &token) const {
+    static const char *reserved[] = {"SELECT", "FROM", "WHERE", "JOIN", "INNER", "ON", "GROUP", "ORDER",
+                                     "BY", "LIMIT", "AS", "SET", "VALUES", "AND", "OR", "NOT", "ASC",
+                                     "DESC", "INSERT", "UPDATE", "DELETE", "INTO", "CREATE", "TABLE"};
+    if (token.type != TokenType::IDENTIFIER)
+        return false;
+    for (const char *word : reserved)
+        if (token.text == word)
+            return true;
+    return false;
+}
+
+bool Parser::parseIdentifier(std::string &name) {
+    if (peek().type != TokenType::IDENTIFIER || isReserved(peek())) {
+        fail("expected identifier");
+        return false;
+    }
+    name = lower(peek().raw);
+    ++pos_;
+    return true;
+}
+
+std::unique_ptr<Statement> Parser::parseStatement(std::string &error) {
+    std::unique_ptr<Statement> statement(new Statement());
+    bool ok = false;
+    if (acceptKeyword("EXPLAIN")) {
+        statement->explain = acceptKeyword("ANALYZE") ? ExplainMode::ANALYZE : ExplainMode::PLAN;
+        if (!isKeyword("SELECT") && !isKeyword("UPDATE") && !isKeyword("DELETE")) {
+            fail("expected SELECT, UPDATE or DELETE");
+            error = error_;
+            return nullptr;
+        }
+    }
+    if (acceptKeyword("SELECT")) {
+        statement->kind = StatementKind::SELECT;
+        statement->select = parseSelect();
+        ok = statement->select != nullptr;
+    } else if (acceptKeyword("INSERT")) {
+        statement->kind = StatementKind::INSERT;
+        statement->insert = parseInsert();
+        ok = statement->insert != nullptr;
+    } else if (acceptKeyword("UPDATE")) {
+        statement->kind = StatementKind::UPDATE;
+        statement->update = parseUpdate();
+        ok = statement->update != nullptr;
+    } else if (acceptKeyword("DELETE")) {
+        statement->kind = StatementKind::DELETE;
+        statement->remove = parseDelete();
+        ok = statement->remove != nullptr;
+    } else if (acceptKeyword("CREATE")) {
+        if (acceptKeyword("INDEX")) {
+            statement->kind = StatementKind::CREATE_INDEX;
+            statement->createIndex = parseCreateIndex();
+            ok = statement->createIndex != nullptr;
+        } else if (acceptKeyword("MATERIALIZED")) {
+            statement->kind = StatementKind::CREATE_VIEW;
+            statement->createView = parseCreateView();
+            ok = statement->createView != nullptr;
+        } else {
+            statement->kind = StatementKind::CREATE_TABLE;
+            statement->createTable = parseCreateTable();
+            ok = statement->createTable != nullptr;
+        }
+    } else if (acceptKeyword("ANALYZE")) {
+        statement->kind = StatementKind::ANALYZE;
+        statement->analyze.reset(new AnalyzeStatement());
+        ok = peek().type != TokenType::IDENTIFIER || parseIdentifier(statement->analyze->table);
+    } else {
+        fail("expected SELECT, INSERT, UPDATE, DELETE, CREATE or ANALYZE");
+    }
+    if (ok) {
+        acceptSymbol(";");
+        if (peek().type != TokenType::END) {
+            fail("unexpected input");
+            ok = false;
+        }
+    }
+    if (!ok) {
+        error = error_.empty() ? "syntax error" : error_;
+        return nullptr;
+    }
+    statement->numParameters = numParameters_;
+    return statement;
+}
+
+bool Parser::parseTableRef(TableRef &ref) {
+    if (!parseIdentifier(ref.name))
+        return false;
+    ref.alias = ref.name;
+    if (acceptKeyword("AS"))
+        return parseIdentifier(ref.alias);
+    if (peek().type == TokenType::IDENTIFIER && !isReserved(peek()))
+        return parseIdentifier(ref.alias);
+    return true;
+}
+
+std::unique_ptr<SelectStatement> Parser::parseSelect() {
+    std::unique_ptr<SelectStatement> select(new SelectStatement());
+    do {
+        SelectItem item;
+        if (acceptSymbol("*")) {
+            item.expr.reset(new AstExpr(AstKind::STAR));
+        } else {
+            item.expr = parseExpr();
+            if (!item.expr)
+                return nullptr;
+            if (acceptKeyword("AS")) {
+                if (!parseIdentifier(item.alias))
+                    return nullptr;
+            } else if (peek().type == TokenType::IDENTIFIER && !isReserved(peek())) {
+                parseIdentifier(item.alias);
+            }
+        }
+        select->items.push_back(std::move(item));
+    } while (acceptSymbol(","));
+
+    if (!expectKeyword("FROM") || !parseTableRef(select->from))
+        return nullptr;
+
+    while (isKeyword("JOIN") || isKeyword("INNER")) {
+        acceptKeyword("INNER");
+        if (!expectKeyword("JOIN"))
+            return nullptr;
+        JoinClause join;
+        if (!parseTableRef(join.table) || !expectKeyword("ON"))
+            return nullptr;
+        join.condition = parseExpr();
+        if (!join.condition)
+            return nullptr;
+        select->joins.push_back(std::move(join));
+    }
+
+    if (acceptKeyword("WHERE")) {
+        select->where = parseExpr();
+        if (!select->where)
+            return nullptr;
+    }
+    if (acceptKeyword("GROUP")) {
+        if (!expectKeyword("BY"))
+            return nullptr;
+        do {
+            std::unique_ptr<AstExpr> expr = parseExpr();
+            if (!expr)
+                return nullptr;
+            select->groupBy.push_back(std::move(expr));
+        } while (acceptSymbol(","));
+    }
+    if (acceptKeyword("ORDER")) {
+        if (!expectKeyword("BY"))
+            return nullptr;
+        do {
+            OrderItem item;
+            item.expr = parseExpr();
+            if (!item.expr)
+                return nullptr;
+            item.ascending = true;
+            if (acceptKeyword("DESC"))
+                item.ascending = false;
+            else
+                acceptKeyword("ASC");
+            select->orderBy.push_back(std::move(item));
+        } while (acceptSymbol(","));
+    }
+    if (acceptKeyword("LIMIT")) {
+        if (peek().type != TokenType::NUMBER) {
+            fail("expected number");
+            return nullptr;
+        }
+        select->limit = std::atoll(peek().text.c_str());
+        ++pos_;
+    }
+    return select;
+}
+
+std::unique_ptr<InsertStatement> Parser::parseInsert() {
+    std::unique_ptr<InsertStatement> insert(new InsertStatement());
+    if (!expectKeyword("INTO") || !parseIdentifier(insert->table))
+        return nullptr;
+    if (acceptSymbol("(")) {
+        do {
+            std::string column;
+            if (!parseIdentifier(column))
+                return nullptr;
+            insert->columns.push_back(column);
+        } while (acceptSymbol(","));
+        if (!expectSymbol(")"))
+            return nullptr;
+    }
+    if (!expectKeyword("VALUES"))
+        return nullptr;
+    do {
+        if (!expectSymbol("("))
+            return nullptr;
+        std::vector<std::unique_ptr<AstExpr>> row;
+        do {
+            std::unique_ptr<AstExpr> value = parseExpr();
+            if (!value)
+                return nullptr;
+            row.push_back(std::move(value));
+        } while (acceptSymbol(","));
+        if (!expectSymbol(")"))
+            return nullptr;
+        insert->rows.push_back(std::move(row));
+    } while (acceptSymbol(","));
+    return insert;
+}
+
+std::unique_ptr<UpdateStatement> Parser::parseUpdate() {
+    std::unique_ptr<UpdateStatement> update(new UpdateStatement());
+    if (!parseIdentifier(update->table) || !expectKeyword("SET"))
+        return nullptr;
+    do {
+        std::string column;
+        if (!parseIdentifier(column) || !expectSymbol("="))
+            return nullptr;
+        std::unique_ptr<AstExpr> value = parseExpr();
+        if (!value)
+            return nullptr;
+        update->assignments.emplace_back(column, std::move(value));
+    } while (acceptSymbol(","));
+    if (acceptKeyword("WHERE")) {
+        update->where = parseExpr();
+        if (!update->where)
+            return nullptr;
+    }
+    return update;
+}
+
+std::unique_ptr<DeleteStatement> Parser::parseDelete() {
+    std::unique_ptr<DeleteStatement> remove(new DeleteStatement());
+    if (!expectKeyword("FROM") || !parseIdentifier(remove->table))
+        return nullptr;
+    if (acceptKeyword("WHERE")) {
+        remove->where = parseExpr();
+        if (!remove->where)
+            return nullptr;
+    }
+    return remove;
+}
+
+std::unique_ptr<CreateTableStatement> Parser::parseCreateTable() {
+    std::unique_ptr<CreateTableStatement> create(new CreateTableStatement());
+    if (!expectKeyword("TABLE") || !parseIdentifier(create->table) || !expectSymbol("("))
+        return nullptr;
+    do {
+        Column column;
+        if (!parseIdentifier(column.name))
+            return nullptr;
+        if (peek().type != TokenType::IDENTIFIER) {
+            fail("expected column type");
+            return nullptr;
+        }
+        std::string type = peek().text;
+        ++pos_;
+        if (type == "INT" || type == "INTEGER")
+            column.type = TypeId::INTEGER;
+        else if (type == "BIGINT")
+            column.type = TypeId::BIGINT;
+        else if (type == "DOUBLE" || type == "FLOAT" || type == "REAL")
+            column.type = TypeId::DOUBLE;
+        else if (type == "DATE")
+            column.type = TypeId::DATE;
+        else if (type == "VARCHAR" || type == "TEXT" || type == "CHAR")
+            column.type = TypeId::VARCHAR;
+        else if (type == "BOOLEAN" || type == "BOOL")
+            column.type = TypeId::BOOLEAN;
+        else {
+            --pos_;
+            fail("unknown column type");
+            return nullptr;
+        }
+        // Length modifiers such as VARCHAR(20) are accepted and ignored.
+        if (acceptSymbol("(")) {
+            if (peek().type != TokenType::NUMBER) {
+                fail("expected number");
+                return nullptr;
+            }
+            ++pos_;
+            if (!expectSymbol(")"))
+                return nullptr;
+        }
+        create->columns.push_back(column);
+    } while (acceptSymbol(","));
+    if (!expectSymbol(")"))
+        return nullptr;
+    return create;
+}
+
+std::unique_ptr<CreateIndexStatement> Parser::parseCreateIndex() {
+    std::unique_ptr<CreateIndexStatement> create(new CreateIndexStatement());
+    if (!parseIdentifier(create->index) || !expectKeyword("ON") || !parseIdentifier(create->table) ||
+        !expectSymbol("(") || !parseIdentifier(create->column) || !expectSymbol(")"))
+        return nullptr;
+    return create;
+}
+
+std::unique_ptr<CreateViewStatement> Parser::parseCreateView() {
+    std::unique_ptr<CreateViewStatement> create(new CreateViewStatement());
+    if (!expectKeyword("VIEW") || !parseIdentifier(create->view) || !expectKeyword("AS") ||
+        !expectKeyword("SELECT"))
+        return nullptr;
+    create->select = parseSelect();
+    return create->select ? std::move(create) : nullptr;
+}
+
+std::unique_ptr<AstExpr> Parser::parseOr() {
+    std::unique_ptr<AstExpr> lhs = parseAnd();
+    while (lhs && acceptKeyword("OR")) {
+        std::unique_ptr<AstExpr> rhs = parseAnd();
+        if (!rhs)
+            return nullptr;
+        lhs = makeBinary(BinaryOp::OR, std::move(lhs), std::move(rhs));
+    }
+    return lhs;
+}
+
+std::unique_ptr<AstExpr> Parser::parseAnd() {
+    std::unique_ptr<AstExpr> lhs = parseNot();
+    while (lhs && acceptKeyword("AND")) {
+        std::unique_ptr<AstExpr> rhs = parseNot();
+        if (!rhs)
+            return nullptr;
+        lhs = makeBinary(BinaryOp::AND, std::move(lhs), std::move(rhs));
+    }
+    return lhs;
+}
+
+std::unique_ptr<AstExpr> Parser::parseNot() {
+    if (acceptKeyword("NOT")) {
+        std::unique_ptr<AstExpr> operand = parseNot();
+        if (!operand)
+            return nullptr;
+        return makeBinary(BinaryOp::EQ, std::move(operand), makeLiteral(Value::makeBoolean(false)));
+    }
+    return parseComparison();
+}
+
+std::unique_ptr<AstExpr> Parser::parseComparison() {
+    std::unique_ptr<AstExpr> lhs = parseAdditive();
+    if (!lhs)
+        return nullptr;
+    if (acceptKeyword("BETWEEN")) {
+        // a BETWEEN x AND y  ==>  a >= x AND a <= y
+        std::unique_ptr<AstExpr> low = parseAdditive();
+        if (!low || !expectKeyword("AND"))
+            return nullptr;
+        std::unique_ptr<AstExpr> high = parseAdditive();
+        if (!high)
+            return nullptr;
+        std::unique_ptr<AstExpr> copy = lhs->clone();
+        return makeBinary(BinaryOp::AND, makeBinary(BinaryOp::GE, std::move(lhs), std::move(low)),
+                          makeBinary(BinaryOp::LE, std::move(copy), std::move(high)));
+    }
+    static const struct { const char *symbol; BinaryOp op; } comparisons[] = {
+        {"=", BinaryOp::EQ}, {"<>", BinaryOp::NE}, {"!=", BinaryOp::NE}, {"<", BinaryOp::LT},
+        {"<=", BinaryOp::LE}, {">", BinaryOp::GT}, {">=", BinaryOp::GE}};
+    for (const auto &comparison : comparisons) {
+        if (acceptSymbol(comparison.symbol)) {
+            std::unique_ptr<AstExpr> rhs = parseAdditive();
+            if (!rhs)
+                return nullptr;
+            return makeBinary(comparison.op, std::move(lhs), std::move(rhs));
+        }
+    }
+    return lhs;
+}
+
+std::unique_ptr<AstExpr> Parser::parseAdditive() {
+    std::unique_ptr<AstExpr> lhs = parseTerm();
+    while (lhs && (isSymbol("+") || isSymbol("-"))) {
+        BinaryOp op = acceptSymbol("+") ? BinaryOp::ADD : (acceptSymbol("-"), BinaryOp::SUB);
+        std::unique_ptr<AstExpr> rhs = parseTerm();
+        if (!rhs)
+            return nullptr;
+        lhs = makeBinary(op, std::move(lhs), std::move(rhs));
+    }
+    return lhs;
+}
+
+std::unique_ptr<AstExpr> Parser::parseTerm() {
+    std::unique_ptr<AstExpr> lhs = parseUnary();
+    while (lhs && (isSymbol("*") || isSymbol("/"))) {
+        BinaryOp op = acceptSymbol("*") ? BinaryOp::MUL : (acceptSymbol("/"), BinaryOp::DIV);
+        std::unique_ptr<AstExpr> rhs = parseUnary();
+        if (!rhs)
+            return nullptr;
+        lhs = makeBinary(op, std::move(lhs), std::move(rhs));
+    }
+    return lhs;
+}
+
+std::unique_ptr<AstExpr> Parser::parseUnary() {
+    if (acceptSymbol("-")) {
+        std::unique_ptr<AstExpr> operand = parseUnary();
+        if (!operand)
+            return nullptr;
+        if (operand->kind == AstKind::LITERAL && isNumeric(operand->literal.type)) {
+            operand->literal.integer = -operand->literal.integer;
+            operand->literal.real = -operand->literal.real;
+            return operand;
+        }
+        return makeBinary(BinaryOp::SUB, makeLiteral(Value::makeInteger(0)), std::move(operand));
+    }
+    return parsePrimary();
+}
+
+std::unique_ptr<AstExpr> Parser::parsePrimary() {
+    const Token &token = peek();
+    if (token.type == TokenType::NUMBER) {
+        ++pos_;
+        if (token.text.find_first_of(".eE") != std::string::npos)
+            return makeLiteral(Value::makeDouble(std::atof(token.text.c_str())));
+        long long value = std::atoll(token.text.c_str());
+        if (value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max())
+            return makeLiteral(Value::makeInteger(static_cast<int32_t>(value)));
+        return makeLiteral(Value::makeBigint(value));
+    }
+    if (token.type == TokenType::STRING) {
+        ++pos_;
+        return makeLiteral(Value::makeVarchar(token.text));
+    }
+    if (token.type == TokenType::PARAMETER) {
+        ++pos_;
+        std::unique_ptr<AstExpr> expr(new AstExpr(AstKind::PARAMETER));
+        expr->parameterIndex = numParameters_++;
+        return expr;
+    }
+    if (acceptSymbol("(")) {
+        std::unique_ptr<AstExpr> expr = parseExpr();
+        if (!expr || !expectSymbol(")"))
+            return nullptr;
+        return expr;
+    }
+    if (token.type != TokenType::IDENTIFIER) {
+        fail("expected expression");
+        return nullptr;
+    }
+    if (token.text == "TRUE" || token.text == "FALSE") {
+        ++pos_;
+        return makeLiteral(Value::makeBoolean(token.text == "TRUE"));
+    }
+    if (token.text == "DATE" && peek(1).type == TokenType::STRING) {
+        int32_t days;
+        if (!parseDate(peek(1).text, days)) {
+            ++pos_;
+            fail("invalid date");
+            return nullptr;
+        }
+        pos_ += 2;
+        return makeLiteral(Value::makeDate(days));
+    }
+    static const struct { const char *name; AggregateFunction function; } aggregates[] = {
+        {"COUNT", AggregateFunction::COUNT}, {"SUM", AggregateFunction::SUM}, {"MIN", AggregateFunction::MIN},
+        {"MAX", AggregateFunction::MAX}, {"AVG", AggregateFunction::AVG}};
+    for (const auto &aggregate : aggregates) {
+        if (token.text == aggregate.name && peek(1).type == TokenType::SYMBOL && peek(1).text == "(") {
+            pos_ += 2;
+            std::unique_ptr<AstExpr> expr(new AstExpr(AstKind::AGGREGATE));
+            expr->function = aggregate.function;
+            if (aggregate.function == AggregateFunction::COUNT && acceptSymbol("*"))
+                expr->lhs.reset(new AstExpr(AstKind::STAR));
+            else
+                expr->lhs = parseExpr();
+            if (!expr->lhs || !expectSymbol(")"))
+                return nullptr;
+            return expr;
+        }
+    }
+    std::unique_ptr<AstExpr> expr(new AstExpr(AstKind::COLUMN));
+    if (!parseIdentifier(expr->name))
+        return nullptr;
+    if (acceptSymbol(".")) {
+        expr->table = expr->name;
+        if (!parseIdentifier(expr->name))
+            return nullptr;
+    }
+    return expr;
+}
+
+} // namespace
+
+std::unique_ptr<Statement> SqlParser::parse(const std::string &sql, std::string &error) {
+    // The tokens are only needed while parsing; the AST outlives them.
+    Arena arena(4096);
+    ArenaVector<Token> tokens(&arena);
+    if (!tokenize(sql, tokens, error))
+        return nullptr;
+    Parser parser(std::move(tokens));
+    return parser.parseStatement(error);
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "expression.h"
+#include "hashaggregate.h"
+#include "schema.h"
+
+// Abstract syntax tree of the supported SQL subset:
+//
+//   CREATE TABLE t (col type, ...)
+//   CREATE INDEX name ON t (col)
+//   CREATE MATERIALIZED VIEW name AS select
+//   ANALYZE [t]
+//   INSERT INTO t [(col, ...)] VALUES (expr, ...), ...
+//   SELECT items FROM t [alias] [JOIN u [alias] ON cond]... [WHERE cond]
+//          [GROUP BY expr] [ORDER BY expr [ASC|DESC], ...] [LIMIT n]
+//   UPDATE t SET col = expr, ... [WHERE cond]
+//   DELETE FROM t [WHERE cond]
+//   EXPLAIN [ANALYZE] select, update or delete statement
+//
+// '?' placeholders may appear wherever a literal can.
+
+enum class AstKind { COLUMN, LITERAL, PARAMETER, BINARY, AGGREGATE, STAR };
+
+struct AstExpr {
+    AstKind kind;
+    std::string table;    // COLUMN: optional qualifier.
+    std::string name;     // COLUMN: column name.
+    Value literal;        // LITERAL.
+    int parameterIndex;   // PARAMETER: 0-based position.
+    BinaryOp op;          // BINARY.
+    AggregateFunction function; // AGGREGATE; its argument is 'lhs' (STAR for COUNT(*)).
+    std::unique_ptr<AstExpr> lhs;
+    std::unique_ptr<AstExpr> rhs;
+
+    explicit AstExpr(AstKind k) : kind(k), parameterIndex(-1), op(BinaryOp::ADD),
+                                  function(AggregateFunction::COUNT) {}
+
+    std::unique_ptr<AstExpr> clone() const;
+
+    // Canonical text, used for output column names and to match identical
+    // expressions (e.g. an ORDER BY item against a select item).
+    std::string toString() const;
+};
+
+struct SelectItem {
+    std::unique_ptr<AstExpr> expr;
+    std::string alias;
+};
+
+struct TableRef {
+    std::string name;
+    std::string alias; // Equals 'name' when no alias is given.
+};
+
+struct JoinClause {
+    TableRef table;
+    std::unique_ptr<AstExpr> condition;
+};
+
+struct OrderItem {
+    std::unique_ptr<AstExpr> expr;
+    bool ascending;
+};
+
+struct SelectStatement {
+    std::vector<SelectItem> items;
+    TableRef from;
+    std::vector<JoinClause> joins;
+    std::unique_ptr<AstExpr> where;
+    std::vector<std::unique_ptr<AstExpr>> groupBy;
+    std::vector<OrderItem> orderBy;
+    int64_t limit = -1;
+};
+
+struct InsertStatement {
+    std::string table;
+    std::vector<std::string> columns; // Empty means all columns in order.
+    std::vector<std::vector<std::unique_ptr<AstExpr>>> rows;
+};
+
+struct UpdateStatement {
+    std::string table;
+    std::vector<std::pair<std::string, std::unique_ptr<AstExpr>>> assignments;
+    std::unique_ptr<AstExpr> where;
+};
+
+struct DeleteStatement {
+    std::string table;
+    std::unique_ptr<AstExpr> where;
+};
+
+struct CreateTableStatement {
+    std::string table;
+    std::vector<Column> columns;
+};
+
+struct CreateIndexStatement {
+    std::string index;
+    std::string table;
+    std::string column;
+};
+
+struct CreateViewStatement {
+    std::string view;
+    std::unique_ptr<SelectStatement> select;
+};
+
+struct AnalyzeStatement {
+    std::string table; // Empty means every table.
+};
+
+enum class StatementKind { SELECT, INSERT, UPDATE, DELETE, CREATE_TABLE, CREATE_INDEX, CREATE_VIEW,
+                           ANALYZE };
+
+// EXPLAIN shows the plan instead of running the statement; EXPLAIN ANALYZE
+// runs it and shows the plan with what every operator spent.
+enum class ExplainMode { NONE, PLAN, ANALYZE };
+
+struct Statement {
+    StatementKind kind;
+    ExplainMode explain = ExplainMode::NONE;
+    int numParameters = 0;
+    std::unique_ptr<SelectStatement> select;
+    std::unique_ptr<InsertStatement> insert;
+    std::unique_ptr<UpdateStatement> update;
+    std::unique_ptr<DeleteStatement> remove;
+    std::unique_ptr<CreateTableStatement> createTable;
+    std::unique_ptr<CreateIndexStatement> createIndex;
+    std::unique_ptr<CreateViewStatement> createView;
+    std::unique_ptr<AnalyzeStatement> analyze;
+};
+
+// Recursive-descent parser. Keywords and identifiers are case-insensitive;
+// identifiers are folded to lower case.
+class SqlParser {
+public:
+    // Returns nullptr and sets 'error' if 'sql' is not valid.
+    static std::unique_ptr<Statement> parse(const std::string &sql, std::string &error);
+};
+
+// Days since 1970-01-01 for a 'YYYY-MM-DD' string. Returns false if malformed.
+bool parseDate(const std::string &text, int32_t &days);
+std::string formatDate(int32_t days);
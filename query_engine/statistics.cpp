@@ -0,0 +1,199 @@
+#include "statistics.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include "operators.h"
+
+HyperLogLog::HyperLogLog(int precision)
+    : precision_(precision), registers_(size_t(1) << precision, 0)
+{
+}
+
+void HyperLogLog::add(uint64_t hash) {
+    size_t index = hash >> (64 - precision_);
+    // Rank of the first set bit among the remaining bits; the guard bit caps it.
+    uint64_t rest = (hash << precision_) | (uint64_t(1) << (precision_ - 1));
+    uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+    registers_[index] = std::max(registers_[index], rank);
+}
+
+void HyperLogLog::merge(const HyperLogLog &other) {
+    for (size_t i = 0; i < registers_.size() && i < other.registers_.size(); ++i)
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+}
+
+double HyperLogLog::estimate() const {
+    double m = static_cast<double>(registers_.size());
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t r : registers_) {
+        sum += std::ldexp(1.0, -r);
+        zeros += r == 0;
+    }
+    double alpha = 0.7213 / (1 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    // Small cardinalities: linear counting over the empty registers is
+    // more accurate than the harmonic mean.
+    if (estimate <= 2.5 * m && zeros > 0)
+        estimate = m * std::log(m / zeros);
+    return estimate;
+}
+
+EquiDepthHistogram::EquiDepthHistogram(std::vector<double> values, size_t numBuckets) {
+    if (values.empty() || numBuckets == 0)
+        return;
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    size_t k = std::min(numBuckets, n);
+    for (size_t j = 0; j <= k; ++j)
+        bounds_.push_back(values[j * (n - 1) / k]);
+}
+
+double EquiDepthHistogram::fractionAtMost(double value) const {
+    if (empty() || value < bounds_.front())
+        return 0;
+    if (value >= bounds_.back())
+        return 1;
+    // Buckets before 'i - 1' lie entirely at or below 'value'.
+    size_t i = std::upper_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    double low = bounds_[i - 1], high = bounds_[i];
+    double inside = high > low ? (value - low) / (high - low) : 1;
+    return (static_cast<double>(i - 1) + inside) / getNumBuckets();
+}
+
+double EquiDepthHistogram::fractionOf(double value) const {
+    size_t buckets = 0;
+    for (size_t i = 0; i + 1 < bounds_.size(); ++i)
+        buckets += bounds_[i] == value && bounds_[i + 1] == value;
+    return empty() ? 0 : static_cast<double>(buckets) / getNumBuckets();
+}
+
+double TableStatistics::selectivity(int column, CompareOp op, const Value *value) const {
+    bool range = op != CompareOp::EQ && op != CompareOp::NE;
+    if (column < 0 || static_cast<size_t>(column) >= columns.size())
+        return op == CompareOp::EQ ? kDefaultEqualitySelectivity
+                                   : (op == CompareOp::NE ? 1 - kDefaultEqualitySelectivity
+                                                          : kDefaultRangeSelectivity);
+    const ColumnStatistics &stats = columns[column];
+    double equal = stats.distinctCount >= 1 ? 1 / stats.distinctCount : kDefaultEqualitySelectivity;
+    const EquiDepthHistogram &histogram = stats.histogram;
+    if (value == nullptr || value->type == TypeId::VARCHAR || histogram.empty()) {
+        if (range)
+            return kDefaultRangeSelectivity;
+        return op == CompareOp::EQ ? equal : 1 - equal;
+    }
+
+    double v = value->asDouble();
+    if (v < histogram.getMin() || v > histogram.getMax())
+        equal = 0;
+    else
+        equal = std::max(equal, histogram.fractionOf(v));
+    double atMost = histogram.fractionAtMost(v);
+    double below = std::max(0.0, atMost - equal);
+    double result = 0;
+    switch (op) {
+    case CompareOp::EQ: result = equal; break;
+    case CompareOp::NE: result = 1 - equal; break;
+    case CompareOp::LT: result = below; break;
+    case CompareOp::LE: result = atMost; break;
+    case CompareOp::GT: result = 1 - atMost; break;
+    case CompareOp::GE: result = 1 - below; break;
+    }
+    return std::min(1.0, std::max(0.0, result));
+}
+
+// Distinct values of a table of 'rows' rows given 'distinct' distinct values
+// in a sample of 'sampleRows' of them. Assumes the values are about equally
+// frequent, in which case a sample of n rows is expected to contain
+// D * (1 - exp(-n / D)) distinct values, and solves that for D.
+static double scaleDistinct(double distinct, double sampleRows, double rows) {
+    if (sampleRows <= 0)
+        return 0;
+    // All distinct within the sketch's error: a key-like column.
+    if (distinct >= 0.98 * sampleRows)
+        return rows;
+    auto expected = [&](double d) { return d * (1 - std::exp(-sampleRows / d)); };
+    if (expected(rows) <= distinct)
+        return rows;
+    double low = distinct, high = rows;
+    for (int i = 0; i < 64; ++i) {
+        double mid = (low + high) / 2;
+        if (expected(mid) < distinct)
+            low = mid;
+        else
+            high = mid;
+    }
+    return high;
+}
+
+std::shared_ptr<TableStatistics> analyzeTable(HeapFile &heap, const Schema &schema, const AnalyzeOptions &options,
+                                              std::string &error) {
+    auto stats = std::make_shared<TableStatistics>();
+    std::vector<int> pageIds = heap.getPageIds();
+    stats->pageCount = pageIds.size();
+
+    // Block sample: whole pages, read in physical order.
+    std::mt19937_64 rng(options.seed);
+    if (pageIds.size() > options.samplePages) {
+        for (size_t i = 0; i < options.samplePages; ++i)
+            std::swap(pageIds[i], pageIds[i + rng() % (pageIds.size() - i)]);
+        pageIds.resize(options.samplePages);
+        std::sort(pageIds.begin(), pageIds.end());
+    }
+    stats->sampledPages = pageIds.size();
+
+    size_t numColumns = schema.size();
+    std::vector<HyperLogLog> sketches(numColumns);
+    std::vector<std::vector<double>> samples(numColumns);
+    std::vector<ColumnVector> scratch;
+    for (size_t c = 0; c < numColumns; ++c) {
+        scratch.emplace_back(schema.getColumn(c).type);
+        scratch.back().resize(1);
+    }
+
+    size_t sampleRows = 0;
+    BufferPool *bufferPool = heap.getBufferPool();
+    for (int pageId : pageIds) {
+        Page *page = bufferPool->fixPage(pageId, false);
+        if (page == nullptr) {
+            error = "could not read page " + std::to_string(pageId);
+            return nullptr;
+        }
+        for (int slot = 0; slot < page->getNumberOfSlots(); ++slot) {
+            int length;
+            const char *record = page->getRecordData(slot, length);
+            if (record == nullptr)
+                continue;
+            ++sampleRows;
+            for (size_t c = 0; c < numColumns; ++c) {
+                schema.decodeColumn(record, c, scratch[c], 0);
+                sketches[c].add(hashValueAt(scratch[c], 0));
+                if (!isNumeric(schema.getColumn(c).type))
+                    continue;
+                // Reservoir sampling keeps the histogram input bounded.
+                double value = scratch[c].getValue(0).asDouble();
+                if (samples[c].size() < options.maxHistogramValues) {
+                    samples[c].push_back(value);
+                } else {
+                    size_t j = rng() % sampleRows;
+                    if (j < options.maxHistogramValues)
+                        samples[c][j] = value;
+                }
+            }
+        }
+        bufferPool->unfixPage(page, false);
+    }
+
+    bool complete = stats->sampledPages == stats->pageCount;
+    stats->rowCount = complete || stats->sampledPages == 0
+                          ? static_cast<double>(sampleRows)
+                          : static_cast<double>(sampleRows) * stats->pageCount / stats->sampledPages;
+    stats->columns.resize(numColumns);
+    for (size_t c = 0; c < numColumns; ++c) {
+        double distinct = std::min(sketches[c].estimate(), static_cast<double>(sampleRows));
+        stats->columns[c].distinctCount =
+            complete ? distinct : scaleDistinct(distinct, static_cast<double>(sampleRows), stats->rowCount);
+        stats->columns[c].histogram = EquiDepthHistogram(std::move(samples[c]), options.histogramBuckets);
+    }
+    return stats;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../storage_engine/heapfilemanager.h"
+#include "../storage_engine/memory_tracker.h"
+#include "schema.h"
+#include "simd_filter.h"
+
+// Table statistics collected by ANALYZE and read by the cost-based planner.
+
+// HyperLogLog distinct-value sketch: 2^precision one-byte registers, about
+// 1.04 / sqrt(2^precision) relative error (1.6% with the default 4 KB).
+class HyperLogLog {
+public:
+    explicit HyperLogLog(int precision = 12);
+
+    // 'hash' must be a well-mixed 64-bit hash of the value.
+    void add(uint64_t hash);
+
+    // Combines with a sketch of the same precision, as if all values had been
+    // added to this one.
+    void merge(const HyperLogLog &other);
+
+    double estimate() const;
+
+private:
+    int precision_;
+    std::vector<uint8_t> registers_;
+};
+
+// Equi-depth histogram over numeric values: bucket boundaries chosen so that
+// every bucket holds about the same number of values. A value that is
+// frequent enough to fill whole buckets shows up as repeated boundaries.
+class EquiDepthHistogram {
+public:
+    EquiDepthHistogram() {}
+
+    // Builds up to 'numBuckets' buckets from a sample of the values.
+    EquiDepthHistogram(std::vector<double> values, size_t numBuckets);
+
+    bool empty() const { return bounds_.size() < 2; }
+    size_t getNumBuckets() const { return empty() ? 0 : bounds_.size() - 1; }
+    double getMin() const { return bounds_.front(); }
+    double getMax() const { return bounds_.back(); }
+
+    // Estimated fraction of the values <= 'value', interpolating linearly
+    // inside a bucket.
+    double fractionAtMost(double value) const;
+
+    // Fraction of the buckets that start and end at 'value', i.e. a lower
+    // bound for the frequency of a very common value.
+    double fractionOf(double value) const;
+
+private:
+    // getNumBuckets() + 1 ascending boundaries.
+    TrackedVector<double, MemorySubsystem::CATALOG> bounds_;
+};
+
+struct ColumnStatistics {
+    double distinctCount = 0;
+    EquiDepthHistogram histogram; // Numeric columns only.
+};
+
+// Default selectivities, for columns without statistics and for comparisons
+// with a placeholder whose value is unknown when the plan is built.
+const double kDefaultEqualitySelectivity = 0.005;
+const double kDefaultRangeSelectivity = 1.0 / 3;
+
+struct TableStatistics {
+    double rowCount = 0;
+    size_t pageCount = 0;    // Heap pages when ANALYZE ran.
+    size_t sampledPages = 0;
+    TrackedVector<ColumnStatistics, MemorySubsystem::CATALOG> columns;
+
+    // Estimated fraction of the rows with 'column op value'. 'value' is null
+    // if it is not known yet.
+    double selectivity(int column, CompareOp op, const Value *value) const;
+
+    // Rows per heap page, to scale rowCount to the current size of a table
+    // that has grown or shrunk since ANALYZE.
+    double rowsPerPage() const { return pageCount == 0 ? 0 : rowCount / pageCount; }
+};
+
+struct AnalyzeOptions {
+    size_t samplePages = 256;       // Heap pages read per table; small tables are read whole.
+    size_t histogramBuckets = 64;
+    size_t maxHistogramValues = 30000; // Reservoir sample per column for the histogram.
+    uint64_t seed = 42;
+};
+
+// Reads a random sample of the heap file's pages and estimates row count,
+// distinct values and value distribution of every column. Returns null and
+// sets 'error' if a sampled page cannot be read.
+std::shared_ptr<TableStatistics> analyzeTable(HeapFile &heap, const Schema &schema, const AnalyzeOptions &options,
+                                              std::string &error);
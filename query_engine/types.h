@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Logical column types.
+// INTEGER and DATE share a 32-bit physical representation (DATE counts days
+// since 1970-01-01), BOOLEAN is stored as one byte per value.
+enum class TypeId { INTEGER, BIGINT, DOUBLE, DATE, VARCHAR, BOOLEAN };
+
+// Size in bytes of one value of a fixed-width type (0 for VARCHAR).
+inline size_t typeWidth(TypeId type) {
+    switch (type) {
+    case TypeId::INTEGER: return sizeof(int32_t);
+    case TypeId::DATE:    return sizeof(int32_t);
+    case TypeId::BIGINT:  return sizeof(int64_t);
+    case TypeId::DOUBLE:  return sizeof(double);
+    case TypeId::BOOLEAN: return sizeof(uint8_t);
+    case TypeId::VARCHAR: return 0;
+    }
+    return 0;
+}
+
+inline bool isNumeric(TypeId type) {
+    return type == TypeId::INTEGER || type == TypeId::BIGINT ||
+           type == TypeId::DOUBLE || type == TypeId::DATE;
+}
+
+inline const char* typeName(TypeId type) {
+    switch (type) {
+    case TypeId::INTEGER: return "INTEGER";
+    case TypeId::BIGINT:  return "BIGINT";
+    case TypeId::DOUBLE:  return "DOUBLE";
+    case TypeId::DATE:    return "DATE";
+    case TypeId::VARCHAR: return "VARCHAR";
+    case TypeId::BOOLEAN: return "BOOLEAN";
+    }
+    return "UNKNOWN";
+}
+
+// A single typed value, used for constants and row-at-a-time paths.
+// Integral types (including DATE and BOOLEAN) live in 'integer'.
+struct Value {
+    TypeId type = TypeId::BIGINT;
+    int64_t integer = 0;
+    double real = 0;
+    std::string text;
+
+    static Value makeInteger(int32_t v) { Value r; r.type = TypeId::INTEGER; r.integer = v; return r; }
+    static Value makeBigint(int64_t v)  { Value r; r.type = TypeId::BIGINT; r.integer = v; return r; }
+    static Value makeDouble(double v)   { Value r; r.type = TypeId::DOUBLE; r.real = v; return r; }
+    static Value makeDate(int32_t days) { Value r; r.type = TypeId::DATE; r.integer = days; return r; }
+    static Value makeBoolean(bool v)    { Value r; r.type = TypeId::BOOLEAN; r.integer = v ? 1 : 0; return r; }
+    static Value makeVarchar(const std::string &v) { Value r; r.type = TypeId::VARCHAR; r.text = v; return r; }
+
+    // Numeric view of the value regardless of its integral/floating type.
+    double asDouble() const { return type == TypeId::DOUBLE ? real : static_cast<double>(integer); }
+
+    std::string toString() const {
+        switch (type) {
+        case TypeId::DOUBLE:  return std::to_string(real);
+        case TypeId::VARCHAR: return text;
+        case TypeId::BOOLEAN: return integer ? "true" : "false";
+        default:              return std::to_string(integer);
+        }
+    }
+};
@@ -0,0 +1,183 @@
+#include "bplustree.h"
+#include <algorithm>
+#include <mutex>
+#include "memory_tracker.h"
+
+namespace {
+
+// Entries per node. A node may briefly hold one more while it is split.
+const int kNodeCapacity = 64;
+
+} // namespace
+
+struct BPlusTree::Node {
+    bool leaf;
+    int count; // Entries of a leaf, separator keys of an inner node.
+    Entry keys[kNodeCapacity + 1];
+    // Inner nodes: children[i] holds the entries e with
+    // keys[i - 1] <= e < keys[i].
+    Node *children[kNodeCapacity + 2];
+    Node *next; // Leaves: right sibling.
+
+    explicit Node(bool isLeaf) : leaf(isLeaf), count(0), next(nullptr) {}
+
+    // Nodes are charged to the index memory.
+    static void *operator new(size_t size) {
+        void *node = ::operator new(size);
+        MemoryTracker::allocated(MemorySubsystem::INDEXES, size);
+        return node;
+    }
+    static void operator delete(void *node, size_t size) {
+        ::operator delete(node);
+        MemoryTracker::freed(MemorySubsystem::INDEXES, size);
+    }
+};
+
+BPlusTree::BPlusTree() : root_(new Node(true)), size_(0), height_(1), leaves_(1) {}
+
+BPlusTree::~BPlusTree() {
+    destroy(root_);
+}
+
+void BPlusTree::destroy(Node *node) {
+    if (!node->leaf)
+        for (int i = 0; i <= node->count; ++i)
+            destroy(node->children[i]);
+    delete node;
+}
+
+uint64_t BPlusTree::packRecordId(RecordId rid) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(rid.pageId)) << 32) | static_cast<uint32_t>(rid.slotId);
+}
+
+RecordId BPlusTree::unpackRecordId(uint64_t rid) {
+    return RecordId{static_cast<int>(rid >> 32), static_cast<int>(rid & 0xffffffff)};
+}
+
+BPlusTree::Node *BPlusTree::insertInto(Node *node, const Entry &entry, Entry &separator, bool &inserted) {
+    if (node->leaf) {
+        Entry *end = node->keys + node->count;
+        Entry *pos = std::lower_bound(node->keys, end, entry);
+        if (pos != end && *pos == entry) {
+            inserted = false;
+            return nullptr;
+        }
+        std::copy_backward(pos, end, end + 1);
+        *pos = entry;
+        ++node->count;
+        inserted = true;
+        if (node->count <= kNodeCapacity)
+            return nullptr;
+
+        Node *right = new Node(true);
+        int half = node->count / 2;
+        right->count = node->count - half;
+        std::copy(node->keys + half, node->keys + node->count, right->keys);
+        node->count = half;
+        right->next = node->next;
+        node->next = right;
+        ++leaves_;
+        separator = right->keys[0];
+        return right;
+    }
+
+    int i = static_cast<int>(std::upper_bound(node->keys, node->keys + node->count, entry) - node->keys);
+    Entry childSeparator;
+    Node *split = insertInto(node->children[i], entry, childSeparator, inserted);
+    if (split == nullptr)
+        return nullptr;
+    std::copy_backward(node->keys + i, node->keys + node->count, node->keys + node->count + 1);
+    std::copy_backward(node->children + i + 1, node->children + node->count + 1,
+                       node->children + node->count + 2);
+    node->keys[i] = childSeparator;
+    node->children[i + 1] = split;
+    ++node->count;
+    if (node->count <= kNodeCapacity)
+        return nullptr;
+
+    // The middle key moves up; the keys on either side stay in the halves.
+    Node *right = new Node(false);
+    int mid = node->count / 2;
+    separator = node->keys[mid];
+    right->count = node->count - mid - 1;
+    std::copy(node->keys + mid + 1, node->keys + node->count, right->keys);
+    std::copy(node->children + mid + 1, node->children + node->count + 1, right->children);
+    node->count = mid;
+    return right;
+}
+
+bool BPlusTree::insert(int64_t key, RecordId rid) {
+    Entry entry{key, packRecordId(rid)};
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    Entry separator;
+    bool inserted = false;
+    Node *split = insertInto(root_, entry, separator, inserted);
+    if (split != nullptr) {
+        Node *root = new Node(false);
+        root->count = 1;
+        root->keys[0] = separator;
+        root->children[0] = root_;
+        root->children[1] = split;
+        root_ = root;
+        ++height_;
+    }
+    if (inserted)
+        ++size_;
+    return inserted;
+}
+
+const BPlusTree::Node *BPlusTree::findLeaf(const Entry &entry) const {
+    const Node *node = root_;
+    while (!node->leaf) {
+        int i = static_cast<int>(std::upper_bound(node->keys, node->keys + node->count, entry) - node->keys);
+        node = node->children[i];
+    }
+    return node;
+}
+
+bool BPlusTree::remove(int64_t key, RecordId rid) {
+    Entry entry{key, packRecordId(rid)};
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    Node *leaf = const_cast<Node *>(findLeaf(entry));
+    Entry *end = leaf->keys + leaf->count;
+    Entry *pos = std::lower_bound(leaf->keys, end, entry);
+    if (pos == end || !(*pos == entry))
+        return false;
+    std::copy(pos + 1, end, pos);
+    --leaf->count;
+    --size_;
+    return true;
+}
+
+void BPlusTree::scan(int64_t low, int64_t high,
+                     const std::function<bool(int64_t, RecordId)> &visitor) const {
+    if (low > high)
+        return;
+    Entry first{low, 0};
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const Node *leaf = findLeaf(first);
+    int i = static_cast<int>(std::lower_bound(leaf->keys, leaf->keys + leaf->count, first) - leaf->keys);
+    for (; leaf != nullptr; leaf = leaf->next, i = 0) {
+        for (; i < leaf->count; ++i) {
+            if (leaf->keys[i].key > high)
+                return;
+            if (!visitor(leaf->keys[i].key, unpackRecordId(leaf->keys[i].rid)))
+                return;
+        }
+    }
+}
+
+size_t BPlusTree::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return size_;
+}
+
+int BPlusTree::getHeight() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return height_;
+}
+
+size_t BPlusTree::getNumberOfLeaves() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return leaves_;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include "heapfilemanager.h"
+
+// Ordered secondary index from 64-bit keys to record ids.
+//
+// Duplicate keys are allowed: entries are ordered by (key, record id), which
+// makes every entry unique, so remove() finds exactly the entry of one
+// record. Leaves are linked left to right for range scans. Deletes do not
+// rebalance; an underfull leaf simply takes later inserts.
+//
+// Nodes are kept in memory. Like the catalog, an index is not persisted and
+// is built from its heap file when it is created.
+class BPlusTree {
+public:
+    BPlusTree();
+    ~BPlusTree();
+
+    BPlusTree(const BPlusTree &) = delete;
+    BPlusTree &operator=(const BPlusTree &) = delete;
+
+    // Returns false if the entry is already present.
+    bool insert(int64_t key, RecordId rid);
+
+    // Returns false if there is no such entry.
+    bool remove(int64_t key, RecordId rid);
+
+    // Calls 'visitor' for every entry with low <= key <= high in (key, record
+    // id) order until it returns false. The tree is read-locked meanwhile, so
+    // 'visitor' must not modify it.
+    void scan(int64_t low, int64_t high, const std::function<bool(int64_t, RecordId)> &visitor) const;
+
+    size_t size() const;
+
+    // Levels from the root to the leaves (1 for a single leaf).
+    int getHeight() const;
+
+    size_t getNumberOfLeaves() const;
+
+private:
+    struct Entry {
+        int64_t key;
+        uint64_t rid;
+
+        bool operator<(const Entry &other) const {
+            return key < other.key || (key == other.key && rid < other.rid);
+        }
+        bool operator==(const Entry &other) const { return key == other.key && rid == other.rid; }
+    };
+
+    struct Node;
+
+    static uint64_t packRecordId(RecordId rid);
+    static RecordId unpackRecordId(uint64_t rid);
+
+    // Inserts into the subtree under 'node'. If the node splits, returns the
+    // new right sibling and stores its smallest entry in 'separator'.
+    Node *insertInto(Node *node, const Entry &entry, Entry &separator, bool &inserted);
+
+    // Leaf whose range contains 'entry'.
+    const Node *findLeaf(const Entry &entry) const;
+
+    static void destroy(Node *node);
+
+    Node *root_;
+    size_t size_;
+    int height_;
+    size_t leaves_;
+    mutable std::shared_mutex mutex_;
+};
@@ -1,104 +1,229 @@
 #include "bufferpool.h"
+#include <algorithm>
+#include "event_trace.h"
+#include "storage_latency.h"
 
-BufferPool::BufferPool(int poolSize, DiskManager *diskManager)
-    : poolSize_(poolSize), diskManager_(diskManager)
+static thread_local IoCounters threadCounters;
+
+const IoCounters &BufferPool::getThreadCounters() {
+    return threadCounters;
+}
+
+BufferPool::BufferPool(int poolSize, DiskManager *diskManager, MemoryGovernor *governor)
+    : poolSize_(poolSize), diskManager_(diskManager), governor_(governor), allocatedFrames_(0), reclaimerId_(-1),
+      pageTrace_(nullptr)
 {
     frames_.resize(poolSize_);
-    for(auto &frame : frames_) {
+    for (int i = 0; i < poolSize_; ++i) {
+        Frame &frame = frames_[i];
         frame.pinCount = 0;
         frame.isDirty = false;
-        // Mark an empty frame by setting page id to -1.
-        frame.page.setPageId(-1);
         frame.lastAccessTime = std::chrono::steady_clock::now();
+        // Frames the governor does not grant now are allocated on demand.
+        if (governor_ != nullptr) {
+            if (i < kMinFrames)
+                governor_->reserve(kFrameBytes);
+            else if (!governor_->tryReserve(kFrameBytes, false))
+                continue;
+        }
+        // A new page has id -1, which marks an empty frame.
+        frame.page.reset(new Page());
+        ++allocatedFrames_;
+        MemoryTracker::allocated(MemorySubsystem::BUFFER_POOL, kFrameBytes);
     }
     pageTable_.clear();
+    if (governor_ != nullptr)
+        reclaimerId_ = governor_->addReclaimer([this](size_t bytes) { return releaseFrames(bytes); });
 }
 
 BufferPool::~BufferPool() {
+    if (governor_ != nullptr)
+        governor_->removeReclaimer(reclaimerId_);
     flushAllPages();
+    MemoryTracker::freed(MemorySubsystem::BUFFER_POOL, allocatedFrames_ * kFrameBytes);
+    if (governor_ != nullptr)
+        governor_->release(allocatedFrames_ * kFrameBytes);
 }
 
 int BufferPool::findVictim() {
     // Use min_element to find the unpinned frame with the oldest access time.
     auto victimIt = std::min_element(frames_.begin(), frames_.end(),
         [](const Frame &a, const Frame &b) {
-            // Only consider unpinned frames. If one is pinned, it cannot be evicted.
-            if (a.pinCount == 0 && b.pinCount != 0) return true;
-            if (a.pinCount != 0 && b.pinCount == 0) return false;
+            // Only consider unpinned frames that hold a page. If one is
+            // pinned or released, it cannot be evicted.
+            if (a.isEvictable() && !b.isEvictable()) return true;
+            if (!a.isEvictable() && b.isEvictable()) return false;
             return a.lastAccessTime < b.lastAccessTime;
         });
     // Ensure the victim is unpinned.
-    if (victimIt != frames_.end() && victimIt->pinCount == 0)
+    if (victimIt != frames_.end() && victimIt->isEvictable())
         return std::distance(frames_.begin(), victimIt);
     return -1;
 }
 
 bool BufferPool::loadPageIntoFrame(int frameIndex, int pageId) {
     // Read the page from disk into the given frame.
-    if (!diskManager_->readPage(pageId, frames_[frameIndex].page))
+    if (!diskManager_->readPage(pageId, *frames_[frameIndex].page))
         return false;
     frames_[frameIndex].pinCount = 1;
     frames_[frameIndex].lastAccessTime = std::chrono::steady_clock::now();
     // Set the page's id (if not already set).
-    frames_[frameIndex].page.setPageId(pageId);
+    frames_[frameIndex].page->setPageId(pageId);
     return true;
 }
 
+std::unique_lock<std::mutex> BufferPool::lockPool() {
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        TRACE_SCOPE("bufferpool", "latchWait");
+        lock.lock();
+    }
+    return lock;
+}
+
 Page* BufferPool::fixPage(int pageId, bool isWrite) {
+    StorageLatencyTimer timer(StorageOperation::FIX_PAGE);
+    TRACE_SCOPE_ARG("bufferpool", "fixPage", "page", pageId);
+    std::unique_lock<std::mutex> lock = lockPool();
+    return fixPageLocked(pageId, isWrite);
+}
+
+Page* BufferPool::newPage(int &pageId) {
+    TRACE_SCOPE("bufferpool", "newPage");
+    std::unique_lock<std::mutex> lock = lockPool();
+    pageId = diskManager_->allocateNewPage();
+    if (pageId == -1)
+        return nullptr;
+    Page *page = fixPageLocked(pageId, true);
+    if (page == nullptr)
+        diskManager_->deallocatePage(pageId);
+    return page;
+}
+
+Page* BufferPool::fixPageLocked(int pageId, bool isWrite) {
+    if (pageTrace_ != nullptr)
+        pageTrace_->record(pageId, isWrite, false);
     // Check if the page is already in cache.
     auto it = pageTable_.find(pageId);
     if (it != pageTable_.end()) {
         int index = it->second;
+        ++threadCounters.hits;
         frames_[index].pinCount++;
         frames_[index].lastAccessTime = std::chrono::steady_clock::now();
         if (isWrite)
             frames_[index].isDirty = true;
-        return &(frames_[index].page);
+        return frames_[index].page.get();
     }
 
-    // Try to find an empty frame (unassigned frame).
-    auto emptyIt = std::find_if(frames_.begin(), frames_.end(), [](const Frame &frame) {
-        return (frame.pinCount == 0 && frame.page.getPageId() == -1);
-    });
+    ++threadCounters.misses;
+    // An empty frame, or a victim based on LRU.
+    int index = takeFrame();
+    if (index == -1)
+        return nullptr; // All frames are pinned.
+    if (!diskManager_->readPage(pageId, *frames_[index].page)) {
+        frames_[index].page->setPageId(-1);
+        return nullptr;
+    }
+    ++threadCounters.pagesRead;
+    frames_[index].pinCount = 1;
+    frames_[index].lastAccessTime = std::chrono::steady_clock::now();
+    frames_[index].isDirty = isWrite;  // Mark dirty only if it's a write request.
+    frames_[index].page->setPageId(pageId);
+    pageTable_[pageId] = index;
+    return frames_[index].page.get();
+}
 
-    if (emptyIt != frames_.end()) {
-        int index = std::distance(frames_.begin(), emptyIt);
-        if (!diskManager_->readPage(pageId, frames_[index].page))
-            return nullptr;
-        frames_[index].pinCount = 1;
-        frames_[index].lastAccessTime = std::chrono::steady_clock::now();
-        frames_[index].isDirty = isWrite;  // Mark dirty only if it's a write request.
-        frames_[index].page.setPageId(pageId);
-        pageTable_[pageId] = index;
-        return &(frames_[index].page);
-    } else {
-        // No empty frame available, so select a victim based on LRU.
-        int index = findVictim();
-        if (index == -1)
-            return nullptr; // All frames are pinned.
-        
-        // Before reusing, write back the victim if it is dirty.
-        int victimPageId = frames_[index].page.getPageId();
-        if (frames_[index].isDirty && victimPageId != -1) {
-            diskManager_->writePage(victimPageId, frames_[index].page);
+int BufferPool::takeFrame() {
+    int released = -1;
+    for (size_t i = 0; i < frames_.size(); ++i) {
+        Frame &frame = frames_[i];
+        if (!frame.page) {
+            if (released == -1)
+                released = static_cast<int>(i);
+        } else if (frame.pinCount == 0 && frame.page->getPageId() == -1) {
+            return static_cast<int>(i);
+        }
+    }
+    // Grow back into a released frame if the memory is available again;
+    // the pool never reclaims from others to do so.
+    if (released != -1 && (governor_ == nullptr || governor_->tryReserve(kFrameBytes, false))) {
+        frames_[released].page.reset(new Page());
+        ++allocatedFrames_;
+        MemoryTracker::allocated(MemorySubsystem::BUFFER_POOL, kFrameBytes);
+        return released;
+    }
+    int index = findVictim();
+    if (index == -1)
+        return -1;
+    int victimPageId = frames_[index].page->getPageId();
+    TRACE_SCOPE_ARG("bufferpool", "evict", "page", victimPageId);
+    if (frames_[index].isDirty && victimPageId != -1) {
+        diskManager_->writePage(victimPageId, *frames_[index].page);
+        ++threadCounters.pagesWritten;
+        frames_[index].isDirty = false;
+    }
+    pageTable_.erase(victimPageId);
+    frames_[index].page->setPageId(-1);
+    return index;
+}
+
+int BufferPool::prefetchPages(const std::vector<int> &pageIds) {
+    TRACE_SCOPE_ARG("bufferpool", "prefetch", "pages", static_cast<int64_t>(pageIds.size()));
+    std::unique_lock<std::mutex> lock = lockPool();
+    int budget = std::max(1, poolSize_ / 2);
+    int loaded = 0;
+    std::vector<int> run;       // Frames for consecutive page ids.
+    std::vector<Page *> pages;
+    int runStart = -1;
+    auto readRun = [&]() {
+        if (run.empty())
+            return;
+        bool ok = diskManager_->readPages(runStart, static_cast<int>(run.size()), pages.data());
+        for (size_t i = 0; i < run.size(); ++i) {
+            Frame &frame = frames_[run[i]];
+            frame.pinCount = 0;
+            if (!ok) {
+                frame.page->setPageId(-1);
+                continue;
+            }
+            frame.page->setPageId(runStart + static_cast<int>(i));
+            frame.isDirty = false;
+            frame.lastAccessTime = std::chrono::steady_clock::now();
+            pageTable_[runStart + static_cast<int>(i)] = run[i];
+            ++threadCounters.pagesRead;
+            ++loaded;
         }
-        // Remove the victim's entry from the page table.
-        pageTable_.erase(victimPageId);
-        
-        // Load the new page into the victim frame.
-        if (!diskManager_->readPage(pageId, frames_[index].page))
-            return nullptr;
+        run.clear();
+        pages.clear();
+    };
+
+    for (int pageId : pageIds) {
+        if (loaded + static_cast<int>(run.size()) >= budget)
+            break;
+        if (pageTable_.count(pageId))
+            continue;
+        if (!run.empty() && (pageId != runStart + static_cast<int>(run.size()) ||
+                             static_cast<int>(run.size()) == DiskManager::kMaxPagesPerRead))
+            readRun();
+        int index = takeFrame();
+        if (index == -1)
+            break;
+        // Pinned until the read is done, so the run cannot evict itself.
         frames_[index].pinCount = 1;
-        frames_[index].lastAccessTime = std::chrono::steady_clock::now();
-        frames_[index].isDirty = isWrite;
-        frames_[index].page.setPageId(pageId);
-        pageTable_[pageId] = index;
-        return &(frames_[index].page);
+        if (run.empty())
+            runStart = pageId;
+        run.push_back(index);
+        pages.push_back(frames_[index].page.get());
     }
+    readRun();
+    return loaded;
 }
 
 void BufferPool::unfixPage(Page* page, bool isDirty) {
+    std::unique_lock<std::mutex> lock = lockPool();
     int pageId = page->getPageId();
+    if (pageTrace_ != nullptr)
+        pageTrace_->record(pageId, isDirty, true);
     auto it = pageTable_.find(pageId);
     if (it != pageTable_.end()) {
         int index = it->second;
@@ -110,11 +235,75 @@ void BufferPool::unfixPage(Page* page, bool isDirty) {
     }
 }
 
+bool BufferPool::deletePage(int pageId) {
+    std::unique_lock<std::mutex> lock = lockPool();
+    auto it = pageTable_.find(pageId);
+    if (it != pageTable_.end()) {
+        Frame &frame = frames_[it->second];
+        if (frame.pinCount > 0)
+            return false;
+        frame.page->setPageId(-1);
+        frame.isDirty = false;
+        pageTable_.erase(it);
+    }
+    diskManager_->deallocatePage(pageId);
+    return true;
+}
+
+void BufferPool::setPageTrace(PageTraceWriter *trace) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pageTrace_ = trace;
+}
+
 void BufferPool::flushAllPages() {
+    TRACE_SCOPE("bufferpool", "flushAllPages");
+    std::lock_guard<std::mutex> lock(mutex_);
     for (auto &frame : frames_) {
-        if (frame.isDirty && frame.pinCount == 0 && frame.page.getPageId() != -1) {
-            diskManager_->writePage(frame.page.getPageId(), frame.page);
+        if (frame.page && frame.isDirty && frame.pinCount == 0 && frame.page->getPageId() != -1) {
+            diskManager_->writePage(frame.page->getPageId(), *frame.page);
+            ++threadCounters.pagesWritten;
             frame.isDirty = false;
         }
     }
 }
+
+size_t BufferPool::releaseFrames(size_t bytes) {
+    TRACE_SCOPE("bufferpool", "releaseFrames");
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Empty frames go first, then the least recently used pages.
+    std::vector<int> candidates;
+    for (size_t i = 0; i < frames_.size(); ++i) {
+        if (frames_[i].isEvictable())
+            candidates.push_back(static_cast<int>(i));
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](int a, int b) {
+        bool emptyA = frames_[a].page->getPageId() == -1;
+        bool emptyB = frames_[b].page->getPageId() == -1;
+        if (emptyA != emptyB)
+            return emptyA;
+        return frames_[a].lastAccessTime < frames_[b].lastAccessTime;
+    });
+
+    size_t freed = 0;
+    for (int index : candidates) {
+        if (freed >= bytes || allocatedFrames_ <= kMinFrames)
+            break;
+        Frame &frame = frames_[index];
+        int pageId = frame.page->getPageId();
+        if (pageId != -1) {
+            if (frame.isDirty) {
+                diskManager_->writePage(pageId, *frame.page);
+                ++threadCounters.pagesWritten;
+            }
+            pageTable_.erase(pageId);
+        }
+        frame.page.reset();
+        frame.isDirty = false;
+        --allocatedFrames_;
+        freed += kFrameBytes;
+    }
+    MemoryTracker::freed(MemorySubsystem::BUFFER_POOL, freed);
+    if (governor_ != nullptr)
+        governor_->release(freed);
+    return freed;
+}
@@ -1,39 +1,133 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <unordered_map>
 #include "diskmanager.h"
+#include "memory_governor.h"
+#include "memory_tracker.h"
 #include "page.h"
+#include "page_trace.h"
 
+// Buffer pool activity. It is counted per thread, so that an executor can
+// charge it to the operator that was running on that thread.
+struct IoCounters {
+    uint64_t hits = 0;         // Fixes of a page already in the pool.
+    uint64_t misses = 0;       // Fixes that had to read the page.
+    uint64_t pagesRead = 0;
+    uint64_t pagesWritten = 0;
+
+    IoCounters &operator+=(const IoCounters &other) {
+        hits += other.hits;
+        misses += other.misses;
+        pagesRead += other.pagesRead;
+        pagesWritten += other.pagesWritten;
+        return *this;
+    }
+    IoCounters operator-(const IoCounters &other) const {
+        IoCounters result;
+        result.hits = hits - other.hits;
+        result.misses = misses - other.misses;
+        result.pagesRead = pagesRead - other.pagesRead;
+        result.pagesWritten = pagesWritten - other.pagesWritten;
+        return result;
+    }
+};
+
+// Fixed-size page cache. With a MemoryGovernor its frames are memory like
+// any other: they are reserved from the governor, and a reservation that
+// does not fit makes the pool evict its least recently used pages and free
+// their frames, down to kMinFrames. Freed frames are allocated again once
+// the governor grants them.
 class BufferPool {
 public:
-    BufferPool(int poolSize, DiskManager *diskManager);
+    // Frames the pool keeps whatever the governor needs.
+    static const int kMinFrames = 16;
+    // Memory of one frame.
+    static const size_t kFrameBytes = sizeof(Page);
+
+    BufferPool(int poolSize, DiskManager *diskManager, MemoryGovernor *governor = nullptr);
     ~BufferPool();
 
     // Returns a pointer to the page if successfully fixed, or nullptr on error.
     Page* fixPage(int pageId, bool isWrite);
 
+    // Allocates a new page on disk and fixes it for writing.
+    // Stores the new page id in 'pageId'; returns nullptr on error.
+    Page* newPage(int &pageId);
+
+    // Reads those of 'pageIds' (ascending) that are not in the pool, with one
+    // vectored read per run of consecutive ids. The pages are not fixed, so
+    // later fixPage() calls find them unless they have been evicted again;
+    // at most half the pool is filled per call. Returns the pages read.
+    int prefetchPages(const std::vector<int> &pageIds);
+
     // Unfixes (unpins) the page. Marks as dirty if needed.
     void unfixPage(Page* page, bool isDirty);
 
+    // Drops the page from the pool without writing it back and gives it back
+    // to the disk manager for reuse. Returns false if the page is fixed.
+    bool deletePage(int pageId);
+
     // Writes all dirty pages in the pool back to disk.
     void flushAllPages();
 
+    // Records every fixPage() and unfixPage() in 'trace' from now on, or
+    // stops recording if it is null. The trace must outlive its use here.
+    void setPageTrace(PageTraceWriter *trace);
+
+    // Evicts unpinned pages, least recently used first, and frees their
+    // frames until 'bytes' are freed or only kMinFrames are left; the
+    // governor's reclaimer. Returns the bytes freed.
+    size_t releaseFrames(size_t bytes);
+
+    int getPoolSize() const { return poolSize_; }
+    // Frames holding memory, at most getPoolSize().
+    int getAllocatedFrames() const { return allocatedFrames_.load(); }
+
+    // Activity caused by the calling thread so far, in all buffer pools.
+    static const IoCounters &getThreadCounters();
+
 private:
     struct Frame {
-        Page page;
+        std::unique_ptr<Page> page; // Null while the frame is released.
         int pinCount;
         bool isDirty;
-        // Additional eviction-related data (e.g., last access time for LRU)
+        // Last time the frame was fixed or unfixed, for LRU eviction.
+        std::chrono::steady_clock::time_point lastAccessTime;
+
+        bool isEvictable() const { return page && pinCount == 0; }
     };
 
     int poolSize_;
     DiskManager* diskManager_;
+    MemoryGovernor *governor_;
+    std::atomic<int> allocatedFrames_;
+    int reclaimerId_;
+    PageTraceWriter *pageTrace_; // Null unless recording.
     std::vector<Frame> frames_;
     std::unordered_map<int, int> pageTable_; // Maps pageId to index in frames_
+    // Protects the frames' metadata, the page table and the disk manager.
+    // Page contents are protected by the pin: a fixed page is never evicted.
+    std::mutex mutex_;
 
     // Finds a victim frame index based on the replacement policy.
     int findVictim();
 
     // (Optional) Helper function to load a page into a specific frame.
     bool loadPageIntoFrame(int frameIndex, int pageId);
+
+    // Locks mutex_, tracing the wait if it is contended.
+    std::unique_lock<std::mutex> lockPool();
+
+    // fixPage() with mutex_ already held.
+    Page* fixPageLocked(int pageId, bool isWrite);
+
+    // Frame that is empty, newly allocated or whose page was evicted (written
+    // back first if dirty), or -1 if all frames are pinned. mutex_ must be
+    // held.
+    int takeFrame();
 };
@@ -1,4 +1,13 @@
 #include "diskmanager.h"
+#include <algorithm>
+#include <vector>
+#include "event_trace.h"
+#include "storage_latency.h"
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 DiskManager::DiskManager(const std::string& fileName) : fileName_(fileName) {
     // Open the file in read/write mode (binary)
@@ -18,14 +27,30 @@ DiskManager::DiskManager(const std::string& fileName) : fileName_(fileName) {
     numPages_ = static_cast<int>(fileSize / PAGE_SIZE);
     // Reset read position.
     fileStream_.seekg(0, std::ios::beg);
+#ifdef __unix__
+    readFd_ = open(fileName_.c_str(), O_RDONLY);
+#else
+    readFd_ = -1;
+#endif
 }
 
 DiskManager::~DiskManager() {
+#ifdef __unix__
+    if (readFd_ >= 0)
+        close(readFd_);
+#endif
     fileStream_.close();
 }
 
 bool DiskManager::readPage(int pageId, Page &page) {
-    int offset = pageId * PAGE_SIZE;
+    StorageLatencyTimer timer(StorageOperation::DISK_READ);
+    TRACE_SCOPE_ARG("disk", "readPage", "page", pageId);
+    if (pageId < 0 || pageId >= numPages_) {
+        return false;
+    }
+    long offset = getOffset(pageId);
+    // A previous short read leaves the stream in a failed state; reset it.
+    fileStream_.clear();
     fileStream_.seekg(offset, std::ios::beg);
     if (!fileStream_) {
         return false;
@@ -39,15 +64,50 @@ bool DiskManager::readPage(int pageId, Page &page) {
     return true;
 }
 
+bool DiskManager::readPages(int firstPageId, int count, Page *const *pages) {
+    TRACE_SCOPE_ARG("disk", "readPages", "pages", count);
+    if (firstPageId < 0 || count < 0 || firstPageId + count > numPages_)
+        return false;
+#ifdef __unix__
+    if (readFd_ >= 0) {
+        // Writes go through the stream, which flushes after every page, so
+        // the descriptor sees them.
+        std::vector<char> buffer(static_cast<size_t>(std::min(count, kMaxPagesPerRead)) * PAGE_SIZE);
+        struct iovec vectors[kMaxPagesPerRead];
+        for (int done = 0; done < count;) {
+            int n = std::min(count - done, kMaxPagesPerRead);
+            for (int i = 0; i < n; ++i) {
+                vectors[i].iov_base = buffer.data() + static_cast<size_t>(i) * PAGE_SIZE;
+                vectors[i].iov_len = PAGE_SIZE;
+            }
+            ssize_t bytes = preadv(readFd_, vectors, n, getOffset(firstPageId + done));
+            if (bytes != static_cast<ssize_t>(n) * PAGE_SIZE)
+                return false;
+            for (int i = 0; i < n; ++i)
+                pages[done + i]->deserialize(buffer.data() + static_cast<size_t>(i) * PAGE_SIZE);
+            done += n;
+        }
+        return true;
+    }
+#endif
+    for (int i = 0; i < count; ++i)
+        if (!readPage(firstPageId + i, *pages[i]))
+            return false;
+    return true;
+}
+
 bool DiskManager::writePage(int pageId, const Page &page) {
-    int offset = 0;
+    StorageLatencyTimer timer(StorageOperation::DISK_WRITE);
+    TRACE_SCOPE_ARG("disk", "writePage", "page", pageId);
+    long offset = 0;
     if (pageId == numPages_) {
-        offset = numPages_ * PAGE_SIZE;
-    } else if (pageId < numPages_) {
-        offset = pageId * PAGE_SIZE;
+        offset = getOffset(numPages_);
+    } else if (pageId >= 0 && pageId < numPages_) {
+        offset = getOffset(pageId);
     } else {
         return false;
     }
+    fileStream_.clear();
     fileStream_.seekp(offset, std::ios::beg);
     if (!fileStream_) {
         return false;
@@ -66,6 +126,15 @@ bool DiskManager::writePage(int pageId, const Page &page) {
 }
 
 int DiskManager::allocateNewPage() {
+    if (!freePages_.empty()) {
+        int pageId = freePages_.back();
+        Page empty;
+        empty.setPageId(pageId);
+        if (!writePage(pageId, empty))
+            return -1;
+        freePages_.pop_back();
+        return pageId;
+    }
     // Create a new empty page.
     Page newPage;
     // Set its page id (optional, depending on your Page design)
@@ -77,6 +146,11 @@ int DiskManager::allocateNewPage() {
     return -1; // Return -1 to indicate failure.
 }
 
+void DiskManager::deallocatePage(int pageId) {
+    if (pageId >= 0 && pageId < numPages_)
+        freePages_.push_back(pageId);
+}
+
 int DiskManager::getNumberOfPages() const {
     return numPages_;
 }
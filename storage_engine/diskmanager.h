@@ -1,6 +1,7 @@
 #pragma once
 #include <fstream>
 #include <string>
+#include <vector>
 #include "page.h"   // Your Page class header
 
 class DiskManager {
@@ -15,21 +16,33 @@ public:
     // pageId is used to compute the offset (pageId * PAGE_SIZE)
     bool readPage(int pageId, Page &page);
 
+    // Reads the 'count' consecutive pages starting at 'firstPageId' into
+    // pages[0..count) with one vectored read per up to kMaxPagesPerRead pages.
+    // Returns false if any of them cannot be read.
+    bool readPages(int firstPageId, int count, Page *const *pages);
+
+    static constexpr int kMaxPagesPerRead = 64;
+
     // Write a Page object to disk.
     // Serialize the Page into a raw buffer, then write at the appropriate offset.
     bool writePage(int pageId, const Page &page);
 
-    // Allocate a new page by extending the file.
+    // Allocate a new page by extending the file, or reuse a deallocated one.
     // Returns the new pageId (for example, current number of pages)
     int allocateNewPage();
 
+    // Gives a page back; allocateNewPage() hands it out again, cleared.
+    void deallocatePage(int pageId);
+
     // (Optional) Returns the current number of pages in the file.
     int getNumberOfPages() const;
 
 private:
     std::string fileName_;
     std::fstream fileStream_;  // Use fstream for both input and output.
+    int readFd_;               // Separate descriptor for vectored reads, or -1.
     int numPages_;             // Track the current number of pages in the file.
+    std::vector<int> freePages_; // Deallocated pages, reused before the file grows.
     
     // Helper method: computes file offset for a given pageId.
     long getOffset(int pageId) const {
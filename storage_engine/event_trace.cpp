@@ -0,0 +1,192 @@
+#include "event_trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+
+std::atomic<bool> EventTrace::recording_(false);
+
+namespace {
+
+int64_t steadyNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Events of one thread at a time. Only its thread writes it; an exporter
+// reads the events below 'written' once recording has stopped.
+struct ThreadBuffer {
+    explicit ThreadBuffer(size_t capacity) : events(new TraceEvent[capacity]), capacity(capacity), written(0) {}
+
+    std::unique_ptr<TraceEvent[]> events;
+    size_t capacity;
+    std::atomic<uint64_t> written; // Events ever appended; the last 'capacity' are kept.
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer *> freeBuffers; // Of threads that exited.
+    size_t eventsPerThread = EventTrace::kDefaultEventsPerThread;
+    std::atomic<int64_t> epoch{steadyNanoseconds()}; // When the trace started.
+    std::unordered_set<std::string> names;
+};
+
+Registry &registry() {
+    static Registry *instance = new Registry(); // Outlives exiting threads.
+    return *instance;
+}
+
+std::atomic<uint32_t> nextThreadId(1);
+
+// The calling thread's buffer, handed back for reuse when the thread exits;
+// its events stay until the next thread overwrites them.
+struct ThreadState {
+    ThreadBuffer *buffer = nullptr;
+    uint32_t threadId = nextThreadId++;
+
+    ~ThreadState() {
+        if (buffer == nullptr)
+            return;
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.freeBuffers.push_back(buffer);
+    }
+};
+
+thread_local ThreadState threadState;
+
+void append(const TraceEvent &event) {
+    ThreadState &state = threadState;
+    if (state.buffer == nullptr) {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (r.freeBuffers.empty()) {
+            r.buffers.emplace_back(new ThreadBuffer(r.eventsPerThread));
+            state.buffer = r.buffers.back().get();
+        } else {
+            state.buffer = r.freeBuffers.back();
+            r.freeBuffers.pop_back();
+        }
+    }
+    ThreadBuffer &buffer = *state.buffer;
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    TraceEvent &slot = buffer.events[index % buffer.capacity];
+    slot = event;
+    slot.threadId = state.threadId;
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void appendJsonString(std::ostringstream &out, const char *text) {
+    out << '"';
+    for (const char *c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\')
+            out << '\\' << *c;
+        else if (static_cast<unsigned char>(*c) < 0x20)
+            out << ' ';
+        else
+            out << *c;
+    }
+    out << '"';
+}
+
+} // namespace
+
+void EventTrace::start(size_t eventsPerThread) {
+    Registry &r = registry();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.eventsPerThread = std::max<size_t>(1, eventsPerThread);
+        for (auto &buffer : r.buffers)
+            buffer->written.store(0, std::memory_order_relaxed);
+        r.epoch.store(steadyNanoseconds(), std::memory_order_relaxed);
+    }
+    recording_.store(true, std::memory_order_release);
+}
+
+void EventTrace::stop() {
+    recording_.store(false, std::memory_order_release);
+}
+
+uint64_t EventTrace::now() {
+    int64_t elapsed = steadyNanoseconds() - registry().epoch.load(std::memory_order_relaxed);
+    return elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0;
+}
+
+void EventTrace::complete(const char *category, const char *name, uint64_t start, const char *argName,
+                          int64_t argValue) {
+    uint64_t end = now();
+    append(TraceEvent{category, name, argName, argValue, start, end > start ? end - start : 0, 0, 'X'});
+}
+
+void EventTrace::instant(const char *category, const char *name, const char *argName, int64_t argValue) {
+    append(TraceEvent{category, name, argName, argValue, now(), 0, 0, 'i'});
+}
+
+const char *EventTrace::intern(const std::string &name) {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.names.insert(name).first->c_str();
+}
+
+std::vector<TraceEvent> EventTrace::collect() {
+    // A buffer that has wrapped may have its oldest slots overwritten by a
+    // scope that ends after stop(); leave those out.
+    const uint64_t kSlack = 8;
+    std::vector<TraceEvent> events;
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto &buffer : r.buffers) {
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t first = 0;
+        if (written > buffer->capacity)
+            first = written - buffer->capacity + std::min<uint64_t>(kSlack, buffer->capacity);
+        for (uint64_t i = first; i < written; ++i)
+            events.push_back(buffer->events[i % buffer->capacity]);
+    }
+    std::sort(events.begin(), events.end(),
+              [](const TraceEvent &a, const TraceEvent &b) { return a.start < b.start; });
+    return events;
+}
+
+std::string EventTrace::toChromeTrace() {
+    std::vector<TraceEvent> events = collect();
+    std::ostringstream out;
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    char number[64];
+    for (size_t i = 0; i < events.size(); ++i) {
+        const TraceEvent &event = events[i];
+        out << (i ? ",\n" : "\n") << "{\"name\": ";
+        appendJsonString(out, event.name);
+        out << ", \"cat\": ";
+        appendJsonString(out, event.category);
+        // Timestamps are in microseconds.
+        snprintf(number, sizeof(number), "%.3f", event.start / 1e3);
+        out << ", \"ph\": \"" << event.phase << "\", \"ts\": " << number;
+        if (event.phase == 'X') {
+            snprintf(number, sizeof(number), "%.3f", event.duration / 1e3);
+            out << ", \"dur\": " << number;
+        } else {
+            out << ", \"s\": \"t\"";
+        }
+        out << ", \"pid\": 1, \"tid\": " << event.threadId;
+        if (event.argName != nullptr) {
+            out << ", \"args\": {";
+            appendJsonString(out, event.argName);
+            out << ": " << event.argValue << "}";
+        }
+        out << "}";
+    }
+    out << "\n]}\n";
+    return out.str();
+}
+
+bool EventTrace::writeChromeTrace(const std::string &fileName) {
+    std::ofstream file(fileName);
+    file << toChromeTrace();
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Timeline tracing of engine internals (I/O, latch waits, evictions,
+// operator execution) for chrome://tracing and Perfetto.
+//
+// Code is instrumented with the TRACE_* macros below. They compile to
+// nothing unless DBENGINE_TRACING is defined (the CMake option of the same
+// name), and when compiled in they cost a relaxed load while no trace is
+// being recorded. Between EventTrace::start() and stop() every thread
+// appends its events to a ring buffer of its own, without locking; a full
+// buffer overwrites its oldest events, so a trace holds the most recent
+// events of every thread. writeChromeTrace() exports them as Chrome trace
+// event JSON.
+//
+// Names, categories and argument names must be string literals or come
+// from EventTrace::intern(), as only the pointers are stored.
+
+struct TraceEvent {
+    const char *category;
+    const char *name;
+    const char *argName; // Null if the event has no argument.
+    int64_t argValue;
+    uint64_t start;      // Nanoseconds since the trace started.
+    uint64_t duration;   // Nanoseconds; 0 for an instant event.
+    uint32_t threadId;   // Small number per thread, in order of first event.
+    char phase;          // 'X' (complete) or 'i' (instant), as in the format.
+};
+
+class EventTrace {
+public:
+    static const size_t kDefaultEventsPerThread = 16384;
+
+    // Clears the buffers and starts recording. Buffers created from now on
+    // hold 'eventsPerThread' events; those that exist keep their size.
+    static void start(size_t eventsPerThread = kDefaultEventsPerThread);
+
+    // Stops recording. Export after this, once the instrumented code has
+    // left its traced scopes.
+    static void stop();
+
+    static bool isRecording() { return recording_.load(std::memory_order_relaxed); }
+
+    // Nanoseconds since the trace started.
+    static uint64_t now();
+
+    static void complete(const char *category, const char *name, uint64_t start, const char *argName,
+                         int64_t argValue);
+    static void instant(const char *category, const char *name, const char *argName, int64_t argValue);
+
+    // A copy of 'name' that lives as long as the process, for names that are
+    // not literals (operator names). Every distinct name is kept once.
+    static const char *intern(const std::string &name);
+
+    // The events in the buffers, ordered by start time.
+    static std::vector<TraceEvent> collect();
+
+    // The events as Chrome trace event JSON ({"traceEvents": [...]}).
+    static std::string toChromeTrace();
+    // Returns false if 'fileName' cannot be written.
+    static bool writeChromeTrace(const std::string &fileName);
+
+private:
+    static std::atomic<bool> recording_;
+};
+
+// Records the time from its construction to its destruction as a complete
+// event, if a trace was being recorded when it was constructed.
+class TraceScope {
+public:
+    TraceScope(const char *category, const char *name, const char *argName = nullptr, int64_t argValue = 0)
+        : category_(category), name_(name), argName_(argName), argValue_(argValue),
+          recording_(EventTrace::isRecording()), start_(recording_ ? EventTrace::now() : 0) {}
+
+    ~TraceScope() {
+        if (recording_)
+            EventTrace::complete(category_, name_, start_, argName_, argValue_);
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *category_;
+    const char *name_;
+    const char *argName_;
+    int64_t argValue_;
+    bool recording_;
+    uint64_t start_;
+};
+
+#define DBENGINE_TRACE_CONCAT2(a, b) a##b
+#define DBENGINE_TRACE_CONCAT(a, b) DBENGINE_TRACE_CONCAT2(a, b)
+
+#ifdef DBENGINE_TRACING
+// Traces the rest of the enclosing scope.
+#define TRACE_SCOPE(category, name) TraceScope DBENGINE_TRACE_CONCAT(traceScope, __LINE__)(category, name)
+// Same, with one integer argument shown with the event.
+#define TRACE_SCOPE_ARG(category, name, argName, argValue)                                                    \
+    TraceScope DBENGINE_TRACE_CONCAT(traceScope, __LINE__)(category, name, argName, argValue)
+// A point in time.
+#define TRACE_INSTANT_ARG(category, name, argName, argValue)                                                  \
+    do {                                                                                                      \
+        if (EventTrace::isRecording())                                                                        \
+            EventTrace::instant(category, name, argName, argValue);                                          \
+    } while (0)
+#else
+#define TRACE_SCOPE(category, name) do {} while (0)
+#define TRACE_SCOPE_ARG(category, name, argName, argValue) do {} while (0)
+#define TRACE_INSTANT_ARG(category, name, argName, argValue) do {} while (0)
+#endif
@@ -1,6 +1,6 @@
 #include "heapfilemanager.h"
 
-HeapFile::HeapFile(BufferPool* bp): bp(bp_)
+HeapFile::HeapFile(BufferPool* bp): bp_(bp), modificationCount_(0)
 {
 	
 }
@@ -10,25 +10,158 @@ HeapFile::~HeapFile()
 	
 }
 
-RecordId RecordId::insertRecord(std::vector<char>& record)
+void HeapFile::setFreeSpace(int pageId, int freeBytes)
 {
+	auto it = freeSpaceMap_.find(pageId);
+	if (it != freeSpaceMap_.end())
+		pagesBySpace_.erase(std::make_pair(it->second, pageId));
+	freeSpaceMap_[pageId] = freeBytes;
+	pagesBySpace_.insert(std::make_pair(freeBytes, pageId));
+}
+
+Page* HeapFile::findPageWithSpace(int length, int& pageId)
+{
+	int required = length + static_cast<int>(sizeof(Slot));
+	auto it = pagesBySpace_.lower_bound(std::make_pair(required, -1));
+	if (it != pagesBySpace_.end())
+	{
+		pageId = it->second;
+		return bp_->fixPage(pageId, true);
+	}
+	Page* page = bp_->newPage(pageId);
+	if (page == nullptr)
+		return nullptr;
+	pageIds_.push_back(pageId);
+	setFreeSpace(pageId, page->getFreeSpace());
+	return page;
+}
+
+RecordId HeapFile::insertRecord(std::vector<char>& record)
+{
+	RecordId rid = {-1, -1};
+	int length = static_cast<int>(record.size());
+	std::lock_guard<std::mutex> lock(mutex_);
 	//find the free page
 	//fix the page
+	int pageId;
+	Page* page = findPageWithSpace(length, pageId);
+	if (page == nullptr)
+		return rid;
 	//Insert the record
+	int slotId = page->insertRecord(record.data(), length);
+	setFreeSpace(pageId, page->getFreeSpace());
 	//unfix the page	
+	bp_->unfixPage(page, slotId != -1);
+	if (slotId != -1)
+	{
+		rid.pageId = pageId;
+		rid.slotId = slotId;
+		++modificationCount_;
+	}
+	return rid;
 }
 
-bool RecordId::deleteRecord(RecordId rid)
+bool HeapFile::deleteRecord(RecordId rid)
 {
-	
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (freeSpaceMap_.find(rid.pageId) == freeSpaceMap_.end())
+		return false;
+	Page* page = bp_->fixPage(rid.pageId, true);
+	if (page == nullptr)
+		return false;
+	bool deleted = page->deleteRecord(rid.slotId);
+	setFreeSpace(rid.pageId, page->getFreeSpace());
+	bp_->unfixPage(page, deleted);
+	if (deleted)
+		++modificationCount_;
+	return deleted;
 }
 
-bool RecordId::getRecord(RecordId rid, std::vector<char>& record)
+bool HeapFile::getRecord(RecordId rid, std::vector<char>& record)
 {
-	
+	Page* page = bp_->fixPage(rid.pageId, false);
+	if (page == nullptr)
+		return false;
+	int length = page->getRecordLength(rid.slotId);
+	if (length >= 0)
+	{
+		record.resize(length);
+		page->getRecord(rid.slotId, record.data());
+	}
+	bp_->unfixPage(page, false);
+	return length >= 0;
 }
 
-bool RecordId::updateRecord(RecordId rid, const std::vector<char> record)
+bool HeapFile::updateRecord(RecordId rid, const std::vector<char>& record, RecordId* newRid)
 {
-	
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (freeSpaceMap_.find(rid.pageId) == freeSpaceMap_.end())
+		return false;
+	Page* page = bp_->fixPage(rid.pageId, true);
+	if (page == nullptr)
+		return false;
+	if (page->getRecordLength(rid.slotId) < 0)
+	{
+		bp_->unfixPage(page, false);
+		return false;
+	}
+	int length = static_cast<int>(record.size());
+	if (page->updateRecord(rid.slotId, record.data(), length))
+	{
+		setFreeSpace(rid.pageId, page->getFreeSpace());
+		bp_->unfixPage(page, true);
+		++modificationCount_;
+		if (newRid != nullptr)
+			*newRid = rid;
+		return true;
+	}
+	// The new version doesn't fit here: move it to another page.
+	int pageId;
+	Page* target = findPageWithSpace(length, pageId);
+	if (target == nullptr)
+	{
+		bp_->unfixPage(page, false);
+		return false;
+	}
+	int slotId = target->insertRecord(record.data(), length);
+	setFreeSpace(pageId, target->getFreeSpace());
+	bp_->unfixPage(target, slotId != -1);
+	if (slotId == -1)
+	{
+		bp_->unfixPage(page, false);
+		return false;
+	}
+	page->deleteRecord(rid.slotId);
+	setFreeSpace(rid.pageId, page->getFreeSpace());
+	bp_->unfixPage(page, true);
+	++modificationCount_;
+	if (newRid != nullptr)
+	{
+		newRid->pageId = pageId;
+		newRid->slotId = slotId;
+	}
+	return true;
+}
+
+std::vector<int> HeapFile::getPageIds() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return pageIds_;
+}
+
+void HeapFile::freePages()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (int pageId : pageIds_)
+		bp_->deletePage(pageId);
+	pageIds_.clear();
+	freeSpaceMap_.clear();
+	pagesBySpace_.clear();
+	++modificationCount_;
+}
+
+int HeapFile::getNumberOfPages() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return static_cast<int>(pageIds_.size());
 }
@@ -1,6 +1,11 @@
+#pragma once
+#include <atomic>
 #include <vector>
 #include <iostream>
+#include <mutex>
+#include <set>
 #include <unordered_map>
+#include "bufferpool.h"
 
 struct RecordId
 {
@@ -15,16 +20,48 @@ public:
 
 	~HeapFile();
 
+	// Returns the id of the new record, or {-1, -1} if it could not be stored.
 	RecordId insertRecord(std::vector<char>& record);
 
 	bool deleteRecord(RecordId rid);
 
 	bool getRecord(RecordId rid, std::vector<char>& record);
 
-	bool updateRecord(RecordId rid, const std::vector<char>& record);
+	// Replaces the record in place when it still fits on its page. Otherwise the
+	// record moves to another page and, if 'newRid' is given, its new id is
+	// stored there.
+	bool updateRecord(RecordId rid, const std::vector<char>& record, RecordId* newRid = nullptr);
+
+	// Pages that belong to this heap file, in allocation order.
+	std::vector<int> getPageIds() const;
+
+	int getNumberOfPages() const;
+
+	// Gives every page back to the buffer pool for reuse, leaving the file
+	// empty. Nothing may use the file's pages or record ids concurrently.
+	void freePages();
+
+	BufferPool* getBufferPool() const { return bp_; }
+
+	// Number of successful inserts, deletes and updates so far. It goes up
+	// only once a change is in place, so anything computed from the file
+	// after reading count n is still current while the count is n.
+	uint64_t getModificationCount() const { return modificationCount_.load(); }
 	
 private:
+	// Picks a page with room for 'length' bytes, allocating one if needed.
+	// Returns the fixed page or nullptr; mutex_ must be held.
+	Page* findPageWithSpace(int length, int& pageId);
+
+	void setFreeSpace(int pageId, int freeBytes);
+
 	BufferPool* bp_;
 	//pageid to Number of bytes availabe in the map.
 	std::unordered_map<int,int> freeSpaceMap_;	
+	// The same information ordered by free bytes, to find a page for an insert quickly.
+	std::set<std::pair<int,int>> pagesBySpace_;
+	std::vector<int> pageIds_;
+	// Serializes writers; readers only rely on the buffer pool pin.
+	mutable std::mutex mutex_;
+	std::atomic<uint64_t> modificationCount_;
 };
@@ -0,0 +1,148 @@
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+    : counts_(kNumBuckets, 0), count_(0), sum_(0), min_(UINT64_MAX), max_(0)
+{
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+    for (size_t b = 0; b < kNumBuckets; ++b)
+        counts_[b] += other.counts_[b];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+void LatencyHistogram::clear() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    count_ = 0;
+    sum_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+}
+
+uint64_t LatencyHistogram::highestValueIn(size_t bucket) {
+    if (bucket < kSubBuckets)
+        return bucket;
+    int shift = static_cast<int>(bucket / kSubBuckets) - 1;
+    uint64_t lowest = static_cast<uint64_t>(kSubBuckets + bucket % kSubBuckets) << shift;
+    return lowest + ((uint64_t(1) << shift) - 1);
+}
+
+uint64_t LatencyHistogram::getPercentile(double percentile) const {
+    if (count_ == 0)
+        return 0;
+    double clamped = std::min(100.0, std::max(0.0, percentile));
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped / 100 * count_)));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < kNumBuckets; ++b) {
+        seen += counts_[b];
+        if (seen >= rank)
+            return std::min(highestValueIn(b), max_);
+    }
+    return max_;
+}
+
+void LatencyHistogram::subtract(const LatencyHistogram &earlier) {
+    min_ = UINT64_MAX;
+    max_ = 0;
+    for (size_t b = 0; b < kNumBuckets; ++b) {
+        counts_[b] -= std::min(counts_[b], earlier.counts_[b]);
+        if (counts_[b] > 0) {
+            min_ = std::min(min_, b < kSubBuckets ? b : highestValueIn(b - 1) + 1);
+            max_ = highestValueIn(b);
+        }
+    }
+    count_ -= std::min(count_, earlier.count_);
+    sum_ -= std::min(sum_, earlier.sum_);
+}
+
+// Shards of the calling thread by recorder id; returned to their recorders
+// when the thread exits.
+struct LatencyRecorder::ThreadShards {
+    std::vector<std::pair<std::weak_ptr<Shards>, Shard *>> shards;
+
+    ~ThreadShards() {
+        for (auto &entry : shards)
+            if (std::shared_ptr<Shards> owner = entry.first.lock())
+                owner->retire(entry.second);
+    }
+};
+
+static std::atomic<size_t> nextRecorderId(0);
+
+LatencyRecorder::LatencyRecorder() : id_(nextRecorderId++), shards_(std::make_shared<Shards>()) {}
+
+LatencyRecorder::~LatencyRecorder() {}
+
+void LatencyRecorder::Shard::clear() {
+    for (auto &bucket : counts)
+        bucket.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    min.store(UINT64_MAX, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+void LatencyRecorder::Shard::addTo(LatencyHistogram &histogram) const {
+    for (size_t b = 0; b < LatencyHistogram::kNumBuckets; ++b)
+        histogram.counts_[b] += counts[b].load(std::memory_order_relaxed);
+    histogram.count_ += count.load(std::memory_order_relaxed);
+    histogram.sum_ += sum.load(std::memory_order_relaxed);
+    histogram.min_ = std::min(histogram.min_, min.load(std::memory_order_relaxed));
+    histogram.max_ = std::max(histogram.max_, max.load(std::memory_order_relaxed));
+}
+
+void LatencyRecorder::Shards::retire(Shard *shard) {
+    std::lock_guard<std::mutex> lock(mutex);
+    shard->addTo(retired);
+    shard->clear();
+    free.push_back(shard);
+}
+
+LatencyRecorder::Shard &LatencyRecorder::shard() {
+    static thread_local ThreadShards local;
+    if (id_ < local.shards.size() && local.shards[id_].second != nullptr)
+        return *local.shards[id_].second;
+    Shard *shard;
+    {
+        std::lock_guard<std::mutex> lock(shards_->mutex);
+        if (shards_->free.empty()) {
+            shards_->all.emplace_back(new Shard());
+            shard = shards_->all.back().get();
+        } else {
+            shard = shards_->free.back();
+            shards_->free.pop_back();
+        }
+    }
+    if (local.shards.size() <= id_)
+        local.shards.resize(id_ + 1);
+    local.shards[id_] = std::make_pair(std::weak_ptr<Shards>(shards_), shard);
+    return *shard;
+}
+
+void LatencyRecorder::record(uint64_t nanoseconds) {
+    // Only this thread writes its shard, so plain loads and stores suffice;
+    // they are atomic so that snapshot() can read them meanwhile.
+    Shard &own = shard();
+    std::atomic<uint64_t> &bucket = own.counts[LatencyHistogram::bucketOf(nanoseconds)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    own.count.store(own.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    own.sum.store(own.sum.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+    if (nanoseconds < own.min.load(std::memory_order_relaxed))
+        own.min.store(nanoseconds, std::memory_order_relaxed);
+    if (nanoseconds > own.max.load(std::memory_order_relaxed))
+        own.max.store(nanoseconds, std::memory_order_relaxed);
+}
+
+LatencyHistogram LatencyRecorder::snapshot() const {
+    std::lock_guard<std::mutex> lock(shards_->mutex);
+    LatencyHistogram histogram;
+    histogram.merge(shards_->retired);
+    for (const auto &shard : shards_->all)
+        shard->addTo(histogram);
+    return histogram;
+}
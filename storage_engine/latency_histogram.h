@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Histogram of latencies in nanoseconds with a fixed relative precision, in
+// the manner of HdrHistogram: values up to 2^kSubBucketBits are counted
+// exactly, and every larger power-of-two range is split into 2^kSubBucketBits
+// equal buckets, so a reported percentile is within 1/128 of the true value
+// whatever its magnitude. Recording is an index computation and an
+// increment; histograms of the same kind add up with merge().
+//
+// Not thread-safe: every thread records into its own histogram, and the
+// histograms are merged for reporting. LatencyRecorder does that for a
+// histogram shared by many threads.
+class LatencyHistogram {
+public:
+    static const int kSubBucketBits = 7;
+
+    LatencyHistogram();
+
+    void record(uint64_t nanoseconds) {
+        ++counts_[bucketOf(nanoseconds)];
+        ++count_;
+        sum_ += nanoseconds;
+        if (nanoseconds < min_) min_ = nanoseconds;
+        if (nanoseconds > max_) max_ = nanoseconds;
+    }
+
+    void merge(const LatencyHistogram &other);
+    void clear();
+
+    // Removes the values of 'earlier', a previous state of this histogram, so
+    // that what is left are the values recorded since. The minimum and
+    // maximum become those of the remaining buckets.
+    void subtract(const LatencyHistogram &earlier);
+
+    uint64_t getCount() const { return count_; }
+    uint64_t getMin() const { return count_ ? min_ : 0; }
+    uint64_t getMax() const { return max_; }
+    double getMean() const { return count_ ? static_cast<double>(sum_) / count_ : 0; }
+
+    // Value that 'percentile' percent (0 to 100) of the recorded values do
+    // not exceed, as the highest value of its bucket; 0 if empty.
+    uint64_t getPercentile(double percentile) const;
+
+private:
+    friend class LatencyRecorder;
+
+    static const size_t kSubBuckets = size_t(1) << kSubBucketBits;
+    static const size_t kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    static size_t bucketOf(uint64_t value) {
+        if (value < kSubBuckets)
+            return static_cast<size_t>(value);
+        int exponent = 63 - __builtin_clzll(value);
+        int shift = exponent - kSubBucketBits;
+        return (shift + 1) * kSubBuckets + ((value >> shift) & (kSubBuckets - 1));
+    }
+
+    // Highest value counted in 'bucket'.
+    static uint64_t highestValueIn(size_t bucket);
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+// LatencyHistogram that many threads record into without locking. Every
+// thread has a shard of atomic counters that only it writes, so record() is
+// a few relaxed loads and stores; snapshot() adds the shards up. The shard
+// of a thread that exits is folded into the totals and reused by the next
+// thread, so memory follows the number of live threads.
+class LatencyRecorder {
+public:
+    LatencyRecorder();
+    ~LatencyRecorder();
+
+    LatencyRecorder(const LatencyRecorder &) = delete;
+    LatencyRecorder &operator=(const LatencyRecorder &) = delete;
+
+    void record(uint64_t nanoseconds);
+
+    // Everything recorded so far by all threads.
+    LatencyHistogram snapshot() const;
+
+private:
+    struct Shard {
+        std::atomic<uint64_t> counts[LatencyHistogram::kNumBuckets];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> min;
+        std::atomic<uint64_t> max;
+
+        Shard() { clear(); }
+        void clear();
+        void addTo(LatencyHistogram &histogram) const;
+    };
+
+    // The shards. Threads that exit after the recorder is gone find it
+    // expired, as they hold it weakly.
+    struct Shards {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Shard>> all;
+        std::vector<Shard *> free;
+        LatencyHistogram retired; // Values of threads that have exited.
+
+        void retire(Shard *shard);
+    };
+
+    struct ThreadShards;
+
+    // The calling thread's shard, taken on its first record().
+    Shard &shard();
+
+    size_t id_; // Index of this recorder's shard in every thread's table.
+    std::shared_ptr<Shards> shards_;
+};
@@ -0,0 +1,88 @@
+#include "memory_governor.h"
+#include <algorithm>
+
+MemoryGovernor::MemoryGovernor(size_t limit)
+    : limit_(limit), used_(0), peak_(0), denied_(0), reclaimedBytes_(0), nextId_(0)
+{
+}
+
+bool MemoryGovernor::tryReserve(size_t bytes, bool reclaim) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fits(bytes)) {
+            used_ += bytes;
+            peak_ = std::max(peak_, used_);
+            return true;
+        }
+        if (!reclaim) {
+            ++denied_;
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> reclaimLock(reclaimMutex_);
+    for (Entry &entry : reclaimers_) {
+        size_t missing;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (fits(bytes))
+                break;
+            missing = bytes - (limit_ - std::min(used_, limit_));
+        }
+        size_t freed = entry.reclaimer(missing);
+        std::lock_guard<std::mutex> lock(mutex_);
+        reclaimedBytes_ += freed;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!fits(bytes)) {
+        ++denied_;
+        return false;
+    }
+    used_ += bytes;
+    peak_ = std::max(peak_, used_);
+    return true;
+}
+
+void MemoryGovernor::reserve(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    used_ += bytes;
+    peak_ = std::max(peak_, used_);
+}
+
+void MemoryGovernor::release(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    used_ -= std::min(bytes, used_);
+}
+
+int MemoryGovernor::addReclaimer(Reclaimer reclaimer) {
+    std::lock_guard<std::mutex> reclaimLock(reclaimMutex_);
+    reclaimers_.push_back(Entry{nextId_, std::move(reclaimer)});
+    return nextId_++;
+}
+
+void MemoryGovernor::removeReclaimer(int id) {
+    std::lock_guard<std::mutex> reclaimLock(reclaimMutex_);
+    reclaimers_.erase(std::remove_if(reclaimers_.begin(), reclaimers_.end(),
+                                     [id](const Entry &entry) { return entry.id == id; }),
+                      reclaimers_.end());
+}
+
+size_t MemoryGovernor::getUsed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_;
+}
+
+size_t MemoryGovernor::getPeak() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return peak_;
+}
+
+uint64_t MemoryGovernor::getDenied() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return denied_;
+}
+
+uint64_t MemoryGovernor::getReclaimedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reclaimedBytes_;
+}
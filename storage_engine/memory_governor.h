@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Central budget for the memory of one database. Consumers reserve bytes
+// before they allocate them and release them when they are freed, so a
+// single large query cannot take memory the rest of the process needs.
+//
+// Memory that is only a cache (buffer pool frames, cached results) is given
+// back on demand by reclaimers: a reservation that does not fit first asks
+// them to free enough to make room. Consumers that can do without, such as
+// an aggregation that can spill its partitions to disk, are refused when the
+// budget is still exhausted and fall back on their slower path.
+class MemoryGovernor {
+public:
+    // Frees up to 'bytes' by calling release() and returns the bytes freed.
+    typedef std::function<size_t(size_t bytes)> Reclaimer;
+
+    // A limit of 0 grants every reservation.
+    explicit MemoryGovernor(size_t limit = 0);
+
+    // Grants 'bytes' if they fit within the limit. Unless 'reclaim' is false
+    // the reclaimers are asked to make room first. A consumer that is itself
+    // a reclaimer must not reclaim while it holds its own locks.
+    bool tryReserve(size_t bytes, bool reclaim = true);
+
+    // Counts 'bytes' even beyond the limit, for memory that is needed
+    // whatever the budget (so that the reservations after it are refused).
+    void reserve(size_t bytes);
+
+    void release(size_t bytes);
+
+    // Registers a reclaimer; it is called without the governor's locks held,
+    // never concurrently with itself. Returns an id for removeReclaimer(),
+    // which waits for a call in progress to return.
+    int addReclaimer(Reclaimer reclaimer);
+    void removeReclaimer(int id);
+
+    size_t getLimit() const { return limit_; }
+    size_t getUsed() const;
+    size_t getPeak() const;
+    // Reservations refused and bytes reclaimers have freed so far.
+    uint64_t getDenied() const;
+    uint64_t getReclaimedBytes() const;
+
+private:
+    // Whether 'bytes' more fit; mutex_ must be held.
+    bool fits(size_t bytes) const { return limit_ == 0 || (used_ <= limit_ && bytes <= limit_ - used_); }
+
+    size_t limit_;
+    size_t used_;
+    size_t peak_;
+    uint64_t denied_;
+    uint64_t reclaimedBytes_;
+    mutable std::mutex mutex_;
+
+    struct Entry {
+        int id;
+        Reclaimer reclaimer;
+    };
+    // Held while reclaimers run, so reclaims are serialized and a reclaimer
+    // is not removed during its call.
+    std::mutex reclaimMutex_;
+    std::vector<Entry> reclaimers_;
+    int nextId_;
+};
@@ -0,0 +1,88 @@
+#include "memory_tracker.h"
+#include <cstdio>
+
+static std::atomic<int64_t> subsystemBytes[kNumMemorySubsystems];
+static std::atomic<int64_t> subsystemPeakBytes[kNumMemorySubsystems];
+static thread_local QueryMemory *currentQueryMemory = nullptr;
+
+static void raisePeak(std::atomic<int64_t> &peak, int64_t value) {
+    int64_t seen = peak.load(std::memory_order_relaxed);
+    while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+static bool isQuerySubsystem(MemorySubsystem subsystem) {
+    return subsystem == MemorySubsystem::QUERY_ARENAS || subsystem == MemorySubsystem::QUERY_STATE;
+}
+
+const char *memorySubsystemName(MemorySubsystem subsystem) {
+    switch (subsystem) {
+    case MemorySubsystem::BUFFER_POOL:  return "buffer pool";
+    case MemorySubsystem::INDEXES:      return "indexes";
+    case MemorySubsystem::CATALOG:      return "catalog";
+    case MemorySubsystem::RESULT_CACHE: return "result cache";
+    case MemorySubsystem::QUERY_ARENAS: return "query arenas";
+    case MemorySubsystem::QUERY_STATE:  return "query state";
+    }
+    return "?";
+}
+
+int64_t MemoryBreakdown::total() const {
+    int64_t sum = 0;
+    for (int64_t value : bytes)
+        sum += value;
+    return sum;
+}
+
+std::vector<std::string> MemoryBreakdown::format() const {
+    std::vector<std::string> lines;
+    for (int s = 0; s < kNumMemorySubsystems; ++s) {
+        char line[128];
+        snprintf(line, sizeof(line), "%s: %.1f KB (peak %.1f KB)", memorySubsystemName(static_cast<MemorySubsystem>(s)),
+                 bytes[s] / 1024.0, peakBytes[s] / 1024.0);
+        lines.push_back(line);
+    }
+    char line[64];
+    snprintf(line, sizeof(line), "total: %.1f KB", total() / 1024.0);
+    lines.push_back(line);
+    return lines;
+}
+
+void MemoryTracker::allocated(MemorySubsystem subsystem, size_t bytes) {
+    int s = static_cast<int>(subsystem);
+    int64_t now = subsystemBytes[s].fetch_add(bytes, std::memory_order_relaxed) + static_cast<int64_t>(bytes);
+    raisePeak(subsystemPeakBytes[s], now);
+    if (currentQueryMemory != nullptr && isQuerySubsystem(subsystem))
+        currentQueryMemory->charge(static_cast<int64_t>(bytes));
+}
+
+void MemoryTracker::freed(MemorySubsystem subsystem, size_t bytes) {
+    subsystemBytes[static_cast<int>(subsystem)].fetch_sub(bytes, std::memory_order_relaxed);
+    if (currentQueryMemory != nullptr && isQuerySubsystem(subsystem))
+        currentQueryMemory->charge(-static_cast<int64_t>(bytes));
+}
+
+MemoryBreakdown MemoryTracker::getBreakdown() {
+    MemoryBreakdown breakdown;
+    for (int s = 0; s < kNumMemorySubsystems; ++s) {
+        breakdown.bytes[s] = subsystemBytes[s].load(std::memory_order_relaxed);
+        breakdown.peakBytes[s] = subsystemPeakBytes[s].load(std::memory_order_relaxed);
+    }
+    return breakdown;
+}
+
+void QueryMemory::charge(int64_t bytes) {
+    raisePeak(peak_, current_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+QueryMemory *QueryMemory::current() {
+    return currentQueryMemory;
+}
+
+QueryMemoryScope::QueryMemoryScope(QueryMemory *memory) : previous_(currentQueryMemory) {
+    currentQueryMemory = memory;
+}
+
+QueryMemoryScope::~QueryMemoryScope() {
+    currentQueryMemory = previous_;
+}
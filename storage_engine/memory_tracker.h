@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+
+// Parts of the process that memory is charged to.
+enum class MemorySubsystem {
+    BUFFER_POOL,  // Page frames.
+    INDEXES,      // B+ tree nodes.
+    CATALOG,      // Table statistics.
+    RESULT_CACHE, // Cached SELECT results.
+    QUERY_ARENAS, // Scratch arenas of executor workers and the parser.
+    QUERY_STATE   // Hash tables and buffers of running operators.
+};
+
+const int kNumMemorySubsystems = 6;
+
+const char *memorySubsystemName(MemorySubsystem subsystem);
+
+// Bytes charged to each subsystem, by MemorySubsystem value.
+struct MemoryBreakdown {
+    int64_t bytes[kNumMemorySubsystems] = {};
+    int64_t peakBytes[kNumMemorySubsystems] = {};
+
+    int64_t total() const;
+
+    // One line per subsystem with its current and peak size.
+    std::vector<std::string> format() const;
+};
+
+// Process-wide memory accounting. Allocations are charged to a subsystem
+// when they are made and credited back when they are freed, so
+// getBreakdown() tells what the memory in use is for at any time. Query
+// subsystems are also charged to the calling thread's QueryMemory.
+class MemoryTracker {
+public:
+    static void allocated(MemorySubsystem subsystem, size_t bytes);
+    static void freed(MemorySubsystem subsystem, size_t bytes);
+
+    static MemoryBreakdown getBreakdown();
+};
+
+// Query memory (QUERY_ARENAS and QUERY_STATE) allocated on behalf of one
+// statement, on every thread that has it installed by a QueryMemoryScope.
+// The executor installs the caller's on its workers.
+class QueryMemory {
+public:
+    QueryMemory() : current_(0), peak_(0) {}
+
+    QueryMemory(const QueryMemory &) = delete;
+    QueryMemory &operator=(const QueryMemory &) = delete;
+
+    void charge(int64_t bytes);
+
+    int64_t getCurrent() const { return current_.load(); }
+    // Most memory the statement held at once.
+    int64_t getPeak() const { return peak_.load(); }
+
+    // The QueryMemory installed on the calling thread, or null.
+    static QueryMemory *current();
+
+private:
+    std::atomic<int64_t> current_;
+    std::atomic<int64_t> peak_;
+};
+
+// Installs a QueryMemory (or null) on the calling thread for its lifetime.
+class QueryMemoryScope {
+public:
+    explicit QueryMemoryScope(QueryMemory *memory);
+    ~QueryMemoryScope();
+
+    QueryMemoryScope(const QueryMemoryScope &) = delete;
+    QueryMemoryScope &operator=(const QueryMemoryScope &) = delete;
+
+private:
+    QueryMemory *previous_;
+};
+
+// STL allocator charging the heap memory of a container to 'Subsystem'.
+template <typename T, MemorySubsystem Subsystem>
+class TrackingAllocator {
+public:
+    typedef T value_type;
+    template <typename U>
+    struct rebind {
+        typedef TrackingAllocator<U, Subsystem> other;
+    };
+
+    TrackingAllocator() {}
+    template <typename U>
+    TrackingAllocator(const TrackingAllocator<U, Subsystem> &) {}
+
+    T *allocate(size_t n) {
+        T *p = static_cast<T *>(::operator new(n * sizeof(T)));
+        MemoryTracker::allocated(Subsystem, n * sizeof(T));
+        return p;
+    }
+
+    void deallocate(T *p, size_t n) {
+        MemoryTracker::freed(Subsystem, n * sizeof(T));
+        ::operator delete(p);
+    }
+};
+
+template <typename T, typename U, MemorySubsystem Subsystem>
+bool operator==(const TrackingAllocator<T, Subsystem> &, const TrackingAllocator<U, Subsystem> &) {
+    return true;
+}
+
+template <typename T, typename U, MemorySubsystem Subsystem>
+bool operator!=(const TrackingAllocator<T, Subsystem> &, const TrackingAllocator<U, Subsystem> &) {
+    return false;
+}
+
+template <typename T, MemorySubsystem Subsystem>
+using TrackedVector = std::vector<T, TrackingAllocator<T, Subsystem>>;
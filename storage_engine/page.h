@@ -71,9 +71,17 @@ public:
     // 'record' points to the record bytes and 'length' is the record size.
     // Returns the slot id on success, or -1 if there isn't enough space.
     int insertRecord(const char* record, int length) {
+        // Reuse the slot of a deleted record if there is one; otherwise a new slot entry is needed.
+        int slotId = -1;
+        for (int i = 0; i < header.numberOfSlots; ++i) {
+            if (!slotDirectory[i].isValid) {
+                slotId = i;
+                break;
+            }
+        }
         // Calculate the space required: record data + a new slot entry.
         //so basically what we get from getFreeSpace is the space between the last record stored in the data section and slot directory vectors size
-        int requiredSpace = length + sizeof(Slot);
+        int requiredSpace = length + (slotId == -1 ? sizeof(Slot) : 0);
         if (getFreeSpace() < requiredSpace) {
             return -1; // Not enough free space.
         }
@@ -84,15 +92,20 @@ public:
         newSlot.offset = header.freeSpaceOffset;
         newSlot.length = length;
         newSlot.isValid = true;
-        // Append the new slot to our in-memory slot directory.
-        slotDirectory.push_back(newSlot);
-        header.numberOfSlots++;
+        if (slotId == -1) {
+            // Append the new slot to our in-memory slot directory.
+            slotDirectory.push_back(newSlot);
+            header.numberOfSlots++;
+            slotId = header.numberOfSlots - 1;
+        } else {
+            slotDirectory[slotId] = newSlot;
+        }
         // Update freeSpaceOffset.
         header.freeSpaceOffset += length;
         // Mark the page as dirty.
         header.dirty = true;
         // Return the slot id (i.e., the index of the new slot).
-        return header.numberOfSlots - 1;
+        return slotId;
     }
 
     // Retrieves a record by slot id.
@@ -108,40 +121,70 @@ public:
         return slot.length;
     }
 
+    // Returns a pointer to the record in 'slotId' inside the page, or nullptr
+    // if there is none, and stores its length in 'length'. The pointer stays
+    // valid while the page is fixed and the record is not modified.
+    const char* getRecordData(int slotId, int &length) const {
+        if (slotId < 0 || slotId >= header.numberOfSlots || !slotDirectory[slotId].isValid)
+            return nullptr;
+        length = slotDirectory[slotId].length;
+        return data + slotDirectory[slotId].offset;
+    }
+
+    // Returns the length of the record in 'slotId', or -1 if there is none.
+    int getRecordLength(int slotId) const {
+        if (slotId < 0 || slotId >= header.numberOfSlots || !slotDirectory[slotId].isValid)
+            return -1;
+        return slotDirectory[slotId].length;
+    }
+
+    // Number of entries in the slot directory, including deleted ones.
+    int getNumberOfSlots() const { return header.numberOfSlots; }
+
     // Deletes a record by slot id.
+    // The slot itself stays behind as an invalid entry so that the slot ids
+    // (and therefore record ids) of the other records on the page don't change.
     bool deleteRecord(int slotId) {
         // Check for valid slot id.
         if (slotId < 0 || slotId >= header.numberOfSlots)
             return false;
-        // Get the slot corresponding to the record to delete.
-        Slot slotToDelete = slotDirectory[slotId];
+        Slot &slotToDelete = slotDirectory[slotId];
         if (!slotToDelete.isValid)
             return false; // Already deleted.
-        int recordOffset = slotToDelete.offset;
-        int recordLength = slotToDelete.length;
-        int freeSpaceEnd = header.freeSpaceOffset;
-        // Calculate the number of bytes after the record.
-        int bytesAfter = freeSpaceEnd - (recordOffset + recordLength);
-        // If the record is not the last in the data area, shift subsequent data left.
-        if (bytesAfter > 0) {
-            // Move data from the end of the deleted record to the start position.
-            memmove(data + recordOffset, data + recordOffset + recordLength, bytesAfter);
-        }
-        // Update the free space pointer.
-        header.freeSpaceOffset -= recordLength;
-        // Remove the deleted slot from the slot directory.
-        slotDirectory.erase(slotDirectory.begin() + slotId);
-        header.numberOfSlots--;
-        // Update the offsets for all slots that follow the deleted record.
-        for (int i = slotId; i < header.numberOfSlots; ++i) {
-            slotDirectory[i].offset -= recordLength;
-        }
+        removeRecordData(slotToDelete.offset, slotToDelete.length);
+        slotToDelete.isValid = false;
+        slotToDelete.offset = 0;
+        slotToDelete.length = 0;
         // Mark the page as dirty since it has been modified.
         header.dirty = true;
         return true;
     }
-    
 
+    // Replaces the record in 'slotId', keeping its slot id.
+    // Returns false if the slot is empty or the new record doesn't fit on the page.
+    bool updateRecord(int slotId, const char* record, int length) {
+        if (slotId < 0 || slotId >= header.numberOfSlots)
+            return false;
+        Slot &slot = slotDirectory[slotId];
+        if (!slot.isValid)
+            return false;
+        if (length == slot.length) {
+            memcpy(data + slot.offset, record, length);
+            header.dirty = true;
+            return true;
+        }
+        if (getFreeSpace() + slot.length < length)
+            return false;
+        // Drop the old bytes and append the new version at the end of the record data.
+        removeRecordData(slot.offset, slot.length);
+        memcpy(data + header.freeSpaceOffset, record, length);
+        slot.offset = header.freeSpaceOffset;
+        slot.length = length;
+        header.freeSpaceOffset += length;
+        header.dirty = true;
+        return true;
+    }
+    
     // Serializes the page into a raw buffer of PAGE_SIZE bytes.
     // The layout is:
     // [Header][Record Data (from 0 to freeSpaceOffset)][Unused Space][Slot Directory (packed at the end)]
@@ -156,7 +199,8 @@ public:
         int slotDirSize = header.numberOfSlots * sizeof(Slot);
         int slotDirStart = dataAreaSize - slotDirSize;
         // Copy the slot directory from our in-memory vector into the appropriate location in the buffer.
-        memcpy(buffer + sizeof(header) + slotDirStart, slotDirectory.data(), slotDirSize);
+        if (slotDirSize > 0)
+            memcpy(buffer + sizeof(header) + slotDirStart, slotDirectory.data(), slotDirSize);
     }
 
     // Deserializes a raw buffer (of PAGE_SIZE bytes) into the Page object.
@@ -169,7 +213,8 @@ public:
         int dataAreaSize = PAGE_SIZE - sizeof(PageHeader);
         int slotDirStart = dataAreaSize - slotDirSize;
         slotDirectory.resize(header.numberOfSlots);
-        memcpy(slotDirectory.data(), buffer + sizeof(header) + slotDirStart, slotDirSize);
+        if (slotDirSize > 0)
+            memcpy(slotDirectory.data(), buffer + sizeof(header) + slotDirStart, slotDirSize);
     }
 
     // Clears the page.
@@ -199,4 +244,23 @@ public:
                       << ", valid=" << (s.isValid ? "true" : "false") << "\n";
         }
     }
+
+private:
+    // Removes 'length' bytes of record data at 'offset', shifting later record
+    // data left and fixing up the offsets of the slots that pointed past it.
+    void removeRecordData(int offset, int length) {
+        int freeSpaceEnd = header.freeSpaceOffset;
+        // Calculate the number of bytes after the record.
+        int bytesAfter = freeSpaceEnd - (offset + length);
+        // If the record is not the last in the data area, shift subsequent data left.
+        if (bytesAfter > 0) {
+            memmove(data + offset, data + offset + length, bytesAfter);
+        }
+        // Update the free space pointer.
+        header.freeSpaceOffset -= length;
+        for (int i = 0; i < header.numberOfSlots; ++i) {
+            if (slotDirectory[i].isValid && slotDirectory[i].offset > offset)
+                slotDirectory[i].offset -= length;
+        }
+    }
 };
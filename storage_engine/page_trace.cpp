@@ -0,0 +1,154 @@
+#include "page_trace.h"
+#include <cstring>
+
+constexpr char PageTraceWriter::kMagic[8];
+
+namespace {
+
+const size_t kBufferBytes = 1 << 16;
+const unsigned char kWriteFlag = 1;
+const unsigned char kUnfixFlag = 2;
+
+void appendVarint(std::vector<unsigned char> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+// Page id differences are signed; zigzag encoding keeps small ones short.
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+} // namespace
+
+PageTraceWriter::PageTraceWriter() : file_(nullptr), lastNanoseconds_(0), lastPageId_(0), accessCount_(0) {}
+
+PageTraceWriter::~PageTraceWriter() {
+    close();
+}
+
+bool PageTraceWriter::open(const std::string &fileName) {
+    close();
+    file_ = fopen(fileName.c_str(), "wb");
+    if (file_ == nullptr)
+        return false;
+    if (fwrite(kMagic, 1, sizeof(kMagic), file_) != sizeof(kMagic)) {
+        fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+    buffer_.clear();
+    buffer_.reserve(kBufferBytes + 32);
+    start_ = std::chrono::steady_clock::now();
+    lastNanoseconds_ = 0;
+    lastPageId_ = 0;
+    accessCount_ = 0;
+    return true;
+}
+
+void PageTraceWriter::close() {
+    if (file_ == nullptr)
+        return;
+    flush();
+    fclose(file_);
+    file_ = nullptr;
+}
+
+void PageTraceWriter::record(int pageId, bool isWrite, bool isUnfix) {
+    if (file_ == nullptr)
+        return;
+    uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count();
+    // The clock is monotonic, but keep the delta unsigned regardless.
+    if (nanoseconds < lastNanoseconds_)
+        nanoseconds = lastNanoseconds_;
+    buffer_.push_back((isWrite ? kWriteFlag : 0) | (isUnfix ? kUnfixFlag : 0));
+    appendVarint(buffer_, nanoseconds - lastNanoseconds_);
+    appendVarint(buffer_, zigzag(static_cast<int64_t>(pageId) - lastPageId_));
+    lastNanoseconds_ = nanoseconds;
+    lastPageId_ = pageId;
+    ++accessCount_;
+    if (buffer_.size() >= kBufferBytes)
+        flush();
+}
+
+void PageTraceWriter::flush() {
+    if (!buffer_.empty())
+        fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    buffer_.clear();
+}
+
+PageTraceReader::PageTraceReader() : file_(nullptr), position_(0), nanoseconds_(0), pageId_(0) {}
+
+PageTraceReader::~PageTraceReader() {
+    if (file_ != nullptr)
+        fclose(file_);
+}
+
+bool PageTraceReader::open(const std::string &fileName) {
+    if (file_ != nullptr)
+        fclose(file_);
+    file_ = fopen(fileName.c_str(), "rb");
+    if (file_ == nullptr)
+        return false;
+    char magic[sizeof(PageTraceWriter::kMagic)];
+    if (fread(magic, 1, sizeof(magic), file_) != sizeof(magic) ||
+        memcmp(magic, PageTraceWriter::kMagic, sizeof(magic)) != 0) {
+        fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+    buffer_.clear();
+    position_ = 0;
+    nanoseconds_ = 0;
+    pageId_ = 0;
+    return true;
+}
+
+bool PageTraceReader::readByte(unsigned char &byte) {
+    if (position_ == buffer_.size()) {
+        if (file_ == nullptr)
+            return false;
+        buffer_.resize(kBufferBytes);
+        buffer_.resize(fread(buffer_.data(), 1, kBufferBytes, file_));
+        position_ = 0;
+        if (buffer_.empty())
+            return false;
+    }
+    byte = buffer_[position_++];
+    return true;
+}
+
+bool PageTraceReader::readVarint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        unsigned char byte;
+        if (!readByte(byte))
+            return false;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool PageTraceReader::next(PageAccess &access) {
+    unsigned char flags;
+    uint64_t delta, pageDelta;
+    if (!readByte(flags) || !readVarint(delta) || !readVarint(pageDelta))
+        return false;
+    nanoseconds_ += delta;
+    pageId_ = static_cast<int>(pageId_ + unzigzag(pageDelta));
+    access.nanoseconds = nanoseconds_;
+    access.pageId = pageId_;
+    access.isWrite = (flags & kWriteFlag) != 0;
+    access.isUnfix = (flags & kUnfixFlag) != 0;
+    return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// One buffer pool request: a fixPage() or an unfixPage() of a page.
+struct PageAccess {
+    uint64_t nanoseconds; // Since the trace was opened.
+    int pageId;
+    bool isWrite;         // Fixed for writing, or unfixed dirty.
+    bool isUnfix;
+};
+
+// Writes the page requests of a BufferPool to a file, for replaying them
+// against other replacement policies and pool sizes offline.
+//
+// The file starts with kMagic. Every access is then a flags byte (bit 0
+// write, bit 1 unfix) followed by the time since the previous access and the
+// difference to the previous page id as variable-length integers, so a
+// typical access takes 3 to 5 bytes. Accesses are buffered and written in
+// large blocks.
+//
+// Not thread-safe: the buffer pool records under its own mutex.
+class PageTraceWriter {
+public:
+    static constexpr char kMagic[8] = {'P', 'G', 'T', 'R', 'A', 'C', 'E', '1'};
+
+    PageTraceWriter();
+    ~PageTraceWriter();
+
+    PageTraceWriter(const PageTraceWriter &) = delete;
+    PageTraceWriter &operator=(const PageTraceWriter &) = delete;
+
+    // Creates (or truncates) 'fileName'. Returns false if it cannot be
+    // written.
+    bool open(const std::string &fileName);
+
+    // Writes what is buffered and closes the file.
+    void close();
+
+    bool isOpen() const { return file_ != nullptr; }
+
+    void record(int pageId, bool isWrite, bool isUnfix);
+
+    uint64_t getAccessCount() const { return accessCount_; }
+
+private:
+    void flush();
+
+    FILE *file_;
+    std::vector<unsigned char> buffer_;
+    std::chrono::steady_clock::time_point start_;
+    uint64_t lastNanoseconds_;
+    int lastPageId_;
+    uint64_t accessCount_;
+};
+
+// Reads a file written by PageTraceWriter.
+class PageTraceReader {
+public:
+    PageTraceReader();
+    ~PageTraceReader();
+
+    PageTraceReader(const PageTraceReader &) = delete;
+    PageTraceReader &operator=(const PageTraceReader &) = delete;
+
+    // Returns false if 'fileName' cannot be read or is not a page trace.
+    bool open(const std::string &fileName);
+
+    // Next access; false at the end of the trace or if it is truncated.
+    bool next(PageAccess &access);
+
+private:
+    bool readByte(unsigned char &byte);
+    bool readVarint(uint64_t &value);
+
+    FILE *file_;
+    std::vector<unsigned char> buffer_;
+    size_t position_;
+    uint64_t nanoseconds_;
+    int pageId_;
+};
@@ -0,0 +1,93 @@
+#include "storage_latency.h"
+#include <cstdio>
+
+std::atomic<bool> StorageLatency::enabled_[kNumStorageOperations] = {{true}, {true}, {false}, {true}, {true}};
+
+namespace {
+
+LatencyRecorder &recorder(StorageOperation operation) {
+    static LatencyRecorder recorders[kNumStorageOperations];
+    return recorders[static_cast<int>(operation)];
+}
+
+std::vector<LatencyHistogram> snapshotAll() {
+    std::vector<LatencyHistogram> histograms;
+    for (int i = 0; i < kNumStorageOperations; ++i)
+        histograms.push_back(StorageLatency::snapshot(static_cast<StorageOperation>(i)));
+    return histograms;
+}
+
+} // namespace
+
+const char *storageOperationName(StorageOperation operation) {
+    switch (operation) {
+    case StorageOperation::DISK_READ: return "DiskManager::readPage";
+    case StorageOperation::DISK_WRITE: return "DiskManager::writePage";
+    case StorageOperation::FIX_PAGE: return "BufferPool::fixPage";
+    case StorageOperation::WAL_FLUSH: return "WAL flush";
+    case StorageOperation::COMMIT: return "Commit";
+    }
+    return "?";
+}
+
+void StorageLatency::setEnabled(StorageOperation operation, bool enabled) {
+    enabled_[static_cast<int>(operation)].store(enabled, std::memory_order_relaxed);
+}
+
+void StorageLatency::record(StorageOperation operation, uint64_t nanoseconds) {
+    recorder(operation).record(nanoseconds);
+}
+
+LatencyHistogram StorageLatency::snapshot(StorageOperation operation) {
+    return recorder(operation).snapshot();
+}
+
+std::vector<std::string> StorageLatency::format() {
+    return format(snapshotAll());
+}
+
+std::vector<std::string> StorageLatency::format(const std::vector<LatencyHistogram> &histograms) {
+    std::vector<std::string> lines;
+    char line[256];
+    for (size_t i = 0; i < histograms.size(); ++i) {
+        const LatencyHistogram &histogram = histograms[i];
+        if (histogram.getCount() == 0)
+            continue;
+        snprintf(line, sizeof(line),
+                 "%-24s %10llu ops  mean %8.1f us  p50 %8.1f us  p90 %8.1f us  p99 %8.1f us  p99.9 %8.1f us  "
+                 "max %8.1f us",
+                 storageOperationName(static_cast<StorageOperation>(i)),
+                 static_cast<unsigned long long>(histogram.getCount()), histogram.getMean() / 1e3,
+                 histogram.getPercentile(50) / 1e3, histogram.getPercentile(90) / 1e3,
+                 histogram.getPercentile(99) / 1e3, histogram.getPercentile(99.9) / 1e3,
+                 histogram.getMax() / 1e3);
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+StorageLatencyReporter::StorageLatencyReporter(std::chrono::milliseconds interval, Sink sink)
+    : interval_(interval), sink_(sink), stop_(false), previous_(snapshotAll()) {
+    thread_ = std::thread([this] { run(); });
+}
+
+StorageLatencyReporter::~StorageLatencyReporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    stopped_.notify_all();
+    thread_.join();
+}
+
+void StorageLatencyReporter::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopped_.wait_for(lock, interval_, [this] { return stop_; })) {
+        std::vector<LatencyHistogram> current = snapshotAll();
+        std::vector<LatencyHistogram> interval = current;
+        for (size_t i = 0; i < interval.size(); ++i)
+            interval[i].subtract(previous_[i]);
+        previous_ = std::move(current);
+        sink_(StorageLatency::format(interval));
+    }
+}
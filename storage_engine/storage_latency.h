@@ -0,0 +1,101 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "latency_histogram.h"
+
+// Storage operations whose latency is recorded.
+enum class StorageOperation {
+    DISK_READ,  // DiskManager::readPage().
+    DISK_WRITE, // DiskManager::writePage().
+    FIX_PAGE,   // BufferPool::fixPage(), including the wait for its mutex.
+    WAL_FLUSH,  // Reserved for the write-ahead log, which does not exist yet.
+    COMMIT      // Reserved likewise.
+};
+
+const int kNumStorageOperations = 5;
+
+const char *storageOperationName(StorageOperation operation);
+
+// Latencies of every StorageOperation, process-wide, in one LatencyRecorder
+// each: any thread records without locking, and a snapshot merges all of
+// them. Recording is switched per operation; a switched-off operation costs
+// a relaxed load. Timing takes two clock reads, which is noise next to disk
+// I/O but a large part of a buffer pool hit, so FIX_PAGE is off until
+// enabled and the others are on.
+class StorageLatency {
+public:
+    static void setEnabled(StorageOperation operation, bool enabled);
+    static bool isEnabled(StorageOperation operation) {
+        return enabled_[static_cast<int>(operation)].load(std::memory_order_relaxed);
+    }
+
+    static void record(StorageOperation operation, uint64_t nanoseconds);
+
+    // Everything recorded for 'operation' since the process started.
+    static LatencyHistogram snapshot(StorageOperation operation);
+
+    // One line per operation with recorded values: count, mean, p50, p90,
+    // p99, p99.9 and max. 'histograms' are by StorageOperation value; the
+    // first overload formats the current snapshots.
+    static std::vector<std::string> format();
+    static std::vector<std::string> format(const std::vector<LatencyHistogram> &histograms);
+
+private:
+    static std::atomic<bool> enabled_[kNumStorageOperations];
+};
+
+// Records the time from its construction to its destruction as one
+// 'operation', if recording it was enabled when it was constructed.
+class StorageLatencyTimer {
+public:
+    explicit StorageLatencyTimer(StorageOperation operation)
+        : operation_(operation), enabled_(StorageLatency::isEnabled(operation)) {
+        if (enabled_)
+            start_ = std::chrono::steady_clock::now();
+    }
+
+    ~StorageLatencyTimer() {
+        if (enabled_)
+            StorageLatency::record(operation_, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                   std::chrono::steady_clock::now() - start_).count());
+    }
+
+    StorageLatencyTimer(const StorageLatencyTimer &) = delete;
+    StorageLatencyTimer &operator=(const StorageLatencyTimer &) = delete;
+
+private:
+    StorageOperation operation_;
+    bool enabled_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Hands the storage latencies of every interval of 'interval' to 'sink',
+// formatted as StorageLatency::format() does, from a thread of its own
+// until it is destroyed.
+class StorageLatencyReporter {
+public:
+    typedef std::function<void(const std::vector<std::string> &)> Sink;
+
+    StorageLatencyReporter(std::chrono::milliseconds interval, Sink sink);
+    ~StorageLatencyReporter();
+
+    StorageLatencyReporter(const StorageLatencyReporter &) = delete;
+    StorageLatencyReporter &operator=(const StorageLatencyReporter &) = delete;
+
+private:
+    void run();
+
+    std::chrono::milliseconds interval_;
+    Sink sink_;
+    std::mutex mutex_;
+    std::condition_variable stopped_;
+    bool stop_;
+    std::vector<LatencyHistogram> previous_; // Snapshots at the last report.
+    std::thread thread_;
+};
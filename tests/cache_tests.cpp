@@ -0,0 +1,36 @@
+// The SELECT result cache and its invalidation.
+#include "test.h"
+
+TEST(resultCacheDropsResultsOfModifiedTables) {
+    DatabaseOptions options;
+    options.resultCacheBytes = 1 << 20;
+    TestDatabase db("resultCache", options);
+    runQuery(*db, "CREATE TABLE t (id INT, v INT)");
+    runQuery(*db, "CREATE TABLE u (id INT)");
+    for (int i = 0; i < 100; ++i)
+        runQuery(*db, "INSERT INTO t VALUES (?, ?)", {Value::makeInteger(i), Value::makeInteger(i % 10)});
+    const std::string sum = "SELECT SUM(v) FROM t WHERE id < ?";
+    const std::vector<Value> fifty = {Value::makeInteger(50)};
+
+    CHECK_EQ(queryValue(*db, sum, fifty).asDouble(), 225.0);
+    CHECK_EQ(queryValue(*db, sum, fifty).asDouble(), 225.0);
+    CHECK_EQ(db->getResultCacheHits(), size_t(1));
+    // Other parameter values are cached separately.
+    CHECK_EQ(queryValue(*db, sum, {Value::makeInteger(10)}).asDouble(), 45.0);
+    CHECK_EQ(db->getResultCacheHits(), size_t(1));
+
+    // Changing another table keeps the result.
+    runQuery(*db, "INSERT INTO u VALUES (1)");
+    CHECK_EQ(queryValue(*db, sum, fifty).asDouble(), 225.0);
+    CHECK_EQ(db->getResultCacheHits(), size_t(2));
+
+    size_t misses = db->getResultCacheMisses();
+    runQuery(*db, "INSERT INTO t VALUES (0, 100)");
+    CHECK_EQ(queryValue(*db, sum, fifty).asDouble(), 325.0);
+    runQuery(*db, "UPDATE t SET v = 0 WHERE id = 0");
+    CHECK_EQ(queryValue(*db, sum, fifty).asDouble(), 225.0);
+    runQuery(*db, "DELETE FROM t WHERE id < 10");
+    CHECK_EQ(queryValue(*db, sum, fifty).asDouble(), 180.0);
+    CHECK_EQ(db->getResultCacheMisses(), misses + 3);
+    CHECK_EQ(db->getResultCacheHits(), size_t(2));
+}
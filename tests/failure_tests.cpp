@@ -0,0 +1,195 @@
+// Statements that cannot fix a page, and operators that see rows vanish.
+#include <fstream>
+#include "../query_engine/operators.h"
+#include "test.h"
+
+static const int kPoolFrames = 8;
+
+// Pins 'frames' frames of the buffer pool (all of them by default) with new
+// pages until release().
+class PinnedPool {
+public:
+    explicit PinnedPool(BufferPool &pool, int frames = kPoolFrames) : pool_(pool) {
+        for (int i = 0; i < frames; ++i) {
+            int pageId;
+            if (Page *page = pool_.newPage(pageId))
+                pages_.push_back(page);
+        }
+        CHECK_EQ(pages_.size(), size_t(frames));
+    }
+    ~PinnedPool() { release(); }
+
+    void release() {
+        for (Page *page : pages_)
+            pool_.unfixPage(page, false);
+        pages_.clear();
+    }
+
+private:
+    BufferPool &pool_;
+    std::vector<Page *> pages_;
+};
+
+static DatabaseOptions smallPoolOptions() {
+    DatabaseOptions options;
+    options.bufferPoolSize = kPoolFrames;
+    options.executor.numWorkers = 4;
+    return options;
+}
+
+static void loadRows(Database &db) {
+    runQuery(db, "CREATE TABLE t (id INT, v INT, s VARCHAR(200))");
+    for (int i = 0; i < 2000; ++i)
+        runQuery(db, "INSERT INTO t VALUES (?, ?, ?)",
+                 {Value::makeInteger(i), Value::makeInteger(i % 10), Value::makeVarchar(std::string(150, 'x'))});
+}
+
+static void checkFails(Database &db, const std::string &sql) {
+    QueryResult result = db.execute(sql);
+    if (result.ok)
+        testFailed(__FILE__, __LINE__, sql + " succeeded");
+}
+
+TEST(statementsFailOnPagesThatCannotBeFixed) {
+    TestDatabase db("pinned", smallPoolOptions());
+    loadRows(*db);
+    PinnedPool pinned(db->getBufferPool());
+    QueryResult result = db->execute("SELECT COUNT(*) FROM t");
+    CHECK(!result.ok);
+    CHECK(result.error.find("could not fix page") != std::string::npos);
+    checkFails(*db, "SELECT v, COUNT(*) FROM t GROUP BY v");
+    checkFails(*db, "UPDATE t SET v = 1 WHERE id < 10");
+    checkFails(*db, "DELETE FROM t WHERE id < 10");
+    checkFails(*db, "CREATE INDEX ti ON t (id)");
+    checkFails(*db, "ANALYZE t");
+    checkFails(*db, "CREATE MATERIALIZED VIEW tv AS SELECT v, COUNT(*) AS n FROM t GROUP BY v");
+
+    std::string error;
+    std::unique_ptr<ResultCursor> cursor = db->openCursor("SELECT id FROM t", {}, error);
+    if (cursor) {
+        Batch batch;
+        while (cursor->next(batch)) {
+        }
+        CHECK(!cursor->getError().empty());
+    } else {
+        CHECK(!error.empty());
+    }
+    cursor.reset();
+
+    // Nothing was changed or registered by the failed statements.
+    pinned.release();
+    CHECK_EQ(queryValue(*db, "SELECT COUNT(*) FROM t WHERE v = 1").integer, 200);
+    runQuery(*db, "CREATE INDEX ti ON t (id)");
+    runQuery(*db, "ANALYZE t");
+    runQuery(*db, "CREATE MATERIALIZED VIEW tv AS SELECT v, COUNT(*) AS n FROM t GROUP BY v");
+    CHECK_EQ(queryValue(*db, "SELECT n FROM tv WHERE v = 3").integer, 200);
+}
+
+static long fileSize(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    return static_cast<long>(file.tellg());
+}
+
+TEST(failedViewsGiveTheirPagesBack) {
+    TestDatabase db("viewPages", smallPoolOptions());
+    loadRows(*db);
+    // One frame is left: the view cannot fix a page of its own while the
+    // base table's page is fixed.
+    PinnedPool pinned(db->getBufferPool(), kPoolFrames - 1);
+    long size = 0;
+    for (int i = 0; i < 5; ++i) {
+        checkFails(*db, "CREATE MATERIALIZED VIEW tv AS SELECT v, COUNT(*) AS n FROM t GROUP BY v");
+        checkFails(*db, "CREATE MATERIALIZED VIEW tv AS SELECT COUNT(*) AS n FROM t");
+        // The pages the first attempts took are reused by the later ones.
+        if (i == 0)
+            size = fileSize(db.getFileName());
+    }
+    CHECK_EQ(fileSize(db.getFileName()), size);
+}
+
+TEST(freedHeapPagesAreReused) {
+    const std::string fileName = "heapPages.db";
+    {
+        DiskManager disk(fileName);
+        BufferPool pool(4, &disk);
+        std::vector<char> record(500, 'x');
+        HeapFile first(&pool);
+        for (int i = 0; i < 100; ++i)
+            first.insertRecord(record);
+        std::vector<int> pageIds = first.getPageIds();
+        int pages = disk.getNumberOfPages();
+        first.freePages();
+        CHECK_EQ(first.getNumberOfPages(), 0);
+
+        HeapFile second(&pool);
+        RecordId id = {-1, -1};
+        for (int i = 0; i < 100; ++i)
+            id = second.insertRecord(record);
+        CHECK_EQ(disk.getNumberOfPages(), pages);
+        std::vector<int> reused = second.getPageIds();
+        std::sort(pageIds.begin(), pageIds.end());
+        std::sort(reused.begin(), reused.end());
+        CHECK(reused == pageIds);
+        // Reused pages start out empty.
+        std::vector<char> read;
+        CHECK(second.getRecord(id, read) && read == record);
+        CHECK_EQ(second.getRecord({id.pageId, id.slotId + 1}, read), false);
+    }
+    std::remove(fileName.c_str());
+}
+
+TEST(fetchDropsDeletedRows) {
+    const std::string fileName = "fetch.db";
+    {
+        DiskManager disk(fileName);
+        BufferPool pool(16, &disk);
+        HeapFile heap(&pool);
+        Schema schema({{"a", TypeId::BIGINT}});
+        std::vector<RecordId> ids;
+        std::vector<char> record;
+        for (int i = 0; i < 10; ++i) {
+            schema.serializeRow({Value::makeBigint(i * 10)}, record);
+            ids.push_back(heap.insertRecord(record));
+        }
+        heap.deleteRecord(ids[3]);
+        heap.deleteRecord(ids[7]);
+
+        // Ids in reverse order, so the fetch has to put rows back in place.
+        Batch batch;
+        batch.columns.emplace_back(TypeId::BIGINT);
+        batch.columns[0].resize(10);
+        batch.count = 10;
+        for (int i = 0; i < 10; ++i)
+            batch.columns[0].values<int64_t>()[9 - i] = encodeRecordId(ids[i]);
+        batch.hasSelection = true;
+        batch.selection = {0, 1, 2, 4, 5, 6, 8, 9};
+
+        Arena arena(4096);
+        ArenaScope scope(&arena);
+        FetchOperator fetch(&heap, schema, 0, {0});
+        fetch.execute(batch);
+        std::vector<int64_t> values;
+        for (size_t i = 0; i < batch.activeCount(); ++i)
+            values.push_back(batch.columns[1].values<int64_t>()[batch.rowAt(i)]);
+        CHECK(values == std::vector<int64_t>({90, 80, 50, 40, 10, 0}));
+    }
+    std::remove(fileName.c_str());
+}
+
+TEST(streamReopensAfterClose) {
+    StreamSink sink(1);
+    Batch batch;
+    batch.columns.emplace_back(TypeId::BIGINT);
+    batch.columns[0].resize(1);
+    batch.count = 1;
+    sink.prepare(1);
+    sink.close();
+    sink.finish();
+    sink.prepare(1);
+    Batch copy = batch;
+    CHECK(sink.consume(copy, 0));
+    sink.finish();
+    CHECK(sink.next(copy));
+    CHECK(!sink.next(copy));
+    CHECK(sink.getError().empty());
+}
@@ -0,0 +1,165 @@
+// Statements with parameters and aggregations.
+#include "../storage_engine/event_trace.h"
+#include "test.h"
+
+static void loadRows(Database &db, int rows) {
+    runQuery(db, "CREATE TABLE t (id INT, g INT, x DOUBLE)");
+    for (int i = 0; i < rows; ++i)
+        runQuery(db, "INSERT INTO t VALUES (?, ?, ?)",
+                 {Value::makeInteger(i), Value::makeInteger(i / 7), Value::makeDouble(i * 0.5)});
+}
+
+TEST(parametersRebindCachedPlan) {
+    TestDatabase db("parameters");
+    loadRows(*db, 3000);
+    size_t misses = db->getPlanCacheMisses();
+    CHECK_EQ(queryValue(*db, "SELECT COUNT(*) FROM t WHERE id < ?", {Value::makeInteger(100)}).integer, 100);
+    CHECK_EQ(queryValue(*db, "SELECT COUNT(*) FROM t WHERE id < ?", {Value::makeInteger(2000)}).integer, 2000);
+    CHECK_EQ(db->getPlanCacheMisses(), misses + 1);
+    CHECK_EQ(queryValue(*db, "SELECT COUNT(*) FROM t WHERE id >= ? AND x < ?",
+                        {Value::makeBigint(10), Value::makeDouble(20)}).integer, 30);
+
+    std::string error;
+    std::shared_ptr<PreparedStatement> statement = db->prepare("SELECT id FROM t WHERE id = ? OR g = ?", error);
+    CHECK(statement);
+    if (statement) {
+        CHECK_EQ(statement->getNumParameters(), 2);
+        QueryResult result = db->execute(*statement, {Value::makeInteger(2999), Value::makeInteger(1)});
+        CHECK(result.ok);
+        CHECK_EQ(result.rowCount, size_t(8));
+    }
+}
+
+TEST(parametersWithoutColumnOperands) {
+    TestDatabase db("constantParameters");
+    loadRows(*db, 3000);
+    const std::string equalsOne = "SELECT COUNT(*) FROM t WHERE ? = 1";
+    CHECK_EQ(queryValue(*db, equalsOne, {Value::makeInteger(1)}).integer, 3000);
+    CHECK_EQ(queryValue(*db, equalsOne, {Value::makeInteger(2)}).integer, 0);
+    const std::string equal = "SELECT COUNT(*) FROM t WHERE ? = ?";
+    CHECK_EQ(queryValue(*db, equal, {Value::makeInteger(4), Value::makeInteger(4)}).integer, 3000);
+    CHECK_EQ(queryValue(*db, equal, {Value::makeInteger(4), Value::makeInteger(5)}).integer, 0);
+    CHECK_EQ(queryValue(*db, "SELECT COUNT(*) FROM t WHERE id < ? + 1", {Value::makeInteger(99)}).integer, 100);
+    CHECK_EQ(queryValue(*db, "SELECT SUM(id + ? * 2) FROM t WHERE id < 10", {Value::makeInteger(3)}).asDouble(),
+             105.0);
+}
+
+TEST(parametersConvertLikeLiterals) {
+    TestDatabase db("parameterTypes");
+    loadRows(*db, 100);
+    // A placeholder typed from an INTEGER column rejects values it would change.
+    CHECK_EQ(queryValue(*db, "SELECT COUNT(*) FROM t WHERE id < 2.5").integer, 3);
+    CHECK(!db->execute("SELECT COUNT(*) FROM t WHERE id < ?", {Value::makeDouble(2.5)}).ok);
+    CHECK(!db->execute("SELECT COUNT(*) FROM t WHERE id = ?", {Value::makeDouble(2.5)}).ok);
+    CHECK(!db->execute("SELECT COUNT(*) FROM t WHERE id = ?", {Value::makeBigint(int64_t(1) << 32)}).ok);
+    CHECK_EQ(queryValue(*db, "SELECT COUNT(*) FROM t WHERE id < ?", {Value::makeDouble(3)}).integer, 3);
+    // Next to a wider operand or context it takes the wider type.
+    CHECK_EQ(queryValue(*db, "SELECT COUNT(*) FROM t WHERE x < ?", {Value::makeDouble(1.25)}).integer, 3);
+    CHECK_EQ(queryValue(*db, "SELECT COUNT(*) FROM t WHERE x < ? + g", {Value::makeDouble(3.5)}).integer,
+             queryValue(*db, "SELECT COUNT(*) FROM t WHERE x < 3.5 + g").integer);
+    CHECK_EQ(queryValue(*db, "SELECT COUNT(*) FROM t WHERE id + 0.5 < ? * 2", {Value::makeDouble(1.5)}).integer,
+             3);
+}
+
+TEST(divisionOfSmallestValueByMinusOneWraps) {
+    TestDatabase db("division");
+    const int64_t smallest = INT64_MIN;
+    runQuery(*db, "CREATE TABLE d (a BIGINT, b BIGINT, i INT, j INT)");
+    runQuery(*db, "INSERT INTO d VALUES (?, -1, ?, -1)", {Value::makeBigint(smallest), Value::makeInteger(INT32_MIN)});
+    QueryResult result = runQuery(*db, "SELECT a / b, i / j, a / ?, ? / b, ? / ?, a / 0 FROM d",
+                                  {Value::makeBigint(-1), Value::makeBigint(smallest), Value::makeBigint(smallest),
+                                   Value::makeBigint(-1)});
+    CHECK_EQ(result.getValue(0, 0).integer, smallest);
+    CHECK_EQ(result.getValue(0, 1).integer, int64_t(INT32_MIN));
+    CHECK_EQ(result.getValue(0, 2).integer, smallest);
+    CHECK_EQ(result.getValue(0, 3).integer, smallest);
+    CHECK_EQ(result.getValue(0, 4).integer, smallest);
+    CHECK_EQ(result.getValue(0, 5).integer, 0);
+}
+
+TEST(parametersRejectBadBinds) {
+    TestDatabase db("badBinds");
+    loadRows(*db, 10);
+    CHECK(!db->execute("SELECT COUNT(*) FROM t WHERE id < ?").ok);
+    CHECK(!db->execute("SELECT COUNT(*) FROM t WHERE id < ?", {Value::makeInteger(1), Value::makeInteger(2)}).ok);
+    CHECK(!db->execute("SELECT COUNT(*) FROM t WHERE id < ?", {Value::makeVarchar("a")}).ok);
+}
+
+TEST(aggregationSpillKeepsEveryGroup) {
+    DatabaseOptions options;
+    options.executor.numWorkers = 4;
+    options.aggregate.memoryBudget = 4096;
+    options.aggregate.localTableCapacity = 16;
+    TestDatabase db("spill", options);
+    const int rows = 7000;
+    loadRows(*db, rows);
+    QueryResult result = runQuery(*db, "SELECT g, COUNT(*), SUM(x), MIN(id), MAX(id) FROM t GROUP BY g ORDER BY g");
+    CHECK_EQ(result.rowCount, size_t(rows / 7));
+    for (size_t row = 0; row < result.rowCount; ++row) {
+        int64_t g = result.getValue(row, 0).integer;
+        CHECK_EQ(g, int64_t(row));
+        CHECK_EQ(result.getValue(row, 1).integer, 7);
+        CHECK_EQ(result.getValue(row, 2).asDouble(), (g * 7 * 7 + 21) * 0.5);
+        CHECK_EQ(result.getValue(row, 3).asDouble(), g * 7.0);
+        CHECK_EQ(result.getValue(row, 4).asDouble(), g * 7.0 + 6);
+    }
+}
+
+TEST(aggregationKeepsIntegralResultsExact) {
+    DatabaseOptions options;
+    options.executor.numWorkers = 4;
+    options.aggregate.memoryBudget = 4096;
+    options.aggregate.localTableCapacity = 16;
+    TestDatabase db("exactAggregates", options);
+    const int64_t big = (int64_t(1) << 53) + 1;
+    runQuery(*db, "CREATE TABLE u (a BIGINT)");
+    runQuery(*db, "INSERT INTO u VALUES (9007199254740993), (1)");
+    QueryResult result = runQuery(*db, "SELECT SUM(a), MIN(a), MAX(a), COUNT(*) FROM u");
+    CHECK_EQ(result.getValue(0, 0).integer, big + 1);
+    CHECK_EQ(result.getValue(0, 1).integer, 1);
+    CHECK_EQ(result.getValue(0, 2).integer, big);
+    CHECK_EQ(result.getValue(0, 3).integer, 2);
+
+    // Enough groups to spill, each with two values beyond 2^53.
+    runQuery(*db, "CREATE TABLE v (g INT, a BIGINT)");
+    const int groups = 2000;
+    for (int i = 0; i < 2 * groups; ++i)
+        runQuery(*db, "INSERT INTO v VALUES (?, ?)", {Value::makeInteger(i % groups), Value::makeBigint(big + i)});
+    result = runQuery(*db, "SELECT g, SUM(a), MIN(a), MAX(a) FROM v GROUP BY g ORDER BY g");
+    CHECK_EQ(result.rowCount, size_t(groups));
+    for (size_t row = 0; row < result.rowCount; ++row) {
+        int64_t g = result.getValue(row, 0).integer;
+        CHECK_EQ(result.getValue(row, 1).integer, 2 * big + 2 * g + groups);
+        CHECK_EQ(result.getValue(row, 2).integer, big + g);
+        CHECK_EQ(result.getValue(row, 3).integer, big + g + groups);
+    }
+    runQuery(*db, "CREATE MATERIALIZED VIEW sums AS SELECT g, SUM(a) AS s FROM v GROUP BY g");
+    CHECK_EQ(runQuery(*db, "SELECT g, s FROM sums ORDER BY g").toString(),
+             runQuery(*db, "SELECT g, SUM(a) AS s FROM v GROUP BY g ORDER BY g").toString());
+}
+
+TEST(aggregationRejectsTooManyAggregates) {
+    TestDatabase db("manyAggregates");
+    loadRows(*db, 10);
+    std::string sql = "SELECT g";
+    for (int k = 0; k < 127; ++k)
+        sql += ", SUM(x + " + std::to_string(k) + ")";
+    QueryResult result = db->execute(sql + " FROM t GROUP BY g");
+    CHECK(!result.ok);
+    CHECK(result.error.find("too many aggregates") != std::string::npos);
+}
+
+#ifdef DBENGINE_TRACING
+TEST(traceNamesPipelineStages) {
+    TestDatabase db("trace");
+    loadRows(*db, 3000);
+    runQuery(*db, "SELECT g, COUNT(*) FROM t GROUP BY g");
+    EventTrace::start();
+    runQuery(*db, "SELECT g, SUM(x) FROM t GROUP BY g");
+    EventTrace::stop();
+    bool sinkTraced = false;
+    for (const TraceEvent &event : EventTrace::collect())
+        sinkTraced |= std::string(event.category) == "executor" && std::string(event.name) == "HashAggregate";
+    CHECK(sinkTraced);
+}
+#endif
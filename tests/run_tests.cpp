@@ -0,0 +1,53 @@
+// Runs the regression tests; an argument runs only the cases whose name
+// contains it. Exits with 1 if a check failed.
+#include <cstring>
+#include <iostream>
+#include "test.h"
+
+static int failedChecks = 0;
+
+std::vector<TestCase> &testCases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+void testFailed(const char *file, int line, const std::string &message) {
+    std::cout << file << ":" << line << ": check failed: " << message << std::endl;
+    ++failedChecks;
+}
+
+QueryResult runQuery(Database &db, const std::string &sql, const std::vector<Value> &parameters) {
+    QueryResult result = db.execute(sql, parameters);
+    if (!result.ok)
+        testFailed(__FILE__, __LINE__, sql + ": " + result.error);
+    return result;
+}
+
+Value queryValue(Database &db, const std::string &sql, const std::vector<Value> &parameters) {
+    QueryResult result = runQuery(db, sql, parameters);
+    if (result.ok && result.rowCount == 0)
+        testFailed(__FILE__, __LINE__, sql + ": no rows");
+    return result.getValue(0, 0);
+}
+
+int main(int argc, char **argv) {
+    const char *filter = argc > 1 ? argv[1] : "";
+    int cases = 0;
+    int failedCases = 0;
+    for (const TestCase &test : testCases()) {
+        if (!std::strstr(test.name, filter))
+            continue;
+        std::cout << "[ RUN    ] " << test.name << std::endl;
+        int before = failedChecks;
+        test.run();
+        ++cases;
+        if (failedChecks != before) {
+            ++failedCases;
+            std::cout << "[ FAILED ] " << test.name << std::endl;
+        } else {
+            std::cout << "[     OK ] " << test.name << std::endl;
+        }
+    }
+    std::cout << cases << " test(s), " << failedCases << " failed" << std::endl;
+    return failedCases ? 1 : 0;
+}
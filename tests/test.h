@@ -0,0 +1,71 @@
+// Harness of runTests: TEST(name) registers a case, and CHECK and CHECK_EQ
+// report a failed condition and let the case go on.
+#pragma once
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../query_engine/database.h"
+
+struct TestCase {
+    const char *name;
+    void (*run)();
+};
+
+std::vector<TestCase> &testCases();
+
+// Marks the running case as failed.
+void testFailed(const char *file, int line, const std::string &message);
+
+struct TestRegistration {
+    TestRegistration(const char *name, void (*run)()) { testCases().push_back({name, run}); }
+};
+
+#define TEST(name)                                                  \
+    static void name();                                             \
+    static TestRegistration name##Registration(#name, name);        \
+    static void name()
+
+#define CHECK(condition)                                            \
+    do {                                                            \
+        if (!(condition))                                           \
+            testFailed(__FILE__, __LINE__, #condition);             \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                  \
+    do {                                                            \
+        auto actual_ = (actual);                                    \
+        auto expected_ = (expected);                                \
+        if (!(actual_ == expected_)) {                              \
+            std::ostringstream message_;                            \
+            message_ << #actual " == " #expected ": got " << actual_ \
+                     << ", expected " << expected_;                 \
+            testFailed(__FILE__, __LINE__, message_.str());         \
+        }                                                           \
+    } while (0)
+
+// A Database on a file of its own, which is removed with it.
+class TestDatabase {
+public:
+    explicit TestDatabase(const std::string &name, const DatabaseOptions &options = DatabaseOptions())
+        : fileName_(name + ".db"), db_(new Database(fileName_, options)) {}
+    ~TestDatabase() {
+        db_.reset();
+        std::remove(fileName_.c_str());
+    }
+
+    Database *operator->() { return db_.get(); }
+    Database &operator*() { return *db_; }
+    const std::string &getFileName() const { return fileName_; }
+
+private:
+    std::string fileName_;
+    std::unique_ptr<Database> db_;
+};
+
+// Runs 'sql' and checks that it succeeded.
+QueryResult runQuery(Database &db, const std::string &sql, const std::vector<Value> &parameters = {});
+
+// The first column of the first row of a query that must succeed.
+Value queryValue(Database &db, const std::string &sql, const std::vector<Value> &parameters = {});
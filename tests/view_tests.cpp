@@ -0,0 +1,75 @@
+// Materialized views kept up to date by INSERT, UPDATE and DELETE.
+#include <random>
+#include "test.h"
+
+// Compares the views with the queries that define them.
+static void checkViews(Database &db) {
+    CHECK_EQ(runQuery(db, "SELECT g, n, s, a FROM groups ORDER BY g").toString(),
+             runQuery(db, "SELECT v AS g, COUNT(*) AS n, SUM(x) AS s, AVG(w) AS a FROM t "
+                          "WHERE x > 3 GROUP BY v ORDER BY g").toString());
+    CHECK_EQ(runQuery(db, "SELECT total, rows FROM totals").toString(),
+             runQuery(db, "SELECT SUM(x) AS total, COUNT(*) AS rows FROM t").toString());
+}
+
+TEST(viewsFollowDml) {
+    DatabaseOptions options;
+    options.executor.numWorkers = 3;
+    TestDatabase db("views", options);
+    runQuery(*db, "CREATE TABLE t (id INT, v INT, x BIGINT, w DOUBLE)");
+    std::mt19937 rng(1);
+    for (int i = 0; i < 2000; ++i)
+        runQuery(*db, "INSERT INTO t VALUES (?, ?, ?, ?)",
+                 {Value::makeInteger(i), Value::makeInteger(rng() % 20), Value::makeBigint(rng() % 10),
+                  Value::makeDouble((rng() % 100) * 0.25)});
+    runQuery(*db, "CREATE MATERIALIZED VIEW groups AS SELECT v AS g, COUNT(*) AS n, SUM(x) AS s, AVG(w) AS a "
+                  "FROM t WHERE x > 3 GROUP BY v");
+    runQuery(*db, "CREATE MATERIALIZED VIEW totals AS SELECT SUM(x) AS total, COUNT(*) AS rows FROM t");
+    checkViews(*db);
+    for (int round = 0; round < 30; ++round) {
+        switch (rng() % 3) {
+        case 0:
+            runQuery(*db, "INSERT INTO t VALUES (?, ?, ?, ?)",
+                     {Value::makeInteger(5000 + round), Value::makeInteger(rng() % 25),
+                      Value::makeBigint(rng() % 10), Value::makeDouble(1.5)});
+            break;
+        case 1:
+            runQuery(*db, "UPDATE t SET v = v + 1, x = x + 2 WHERE id < ?", {Value::makeInteger(rng() % 2000)});
+            break;
+        default:
+            runQuery(*db, "DELETE FROM t WHERE v = ?", {Value::makeInteger(rng() % 25)});
+        }
+        checkViews(*db);
+    }
+    runQuery(*db, "DELETE FROM t");
+    checkViews(*db);
+}
+
+TEST(viewSumsStayExact) {
+    TestDatabase db("viewSums");
+    runQuery(*db, "CREATE TABLE t (id INT, x BIGINT)");
+    const int64_t big = (int64_t(1) << 53) + 1;
+    runQuery(*db, "INSERT INTO t VALUES (0, ?)", {Value::makeBigint(big)});
+    runQuery(*db, "CREATE MATERIALIZED VIEW v AS SELECT SUM(x) AS s, COUNT(*) AS n FROM t");
+    for (int i = 1; i <= 1000; ++i)
+        runQuery(*db, "INSERT INTO t VALUES (?, 1)", {Value::makeInteger(i)});
+    runQuery(*db, "DELETE FROM t WHERE id > 500");
+    CHECK_EQ(queryValue(*db, "SELECT s FROM v").integer, big + 500);
+}
+
+TEST(viewsRejectUnsupportedStatements) {
+    TestDatabase db("viewErrors");
+    runQuery(*db, "CREATE TABLE t (id INT, v INT, x BIGINT)");
+    runQuery(*db, "CREATE MATERIALIZED VIEW mv AS SELECT v AS g, COUNT(*) AS n FROM t GROUP BY v");
+    for (const char *sql : {"INSERT INTO mv VALUES (1, 1)",
+                            "UPDATE mv SET n = 0",
+                            "DELETE FROM mv",
+                            "CREATE INDEX i ON mv (g)",
+                            "CREATE MATERIALIZED VIEW m2 AS SELECT v, MAX(x) AS m FROM t GROUP BY v",
+                            "CREATE MATERIALIZED VIEW m2 AS SELECT v, id AS i FROM t GROUP BY v",
+                            "CREATE MATERIALIZED VIEW m2 AS SELECT v FROM t WHERE x > ? GROUP BY v",
+                            "CREATE MATERIALIZED VIEW mv AS SELECT v FROM t GROUP BY v"}) {
+        QueryResult result = db->execute(sql);
+        if (result.ok)
+            testFailed(__FILE__, __LINE__, std::string(sql) + " succeeded");
+    }
+}